@@ -28,6 +28,7 @@
 #include <string.h>
 
 #include "gstomx.h"
+#include "gstomxvideo.h"
 #include "gstomxmjpegdec.h"
 #include "gstomxmpeg2videodec.h"
 #include "gstomxmpeg4videodec.h"
@@ -48,6 +49,8 @@
 #include "gstomxamrdec.h"
 #include "gstomxanalogaudiosink.h"
 #include "gstomxhdmiaudiosink.h"
+#include "gstomxcache.h"
+#include "gstomxcopy.h"
 
 GST_DEBUG_CATEGORY (gstomx_debug);
 #define GST_CAT_DEFAULT gstomx_debug
@@ -74,6 +77,8 @@ gst_omx_core_acquire (const gchar * filename)
     core = g_slice_new0 (GstOMXCore);
     g_mutex_init (&core->lock);
     core->user_count = 0;
+    g_cond_init (&core->admission_cond);
+    core->reserved_macroblocks = g_hash_table_new (g_str_hash, g_str_equal);
     g_hash_table_insert (core_handles, g_strdup (filename), core);
 
     /* Hack for the Broadcom OpenMAX IL implementation */
@@ -178,6 +183,8 @@ error:
   {
     g_hash_table_remove (core_handles, filename);
     g_mutex_clear (&core->lock);
+    g_cond_clear (&core->admission_cond);
+    g_hash_table_unref (core->reserved_macroblocks);
     g_slice_free (GstOMXCore, core);
 
     G_UNLOCK (core_handles);
@@ -212,17 +219,217 @@ gst_omx_core_release (GstOMXCore * core)
   G_UNLOCK (core_handles);
 }
 
+/* Bounded multi-producer, single-consumer ring of preallocated
+ * messages. Every slot carries a sequence number that tells
+ * producers and the consumer whose turn it is to use the slot,
+ * so no locks or allocations are needed on either side.
+ */
+#define GST_OMX_MESSAGE_RING_DEFAULT_SIZE 64
+/* Control events that can be queued in addition to buffers */
+#define GST_OMX_MESSAGE_RING_CONTROL_SLOTS 32
+
+struct _GstOMXMessageRing
+{
+  guint size;                   /* Power of two */
+  gint head;                    /* ATOMIC, next slot to be reserved */
+  gint tail;                    /* ATOMIC, next slot to be read */
+  gint *seq;                    /* ATOMIC, sequence number per slot */
+  GstOMXMessage *slots;
+};
+
+static GstOMXMessageRing *
+gst_omx_message_ring_new (guint size)
+{
+  GstOMXMessageRing *ring;
+  guint i;
+
+  g_assert (size > 0 && (size & (size - 1)) == 0);
+
+  ring = g_slice_new0 (GstOMXMessageRing);
+  ring->size = size;
+  ring->seq = g_new (gint, size);
+  ring->slots = g_new0 (GstOMXMessage, size);
+  for (i = 0; i < size; i++)
+    ring->seq[i] = i;
+
+  return ring;
+}
+
+static void
+gst_omx_message_ring_free (GstOMXMessageRing * ring)
+{
+  g_free (ring->seq);
+  g_free (ring->slots);
+  g_slice_free (GstOMXMessageRing, ring);
+}
+
+/* Can be called from any number of threads at once.
+ * Returns FALSE if the ring is full */
+static gboolean
+gst_omx_message_ring_push (GstOMXMessageRing * ring, const GstOMXMessage * msg)
+{
+  guint mask = ring->size - 1;
+  guint pos, seq;
+  gint diff;
+
+  pos = g_atomic_int_get (&ring->head);
+  for (;;) {
+    seq = g_atomic_int_get (&ring->seq[pos & mask]);
+    diff = (gint) (seq - pos);
+
+    if (diff == 0) {
+      /* Slot is free, try to reserve it */
+      if (g_atomic_int_compare_and_exchange (&ring->head, (gint) pos,
+              (gint) (pos + 1)))
+        break;
+    } else if (diff < 0) {
+      /* Slot still contains a message from the previous round */
+      return FALSE;
+    }
+
+    /* Another producer was faster */
+    pos = g_atomic_int_get (&ring->head);
+  }
+
+  ring->slots[pos & mask] = *msg;
+  g_atomic_int_set (&ring->seq[pos & mask], (gint) (pos + 1));
+
+  return TRUE;
+}
+
+/* Must only be called from one thread at a time.
+ * Returns FALSE if the ring is empty */
+static gboolean
+gst_omx_message_ring_pop (GstOMXMessageRing * ring, GstOMXMessage * msg)
+{
+  guint mask = ring->size - 1;
+  guint pos, seq;
+
+  pos = g_atomic_int_get (&ring->tail);
+  seq = g_atomic_int_get (&ring->seq[pos & mask]);
+  if ((gint) (seq - (pos + 1)) < 0)
+    return FALSE;
+
+  *msg = ring->slots[pos & mask];
+  g_atomic_int_set (&ring->tail, (gint) (pos + 1));
+  g_atomic_int_set (&ring->seq[pos & mask], (gint) (pos + ring->size));
+
+  return TRUE;
+}
+
+/* Might return TRUE for a message that is only being written
+ * or was just read, but never FALSE if a message is available */
+static gboolean
+gst_omx_message_ring_is_empty (GstOMXMessageRing * ring)
+{
+  guint mask = ring->size - 1;
+  guint pos, seq;
+
+  pos = g_atomic_int_get (&ring->tail);
+  seq = g_atomic_int_get (&ring->seq[pos & mask]);
+
+  return (gint) (seq - (pos + 1)) < 0;
+}
+
+/* NOTE: Call with comp->lock, comp->messages_lock will be used */
+static void
+gst_omx_component_resize_message_ring (GstOMXComponent * comp, guint size)
+{
+  GstOMXMessageRing *old_ring = comp->messages_ring;
+  GstOMXMessage msg;
+  guint n = 0;
+
+  if (old_ring->size >= size)
+    return;
+
+  GST_DEBUG_OBJECT (comp->parent, "%s growing message ring from %u to %u",
+      comp->name, old_ring->size, size);
+
+  g_mutex_lock (&comp->messages_lock);
+
+  /* Send all new messages to the overflow queue and wait until
+   * everybody who is still writing to the old ring is done */
+  g_atomic_int_set (&comp->messages_overflow, 1);
+  while (g_atomic_int_get (&comp->messages_ring_writers) > 0)
+    g_thread_yield ();
+
+  /* Everything left in the old ring is older than what is
+   * in the overflow queue */
+  while (gst_omx_message_ring_pop (old_ring, &msg))
+    g_queue_push_nth (&comp->messages, g_slice_dup (GstOMXMessage, &msg), n++);
+
+  g_atomic_pointer_set (&comp->messages_ring,
+      gst_omx_message_ring_new (size));
+  if (g_queue_is_empty (&comp->messages))
+    g_atomic_int_set (&comp->messages_overflow, 0);
+
+  g_mutex_unlock (&comp->messages_lock);
+
+  gst_omx_message_ring_free (old_ring);
+}
+
+/* NOTE: Call with comp->lock, comp->messages_lock will be used */
+static void
+gst_omx_component_update_message_ring (GstOMXComponent * comp)
+{
+  guint i, n, size, needed = GST_OMX_MESSAGE_RING_CONTROL_SLOTS;
+
+  /* Every buffer can only be done once before it is
+   * given back to the component again */
+  n = (comp->ports ? comp->ports->len : 0);
+  for (i = 0; i < n; i++) {
+    GstOMXPort *port = g_ptr_array_index (comp->ports, i);
+
+    needed += port->port_def.nBufferCountActual;
+  }
+
+  size = comp->messages_ring->size;
+  while (size < needed)
+    size <<= 1;
+
+  gst_omx_component_resize_message_ring (comp, size);
+}
+
 /* NOTE: comp->messages_lock will be used */
 static void
 gst_omx_component_flush_messages (GstOMXComponent * comp)
 {
-  GstOMXMessage *msg;
+  GstOMXMessage *msg, tmp;
 
   g_mutex_lock (&comp->messages_lock);
+  while (gst_omx_message_ring_pop (comp->messages_ring, &tmp));
   while ((msg = g_queue_pop_head (&comp->messages))) {
     g_slice_free (GstOMXMessage, msg);
   }
+  g_atomic_int_set (&comp->messages_overflow, 0);
+  g_mutex_unlock (&comp->messages_lock);
+}
+
+/* NOTE: Call with comp->lock, comp->messages_lock might be used */
+static gboolean
+gst_omx_component_pop_message (GstOMXComponent * comp, GstOMXMessage * msg)
+{
+  GstOMXMessage *overflow_msg;
+
+  if (gst_omx_message_ring_pop (comp->messages_ring, msg))
+    return TRUE;
+
+  if (!g_atomic_int_get (&comp->messages_overflow))
+    return FALSE;
+
+  g_mutex_lock (&comp->messages_lock);
+  overflow_msg = g_queue_pop_head (&comp->messages);
+  if (g_queue_is_empty (&comp->messages))
+    g_atomic_int_set (&comp->messages_overflow, 0);
   g_mutex_unlock (&comp->messages_lock);
+
+  if (!overflow_msg)
+    return FALSE;
+
+  *msg = *overflow_msg;
+  g_slice_free (GstOMXMessage, overflow_msg);
+
+  return TRUE;
 }
 
 static void
@@ -234,16 +441,96 @@ gst_omx_buffer_reset (GstOMXBuffer * buf)
   GST_OMX_SET_TICKS (buf->omx_buf->nTimeStamp, G_GUINT64_CONSTANT (0));
 }
 
-/* NOTE: Call with comp->lock, comp->messages_lock will be used */
+/* NOTE: Must be called while holding comp->lock */
+static inline void
+gst_omx_port_push_pending (GstOMXPort * port, GstOMXBuffer * buf)
+{
+  if (G_UNLIKELY (port->comp->tracer_stats))
+    buf->pending_time = g_get_monotonic_time ();
+
+  /* Not used by the component anymore, can be filled by upstream again */
+  if (G_UNLIKELY (buf->pool_buffer))
+    g_clear_pointer (&buf->pool_buffer, gst_buffer_unref);
+
+  g_queue_push_tail (&port->pending_buffers, buf);
+}
+
+/* NOTE: Must be called while holding comp->lock */
 static void
-gst_omx_component_handle_messages (GstOMXComponent * comp)
+gst_omx_component_timeline_add (GstOMXComponent * comp, const gchar * phase,
+    gint port, gint64 start, gint64 end)
 {
-  GstOMXMessage *msg;
+  GstOMXTimelineEntry entry;
 
-  g_mutex_lock (&comp->messages_lock);
-  while ((msg = g_queue_pop_head (&comp->messages))) {
-    g_mutex_unlock (&comp->messages_lock);
+  if (!comp->timeline || comp->timeline_complete || start == 0)
+    return;
+
+  entry.phase = phase;
+  entry.port = port;
+  entry.start = start;
+  entry.end = end;
+  g_array_append_val (comp->timeline, entry);
+}
+
+static const gchar *
+gst_omx_state_to_timeline_phase (OMX_STATETYPE state)
+{
+  switch (state) {
+    case OMX_StateLoaded:
+      return "state-loaded";
+    case OMX_StateIdle:
+      return "state-idle";
+    case OMX_StateExecuting:
+      return "state-executing";
+    case OMX_StatePause:
+      return "state-pause";
+    default:
+      return "state-other";
+  }
+}
+
+/* Buffers done only wake up the threads waiting on their port and
+ * threads waiting for any message, everything else wakes up everybody.
+ *
+ * NOTE: Must be called while holding comp->messages_lock */
+static void
+gst_omx_component_wake_waiters (GstOMXComponent * comp,
+    const GstOMXMessage * msg)
+{
+  gint i, n;
+
+  if (msg && msg->type == GST_OMX_MESSAGE_BUFFER_DONE) {
+    GstOMXBuffer *buf = msg->content.buffer_done.buffer->pAppPrivate;
+
+    if (buf->port->messages_waiters > 0)
+      g_cond_broadcast (&buf->port->messages_cond);
+    if (g_atomic_int_get (&comp->messages_waiters) >
+        comp->messages_port_waiters)
+      g_cond_broadcast (&comp->messages_cond);
+    return;
+  }
+
+  g_cond_broadcast (&comp->messages_cond);
+
+  if (comp->messages_port_waiters == 0)
+    return;
+
+  n = (comp->ports ? comp->ports->len : 0);
+  for (i = 0; i < n; i++) {
+    GstOMXPort *port = g_ptr_array_index (comp->ports, i);
+
+    if (port->messages_waiters > 0)
+      g_cond_broadcast (&port->messages_cond);
+  }
+}
+
+/* NOTE: Call with comp->lock, comp->messages_lock might be used */
+static void
+gst_omx_component_handle_messages (GstOMXComponent * comp)
+{
+  GstOMXMessage tmp, *msg = &tmp;
 
+  while (gst_omx_component_pop_message (comp, msg)) {
     switch (msg->type) {
       case GST_OMX_MESSAGE_STATE_SET:{
         GST_INFO_OBJECT (comp->parent, "%s state change to %s finished",
@@ -251,6 +538,9 @@ gst_omx_component_handle_messages (GstOMXComponent * comp)
         comp->state = msg->content.state_set.state;
         if (comp->state == comp->pending_state)
           comp->pending_state = OMX_StateInvalid;
+        gst_omx_component_timeline_add (comp,
+            gst_omx_state_to_timeline_phase (comp->state), -1,
+            comp->timeline_state_start, g_get_monotonic_time ());
         break;
       }
       case GST_OMX_MESSAGE_FLUSH:{
@@ -287,7 +577,9 @@ gst_omx_component_handle_messages (GstOMXComponent * comp)
          */
         if (comp->last_error == OMX_ErrorNone)
           comp->last_error = error;
-        g_cond_broadcast (&comp->messages_cond);
+        g_mutex_lock (&comp->messages_lock);
+        gst_omx_component_wake_waiters (comp, NULL);
+        g_mutex_unlock (&comp->messages_lock);
 
         break;
       }
@@ -303,10 +595,13 @@ gst_omx_component_handle_messages (GstOMXComponent * comp)
         GST_DEBUG_OBJECT (comp->parent, "%s port %u %s", comp->name,
             port->index, (enable ? "enabled" : "disabled"));
 
-        if (enable)
+        if (enable) {
           port->enabled_pending = FALSE;
-        else
+          gst_omx_component_timeline_add (comp, "port-enable", port->index,
+              port->timeline_enable_start, g_get_monotonic_time ());
+        } else {
           port->disabled_pending = FALSE;
+        }
         break;
       }
       case GST_OMX_MESSAGE_PORT_SETTINGS_CHANGED:{
@@ -396,11 +691,25 @@ gst_omx_component_handle_messages (GstOMXComponent * comp)
           if ((buf->omx_buf->nFlags & OMX_BUFFERFLAG_EOS)
               && port->port_def.eDir == OMX_DirOutput)
             port->eos = TRUE;
+
+          buf->filled_settings_cookie = port->settings_cookie;
+
+          if (G_UNLIKELY (comp->timeline && !comp->timeline_complete)
+              && buf->omx_buf->nFilledLen > 0) {
+            gst_omx_component_timeline_add (comp, "first-fill-buffer-done",
+                port->index, buf->done_time, buf->done_time);
+            comp->timeline_complete = TRUE;
+          }
         }
 
         buf->used = FALSE;
 
-        g_queue_push_tail (&port->pending_buffers, buf);
+        port->n_used--;
+        port->min_used = MIN (port->min_used, port->n_used);
+        if (port->n_used == 0 && !port->flushing && !port->eos)
+          port->starved_since = buf->done_time;
+
+        gst_omx_port_push_pending (port, buf);
 
         break;
       }
@@ -409,32 +718,64 @@ gst_omx_component_handle_messages (GstOMXComponent * comp)
         break;
       }
     }
-
-    g_slice_free (GstOMXMessage, msg);
-
-    g_mutex_lock (&comp->messages_lock);
   }
+}
 
-  g_mutex_unlock (&comp->messages_lock);
+/* Invalidates the fast path of gst_omx_port_acquire_buffers() */
+static inline void
+gst_omx_component_control_event (GstOMXComponent * comp)
+{
+  g_atomic_int_inc (&comp->control_generation);
 }
 
-/* NOTE: comp->messages_lock will be used */
+/* NOTE: comp->messages_lock is only used if the ring overflows,
+ * somebody is waiting for messages or msg is NULL */
 static void
-gst_omx_component_send_message (GstOMXComponent * comp, GstOMXMessage * msg)
+gst_omx_component_send_message (GstOMXComponent * comp,
+    const GstOMXMessage * msg)
 {
-  g_mutex_lock (&comp->messages_lock);
-  if (msg)
-    g_queue_push_tail (&comp->messages, msg);
-  g_cond_broadcast (&comp->messages_cond);
-  g_mutex_unlock (&comp->messages_lock);
+  gboolean pushed = FALSE;
+
+  if (msg) {
+    g_atomic_int_inc (&comp->messages_ring_writers);
+    if (!g_atomic_int_get (&comp->messages_overflow))
+      pushed =
+          gst_omx_message_ring_push (g_atomic_pointer_get
+          (&comp->messages_ring), msg);
+    g_atomic_int_dec_and_test (&comp->messages_ring_writers);
+
+    if (!pushed) {
+      g_mutex_lock (&comp->messages_lock);
+      g_queue_push_tail (&comp->messages, g_slice_dup (GstOMXMessage, msg));
+      g_atomic_int_set (&comp->messages_overflow, 1);
+      g_mutex_unlock (&comp->messages_lock);
+    }
+  }
+
+  /* Only after the message can be seen by the streaming threads */
+  if (!msg || msg->type != GST_OMX_MESSAGE_BUFFER_DONE)
+    gst_omx_component_control_event (comp);
+
+  /* Nobody can miss the message: waiters are counted before
+   * they check for messages */
+  if (!msg || !pushed || g_atomic_int_get (&comp->messages_waiters) > 0) {
+    g_mutex_lock (&comp->messages_lock);
+    gst_omx_component_wake_waiters (comp, msg);
+    g_mutex_unlock (&comp->messages_lock);
+  }
 }
 
-/* NOTE: Call with comp->lock, comp->messages_lock will be used */
+/* If port is not NULL only buffers done on this port and
+ * component-wide events will wake up the caller.
+ *
+ * NOTE: Call with comp->lock, comp->messages_lock will be used */
 static gboolean
-gst_omx_component_wait_message (GstOMXComponent * comp, GstClockTime timeout)
+gst_omx_component_wait_message_full (GstOMXComponent * comp,
+    GstOMXPort * port, GstClockTime timeout)
 {
-  gboolean signalled;
-  gint64 wait_until = -1;
+  GCond *cond = (port ? &port->messages_cond : &comp->messages_cond);
+  gboolean signalled, pending;
+  gint64 wait_until = -1, wait_start = 0;
 
   if (timeout != GST_CLOCK_TIME_NONE) {
     gint64 add = timeout / (GST_SECOND / G_TIME_SPAN_SECOND);
@@ -449,18 +790,42 @@ gst_omx_component_wait_message (GstOMXComponent * comp, GstClockTime timeout)
     GST_DEBUG_OBJECT (comp->parent, "%s waiting for signal", comp->name);
   }
 
+  /* Register as waiter and check for messages while still holding
+   * comp->lock: nobody else can consume a message that arrived since
+   * the caller checked the port, and everything sent later sees the
+   * waiter and wakes it up */
   g_mutex_lock (&comp->messages_lock);
+  if (port) {
+    port->messages_waiters++;
+    comp->messages_port_waiters++;
+  }
+  g_atomic_int_inc (&comp->messages_waiters);
+  pending = g_atomic_int_get (&comp->messages_overflow)
+      || !gst_omx_message_ring_is_empty (comp->messages_ring);
   g_mutex_unlock (&comp->lock);
 
-  if (!g_queue_is_empty (&comp->messages)) {
-    signalled = TRUE;
-  } else if (timeout == GST_CLOCK_TIME_NONE) {
-    g_cond_wait (&comp->messages_cond, &comp->messages_lock);
+  if (pending) {
     signalled = TRUE;
   } else {
-    signalled =
-        g_cond_wait_until (&comp->messages_cond, &comp->messages_lock,
-        wait_until);
+    if (G_UNLIKELY (comp->tracer_stats))
+      wait_start = g_get_monotonic_time ();
+
+    if (timeout == GST_CLOCK_TIME_NONE) {
+      g_cond_wait (cond, &comp->messages_lock);
+      signalled = TRUE;
+    } else {
+      signalled = g_cond_wait_until (cond, &comp->messages_lock, wait_until);
+    }
+
+    if (G_UNLIKELY (comp->tracer_stats))
+      gst_omx_tracer_stats_add (comp->tracer_stats,
+          GST_OMX_TRACER_METRIC_BLOCKED, g_get_monotonic_time () - wait_start);
+  }
+
+  g_atomic_int_dec_and_test (&comp->messages_waiters);
+  if (port) {
+    port->messages_waiters--;
+    comp->messages_port_waiters--;
   }
 
   g_mutex_unlock (&comp->messages_lock);
@@ -469,6 +834,57 @@ gst_omx_component_wait_message (GstOMXComponent * comp, GstClockTime timeout)
   return signalled;
 }
 
+/* NOTE: Call with comp->lock, comp->messages_lock will be used */
+static gboolean
+gst_omx_component_wait_message (GstOMXComponent * comp, GstClockTime timeout)
+{
+  return gst_omx_component_wait_message_full (comp, NULL, timeout);
+}
+
+/* NOTE: Call with comp->lock, comp->messages_lock will be used */
+static gboolean
+gst_omx_port_wait_message (GstOMXPort * port, GstClockTime timeout)
+{
+  return gst_omx_component_wait_message_full (port->comp, port, timeout);
+}
+
+/* Removes the state callback if it waits for state, any callback is
+ * removed for OMX_StateInvalid.
+ * NOTE: Uses comp->messages_lock */
+static gboolean
+gst_omx_component_take_state_callback (GstOMXComponent * comp,
+    OMX_STATETYPE state, GstOMXComponentStateCallback * callback,
+    gpointer * user_data)
+{
+  gboolean ret = FALSE;
+
+  g_mutex_lock (&comp->messages_lock);
+  if (comp->state_callback && (state == OMX_StateInvalid
+          || state == comp->state_callback_state)) {
+    *callback = comp->state_callback;
+    *user_data = comp->state_callback_data;
+    comp->state_callback = NULL;
+    comp->state_callback_data = NULL;
+    ret = TRUE;
+  }
+  g_mutex_unlock (&comp->messages_lock);
+
+  return ret;
+}
+
+/* NOTE: Uses comp->messages_lock, must be called without comp->lock */
+static void
+gst_omx_component_notify_state (GstOMXComponent * comp, OMX_STATETYPE state,
+    OMX_ERRORTYPE err)
+{
+  GstOMXComponentStateCallback callback;
+  gpointer user_data;
+
+  if (gst_omx_component_take_state_callback (comp, state, &callback,
+          &user_data))
+    callback (comp, state, err, user_data);
+}
+
 static OMX_ERRORTYPE
 EventHandler (OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_EVENTTYPE eEvent,
     OMX_U32 nData1, OMX_U32 nData2, OMX_PTR pEventData)
@@ -485,41 +901,42 @@ EventHandler (OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_EVENTTYPE eEvent,
 
       switch (cmd) {
         case OMX_CommandStateSet:{
-          GstOMXMessage *msg = g_slice_new (GstOMXMessage);
+          GstOMXMessage msg;
 
-          msg->type = GST_OMX_MESSAGE_STATE_SET;
-          msg->content.state_set.state = nData2;
+          msg.type = GST_OMX_MESSAGE_STATE_SET;
+          msg.content.state_set.state = nData2;
 
           GST_DEBUG_OBJECT (comp->parent, "%s state change to %s finished",
-              comp->name,
-              gst_omx_state_to_string (msg->content.state_set.state));
+              comp->name, gst_omx_state_to_string (msg.content.state_set.state));
 
-          gst_omx_component_send_message (comp, msg);
+          gst_omx_component_send_message (comp, &msg);
+          gst_omx_component_notify_state (comp, msg.content.state_set.state,
+              OMX_ErrorNone);
           break;
         }
         case OMX_CommandFlush:{
-          GstOMXMessage *msg = g_slice_new (GstOMXMessage);
+          GstOMXMessage msg;
 
-          msg->type = GST_OMX_MESSAGE_FLUSH;
-          msg->content.flush.port = nData2;
+          msg.type = GST_OMX_MESSAGE_FLUSH;
+          msg.content.flush.port = nData2;
           GST_DEBUG_OBJECT (comp->parent, "%s port %u flushed", comp->name,
-              (guint) msg->content.flush.port);
+              (guint) msg.content.flush.port);
 
-          gst_omx_component_send_message (comp, msg);
+          gst_omx_component_send_message (comp, &msg);
           break;
         }
         case OMX_CommandPortEnable:
         case OMX_CommandPortDisable:{
-          GstOMXMessage *msg = g_slice_new (GstOMXMessage);
+          GstOMXMessage msg;
 
-          msg->type = GST_OMX_MESSAGE_PORT_ENABLE;
-          msg->content.port_enable.port = nData2;
-          msg->content.port_enable.enable = (cmd == OMX_CommandPortEnable);
+          msg.type = GST_OMX_MESSAGE_PORT_ENABLE;
+          msg.content.port_enable.port = nData2;
+          msg.content.port_enable.enable = (cmd == OMX_CommandPortEnable);
           GST_DEBUG_OBJECT (comp->parent, "%s port %u %s", comp->name,
-              (guint) msg->content.port_enable.port,
-              (msg->content.port_enable.enable ? "enabled" : "disabled"));
+              (guint) msg.content.port_enable.port,
+              (msg.content.port_enable.enable ? "enabled" : "disabled"));
 
-          gst_omx_component_send_message (comp, msg);
+          gst_omx_component_send_message (comp, &msg);
           break;
         }
         default:
@@ -529,7 +946,7 @@ EventHandler (OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_EVENTTYPE eEvent,
     }
     case OMX_EventError:
     {
-      GstOMXMessage *msg;
+      GstOMXMessage msg;
       OMX_ERRORTYPE error_type = nData1;
 
       /* Yes, this really happens... */
@@ -545,20 +962,20 @@ EventHandler (OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_EVENTTYPE eEvent,
         break;
       }
 
-      msg = g_slice_new (GstOMXMessage);
-
-      msg->type = GST_OMX_MESSAGE_ERROR;
-      msg->content.error.error = error_type;
+      msg.type = GST_OMX_MESSAGE_ERROR;
+      msg.content.error.error = error_type;
       GST_ERROR_OBJECT (comp->parent, "%s got error: %s (0x%08x)", comp->name,
-          gst_omx_error_to_string (msg->content.error.error),
-          msg->content.error.error);
+          gst_omx_error_to_string (msg.content.error.error),
+          msg.content.error.error);
 
-      gst_omx_component_send_message (comp, msg);
+      gst_omx_component_send_message (comp, &msg);
+      /* Any pending state change will fail now */
+      gst_omx_component_notify_state (comp, OMX_StateInvalid, error_type);
       break;
     }
     case OMX_EventPortSettingsChanged:
     {
-      GstOMXMessage *msg = g_slice_new (GstOMXMessage);
+      GstOMXMessage msg;
       OMX_U32 index;
 
       if (!(comp->hacks &
@@ -575,28 +992,26 @@ EventHandler (OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_EVENTTYPE eEvent,
         index = 1;
 
 
-      msg->type = GST_OMX_MESSAGE_PORT_SETTINGS_CHANGED;
-      msg->content.port_settings_changed.port = index;
+      msg.type = GST_OMX_MESSAGE_PORT_SETTINGS_CHANGED;
+      msg.content.port_settings_changed.port = index;
       GST_DEBUG_OBJECT (comp->parent, "%s settings changed (port index: %u)",
-          comp->name, (guint) msg->content.port_settings_changed.port);
+          comp->name, (guint) msg.content.port_settings_changed.port);
 
-      gst_omx_component_send_message (comp, msg);
+      gst_omx_component_send_message (comp, &msg);
       break;
     }
     case OMX_EventBufferFlag:{
-      GstOMXMessage *msg;
+      GstOMXMessage msg;
 
-      msg = g_slice_new (GstOMXMessage);
-
-      msg->type = GST_OMX_MESSAGE_BUFFER_FLAG;
-      msg->content.buffer_flag.port = nData1;
-      msg->content.buffer_flag.flags = nData2;
+      msg.type = GST_OMX_MESSAGE_BUFFER_FLAG;
+      msg.content.buffer_flag.port = nData1;
+      msg.content.buffer_flag.flags = nData2;
       GST_DEBUG_OBJECT (comp->parent, "%s port %u got buffer flags 0x%08x (%s)",
-          comp->name, (guint) msg->content.buffer_flag.port,
-          (guint) msg->content.buffer_flag.flags,
-          gst_omx_buffer_flags_to_string (msg->content.buffer_flag.flags));
+          comp->name, (guint) msg.content.buffer_flag.port,
+          (guint) msg.content.buffer_flag.flags,
+          gst_omx_buffer_flags_to_string (msg.content.buffer_flag.flags));
 
-      gst_omx_component_send_message (comp, msg);
+      gst_omx_component_send_message (comp, &msg);
       break;
     }
     case OMX_EventPortFormatDetected:
@@ -635,7 +1050,7 @@ EmptyBufferDone (OMX_HANDLETYPE hComponent, OMX_PTR pAppData,
 {
   GstOMXBuffer *buf;
   GstOMXComponent *comp;
-  GstOMXMessage *msg;
+  GstOMXMessage msg;
 
   buf = pBuffer->pAppPrivate;
   if (!buf) {
@@ -655,17 +1070,21 @@ EmptyBufferDone (OMX_HANDLETYPE hComponent, OMX_PTR pAppData,
 
   comp = buf->port->comp;
 
-  msg = g_slice_new (GstOMXMessage);
-  msg->type = GST_OMX_MESSAGE_BUFFER_DONE;
-  msg->content.buffer_done.component = hComponent;
-  msg->content.buffer_done.app_data = pAppData;
-  msg->content.buffer_done.buffer = pBuffer;
-  msg->content.buffer_done.empty = OMX_TRUE;
+  buf->done_time = g_get_monotonic_time ();
+  if (G_UNLIKELY (comp->tracer_stats) && buf->submit_time > 0)
+    gst_omx_tracer_stats_add (comp->tracer_stats,
+        GST_OMX_TRACER_METRIC_RESIDENCY, buf->done_time - buf->submit_time);
+
+  msg.type = GST_OMX_MESSAGE_BUFFER_DONE;
+  msg.content.buffer_done.component = hComponent;
+  msg.content.buffer_done.app_data = pAppData;
+  msg.content.buffer_done.buffer = pBuffer;
+  msg.content.buffer_done.empty = OMX_TRUE;
 
   GST_LOG_OBJECT (comp->parent, "%s port %u emptied buffer %p (%p)",
       comp->name, buf->port->index, buf, buf->omx_buf->pBuffer);
 
-  gst_omx_component_send_message (comp, msg);
+  gst_omx_component_send_message (comp, &msg);
 
   return OMX_ErrorNone;
 }
@@ -676,7 +1095,7 @@ FillBufferDone (OMX_HANDLETYPE hComponent, OMX_PTR pAppData,
 {
   GstOMXBuffer *buf;
   GstOMXComponent *comp;
-  GstOMXMessage *msg;
+  GstOMXMessage msg;
 
   buf = pBuffer->pAppPrivate;
   if (!buf) {
@@ -693,17 +1112,21 @@ FillBufferDone (OMX_HANDLETYPE hComponent, OMX_PTR pAppData,
 
   comp = buf->port->comp;
 
-  msg = g_slice_new (GstOMXMessage);
-  msg->type = GST_OMX_MESSAGE_BUFFER_DONE;
-  msg->content.buffer_done.component = hComponent;
-  msg->content.buffer_done.app_data = pAppData;
-  msg->content.buffer_done.buffer = pBuffer;
-  msg->content.buffer_done.empty = OMX_FALSE;
+  buf->done_time = g_get_monotonic_time ();
+  if (G_UNLIKELY (comp->tracer_stats) && buf->submit_time > 0)
+    gst_omx_tracer_stats_add (comp->tracer_stats,
+        GST_OMX_TRACER_METRIC_RESIDENCY, buf->done_time - buf->submit_time);
+
+  msg.type = GST_OMX_MESSAGE_BUFFER_DONE;
+  msg.content.buffer_done.component = hComponent;
+  msg.content.buffer_done.app_data = pAppData;
+  msg.content.buffer_done.buffer = pBuffer;
+  msg.content.buffer_done.empty = OMX_FALSE;
 
   GST_LOG_OBJECT (comp->parent, "%s port %u filled buffer %p (%p)", comp->name,
       buf->port->index, buf, buf->omx_buf->pBuffer);
 
-  gst_omx_component_send_message (comp, msg);
+  gst_omx_component_send_message (comp, &msg);
 
   return OMX_ErrorNone;
 }
@@ -720,11 +1143,16 @@ gst_omx_component_new (GstObject * parent, const gchar * core_name,
   GstOMXCore *core;
   GstOMXComponent *comp;
   const gchar *dot;
+  gint64 start, core_loaded, got_handle;
+
+  start = g_get_monotonic_time ();
 
   core = gst_omx_core_acquire (core_name);
   if (!core)
     return NULL;
 
+  core_loaded = g_get_monotonic_time ();
+
   comp = g_slice_new0 (GstOMXComponent);
   comp->core = core;
 
@@ -748,7 +1176,9 @@ gst_omx_component_new (GstObject * parent, const gchar * core_name,
   GST_DEBUG_OBJECT (parent,
       "Successfully got component handle %p (%s) from core '%s'", comp->handle,
       component_name, core_name);
-  comp->parent = gst_object_ref (parent);
+  got_handle = g_get_monotonic_time ();
+  /* No parent when probing components during registration */
+  comp->parent = parent ? gst_object_ref (parent) : NULL;
   comp->hacks = hacks;
 
   comp->ports = g_ptr_array_new ();
@@ -760,9 +1190,26 @@ gst_omx_component_new (GstObject * parent, const gchar * core_name,
   g_cond_init (&comp->messages_cond);
 
   g_queue_init (&comp->messages);
+  comp->messages_ring =
+      gst_omx_message_ring_new (GST_OMX_MESSAGE_RING_DEFAULT_SIZE);
   comp->pending_state = OMX_StateInvalid;
   comp->last_error = OMX_ErrorNone;
 
+  comp->timeline = g_array_new (FALSE, FALSE, sizeof (GstOMXTimelineEntry));
+  comp->timeline_start = start;
+  gst_omx_component_timeline_add (comp, "core-load", -1, start, core_loaded);
+  gst_omx_component_timeline_add (comp, "get-handle", -1, core_loaded,
+      got_handle);
+
+  if (parent && GST_OMX_TRACER_IS_ACTIVE ()) {
+    gchar *stats_name;
+
+    stats_name = g_strdup_printf ("%s:%s", GST_OBJECT_NAME (parent),
+        comp->name);
+    comp->tracer_stats = gst_omx_tracer_stats_new (stats_name);
+    g_free (stats_name);
+  }
+
   /* Set component role if any */
   if (component_role && !(hacks & GST_OMX_HACK_NO_COMPONENT_ROLE)) {
     OMX_PARAM_COMPONENTROLETYPE param;
@@ -803,6 +1250,8 @@ gst_omx_component_free (GstOMXComponent * comp)
 
   GST_INFO_OBJECT (comp->parent, "Unloading component %p %s", comp, comp->name);
 
+  gst_omx_component_unreserve (comp);
+
   if (comp->ports) {
     n = comp->ports->len;
     for (i = 0; i < n; i++) {
@@ -812,6 +1261,7 @@ gst_omx_component_free (GstOMXComponent * comp)
       g_assert (port->buffers == NULL);
       g_assert (g_queue_get_length (&port->pending_buffers) == 0);
 
+      g_cond_clear (&port->messages_cond);
       g_slice_free (GstOMXPort, port);
     }
     g_ptr_array_unref (comp->ports);
@@ -821,13 +1271,28 @@ gst_omx_component_free (GstOMXComponent * comp)
   comp->core->free_handle (comp->handle);
   gst_omx_core_release (comp->core);
 
+  /* No callbacks can happen anymore */
+  gst_omx_component_notify_state (comp, OMX_StateInvalid, OMX_ErrorNone);
+
+  if (comp->tracer_stats) {
+    gst_omx_tracer_stats_free (comp->tracer_stats);
+    comp->tracer_stats = NULL;
+  }
+
   gst_omx_component_flush_messages (comp);
+  gst_omx_message_ring_free (comp->messages_ring);
+  comp->messages_ring = NULL;
+
+  if (comp->timeline)
+    g_array_free (comp->timeline, TRUE);
+  comp->timeline = NULL;
 
   g_cond_clear (&comp->messages_cond);
   g_mutex_clear (&comp->messages_lock);
   g_mutex_clear (&comp->lock);
 
-  gst_object_unref (comp->parent);
+  if (comp->parent)
+    gst_object_unref (comp->parent);
 
   g_free (comp->name);
   comp->name = NULL;
@@ -839,8 +1304,27 @@ gst_omx_component_free (GstOMXComponent * comp)
 OMX_ERRORTYPE
 gst_omx_component_set_state (GstOMXComponent * comp, OMX_STATETYPE state)
 {
-  OMX_STATETYPE old_state;
+  return gst_omx_component_set_state_async (comp, state, NULL, NULL);
+}
+
+/* Starts the state change without waiting for it, callback is called
+ * once it finished. The state change can still be waited for with
+ * gst_omx_component_get_state(). This allows to change the state of
+ * many components at the same time.
+ *
+ * callback can be called from this function already if the component
+ * is in the requested state or on errors.
+ *
+ * NOTE: Uses comp->lock and comp->messages_lock */
+OMX_ERRORTYPE
+gst_omx_component_set_state_async (GstOMXComponent * comp,
+    OMX_STATETYPE state, GstOMXComponentStateCallback callback,
+    gpointer user_data)
+{
+  OMX_STATETYPE old_state, done_state = OMX_StateInvalid;
   OMX_ERRORTYPE err = OMX_ErrorNone;
+  GstOMXComponentStateCallback old_callback = NULL, done_callback = NULL;
+  gpointer old_user_data = NULL, done_user_data = NULL;
 
   g_return_val_if_fail (comp != NULL, OMX_ErrorUndefined);
 
@@ -852,6 +1336,16 @@ gst_omx_component_set_state (GstOMXComponent * comp, OMX_STATETYPE state)
   GST_INFO_OBJECT (comp->parent, "Setting %s state from %s to %s", comp->name,
       gst_omx_state_to_string (old_state), gst_omx_state_to_string (state));
 
+  /* Replace the callback before sending the command, the state change
+   * can finish before OMX_SendCommand() returns */
+  g_mutex_lock (&comp->messages_lock);
+  old_callback = comp->state_callback;
+  old_user_data = comp->state_callback_data;
+  comp->state_callback = callback;
+  comp->state_callback_data = user_data;
+  comp->state_callback_state = state;
+  g_mutex_unlock (&comp->messages_lock);
+
   if ((err = comp->last_error) != OMX_ErrorNone && state > old_state) {
     GST_ERROR_OBJECT (comp->parent, "Component %s in error state: %s (0x%08x)",
         comp->name, gst_omx_error_to_string (err), err);
@@ -875,6 +1369,7 @@ gst_omx_component_set_state (GstOMXComponent * comp, OMX_STATETYPE state)
     gst_omx_component_send_message (comp, NULL);
   }
 
+  comp->timeline_state_start = g_get_monotonic_time ();
   err = OMX_SendCommand (comp->handle, OMX_CommandStateSet, state, NULL);
   /* No need to check if anything has changed here */
 
@@ -887,6 +1382,17 @@ done:
         "Last operation returned an error. Setting last_error manually.");
     comp->last_error = err;
   }
+  gst_omx_component_control_event (comp);
+
+  /* Already finished or failed, the callback won't be called from
+   * the OMX callbacks */
+  if (err != OMX_ErrorNone)
+    gst_omx_component_take_state_callback (comp, OMX_StateInvalid,
+        &done_callback, &done_user_data);
+  else if (comp->state == state && comp->pending_state == OMX_StateInvalid
+      && gst_omx_component_take_state_callback (comp, state, &done_callback,
+          &done_user_data))
+    done_state = state;
 
   g_mutex_unlock (&comp->lock);
 
@@ -896,37 +1402,138 @@ done:
         gst_omx_state_to_string (old_state), gst_omx_state_to_string (state),
         gst_omx_error_to_string (err), err);
   }
+
+  if (old_callback)
+    old_callback (comp, OMX_StateInvalid, OMX_ErrorNone, old_user_data);
+  if (done_callback)
+    done_callback (comp, done_state, err, done_user_data);
+
   return err;
 }
 
-/* NOTE: Uses comp->lock and comp->messages_lock */
-OMX_STATETYPE
-gst_omx_component_get_state (GstOMXComponent * comp, GstClockTime timeout)
+void
+gst_omx_state_changes_init (GstOMXStateChanges * changes)
 {
-  OMX_STATETYPE ret;
-  gboolean signalled = TRUE;
+  g_mutex_init (&changes->lock);
+  g_cond_init (&changes->cond);
+  changes->n_pending = 0;
+  changes->last_error = OMX_ErrorNone;
+}
 
-  g_return_val_if_fail (comp != NULL, OMX_StateInvalid);
+void
+gst_omx_state_changes_clear (GstOMXStateChanges * changes)
+{
+  g_warn_if_fail (changes->n_pending == 0);
 
-  GST_DEBUG_OBJECT (comp->parent, "Getting state of %s", comp->name);
+  g_mutex_clear (&changes->lock);
+  g_cond_clear (&changes->cond);
+}
 
-  g_mutex_lock (&comp->lock);
+static void
+gst_omx_state_changes_done (GstOMXComponent * comp, OMX_STATETYPE state,
+    OMX_ERRORTYPE err, gpointer user_data)
+{
+  GstOMXStateChanges *changes = user_data;
 
-  gst_omx_component_handle_messages (comp);
+  /* Superseded by another state change or the component was freed */
+  if (state == OMX_StateInvalid && err == OMX_ErrorNone)
+    err = OMX_ErrorInvalidState;
 
-  ret = comp->state;
-  if (comp->pending_state == OMX_StateInvalid)
-    goto done;
+  g_mutex_lock (&changes->lock);
+  if (err != OMX_ErrorNone && changes->last_error == OMX_ErrorNone)
+    changes->last_error = err;
+  g_assert (changes->n_pending > 0);
+  changes->n_pending--;
+  g_cond_broadcast (&changes->cond);
+  g_mutex_unlock (&changes->lock);
+}
 
-  if (comp->last_error != OMX_ErrorNone) {
-    GST_ERROR_OBJECT (comp->parent, "Component %s in error state: %s (0x%08x)",
-        comp->name, gst_omx_error_to_string (comp->last_error),
-        comp->last_error);
-    ret = OMX_StateInvalid;
-    goto done;
-  }
+/* Starts changing the state of comp without waiting for it. This lets the
+ * state changes of several components, e.g. of all elements of a pipeline,
+ * overlap. Use gst_omx_state_changes_wait() to wait for all of them.
+ *
+ * changes must stay valid until the state change finished or comp was
+ * freed or released.
+ *
+ * NOTE: Uses comp->lock and comp->messages_lock */
+OMX_ERRORTYPE
+gst_omx_state_changes_add (GstOMXStateChanges * changes,
+    GstOMXComponent * comp, OMX_STATETYPE state)
+{
+  g_return_val_if_fail (changes != NULL, OMX_ErrorUndefined);
+  g_return_val_if_fail (comp != NULL, OMX_ErrorUndefined);
 
-  while (signalled && comp->last_error == OMX_ErrorNone
+  g_mutex_lock (&changes->lock);
+  changes->n_pending++;
+  g_mutex_unlock (&changes->lock);
+
+  /* NOTE: The callback is also called if this fails */
+  return gst_omx_component_set_state_async (comp, state,
+      gst_omx_state_changes_done, changes);
+}
+
+/* Waits until all state changes added to changes finished, or until the
+ * timeout expired. Returns the first error since the last wait, or
+ * OMX_ErrorTimeout */
+OMX_ERRORTYPE
+gst_omx_state_changes_wait (GstOMXStateChanges * changes, GstClockTime timeout)
+{
+  gint64 wait_until = -1;
+  OMX_ERRORTYPE err;
+
+  g_return_val_if_fail (changes != NULL, OMX_ErrorUndefined);
+
+  if (timeout != GST_CLOCK_TIME_NONE)
+    wait_until = g_get_monotonic_time () +
+        gst_util_uint64_scale (timeout, G_TIME_SPAN_SECOND, GST_SECOND);
+
+  g_mutex_lock (&changes->lock);
+  while (changes->n_pending > 0) {
+    if (wait_until == -1)
+      g_cond_wait (&changes->cond, &changes->lock);
+    else if (!g_cond_wait_until (&changes->cond, &changes->lock, wait_until))
+      break;
+  }
+
+  if (changes->n_pending > 0) {
+    err = OMX_ErrorTimeout;
+  } else {
+    err = changes->last_error;
+    changes->last_error = OMX_ErrorNone;
+  }
+  g_mutex_unlock (&changes->lock);
+
+  return err;
+}
+
+/* NOTE: Uses comp->lock and comp->messages_lock */
+OMX_STATETYPE
+gst_omx_component_get_state (GstOMXComponent * comp, GstClockTime timeout)
+{
+  OMX_STATETYPE ret;
+  gboolean signalled = TRUE;
+
+  g_return_val_if_fail (comp != NULL, OMX_StateInvalid);
+
+  GST_DEBUG_OBJECT (comp->parent, "Getting state of %s", comp->name);
+
+  g_mutex_lock (&comp->lock);
+
+  gst_omx_component_handle_messages (comp);
+
+  ret = comp->state;
+  if (comp->pending_state == OMX_StateInvalid)
+    goto done;
+
+  if (comp->last_error != OMX_ErrorNone) {
+    GST_ERROR_OBJECT (comp->parent, "Component %s in error state: %s (0x%08x)",
+        comp->name, gst_omx_error_to_string (comp->last_error),
+        comp->last_error);
+    ret = OMX_StateInvalid;
+    goto done;
+  }
+
+  while (signalled && comp->last_error == OMX_ErrorNone
       && comp->pending_state != OMX_StateInvalid) {
 
     signalled = gst_omx_component_wait_message (comp, timeout);
@@ -963,6 +1570,62 @@ done:
   return ret;
 }
 
+/* Returns the startup phases of the component as a GstStructure once
+ * the first output buffer was filled, NULL before that and after the
+ * timeline was taken once.
+ *
+ * NOTE: Uses comp->lock */
+GstStructure *
+gst_omx_component_take_timeline (GstOMXComponent * comp)
+{
+  GstStructure *s = NULL;
+  GValue phases = G_VALUE_INIT;
+  GstClockTime first_frame = GST_CLOCK_TIME_NONE;
+  guint i;
+
+  g_return_val_if_fail (comp != NULL, NULL);
+
+  g_mutex_lock (&comp->lock);
+
+  if (!comp->timeline || !comp->timeline_complete)
+    goto done;
+
+  g_value_init (&phases, GST_TYPE_ARRAY);
+  for (i = 0; i < comp->timeline->len; i++) {
+    const GstOMXTimelineEntry *entry =
+        &g_array_index (comp->timeline, GstOMXTimelineEntry, i);
+    GstClockTime start;
+    GValue v = G_VALUE_INIT;
+
+    start = MAX (entry->start - comp->timeline_start, 0) * GST_USECOND;
+    if (g_str_equal (entry->phase, "first-fill-buffer-done"))
+      first_frame = start;
+
+    g_value_init (&v, GST_TYPE_STRUCTURE);
+    g_value_take_boxed (&v, gst_structure_new ("phase",
+            "name", G_TYPE_STRING, entry->phase,
+            "port", G_TYPE_INT, entry->port,
+            "start", GST_TYPE_CLOCK_TIME, start,
+            "duration", GST_TYPE_CLOCK_TIME,
+            (GstClockTime) MAX (entry->end - entry->start, 0) * GST_USECOND,
+            NULL));
+    gst_value_array_append_and_take_value (&phases, &v);
+  }
+
+  s = gst_structure_new ("omx-startup-timeline",
+      "component", G_TYPE_STRING, comp->name,
+      "time-to-first-frame", GST_TYPE_CLOCK_TIME, first_frame, NULL);
+  gst_structure_take_value (s, "phases", &phases);
+
+  g_array_free (comp->timeline, TRUE);
+  comp->timeline = NULL;
+
+done:
+  g_mutex_unlock (&comp->lock);
+
+  return s;
+}
+
 GstOMXPort *
 gst_omx_component_add_port (GstOMXComponent * comp, guint32 index)
 {
@@ -977,7 +1640,13 @@ gst_omx_component_add_port (GstOMXComponent * comp, guint32 index)
   n = comp->ports->len;
   for (i = 0; i < n; i++) {
     port = g_ptr_array_index (comp->ports, i);
-    g_return_val_if_fail (port->index != index, NULL);
+    if (port->index != index)
+      continue;
+
+    /* Components from the pool still have all their ports */
+    g_return_val_if_fail (comp->reused, NULL);
+    GST_DEBUG_OBJECT (comp->parent, "%s reusing port %u", comp->name, index);
+    return port;
   }
 
   GST_DEBUG_OBJECT (comp->parent, "%s adding port %u", comp->name, index);
@@ -1002,6 +1671,10 @@ gst_omx_component_add_port (GstOMXComponent * comp, guint32 index)
   port->port_def = port_def;
 
   g_queue_init (&port->pending_buffers);
+  g_cond_init (&port->messages_cond);
+  port->messages_waiters = 0;
+  port->acquire_generation =
+      g_atomic_int_get (&comp->control_generation) - 1;
   port->flushing = TRUE;
   port->flushed = FALSE;
   port->enabled_pending = FALSE;
@@ -1013,11 +1686,71 @@ gst_omx_component_add_port (GstOMXComponent * comp, guint32 index)
   else
     comp->n_out_ports++;
 
+  /* The OMX callbacks look at the ports to wake up their waiters */
+  g_mutex_lock (&comp->messages_lock);
   g_ptr_array_add (comp->ports, port);
+  g_mutex_unlock (&comp->messages_lock);
 
   return port;
 }
 
+/* Detects the first input and output port for elements without
+ * configured port indices. index is OMX_IndexParamVideoInit or
+ * OMX_IndexParamAudioInit. For components from
+ * gst_omx_component_acquire() the result is cached across processes */
+gboolean
+gst_omx_component_detect_port_indices (GstOMXComponent * comp,
+    OMX_INDEXTYPE index, gint * in_port_index, gint * out_port_index)
+{
+  OMX_PORT_PARAM_TYPE param;
+  OMX_ERRORTYPE err;
+  gint *cached, indices[2];
+  gsize n_cached;
+
+  g_return_val_if_fail (comp != NULL, FALSE);
+  g_return_val_if_fail (in_port_index != NULL, FALSE);
+  g_return_val_if_fail (out_port_index != NULL, FALSE);
+
+  if (comp->pool_cdata && gst_omx_cache_get_integers (comp->pool_cdata,
+          "port-indices", &cached, &n_cached)) {
+    gboolean valid = (n_cached == 2);
+
+    if (valid) {
+      *in_port_index = cached[0];
+      *out_port_index = cached[1];
+      GST_DEBUG_OBJECT (comp->parent, "%s has cached ports %d and %d",
+          comp->name, *in_port_index, *out_port_index);
+    }
+    g_free (cached);
+
+    if (valid)
+      return TRUE;
+  }
+
+  GST_OMX_INIT_STRUCT (&param);
+
+  err = gst_omx_component_get_parameter (comp, index, &param);
+  if (err != OMX_ErrorNone) {
+    GST_WARNING_OBJECT (comp->parent,
+        "Couldn't get port information of %s: %s (0x%08x)", comp->name,
+        gst_omx_error_to_string (err), err);
+    return FALSE;
+  }
+
+  GST_DEBUG_OBJECT (comp->parent, "%s detected %u ports, starting at %u",
+      comp->name, (guint) param.nPorts, (guint) param.nStartPortNumber);
+  indices[0] = param.nStartPortNumber + 0;
+  indices[1] = param.nStartPortNumber + 1;
+
+  if (comp->pool_cdata)
+    gst_omx_cache_set_integers (comp->pool_cdata, "port-indices", indices, 2);
+
+  *in_port_index = indices[0];
+  *out_port_index = indices[1];
+
+  return TRUE;
+}
+
 GstOMXPort *
 gst_omx_component_get_port (GstOMXComponent * comp, guint32 index)
 {
@@ -1279,29 +2012,112 @@ gst_omx_port_update_port_definition (GstOMXPort * port,
     return err_get;
 }
 
-/* NOTE: Uses comp->lock and comp->messages_lock */
+/* Returns TRUE if a pending buffer can be acquired, i.e. one that is not
+ * shared with a pool
+ *
+ * NOTE: Must be called while holding comp->lock */
+static gboolean
+gst_omx_port_has_pending_buffers_unlocked (GstOMXPort * port)
+{
+  GList *l;
+
+  if (G_LIKELY (port->n_shared == 0))
+    return !g_queue_is_empty (&port->pending_buffers);
+
+  for (l = port->pending_buffers.head; l; l = l->next) {
+    if (!((GstOMXBuffer *) l->data)->shared)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* NOTE: Must be called while holding comp->lock */
+static guint
+gst_omx_port_pop_pending_buffers (GstOMXPort * port, GstOMXBuffer ** bufs,
+    guint max)
+{
+  GstOMXTracerStats *stats = port->comp->tracer_stats;
+  gint64 now = 0;
+  guint n = 0;
+  GList *l;
+
+  if (G_UNLIKELY (stats) && !g_queue_is_empty (&port->pending_buffers))
+    now = g_get_monotonic_time ();
+
+  l = port->pending_buffers.head;
+  while (n < max && l) {
+    GList *next = l->next;
+
+    /* Buffers shared with a pool are only taken explicitly */
+    if (G_UNLIKELY (((GstOMXBuffer *) l->data)->shared)) {
+      l = next;
+      continue;
+    }
+
+    bufs[n] = l->data;
+    g_queue_delete_link (&port->pending_buffers, l);
+    l = next;
+    g_assert (bufs[n] == bufs[n]->omx_buf->pAppPrivate);
+
+    if (G_UNLIKELY (stats) && bufs[n]->pending_time > 0) {
+      gst_omx_tracer_stats_add (stats, GST_OMX_TRACER_METRIC_QUEUE_WAIT,
+          now - bufs[n]->pending_time);
+      bufs[n]->pending_time = 0;
+    }
+    n++;
+  }
+
+  return n;
+}
+
+/* Waits until at least one buffer is available and then returns
+ * up to max buffers at once, without taking comp->lock for
+ * every single buffer.
+ *
+ * NOTE: Uses comp->lock and comp->messages_lock */
 GstOMXAcquireBufferReturn
-gst_omx_port_acquire_buffer (GstOMXPort * port, GstOMXBuffer ** buf)
+gst_omx_port_acquire_buffers (GstOMXPort * port, GstOMXBuffer ** bufs,
+    guint max, guint * n_bufs)
 {
   GstOMXAcquireBufferReturn ret = GST_OMX_ACQUIRE_BUFFER_ERROR;
   GstOMXComponent *comp;
   OMX_ERRORTYPE err;
-  GstOMXBuffer *_buf = NULL;
+  guint n = 0;
   gint64 timeout = GST_CLOCK_TIME_NONE;
+  gint generation;
 
   g_return_val_if_fail (port != NULL, GST_OMX_ACQUIRE_BUFFER_ERROR);
   g_return_val_if_fail (!port->tunneled, GST_OMX_ACQUIRE_BUFFER_ERROR);
-  g_return_val_if_fail (buf != NULL, GST_OMX_ACQUIRE_BUFFER_ERROR);
+  g_return_val_if_fail (bufs != NULL, GST_OMX_ACQUIRE_BUFFER_ERROR);
+  g_return_val_if_fail (max > 0, GST_OMX_ACQUIRE_BUFFER_ERROR);
+  g_return_val_if_fail (n_bufs != NULL, GST_OMX_ACQUIRE_BUFFER_ERROR);
 
-  *buf = NULL;
+  *n_bufs = 0;
 
   comp = port->comp;
 
   g_mutex_lock (&comp->lock);
-  GST_DEBUG_OBJECT (comp->parent, "Acquiring %s buffer from port %u",
-      comp->name, port->index);
+  GST_DEBUG_OBJECT (comp->parent, "Acquiring up to %u %s buffers from port %u",
+      max, comp->name, port->index);
+
+  /* Fast path: if only buffers were done since the last time buffers
+   * were acquired through all the checks below, nothing can have
+   * changed and the buffers that are already pending can be used
+   * directly. Buffers done in the meantime are handled the next time
+   * the slow path runs */
+  if (port->acquire_generation ==
+      g_atomic_int_get (&comp->control_generation)
+      && gst_omx_port_has_pending_buffers_unlocked (port)) {
+    n = gst_omx_port_pop_pending_buffers (port, bufs, max);
+    ret = GST_OMX_ACQUIRE_BUFFER_OK;
+    goto done;
+  }
 
 retry:
+  /* Must be read before handling the messages, see
+   * gst_omx_component_send_message() */
+  generation = g_atomic_int_get (&comp->control_generation);
   gst_omx_component_handle_messages (comp);
 
   /* If we are in the case where we waited for a buffer after EOS,
@@ -1337,7 +2153,7 @@ retry:
           (err = comp->last_error) == OMX_ErrorNone && !port->flushing) {
         GST_DEBUG_OBJECT (comp->parent,
             "Waiting for %s output ports to reconfigure", comp->name);
-        gst_omx_component_wait_message (comp, GST_CLOCK_TIME_NONE);
+        gst_omx_port_wait_message (port, GST_CLOCK_TIME_NONE);
         gst_omx_component_handle_messages (comp);
       }
       goto retry;
@@ -1360,11 +2176,29 @@ retry:
    * we have to drop them... */
   if (port->port_def.eDir == OMX_DirOutput &&
       port->settings_cookie != port->configured_settings_cookie) {
-    if (!g_queue_is_empty (&port->pending_buffers)) {
+    guint stale = max;
+
+    /* Components that keep their buffers over settings changes might
+     * already have filled some with the new settings, those are only
+     * returned once the port is reconfigured */
+    if (comp->hacks & GST_OMX_HACK_KEEPS_OUTPUT_BUFFERS) {
+      GList *l;
+
+      stale = 0;
+      for (l = port->pending_buffers.head; l && stale < max; l = l->next) {
+        GstOMXBuffer *pending = l->data;
+
+        if (pending->filled_settings_cookie == port->settings_cookie)
+          break;
+        stale++;
+      }
+    }
+
+    if (stale > 0 && !g_queue_is_empty (&port->pending_buffers)) {
       GST_DEBUG_OBJECT (comp->parent,
           "%s output port %u needs reconfiguration but has buffers pending",
           comp->name, port->index);
-      _buf = g_queue_pop_head (&port->pending_buffers);
+      n = gst_omx_port_pop_pending_buffers (port, bufs, stale);
 
       ret = GST_OMX_ACQUIRE_BUFFER_OK;
       goto done;
@@ -1380,7 +2214,7 @@ retry:
     if (!g_queue_is_empty (&port->pending_buffers)) {
       GST_DEBUG_OBJECT (comp->parent, "%s output port %u is EOS but has "
           "buffers pending", comp->name, port->index);
-      _buf = g_queue_pop_head (&port->pending_buffers);
+      n = gst_omx_port_pop_pending_buffers (port, bufs, max);
 
       ret = GST_OMX_ACQUIRE_BUFFER_OK;
       goto done;
@@ -1410,10 +2244,10 @@ retry:
    * arrives, an error happens, the port is flushing
    * or the port needs to be reconfigured.
    */
-  if (g_queue_is_empty (&port->pending_buffers)) {
+  if (!gst_omx_port_has_pending_buffers_unlocked (port)) {
     GST_DEBUG_OBJECT (comp->parent, "Queue of %s port %u is empty",
         comp->name, port->index);
-    gst_omx_component_wait_message (comp,
+    gst_omx_port_wait_message (port,
         timeout == -2 ? GST_CLOCK_TIME_NONE : timeout);
 
     /* And now check everything again and maybe get a buffer */
@@ -1422,45 +2256,145 @@ retry:
 
   GST_DEBUG_OBJECT (comp->parent, "%s port %u has pending buffers",
       comp->name, port->index);
-  _buf = g_queue_pop_head (&port->pending_buffers);
+  n = gst_omx_port_pop_pending_buffers (port, bufs, max);
   ret = GST_OMX_ACQUIRE_BUFFER_OK;
+  port->acquire_generation = generation;
 
 done:
   g_mutex_unlock (&comp->lock);
 
-  if (_buf) {
-    g_assert (_buf == _buf->omx_buf->pAppPrivate);
-    *buf = _buf;
-  }
+  *n_bufs = n;
 
-  GST_DEBUG_OBJECT (comp->parent, "Acquired buffer %p (%p) from %s port %u: %d",
-      _buf, (_buf ? _buf->omx_buf->pBuffer : NULL), comp->name, port->index,
-      ret);
+  GST_DEBUG_OBJECT (comp->parent, "Acquired %u buffers, first %p (%p), from "
+      "%s port %u: %d", n, (n ? bufs[0] : NULL),
+      (n ? bufs[0]->omx_buf->pBuffer : NULL), comp->name, port->index, ret);
 
   return ret;
 }
 
 /* NOTE: Uses comp->lock and comp->messages_lock */
-OMX_ERRORTYPE
-gst_omx_port_release_buffer (GstOMXPort * port, GstOMXBuffer * buf)
+GstOMXAcquireBufferReturn
+gst_omx_port_acquire_buffer (GstOMXPort * port, GstOMXBuffer ** buf)
+{
+  GstOMXAcquireBufferReturn ret;
+  guint n;
+
+  g_return_val_if_fail (buf != NULL, GST_OMX_ACQUIRE_BUFFER_ERROR);
+
+  *buf = NULL;
+
+  ret = gst_omx_port_acquire_buffers (port, buf, 1, &n);
+  g_assert (n == 0 || ret == GST_OMX_ACQUIRE_BUFFER_OK);
+
+  return ret;
+}
+
+/* Like gst_omx_port_acquire_buffer() but for a specific input buffer,
+ * used for the buffers of a GstOMXBufferPool that upstream filled in
+ * any order. Waits until the component returned buf if it still uses it.
+ *
+ * NOTE: Uses comp->lock and comp->messages_lock */
+GstOMXAcquireBufferReturn
+gst_omx_port_take_buffer (GstOMXPort * port, GstOMXBuffer * buf)
 {
+  GstOMXAcquireBufferReturn ret;
   GstOMXComponent *comp;
-  OMX_ERRORTYPE err = OMX_ErrorNone;
+  OMX_ERRORTYPE err;
 
-  g_return_val_if_fail (port != NULL, OMX_ErrorUndefined);
-  g_return_val_if_fail (!port->tunneled, OMX_ErrorUndefined);
-  g_return_val_if_fail (buf != NULL, OMX_ErrorUndefined);
-  g_return_val_if_fail (buf->port == port, OMX_ErrorUndefined);
+  g_return_val_if_fail (port != NULL, GST_OMX_ACQUIRE_BUFFER_ERROR);
+  g_return_val_if_fail (port->port_def.eDir == OMX_DirInput,
+      GST_OMX_ACQUIRE_BUFFER_ERROR);
+  g_return_val_if_fail (buf != NULL && buf->port == port,
+      GST_OMX_ACQUIRE_BUFFER_ERROR);
 
   comp = port->comp;
 
   g_mutex_lock (&comp->lock);
+  gst_omx_component_handle_messages (comp);
+
+  while (TRUE) {
+    if ((err = comp->last_error) != OMX_ErrorNone) {
+      GST_ERROR_OBJECT (comp->parent, "Component %s is in error state: %s",
+          comp->name, gst_omx_error_to_string (err));
+      ret = GST_OMX_ACQUIRE_BUFFER_ERROR;
+      break;
+    }
+
+    if (port->flushing) {
+      GST_DEBUG_OBJECT (comp->parent, "Component %s port %d is flushing",
+          comp->name, port->index);
+      ret = GST_OMX_ACQUIRE_BUFFER_FLUSHING;
+      break;
+    }
+
+    if (port->settings_cookie != port->configured_settings_cookie) {
+      GST_DEBUG_OBJECT (comp->parent,
+          "Component %s port %d needs reconfiguring", comp->name, port->index);
+      ret = GST_OMX_ACQUIRE_BUFFER_RECONFIGURE;
+      break;
+    }
+
+    if (g_queue_remove (&port->pending_buffers, buf)) {
+      buf->pending_time = 0;
+      ret = GST_OMX_ACQUIRE_BUFFER_OK;
+      break;
+    }
+
+    GST_DEBUG_OBJECT (comp->parent, "Waiting for %s port %u to return buffer "
+        "%p", comp->name, port->index, buf);
+    gst_omx_port_wait_message (port, GST_CLOCK_TIME_NONE);
+    gst_omx_component_handle_messages (comp);
+  }
+
+  g_mutex_unlock (&comp->lock);
+
+  GST_DEBUG_OBJECT (comp->parent, "Took buffer %p (%p) from %s port %u: %d",
+      buf, buf->omx_buf->pBuffer, comp->name, port->index, ret);
+
+  return ret;
+}
+
+/* Marks buf as wrapped by a GstOMXBufferPool for upstream, such buffers
+ * are skipped by gst_omx_port_acquire_buffers() and only returned by
+ * gst_omx_port_take_buffer(). The remaining buffers of the port can then
+ * be acquired as usual for copying input that is not from the pool.
+ *
+ * NOTE: Uses comp->lock */
+void
+gst_omx_port_set_buffer_shared (GstOMXPort * port, GstOMXBuffer * buf,
+    gboolean shared)
+{
+  GstOMXComponent *comp;
+
+  g_return_if_fail (port != NULL);
+  g_return_if_fail (buf != NULL && buf->port == port);
+
+  comp = port->comp;
+
+  g_mutex_lock (&comp->lock);
+  if (buf->shared != shared) {
+    buf->shared = shared;
+    if (shared)
+      port->n_shared++;
+    else
+      port->n_shared--;
+  }
+  g_mutex_unlock (&comp->lock);
+}
+
+/* Returns TRUE if the buffer could not be passed to the component
+ * and waiters have to be woken up.
+ *
+ * NOTE: Must be called while holding comp->lock */
+static gboolean
+gst_omx_port_release_buffer_unlocked (GstOMXPort * port, GstOMXBuffer * buf,
+    OMX_ERRORTYPE * err)
+{
+  GstOMXComponent *comp = port->comp;
 
   GST_DEBUG_OBJECT (comp->parent, "Releasing buffer %p (%p) to %s port %u",
       buf, buf->omx_buf->pBuffer, comp->name, port->index);
 
-  gst_omx_component_handle_messages (comp);
-
   if (port->port_def.eDir == OMX_DirOutput) {
     /* Reset all flags, some implementations don't
      * reset them themselves and the flags are not
@@ -1469,21 +2403,19 @@ gst_omx_port_release_buffer (GstOMXPort * port, GstOMXBuffer * buf)
     gst_omx_buffer_reset (buf);
   }
 
-  if ((err = comp->last_error) != OMX_ErrorNone) {
+  if ((*err = comp->last_error) != OMX_ErrorNone) {
     GST_ERROR_OBJECT (comp->parent, "Component %s is in error state: %s "
-        "(0x%08x)", comp->name, gst_omx_error_to_string (err), err);
-    g_queue_push_tail (&port->pending_buffers, buf);
-    gst_omx_component_send_message (comp, NULL);
-    goto done;
+        "(0x%08x)", comp->name, gst_omx_error_to_string (*err), *err);
+    gst_omx_port_push_pending (port, buf);
+    return TRUE;
   }
 
   if (port->flushing || port->disabled_pending || !port->port_def.bEnabled) {
     GST_DEBUG_OBJECT (comp->parent,
         "%s port %u is flushing or disabled, not releasing " "buffer",
         comp->name, port->index);
-    g_queue_push_tail (&port->pending_buffers, buf);
-    gst_omx_component_send_message (comp, NULL);
-    goto done;
+    gst_omx_port_push_pending (port, buf);
+    return TRUE;
   }
 
   g_assert (buf == buf->omx_buf->pAppPrivate);
@@ -1491,23 +2423,110 @@ gst_omx_port_release_buffer (GstOMXPort * port, GstOMXBuffer * buf)
   /* FIXME: What if the settings cookies don't match? */
 
   buf->used = TRUE;
+  buf->submit_time = g_get_monotonic_time ();
+
+  if (port->n_used++ == 0 && port->starved_since) {
+    port->starved_time += buf->submit_time - port->starved_since;
+    port->starved_since = 0;
+  }
+
+  if (G_UNLIKELY (comp->timeline && !comp->timeline_submitted)
+      && port->port_def.eDir == OMX_DirInput) {
+    gst_omx_component_timeline_add (comp, "first-empty-this-buffer",
+        port->index, buf->submit_time, buf->submit_time);
+    comp->timeline_submitted = TRUE;
+  }
 
   if (port->port_def.eDir == OMX_DirInput) {
-    err = OMX_EmptyThisBuffer (comp->handle, buf->omx_buf);
+    *err = OMX_EmptyThisBuffer (comp->handle, buf->omx_buf);
   } else {
-    err = OMX_FillThisBuffer (comp->handle, buf->omx_buf);
+    *err = OMX_FillThisBuffer (comp->handle, buf->omx_buf);
   }
   GST_DEBUG_OBJECT (comp->parent, "Released buffer %p to %s port %u: %s "
-      "(0x%08x)", buf, comp->name, port->index, gst_omx_error_to_string (err),
-      err);
+      "(0x%08x)", buf, comp->name, port->index, gst_omx_error_to_string (*err),
+      *err);
 
-done:
+  return FALSE;
+}
+
+/* If passing one buffer fails, the remaining buffers are
+ * put back into the port's pending buffers.
+ *
+ * NOTE: Must be called while holding comp->lock, uses comp->messages_lock */
+static OMX_ERRORTYPE
+gst_omx_port_release_buffers_unlocked (GstOMXPort * port, GstOMXBuffer ** bufs,
+    guint n)
+{
+  OMX_ERRORTYPE err = OMX_ErrorNone;
+  gboolean wakeup = FALSE;
+  guint i;
+
+  for (i = 0; i < n; i++) {
+    if (gst_omx_port_release_buffer_unlocked (port, bufs[i], &err))
+      wakeup = TRUE;
+    if (err != OMX_ErrorNone)
+      break;
+  }
+
+  /* Don't lose the buffers we didn't pass to the component */
+  if (i < n) {
+    for (i = i + 1; i < n; i++) {
+      if (port->port_def.eDir == OMX_DirOutput)
+        gst_omx_buffer_reset (bufs[i]);
+      gst_omx_port_push_pending (port, bufs[i]);
+      wakeup = TRUE;
+    }
+  }
+
+  if (wakeup)
+    gst_omx_component_send_message (port->comp, NULL);
+
+  return err;
+}
+
+/* Passes n buffers to the component while taking comp->lock only
+ * once, see gst_omx_port_release_buffer().
+ *
+ * NOTE: Uses comp->lock and comp->messages_lock */
+OMX_ERRORTYPE
+gst_omx_port_release_buffers (GstOMXPort * port, GstOMXBuffer ** bufs,
+    guint n)
+{
+  GstOMXComponent *comp;
+  OMX_ERRORTYPE err;
+  guint i;
+
+  g_return_val_if_fail (port != NULL, OMX_ErrorUndefined);
+  g_return_val_if_fail (!port->tunneled, OMX_ErrorUndefined);
+  g_return_val_if_fail (bufs != NULL || n == 0, OMX_ErrorUndefined);
+
+  for (i = 0; i < n; i++) {
+    g_return_val_if_fail (bufs[i] != NULL, OMX_ErrorUndefined);
+    g_return_val_if_fail (bufs[i]->port == port, OMX_ErrorUndefined);
+  }
+
+  comp = port->comp;
+
+  g_mutex_lock (&comp->lock);
+
+  gst_omx_component_handle_messages (comp);
+  err = gst_omx_port_release_buffers_unlocked (port, bufs, n);
   gst_omx_component_handle_messages (comp);
+
   g_mutex_unlock (&comp->lock);
 
   return err;
 }
 
+/* NOTE: Uses comp->lock and comp->messages_lock */
+OMX_ERRORTYPE
+gst_omx_port_release_buffer (GstOMXPort * port, GstOMXBuffer * buf)
+{
+  g_return_val_if_fail (buf != NULL, OMX_ErrorUndefined);
+
+  return gst_omx_port_release_buffers (port, &buf, 1);
+}
+
 /* NOTE: Uses comp->lock and comp->messages_lock */
 OMX_ERRORTYPE
 gst_omx_port_set_flushing (GstOMXPort * port, GstClockTime timeout,
@@ -1540,10 +2559,14 @@ gst_omx_port_set_flushing (GstOMXPort * port, GstClockTime timeout,
   }
 
   port->flushing = flush;
+  gst_omx_component_control_event (comp);
   if (flush) {
     gboolean signalled;
     OMX_ERRORTYPE last_error;
 
+    /* Not starved, all buffers are taken back on purpose */
+    port->starved_since = 0;
+
     gst_omx_component_send_message (comp, NULL);
 
     /* Now flush the port */
@@ -1654,6 +2677,51 @@ gst_omx_port_is_flushing (GstOMXPort * port)
   return flushing;
 }
 
+/* Returns in n_used how many of the port's buffers the component has and
+ * in n_pending how many it returned that were not acquired yet
+ *
+ * NOTE: Uses comp->lock and comp->messages_lock */
+void
+gst_omx_port_get_buffer_counts (GstOMXPort * port, guint * n_used,
+    guint * n_pending)
+{
+  GstOMXComponent *comp;
+
+  g_return_if_fail (port != NULL);
+
+  comp = port->comp;
+
+  g_mutex_lock (&comp->lock);
+  gst_omx_component_handle_messages (comp);
+  if (n_used)
+    *n_used = port->n_used;
+  if (n_pending)
+    *n_pending = g_queue_get_length (&port->pending_buffers);
+  g_mutex_unlock (&comp->lock);
+}
+
+/* Returns TRUE if the component already returned buffers that were not
+ * acquired yet, i.e. acquiring a buffer would not wait for the component
+ *
+ * NOTE: Uses comp->lock and comp->messages_lock */
+gboolean
+gst_omx_port_has_pending_buffers (GstOMXPort * port)
+{
+  GstOMXComponent *comp;
+  gboolean pending;
+
+  g_return_val_if_fail (port != NULL, FALSE);
+
+  comp = port->comp;
+
+  g_mutex_lock (&comp->lock);
+  gst_omx_component_handle_messages (comp);
+  pending = gst_omx_port_has_pending_buffers_unlocked (port);
+  g_mutex_unlock (&comp->lock);
+
+  return pending;
+}
+
 static OMX_ERRORTYPE gst_omx_port_deallocate_buffers_unlocked (GstOMXPort *
     port);
 
@@ -1666,12 +2734,14 @@ gst_omx_port_allocate_buffers_unlocked (GstOMXPort * port,
   OMX_ERRORTYPE err = OMX_ErrorNone;
   gint i;
   const GList *l;
+  gint64 start;
 
   g_assert (!port->buffers || port->buffers->len == 0);
 
   g_return_val_if_fail (!port->tunneled, OMX_ErrorBadParameter);
 
   comp = port->comp;
+  start = g_get_monotonic_time ();
 
   gst_omx_component_handle_messages (port->comp);
   if ((err = comp->last_error) != OMX_ErrorNone) {
@@ -1699,6 +2769,9 @@ gst_omx_port_allocate_buffers_unlocked (GstOMXPort * port,
       "Allocating %d buffers of size %" G_GSIZE_FORMAT " for %s port %u", n,
       (size_t) port->port_def.nBufferSize, comp->name, (guint) port->index);
 
+  /* Make sure all buffers can be returned without overflowing the ring */
+  gst_omx_component_update_message_ring (comp);
+
   if (!port->buffers)
     port->buffers = g_ptr_array_sized_new (n);
 
@@ -1748,13 +2821,18 @@ gst_omx_port_allocate_buffers_unlocked (GstOMXPort * port,
     g_assert (buf->omx_buf->pAppPrivate == buf);
 
     /* In the beginning all buffers are not owned by the component */
-    g_queue_push_tail (&port->pending_buffers, buf);
+    gst_omx_port_push_pending (port, buf);
     if (buffers || images)
       l = l->next;
   }
 
+  gst_omx_component_control_event (comp);
+
   gst_omx_component_handle_messages (comp);
 
+  gst_omx_component_timeline_add (comp, "port-allocate", port->index, start,
+      g_get_monotonic_time ());
+
 done:
   gst_omx_port_update_port_definition (port, NULL);
 
@@ -1998,11 +3076,16 @@ gst_omx_port_deallocate_buffers_unlocked (GstOMXPort * port)
           err = tmp;
       }
     }
+    if (buf->pool_buffer)
+      gst_buffer_unref (buf->pool_buffer);
     g_slice_free (GstOMXBuffer, buf);
   }
   g_queue_clear (&port->pending_buffers);
   g_ptr_array_unref (port->buffers);
   port->buffers = NULL;
+  port->n_used = port->min_used = 0;
+  port->n_shared = 0;
+  port->starved_since = 0;
 
   gst_omx_component_handle_messages (comp);
 
@@ -2066,10 +3149,13 @@ gst_omx_port_set_enabled_unlocked (GstOMXPort * port, gboolean enabled)
   if (! !port->port_def.bEnabled == ! !enabled)
     goto done;
 
-  if (enabled)
+  if (enabled) {
     port->enabled_pending = TRUE;
-  else
+    port->timeline_enable_start = g_get_monotonic_time ();
+  } else {
     port->disabled_pending = TRUE;
+  }
+  gst_omx_component_control_event (comp);
 
   if (enabled)
     err =
@@ -2142,7 +3228,7 @@ gst_omx_port_wait_buffers_released_unlocked (GstOMXPort * port,
   while (signalled && last_error == OMX_ErrorNone && (port->buffers
           && port->buffers->len >
           g_queue_get_length (&port->pending_buffers))) {
-    signalled = gst_omx_component_wait_message (comp, timeout);
+    signalled = gst_omx_port_wait_message (port, timeout);
     if (signalled)
       gst_omx_component_handle_messages (comp);
     last_error = comp->last_error;
@@ -2209,7 +3295,6 @@ gst_omx_port_populate_unlocked (GstOMXPort * port)
 {
   GstOMXComponent *comp;
   OMX_ERRORTYPE err = OMX_ErrorNone;
-  GstOMXBuffer *buf;
 
   g_return_val_if_fail (port != NULL, OMX_ErrorUndefined);
 
@@ -2234,29 +3319,28 @@ gst_omx_port_populate_unlocked (GstOMXPort * port)
   }
 
   if (port->port_def.eDir == OMX_DirOutput && port->buffers && !port->tunneled) {
-    /* Enqueue all buffers for the component to fill */
-    while ((buf = g_queue_pop_head (&port->pending_buffers))) {
-      g_assert (!buf->used);
-
-      /* Reset all flags, some implementations don't
-       * reset them themselves and the flags are not
-       * valid anymore after the buffer was consumed.
-       * Also reset nFilledLen as FillThisBuffer() expects an empty buffer.
-       */
-      gst_omx_buffer_reset (buf);
+    GstOMXBuffer **bufs;
+    guint i, n;
 
-      err = OMX_FillThisBuffer (comp->handle, buf->omx_buf);
+    /* Enqueue all buffers for the component to fill. Flags and
+     * nFilledLen are reset when releasing as FillThisBuffer()
+     * expects an empty buffer.
+     */
+    n = g_queue_get_length (&port->pending_buffers);
+    bufs = g_newa (GstOMXBuffer *, n);
+    n = gst_omx_port_pop_pending_buffers (port, bufs, n);
+    for (i = 0; i < n; i++)
+      g_assert (!bufs[i]->used);
 
-      if (err != OMX_ErrorNone) {
-        GST_ERROR_OBJECT (comp->parent,
-            "Failed to pass buffer %p (%p) to %s port %u: %s (0x%08x)", buf,
-            buf->omx_buf->pBuffer, comp->name, port->index,
-            gst_omx_error_to_string (err), err);
-        goto done;
-      }
-      GST_DEBUG_OBJECT (comp->parent, "Passed buffer %p (%p) to component %s",
-          buf, buf->omx_buf->pBuffer, comp->name);
+    err = gst_omx_port_release_buffers_unlocked (port, bufs, n);
+    if (err != OMX_ErrorNone) {
+      GST_ERROR_OBJECT (comp->parent,
+          "Failed to pass buffers to %s port %u: %s (0x%08x)", comp->name,
+          port->index, gst_omx_error_to_string (err), err);
+      goto done;
     }
+    GST_DEBUG_OBJECT (comp->parent, "Passed %u buffers to component %s", n,
+        comp->name);
   }
 
 done:
@@ -2383,23 +3467,101 @@ gst_omx_port_wait_enabled (GstOMXPort * port, GstClockTime timeout)
   err = gst_omx_port_wait_enabled_unlocked (port, timeout);
   g_mutex_unlock (&port->comp->lock);
 
-  return err;
-}
+  return err;
+}
+
+gboolean
+gst_omx_port_is_enabled (GstOMXPort * port)
+{
+  gboolean enabled;
+
+  g_return_val_if_fail (port != NULL, FALSE);
+
+  gst_omx_port_update_port_definition (port, NULL);
+  enabled = ! !port->port_def.bEnabled;
+
+  GST_DEBUG_OBJECT (port->comp->parent, "%s port %u is enabled: %d",
+      port->comp->name, port->index, enabled);
+
+  return enabled;
+}
+
+/* Returns TRUE if the port has buffers allocated that are still enough
+ * and large enough for its current port definition, i.e. after new
+ * settings were signalled.
+ *
+ * NOTE: Uses comp->lock and comp->messages_lock */
+gboolean
+gst_omx_port_buffers_fit (GstOMXPort * port)
+{
+  GstOMXComponent *comp;
+  gboolean ret = FALSE;
+  guint i, n;
+
+  g_return_val_if_fail (port != NULL, FALSE);
+
+  comp = port->comp;
+
+  g_mutex_lock (&comp->lock);
+  gst_omx_component_handle_messages (comp);
+
+  if (!port->buffers || comp->last_error != OMX_ErrorNone)
+    goto done;
+
+  n = port->buffers->len;
+  if (n < port->port_def.nBufferCountMin)
+    goto done;
+
+  for (i = 0; i < n; i++) {
+    GstOMXBuffer *buf = g_ptr_array_index (port->buffers, i);
+
+    if (buf->omx_buf->nAllocLen < port->port_def.nBufferSize)
+      goto done;
+  }
+
+  ret = TRUE;
+
+done:
+  GST_DEBUG_OBJECT (comp->parent, "%s port %u buffers %s the new settings",
+      comp->name, port->index, ret ? "fit" : "don't fit");
+  g_mutex_unlock (&comp->lock);
+
+  return ret;
+}
+
+/* Returns in starved_time for how many microseconds the component had none
+ * of the port's buffers, and in min_used the lowest number of buffers it had,
+ * since the last call. Flushing and EOS don't count as starving.
+ *
+ * NOTE: Uses comp->lock and comp->messages_lock */
+void
+gst_omx_port_take_usage (GstOMXPort * port, gint64 * starved_time,
+    guint * min_used)
+{
+  GstOMXComponent *comp;
+  gint64 now;
+
+  g_return_if_fail (port != NULL);
 
-gboolean
-gst_omx_port_is_enabled (GstOMXPort * port)
-{
-  gboolean enabled;
+  comp = port->comp;
 
-  g_return_val_if_fail (port != NULL, FALSE);
+  g_mutex_lock (&comp->lock);
+  gst_omx_component_handle_messages (comp);
 
-  gst_omx_port_update_port_definition (port, NULL);
-  enabled = ! !port->port_def.bEnabled;
+  now = g_get_monotonic_time ();
+  if (port->starved_since) {
+    port->starved_time += now - port->starved_since;
+    port->starved_since = now;
+  }
 
-  GST_DEBUG_OBJECT (port->comp->parent, "%s port %u is enabled: %d",
-      port->comp->name, port->index, enabled);
+  if (starved_time)
+    *starved_time = port->starved_time;
+  if (min_used)
+    *min_used = port->min_used;
 
-  return enabled;
+  port->starved_time = 0;
+  port->min_used = port->n_used;
+  g_mutex_unlock (&comp->lock);
 }
 
 /* NOTE: Uses comp->lock and comp->messages_lock */
@@ -2423,6 +3585,7 @@ gst_omx_port_mark_reconfigured (GstOMXPort * port)
     goto done;
 
   port->configured_settings_cookie = port->settings_cookie;
+  gst_omx_component_control_event (comp);
 
   if (port->port_def.eDir == OMX_DirOutput) {
     GList *l;
@@ -2449,6 +3612,419 @@ done:
   return err;
 }
 
+/* Components in OMX_StateLoaded that are kept alive to be reused by
+ * gst_omx_component_acquire(), see the "pool-size" and
+ * "pool-idle-timeout" configuration */
+#define GST_OMX_DEFAULT_POOL_IDLE_TIMEOUT 10000 /* ms */
+
+static GMutex component_pool_lock;
+static GCond component_pool_cond;
+static GQueue component_pool = G_QUEUE_INIT;
+static gboolean component_pool_thread_running = FALSE;
+
+static gboolean
+gst_omx_component_pool_matches (GstOMXComponent * comp,
+    const GstOMXClassData * cdata)
+{
+  const GstOMXClassData *pooled = comp->pool_cdata;
+
+  return pooled->hacks == cdata->hacks
+      && g_strcmp0 (pooled->core_name, cdata->core_name) == 0
+      && g_strcmp0 (pooled->component_name, cdata->component_name) == 0
+      && g_strcmp0 (pooled->component_role, cdata->component_role) == 0;
+}
+
+/* Frees the components that were not reused in time */
+static gpointer
+gst_omx_component_pool_thread (gpointer user_data)
+{
+  g_mutex_lock (&component_pool_lock);
+  while (!g_queue_is_empty (&component_pool)) {
+    gint64 now = g_get_monotonic_time (), next_expire = G_MAXINT64;
+    GSList *expired = NULL;
+    GList *l = component_pool.head;
+
+    while (l) {
+      GList *next = l->next;
+      GstOMXComponent *comp = l->data;
+
+      if (comp->pool_expire_time <= now) {
+        g_queue_delete_link (&component_pool, l);
+        expired = g_slist_prepend (expired, comp);
+      } else {
+        next_expire = MIN (next_expire, comp->pool_expire_time);
+      }
+      l = next;
+    }
+
+    if (expired) {
+      g_mutex_unlock (&component_pool_lock);
+      g_slist_free_full (expired, (GDestroyNotify) gst_omx_component_free);
+      g_mutex_lock (&component_pool_lock);
+      continue;
+    }
+
+    g_cond_wait_until (&component_pool_cond, &component_pool_lock,
+        next_expire);
+  }
+  component_pool_thread_running = FALSE;
+  /* gst_omx_component_pool_clear() might wait for this */
+  g_cond_broadcast (&component_pool_cond);
+  g_mutex_unlock (&component_pool_lock);
+
+  return NULL;
+}
+
+/* Frees all pooled components when the plugin is unloaded, after the
+ * thread is done with the ones it already took out of the pool */
+static void
+gst_omx_component_pool_clear (gpointer user_data)
+{
+  GQueue pooled;
+
+  g_mutex_lock (&component_pool_lock);
+  pooled = component_pool;
+  g_queue_init (&component_pool);
+  g_cond_broadcast (&component_pool_cond);
+  while (component_pool_thread_running)
+    g_cond_wait (&component_pool_cond, &component_pool_lock);
+  g_mutex_unlock (&component_pool_lock);
+
+  g_queue_foreach (&pooled, (GFunc) gst_omx_component_free, NULL);
+  g_queue_clear (&pooled);
+}
+
+/* Brings a component that is not used anymore back to how it was after
+ * gst_omx_component_new(), returns FALSE if it can't be reused.
+ *
+ * NOTE: Uses comp->lock and comp->messages_lock */
+static gboolean
+gst_omx_component_pool_reset (GstOMXComponent * comp)
+{
+  gboolean ret = FALSE;
+  gint i, n;
+
+  g_mutex_lock (&comp->lock);
+
+  gst_omx_component_handle_messages (comp);
+
+  if (comp->state != OMX_StateLoaded
+      || comp->pending_state != OMX_StateInvalid
+      || comp->last_error != OMX_ErrorNone)
+    goto done;
+
+  n = comp->ports->len;
+  for (i = 0; i < n; i++) {
+    GstOMXPort *port = g_ptr_array_index (comp->ports, i);
+
+    if (port->buffers || port->tunneled)
+      goto done;
+
+    port->flushing = TRUE;
+    port->flushed = FALSE;
+    port->eos = FALSE;
+
+    /* Ports start enabled after OMX_GetHandle(), in Loaded state
+     * enabling doesn't need any buffers */
+    gst_omx_port_update_port_definition (port, NULL);
+    if (!port->port_def.bEnabled) {
+      if (gst_omx_port_set_enabled_unlocked (port, TRUE) != OMX_ErrorNone)
+        goto done;
+      if (gst_omx_port_wait_enabled_unlocked (port,
+              1 * GST_SECOND) != OMX_ErrorNone)
+        goto done;
+    }
+  }
+
+  g_list_free (comp->pending_reconfigure_outports);
+  comp->pending_reconfigure_outports = NULL;
+  gst_omx_component_control_event (comp);
+
+  ret = TRUE;
+
+done:
+  g_mutex_unlock (&comp->lock);
+
+  return ret;
+}
+
+/* Like gst_omx_component_new() for the component configured in cdata,
+ * but reuses a component from the pool if there is one. Such a
+ * component is in OMX_StateLoaded and its ports are still added.
+ *
+ * NOTE: Uses comp->lock and comp->messages_lock */
+GstOMXComponent *
+gst_omx_component_acquire (GstObject * parent, const GstOMXClassData * cdata)
+{
+  GstOMXComponent *comp = NULL;
+  GList *l;
+
+  g_return_val_if_fail (parent != NULL, NULL);
+  g_return_val_if_fail (cdata != NULL, NULL);
+
+  g_mutex_lock (&component_pool_lock);
+  for (l = component_pool.head; l; l = l->next) {
+    if (gst_omx_component_pool_matches (l->data, cdata)) {
+      comp = l->data;
+      g_queue_delete_link (&component_pool, l);
+      break;
+    }
+  }
+  g_mutex_unlock (&component_pool_lock);
+
+  if (!comp) {
+    comp = gst_omx_component_new (parent, cdata->core_name,
+        cdata->component_name, cdata->component_role, cdata->hacks);
+    if (comp)
+      comp->pool_cdata = cdata;
+    return comp;
+  }
+
+  comp->parent = gst_object_ref (parent);
+  comp->reused = TRUE;
+
+  /* Nothing else is using the component yet */
+  if (comp->timeline)
+    g_array_set_size (comp->timeline, 0);
+  else
+    comp->timeline =
+        g_array_new (FALSE, FALSE, sizeof (GstOMXTimelineEntry));
+  comp->timeline_start = g_get_monotonic_time ();
+  comp->timeline_submitted = FALSE;
+  comp->timeline_complete = FALSE;
+  if (GST_OMX_TRACER_IS_ACTIVE ()) {
+    gchar *stats_name;
+
+    stats_name = g_strdup_printf ("%s:%s", GST_OBJECT_NAME (parent),
+        comp->name);
+    comp->tracer_stats = gst_omx_tracer_stats_new (stats_name);
+    g_free (stats_name);
+  }
+
+  GST_INFO_OBJECT (parent, "Reusing component %p %s", comp, comp->name);
+
+  return comp;
+}
+
+/* Puts a component from gst_omx_component_acquire() back into the pool
+ * if it is in OMX_StateLoaded without any buffers, and the pool has
+ * space for it. Otherwise it is freed.
+ *
+ * NOTE: Uses comp->lock and comp->messages_lock */
+void
+gst_omx_component_release (GstOMXComponent * comp)
+{
+  const GstOMXClassData *cdata;
+  guint n_pooled = 0;
+  GList *l;
+
+  g_return_if_fail (comp != NULL);
+
+  /* Pooled components don't count against the admission budget */
+  gst_omx_component_unreserve (comp);
+
+  /* A pooled component must not call back into the element anymore */
+  gst_omx_component_notify_state (comp, OMX_StateInvalid, OMX_ErrorNone);
+
+  cdata = comp->pool_cdata;
+  if (!cdata || cdata->pool_size == 0 || !gst_omx_component_pool_reset (comp))
+    goto free;
+
+  g_mutex_lock (&component_pool_lock);
+  for (l = component_pool.head; l; l = l->next) {
+    if (gst_omx_component_pool_matches (l->data, cdata))
+      n_pooled++;
+  }
+  if (n_pooled >= cdata->pool_size) {
+    g_mutex_unlock (&component_pool_lock);
+    goto free;
+  }
+
+  GST_INFO_OBJECT (comp->parent, "Keeping component %p %s for %u ms", comp,
+      comp->name, cdata->pool_idle_timeout);
+
+  /* The pool must not keep the element alive */
+  if (comp->tracer_stats) {
+    gst_omx_tracer_stats_free (comp->tracer_stats);
+    comp->tracer_stats = NULL;
+  }
+  gst_object_replace ((GstObject **) & comp->parent, NULL);
+
+  comp->pool_expire_time = g_get_monotonic_time () +
+      cdata->pool_idle_timeout * G_TIME_SPAN_MILLISECOND;
+  g_queue_push_tail (&component_pool, comp);
+
+  if (!component_pool_thread_running) {
+    component_pool_thread_running = TRUE;
+    g_thread_unref (g_thread_new ("omxcomponentpool",
+            gst_omx_component_pool_thread, NULL));
+  } else {
+    g_cond_broadcast (&component_pool_cond);
+  }
+  g_mutex_unlock (&component_pool_lock);
+
+  return;
+
+free:
+  gst_omx_component_free (comp);
+}
+
+const gchar *
+gst_omx_admission_return_to_string (GstOMXAdmissionReturn ret)
+{
+  switch (ret) {
+    case GST_OMX_ADMISSION_OK:
+      return "ok";
+    case GST_OMX_ADMISSION_NO_INSTANCES:
+      return "no-instances";
+    case GST_OMX_ADMISSION_NO_THROUGHPUT:
+      return "no-throughput";
+    default:
+      break;
+  }
+
+  return "unknown";
+}
+
+/* NOTE: Must be called while holding comp->core->lock */
+static GstOMXAdmissionReturn
+gst_omx_component_check_admission_unlocked (GstOMXComponent * comp,
+    const GstOMXClassData * cdata, guint macroblocks)
+{
+  GstOMXCore *core = comp->core;
+  guint used;
+
+  if (cdata->max_instances > 0 && !comp->reserved_component
+      && core->n_reserved >= cdata->max_instances)
+    return GST_OMX_ADMISSION_NO_INSTANCES;
+
+  if (cdata->max_macroblocks > 0) {
+    used = GPOINTER_TO_UINT (g_hash_table_lookup (core->reserved_macroblocks,
+            cdata->component_name));
+    if (comp->reserved_component)
+      used -= comp->reserved_macroblocks;
+
+    if (macroblocks > cdata->max_macroblocks - MIN (used,
+            cdata->max_macroblocks))
+      return GST_OMX_ADMISSION_NO_THROUGHPUT;
+  }
+
+  return GST_OMX_ADMISSION_OK;
+}
+
+/* Reserves an instance on the core and macroblocks per second of the
+ * component type for the component, replacing its previous reservation.
+ * Waits up to cdata->admission_timeout for other components to give
+ * back capacity.
+ *
+ * NOTE: Uses comp->core->lock */
+GstOMXAdmissionReturn
+gst_omx_component_reserve (GstOMXComponent * comp,
+    const GstOMXClassData * cdata, guint macroblocks)
+{
+  GstOMXCore *core;
+  GstOMXAdmissionReturn ret;
+  gint64 deadline;
+  guint used;
+
+  g_return_val_if_fail (comp != NULL, GST_OMX_ADMISSION_NO_INSTANCES);
+  g_return_val_if_fail (cdata != NULL, GST_OMX_ADMISSION_NO_INSTANCES);
+  g_return_val_if_fail (!comp->reserved_component
+      || comp->reserved_component == cdata->component_name,
+      GST_OMX_ADMISSION_NO_INSTANCES);
+
+  core = comp->core;
+
+  /* Waiting won't help if the component can never handle this alone */
+  if (cdata->max_macroblocks > 0 && macroblocks > cdata->max_macroblocks) {
+    GST_WARNING_OBJECT (comp->parent,
+        "%s needs %u macroblocks/s but only supports %u", comp->name,
+        macroblocks, cdata->max_macroblocks);
+    return GST_OMX_ADMISSION_NO_THROUGHPUT;
+  }
+
+  deadline = g_get_monotonic_time () +
+      cdata->admission_timeout * G_TIME_SPAN_MILLISECOND;
+
+  g_mutex_lock (&core->lock);
+  while ((ret = gst_omx_component_check_admission_unlocked (comp, cdata,
+              macroblocks)) != GST_OMX_ADMISSION_OK) {
+    GST_DEBUG_OBJECT (comp->parent, "%s waiting for capacity: %s",
+        comp->name, gst_omx_admission_return_to_string (ret));
+    if (!g_cond_wait_until (&core->admission_cond, &core->lock, deadline)) {
+      ret = gst_omx_component_check_admission_unlocked (comp, cdata,
+          macroblocks);
+      break;
+    }
+  }
+
+  if (ret == GST_OMX_ADMISSION_OK) {
+    used = GPOINTER_TO_UINT (g_hash_table_lookup (core->reserved_macroblocks,
+            cdata->component_name));
+    if (comp->reserved_component)
+      used -= comp->reserved_macroblocks;
+    else
+      core->n_reserved++;
+    g_hash_table_insert (core->reserved_macroblocks,
+        (gpointer) cdata->component_name,
+        GUINT_TO_POINTER (used + macroblocks));
+
+    /* Others might fit now if this one needs less than before */
+    if (comp->reserved_component && macroblocks < comp->reserved_macroblocks)
+      g_cond_broadcast (&core->admission_cond);
+
+    comp->reserved_component = cdata->component_name;
+    comp->reserved_macroblocks = macroblocks;
+
+    GST_DEBUG_OBJECT (comp->parent,
+        "%s reserved %u macroblocks/s, %u instances reserved on the core",
+        comp->name, macroblocks, core->n_reserved);
+  } else {
+    GST_WARNING_OBJECT (comp->parent, "%s failed to reserve capacity: %s",
+        comp->name, gst_omx_admission_return_to_string (ret));
+  }
+  g_mutex_unlock (&core->lock);
+
+  return ret;
+}
+
+/* Gives back the capacity reserved with gst_omx_component_reserve(),
+ * if any.
+ *
+ * NOTE: Uses comp->core->lock */
+void
+gst_omx_component_unreserve (GstOMXComponent * comp)
+{
+  GstOMXCore *core;
+  guint used;
+
+  g_return_if_fail (comp != NULL);
+
+  core = comp->core;
+
+  g_mutex_lock (&core->lock);
+  if (comp->reserved_component) {
+    used = GPOINTER_TO_UINT (g_hash_table_lookup (core->reserved_macroblocks,
+            comp->reserved_component));
+    used -= MIN (used, comp->reserved_macroblocks);
+    if (used > 0)
+      g_hash_table_insert (core->reserved_macroblocks,
+          (gpointer) comp->reserved_component, GUINT_TO_POINTER (used));
+    else
+      g_hash_table_remove (core->reserved_macroblocks,
+          comp->reserved_component);
+    core->n_reserved--;
+
+    GST_DEBUG_OBJECT (comp->parent, "%s gave back %u macroblocks/s",
+        comp->name, comp->reserved_macroblocks);
+
+    comp->reserved_component = NULL;
+    comp->reserved_macroblocks = 0;
+    g_cond_broadcast (&core->admission_cond);
+  }
+  g_mutex_unlock (&core->lock);
+}
+
 typedef GType (*GGetTypeFunction) (void);
 
 static const GGetTypeFunction types[] = {
@@ -2762,6 +4338,10 @@ gst_omx_parse_hacks (gchar ** hacks)
       hacks_flags |= GST_OMX_HACK_HEIGHT_MULTIPLE_16;
     else if (g_str_equal (*hacks, "pass-profile-to-decoder"))
       hacks_flags |= GST_OMX_HACK_PASS_PROFILE_TO_DECODER;
+    else if (g_str_equal (*hacks, "keeps-output-buffers"))
+      hacks_flags |= GST_OMX_HACK_KEEPS_OUTPUT_BUFFERS;
+    else if (g_str_equal (*hacks, "flush-in-executing"))
+      hacks_flags |= GST_OMX_HACK_FLUSH_IN_EXECUTING;
     else
       GST_WARNING ("Unknown hack: %s", *hacks);
     hacks++;
@@ -2779,6 +4359,60 @@ gst_omx_set_default_role (GstOMXClassData * class_data,
     class_data->component_role = default_role;
 }
 
+static GstCaps *
+gst_omx_get_registered_template_caps (const gchar * element_name,
+    const gchar * templ_name)
+{
+  GstPluginFeature *feature;
+  const GList *l;
+  GstCaps *caps = NULL;
+
+  feature = gst_registry_lookup_feature (gst_registry_get (), element_name);
+  if (!feature)
+    return NULL;
+
+  if (GST_IS_ELEMENT_FACTORY (feature)) {
+    l = gst_element_factory_get_static_pad_templates (GST_ELEMENT_FACTORY
+        (feature));
+    for (; l; l = l->next) {
+      GstStaticPadTemplate *templ = l->data;
+
+      if (g_str_equal (templ->name_template, templ_name)) {
+        caps = gst_static_pad_template_get_caps (templ);
+        break;
+      }
+    }
+  }
+  gst_object_unref (feature);
+
+  return caps;
+}
+
+/* Narrows the template caps to what the component supports. The
+ * element factory keeps the result in the registry, the component is
+ * only probed again when the registry is rebuilt, e.g. because the
+ * configuration file changed. Takes ownership of caps */
+static GstCaps *
+gst_omx_probe_template_caps (const GstOMXClassData * class_data,
+    const gchar * element_name, GstPadDirection direction, GstCaps * caps)
+{
+  GstCaps *registered;
+
+  registered = gst_omx_get_registered_template_caps (element_name,
+      direction == GST_PAD_SINK ? "sink" : "src");
+  if (registered) {
+    GST_DEBUG ("Using registered %s template caps for element '%s'",
+        direction == GST_PAD_SINK ? "sink" : "src", element_name);
+    gst_caps_unref (caps);
+    return registered;
+  }
+
+  GST_DEBUG ("Probing %s template caps for element '%s'",
+      direction == GST_PAD_SINK ? "sink" : "src", element_name);
+
+  return gst_omx_video_probe_template_caps (class_data, direction, caps);
+}
+
 static void
 _class_init (gpointer g_class, gpointer data)
 {
@@ -2789,10 +4423,14 @@ _class_init (gpointer g_class, gpointer data)
   GError *err;
   gchar *core_name, *component_name, *component_role;
   gint in_port_index, out_port_index;
+  gint pool_size, pool_idle_timeout;
+  gint max_instances, max_macroblocks, admission_timeout;
   gchar *template_caps;
   GstPadTemplate *templ;
   GstCaps *caps;
   gchar **hacks;
+  gchar *frame_memory;
+  gboolean probe_caps;
   int i;
 
   if (!element_name)
@@ -2855,6 +4493,96 @@ _class_init (gpointer g_class, gpointer data)
   }
   class_data->out_port_index = out_port_index;
 
+  /* Components are not kept around for reuse by default */
+  err = NULL;
+  pool_size = g_key_file_get_integer (config, element_name, "pool-size", &err);
+  if (err != NULL) {
+    pool_size = 0;
+    g_error_free (err);
+  }
+  class_data->pool_size = MAX (pool_size, 0);
+
+  err = NULL;
+  pool_idle_timeout =
+      g_key_file_get_integer (config, element_name, "pool-idle-timeout", &err);
+  if (err != NULL) {
+    pool_idle_timeout = GST_OMX_DEFAULT_POOL_IDLE_TIMEOUT;
+    g_error_free (err);
+  }
+  class_data->pool_idle_timeout = MAX (pool_idle_timeout, 0);
+  GST_DEBUG ("Keeping up to %u components for %u ms for element '%s'",
+      class_data->pool_size, class_data->pool_idle_timeout, element_name);
+
+  /* No admission control by default */
+  err = NULL;
+  max_instances =
+      g_key_file_get_integer (config, element_name, "max-instances", &err);
+  if (err != NULL) {
+    max_instances = 0;
+    g_error_free (err);
+  }
+  class_data->max_instances = MAX (max_instances, 0);
+
+  err = NULL;
+  max_macroblocks =
+      g_key_file_get_integer (config, element_name, "max-macroblocks", &err);
+  if (err != NULL) {
+    max_macroblocks = 0;
+    g_error_free (err);
+  }
+  class_data->max_macroblocks = MAX (max_macroblocks, 0);
+
+  err = NULL;
+  admission_timeout =
+      g_key_file_get_integer (config, element_name, "admission-timeout", &err);
+  if (err != NULL) {
+    admission_timeout = 0;
+    g_error_free (err);
+  }
+  class_data->admission_timeout = MAX (admission_timeout, 0);
+  GST_DEBUG ("Admitting up to %u instances and %u macroblocks/s, waiting "
+      "%u ms for element '%s'", class_data->max_instances,
+      class_data->max_macroblocks, class_data->admission_timeout,
+      element_name);
+
+  /* Frame buffers are plain system memory by default */
+  class_data->frame_memory = GST_OMX_FRAME_MEMORY_SYSTEM;
+  if ((frame_memory =
+          g_key_file_get_string (config, element_name, "frame-memory",
+              NULL))) {
+    GEnumClass *enum_class = g_type_class_ref (GST_TYPE_OMX_FRAME_MEMORY_MODE);
+    GEnumValue *value = g_enum_get_value_by_nick (enum_class, frame_memory);
+
+    if (value)
+      class_data->frame_memory = value->value;
+    else
+      GST_WARNING ("Unknown frame-memory '%s' for element '%s'", frame_memory,
+          element_name);
+    g_type_class_unref (enum_class);
+    g_free (frame_memory);
+  }
+
+  if ((hacks =
+          g_key_file_get_string_list (config, element_name, "hacks", NULL,
+              NULL))) {
+#ifndef GST_DISABLE_GST_DEBUG
+    gchar **walk = hacks;
+
+    while (*walk) {
+      GST_DEBUG ("Using hack: %s", *walk);
+      walk++;
+    }
+#endif
+
+    class_data->hacks = gst_omx_parse_hacks (hacks);
+    g_strfreev (hacks);
+  }
+
+  /* Probing the component for its capabilities is slow and needs the
+   * hardware to be available when registering, so it is optional */
+  probe_caps =
+      g_key_file_get_boolean (config, element_name, "probe-caps", NULL);
+
   /* Add pad templates */
   err = NULL;
   if (class_data->type != GST_OMX_COMPONENT_TYPE_SOURCE) {
@@ -2878,6 +4606,9 @@ _class_init (gpointer g_class, gpointer data)
         g_assert (caps != NULL);
       }
     }
+    if (probe_caps)
+      caps = gst_omx_probe_template_caps (class_data, element_name,
+          GST_PAD_SINK, caps);
     templ = gst_pad_template_new ("sink", GST_PAD_SINK, GST_PAD_ALWAYS, caps);
     g_free (template_caps);
     gst_element_class_add_pad_template (element_class, templ);
@@ -2905,27 +4636,14 @@ _class_init (gpointer g_class, gpointer data)
         g_assert (caps != NULL);
       }
     }
+    if (probe_caps)
+      caps = gst_omx_probe_template_caps (class_data, element_name,
+          GST_PAD_SRC, caps);
     templ = gst_pad_template_new ("src", GST_PAD_SRC, GST_PAD_ALWAYS, caps);
     g_free (template_caps);
     gst_element_class_add_pad_template (element_class, templ);
     gst_caps_unref (caps);
   }
-
-  if ((hacks =
-          g_key_file_get_string_list (config, element_name, "hacks", NULL,
-              NULL))) {
-#ifndef GST_DISABLE_GST_DEBUG
-    gchar **walk = hacks;
-
-    while (*walk) {
-      GST_DEBUG ("Using hack: %s", *walk);
-      walk++;
-    }
-#endif
-
-    class_data->hacks = gst_omx_parse_hacks (hacks);
-    g_strfreev (hacks);
-  }
 }
 
 static gboolean
@@ -2934,7 +4652,7 @@ plugin_init (GstPlugin * plugin)
   GError *err = NULL;
   gchar **config_dirs;
   gchar **elements;
-  gchar *env_config_dir;
+  gchar *env_config_dir, *config_path = NULL;
   const gchar *user_config_dir;
   const gchar *const *system_config_dirs;
   gint i, j;
@@ -2947,6 +4665,15 @@ plugin_init (GstPlugin * plugin)
   GST_DEBUG_CATEGORY_INIT (gst_omx_video_debug_category, "omxvideo", 0,
       "gst-omx-video");
 
+  gst_tracer_register (plugin, "omx", GST_TYPE_OMX_TRACER);
+
+  gst_omx_copy_init ();
+
+  /* The plugin is finalized with the registry in gst_deinit() */
+  g_object_set_qdata_full (G_OBJECT (plugin),
+      g_quark_from_static_string ("gst-omx-component-pool"), &component_pool,
+      gst_omx_component_pool_clear);
+
   /* Read configuration file gstomx.conf from the preferred
    * configuration directories */
   env_config_dir = g_strdup (g_getenv (*env_config_name));
@@ -2971,7 +4698,8 @@ plugin_init (GstPlugin * plugin)
 
   config = g_key_file_new ();
   if (!g_key_file_load_from_dirs (config, *config_name,
-          (const gchar **) config_dirs, NULL, G_KEY_FILE_NONE, &err)) {
+          (const gchar **) config_dirs, &config_path, G_KEY_FILE_NONE,
+          &err)) {
     gchar *paths;
 
     paths = g_strjoinv (":", config_dirs);
@@ -2984,6 +4712,9 @@ plugin_init (GstPlugin * plugin)
     goto done;
   }
 
+  gst_omx_cache_init (config_path);
+  g_free (config_path);
+
   /* Initialize all types */
   for (i = 0; i < G_N_ELEMENTS (types); i++)
     types[i] ();
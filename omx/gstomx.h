@@ -74,6 +74,9 @@
 #pragma pack()
 #endif
 
+#include "gstomxtracer.h"
+#include "gstomxallocator.h"
+
 G_BEGIN_DECLS
 
 #define GST_OMX_INIT_STRUCT(st) G_STMT_START { \
@@ -166,6 +169,19 @@ G_BEGIN_DECLS
  */
 #define GST_OMX_HACK_PASS_PROFILE_TO_DECODER        G_GUINT64_CONSTANT (0x0000000000000800)
 
+/* If the component keeps filling its allocated output buffers after
+ * signalling new output port settings, as long as they are still large
+ * enough, instead of waiting for the port to be disabled and enabled
+ * again. Happens with components that support adaptive playback.
+ */
+#define GST_OMX_HACK_KEEPS_OUTPUT_BUFFERS           G_GUINT64_CONSTANT (0x0000000000001000)
+
+/* If the component can flush its ports while Executing. Decoders then
+ * don't need to go through the Pause state and to restart their srcpad
+ * task on every flush, which makes seeking faster.
+ */
+#define GST_OMX_HACK_FLUSH_IN_EXECUTING             G_GUINT64_CONSTANT (0x0000000000002000)
+
 typedef struct _GstOMXCore GstOMXCore;
 typedef struct _GstOMXPort GstOMXPort;
 typedef enum _GstOMXPortDirection GstOMXPortDirection;
@@ -173,6 +189,9 @@ typedef struct _GstOMXComponent GstOMXComponent;
 typedef struct _GstOMXBuffer GstOMXBuffer;
 typedef struct _GstOMXClassData GstOMXClassData;
 typedef struct _GstOMXMessage GstOMXMessage;
+typedef struct _GstOMXMessageRing GstOMXMessageRing;
+typedef struct _GstOMXTimelineEntry GstOMXTimelineEntry;
+typedef struct _GstOMXStateChanges GstOMXStateChanges;
 
 typedef enum {
   /* Everything good and the buffer is valid */
@@ -187,6 +206,23 @@ typedef enum {
   GST_OMX_ACQUIRE_BUFFER_ERROR
 } GstOMXAcquireBufferReturn;
 
+/* Called from the OpenMAX IL callback thread once a state change started
+ * with gst_omx_component_set_state_async() finished. state is the new
+ * state, or OMX_StateInvalid if the state change failed, was superseded
+ * by another one or the component was freed or released. Must not call
+ * any other function on the component */
+typedef void (*GstOMXComponentStateCallback) (GstOMXComponent * comp,
+    OMX_STATETYPE state, OMX_ERRORTYPE err, gpointer user_data);
+
+typedef enum {
+  /* The capacity was reserved */
+  GST_OMX_ADMISSION_OK = 0,
+  /* The core has no free instances */
+  GST_OMX_ADMISSION_NO_INSTANCES,
+  /* The component type has not enough macroblocks per second left */
+  GST_OMX_ADMISSION_NO_THROUGHPUT
+} GstOMXAdmissionReturn;
+
 struct _GstOMXCore {
   /* Handle to the OpenMAX IL core shared library */
   GModule *module;
@@ -203,6 +239,12 @@ struct _GstOMXCore {
       OMX_STRING name, OMX_PTR data, OMX_CALLBACKTYPE * callbacks);
   OMX_ERRORTYPE (*free_handle) (OMX_HANDLETYPE handle);
   OMX_ERRORTYPE (*setup_tunnel) (OMX_HANDLETYPE output, OMX_U32 outport, OMX_HANDLETYPE input, OMX_U32 inport);
+
+  /* Capacity reserved with gst_omx_component_reserve(), admission_cond
+   * is signalled whenever capacity is given back */
+  GCond admission_cond;
+  guint n_reserved; /* LOCK */
+  GHashTable *reserved_macroblocks; /* LOCK, component name -> guint */
 };
 
 typedef enum {
@@ -283,6 +325,29 @@ struct _GstOMXPort {
    */
   gint settings_cookie;
   gint configured_settings_cookie;
+
+  /* Signalled for buffers done on this port and for
+   * component-wide events, protected by comp->messages_lock */
+  GCond messages_cond;
+  gint messages_waiters;
+
+  /* comp->control_generation when buffers were last acquired through
+   * all the checks, protected by comp->lock */
+  gint acquire_generation;
+
+  /* When the port was last enabled, for the startup timeline */
+  gint64 timeline_enable_start;
+
+  /* Number of buffers passed to the component, the lowest number since
+   * the last gst_omx_port_take_usage() call and since when and for how
+   * long in total the component had none, protected by comp->lock */
+  guint n_used;
+  guint min_used;
+  gint64 starved_since;
+  gint64 starved_time;
+  /* Number of buffers that are shared with a pool, protected by
+   * comp->lock */
+  guint n_shared;
 };
 
 struct _GstOMXComponent {
@@ -302,10 +367,21 @@ struct _GstOMXComponent {
   /* Locking order: lock -> messages_lock
    *
    * Never hold lock while waiting for messages_cond
-   * Always check that messages is empty before waiting */
+   * Always check that messages is empty before waiting
+   * Buffers done don't signal the messages_cond of other ports */
   GMutex lock;
 
-  GQueue messages; /* Queue of GstOMXMessages */
+  /* Messages from the OMX callbacks are written lock-free into
+   * messages_ring and only go to the messages queue if the ring
+   * is full. While messages_overflow is set all new messages go
+   * to the queue to keep them ordered.
+   */
+  GstOMXMessageRing *messages_ring; /* ATOMIC, replaced with lock */
+  gint messages_ring_writers; /* ATOMIC */
+  gint messages_overflow; /* ATOMIC, set with messages_lock */
+  gint messages_waiters; /* ATOMIC, all threads in wait_message */
+  gint messages_port_waiters; /* waiting on port messages_cond, with messages_lock */
+  GQueue messages; /* Queue of GstOMXMessages, overflow of messages_ring */
   GMutex messages_lock;
   GCond messages_cond;
 
@@ -316,6 +392,40 @@ struct _GstOMXComponent {
   OMX_ERRORTYPE last_error;
 
   GList *pending_reconfigure_outports;
+
+  /* Notified when pending_state is reached, protected by messages_lock
+   * as it is used from the OMX callbacks */
+  GstOMXComponentStateCallback state_callback;
+  gpointer state_callback_data;
+  OMX_STATETYPE state_callback_state;
+
+  /* Increased for every message or state change other than
+   * a buffer being done. Buffers can be acquired without any
+   * further checks as long as it stays the same */
+  gint control_generation; /* ATOMIC */
+
+  /* Buffer timing histograms, NULL unless the omx tracer is active */
+  GstOMXTracerStats *tracer_stats;
+
+  /* Startup phases from creation until the first output buffer was
+   * filled, protected by lock. NULL after the timeline was taken */
+  GArray *timeline; /* Contains GstOMXTimelineEntry */
+  gint64 timeline_start;
+  gint64 timeline_state_start;
+  gboolean timeline_submitted; /* TRUE after the first EmptyThisBuffer */
+  gboolean timeline_complete; /* TRUE after the first FillBufferDone */
+
+  /* Set by gst_omx_component_acquire(), NULL otherwise. Also used
+   * to cache the capabilities of the component */
+  const GstOMXClassData *pool_cdata;
+  /* TRUE if the component was taken from the pool */
+  gboolean reused;
+  /* When the component is freed if it stays in the pool */
+  gint64 pool_expire_time;
+
+  /* Set by gst_omx_component_reserve(), protected by core->lock */
+  const gchar *reserved_component;
+  guint reserved_macroblocks;
 };
 
 struct _GstOMXBuffer {
@@ -329,6 +439,17 @@ struct _GstOMXBuffer {
 
   /* Cookie of the settings when this buffer was allocated */
   gint settings_cookie;
+  /* Cookie of the settings when the component last filled this
+   * output buffer */
+  gint filled_settings_cookie;
+
+  /* Monotonic time in microseconds when the buffer was last passed to
+   * the component and when the component returned it */
+  gint64 submit_time;
+  gint64 done_time;
+  /* When the buffer was put in the pending buffers, only set if the
+   * component has tracer stats */
+  gint64 pending_time;
 
   /* TRUE if this is an EGLImage */
   gboolean eglimage;
@@ -340,6 +461,32 @@ struct _GstOMXBuffer {
   GstMemory *input_mem;
   GstBuffer *input_buffer;
   GstMapInfo map;
+
+  /* Buffer of a GstOMXBufferPool wrapping this input buffer, kept
+   * alive while the component uses it so it only goes back to the pool
+   * after EmptyBufferDone */
+  GstBuffer *pool_buffer;
+  /* TRUE while such a pool wraps this buffer, it is then only returned
+   * by gst_omx_port_take_buffer(). Protected by comp->lock */
+  gboolean shared;
+};
+
+struct _GstOMXTimelineEntry {
+  const gchar *phase; /* static string */
+  gint port; /* -1 for the whole component */
+  /* Monotonic time in microseconds */
+  gint64 start, end;
+};
+
+/* State changes of one or more components that run at the same time and
+ * are waited for together, see gst_omx_state_changes_add() */
+struct _GstOMXStateChanges {
+  GMutex lock;
+  GCond cond;
+  /* Started but not finished yet */
+  guint n_pending;
+  /* First error since the last wait */
+  OMX_ERRORTYPE last_error;
 };
 
 struct _GstOMXClassData {
@@ -355,6 +502,23 @@ struct _GstOMXClassData {
   guint64 hacks;
 
   GstOmxComponentType type;
+
+  /* Maximum number of unused components kept by
+   * gst_omx_component_release() and for how long in milliseconds */
+  guint pool_size;
+  guint pool_idle_timeout;
+
+  /* Admission control, 0 means unlimited. max_instances is the number
+   * of components with reserved capacity on the core, max_macroblocks
+   * the macroblocks per second of all components with this component
+   * name. admission_timeout is how long to wait for capacity in
+   * milliseconds */
+  guint max_instances;
+  guint max_macroblocks;
+  guint admission_timeout;
+
+  /* Memory for the frame buffers the elements allocate themselves */
+  GstOMXFrameMemoryMode frame_memory;
 };
 
 GKeyFile *        gst_omx_get_configuration (void);
@@ -372,15 +536,30 @@ void              gst_omx_core_release (GstOMXCore * core);
 
 GstOMXComponent * gst_omx_component_new (GstObject * parent, const gchar *core_name, const gchar *component_name, const gchar * component_role, guint64 hacks);
 void              gst_omx_component_free (GstOMXComponent * comp);
+GstOMXComponent * gst_omx_component_acquire (GstObject * parent, const GstOMXClassData * cdata);
+void              gst_omx_component_release (GstOMXComponent * comp);
+
+GstOMXAdmissionReturn gst_omx_component_reserve (GstOMXComponent * comp, const GstOMXClassData * cdata, guint macroblocks);
+void              gst_omx_component_unreserve (GstOMXComponent * comp);
+const gchar *     gst_omx_admission_return_to_string (GstOMXAdmissionReturn ret);
 
 OMX_ERRORTYPE     gst_omx_component_set_state (GstOMXComponent * comp, OMX_STATETYPE state);
+OMX_ERRORTYPE     gst_omx_component_set_state_async (GstOMXComponent * comp, OMX_STATETYPE state, GstOMXComponentStateCallback callback, gpointer user_data);
 OMX_STATETYPE     gst_omx_component_get_state (GstOMXComponent * comp, GstClockTime timeout);
 
+void              gst_omx_state_changes_init (GstOMXStateChanges * changes);
+void              gst_omx_state_changes_clear (GstOMXStateChanges * changes);
+OMX_ERRORTYPE     gst_omx_state_changes_add (GstOMXStateChanges * changes, GstOMXComponent * comp, OMX_STATETYPE state);
+OMX_ERRORTYPE     gst_omx_state_changes_wait (GstOMXStateChanges * changes, GstClockTime timeout);
+
+GstStructure *    gst_omx_component_take_timeline (GstOMXComponent * comp);
+
 OMX_ERRORTYPE     gst_omx_component_get_last_error (GstOMXComponent * comp);
 const gchar *     gst_omx_component_get_last_error_string (GstOMXComponent * comp);
 
 GstOMXPort *      gst_omx_component_add_port (GstOMXComponent * comp, guint32 index);
 GstOMXPort *      gst_omx_component_get_port (GstOMXComponent * comp, guint32 index);
+gboolean          gst_omx_component_detect_port_indices (GstOMXComponent * comp, OMX_INDEXTYPE index, gint * in_port_index, gint * out_port_index);
 
 OMX_ERRORTYPE     gst_omx_component_get_parameter (GstOMXComponent * comp, OMX_INDEXTYPE index, gpointer param);
 OMX_ERRORTYPE     gst_omx_component_set_parameter (GstOMXComponent * comp, OMX_INDEXTYPE index, gpointer param);
@@ -396,10 +575,16 @@ OMX_ERRORTYPE     gst_omx_port_get_port_definition (GstOMXPort * port, OMX_PARAM
 OMX_ERRORTYPE     gst_omx_port_update_port_definition (GstOMXPort *port, OMX_PARAM_PORTDEFINITIONTYPE *port_definition);
 
 GstOMXAcquireBufferReturn gst_omx_port_acquire_buffer (GstOMXPort *port, GstOMXBuffer **buf);
+GstOMXAcquireBufferReturn gst_omx_port_take_buffer (GstOMXPort *port, GstOMXBuffer *buf);
+void              gst_omx_port_set_buffer_shared (GstOMXPort *port, GstOMXBuffer *buf, gboolean shared);
+GstOMXAcquireBufferReturn gst_omx_port_acquire_buffers (GstOMXPort *port, GstOMXBuffer **bufs, guint max, guint *n_bufs);
 OMX_ERRORTYPE     gst_omx_port_release_buffer (GstOMXPort *port, GstOMXBuffer *buf);
+OMX_ERRORTYPE     gst_omx_port_release_buffers (GstOMXPort *port, GstOMXBuffer **bufs, guint n);
 
 OMX_ERRORTYPE     gst_omx_port_set_flushing (GstOMXPort *port, GstClockTime timeout, gboolean flush);
 gboolean          gst_omx_port_is_flushing (GstOMXPort *port);
+gboolean          gst_omx_port_has_pending_buffers (GstOMXPort *port);
+void              gst_omx_port_get_buffer_counts (GstOMXPort *port, guint *n_used, guint *n_pending);
 
 OMX_ERRORTYPE     gst_omx_port_allocate_buffers (GstOMXPort *port);
 OMX_ERRORTYPE     gst_omx_port_use_buffers (GstOMXPort *port, const GList *buffers);
@@ -413,6 +598,8 @@ OMX_ERRORTYPE     gst_omx_port_mark_reconfigured (GstOMXPort * port);
 OMX_ERRORTYPE     gst_omx_port_set_enabled (GstOMXPort * port, gboolean enabled);
 OMX_ERRORTYPE     gst_omx_port_wait_enabled (GstOMXPort * port, GstClockTime timeout);
 gboolean          gst_omx_port_is_enabled (GstOMXPort * port);
+gboolean          gst_omx_port_buffers_fit (GstOMXPort * port);
+void              gst_omx_port_take_usage (GstOMXPort * port, gint64 * starved_time, guint * min_used);
 
 /* OMX 1.2.0 dynamic allocation mode */
 gboolean          gst_omx_is_dynamic_allocation_supported (void);
@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2026, RidgeRun
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/* Allocator for video frames that are big enough for TLB misses and
+ * page faults on the first touch to matter. Every memory is mapped on
+ * its own, aligned to at least a page and to the requested alignment,
+ * and all its pages are faulted in before it is handed out. Depending
+ * on the mode the mapping is also backed by huge pages.
+ *
+ * The mode is selected with the "frame-memory" key in the configuration
+ * file or the "frame-memory" property of the elements using it.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "gstomxallocator.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_omx_allocator_debug_category);
+#define GST_CAT_DEFAULT gst_omx_allocator_debug_category
+
+/* Size of the huge pages used for alignment with transparent huge pages,
+ * the default size on all architectures we care about */
+#define GST_OMX_FRAME_ALLOCATOR_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+typedef struct _GstOMXFrameMemory GstOMXFrameMemory;
+
+struct _GstOMXFrameMemory
+{
+  GstMemory mem;
+
+  /* The mapping, only set for memories that are not shared */
+  gpointer base;
+  gsize length;
+
+  /* Start of the memory inside the mapping */
+  guint8 *data;
+};
+
+GType
+gst_omx_frame_memory_mode_get_type (void)
+{
+  static GType qtype = 0;
+
+  if (qtype == 0) {
+    static const GEnumValue values[] = {
+      {GST_OMX_FRAME_MEMORY_SYSTEM, "System memory", "system"},
+      {GST_OMX_FRAME_MEMORY_ALIGNED, "Aligned and pre-faulted", "aligned"},
+      {GST_OMX_FRAME_MEMORY_THP, "Transparent huge pages", "thp"},
+      {GST_OMX_FRAME_MEMORY_HUGETLB, "Reserved huge pages", "hugetlb"},
+      {0, NULL, NULL}
+    };
+
+    qtype = g_enum_register_static ("GstOMXFrameMemoryMode", values);
+  }
+  return qtype;
+}
+
+G_DEFINE_TYPE_WITH_CODE (GstOMXFrameAllocator, gst_omx_frame_allocator,
+    GST_TYPE_ALLOCATOR,
+    GST_DEBUG_CATEGORY_INIT (gst_omx_allocator_debug_category, "omxallocator",
+        0, "debug category for the omx frame allocator"));
+
+static gsize
+gst_omx_frame_allocator_get_page_size (void)
+{
+  static gsize page_size = 0;
+
+  if (g_once_init_enter (&page_size)) {
+    glong size = sysconf (_SC_PAGESIZE);
+
+    g_once_init_leave (&page_size, size > 0 ? size : 4096);
+  }
+
+  return page_size;
+}
+
+static GstMemory *
+gst_omx_frame_allocator_alloc (GstAllocator * allocator, gsize size,
+    GstAllocationParams * params)
+{
+  GstOMXFrameAllocator *self = GST_OMX_FRAME_ALLOCATOR (allocator);
+  GstOMXFrameMemory *mem;
+  gsize page_size, maxsize, align, length = 0, i;
+  gpointer base = MAP_FAILED;
+  gboolean hugetlb = FALSE;
+  guint8 *data;
+
+  page_size = gst_omx_frame_allocator_get_page_size ();
+  maxsize = params->prefix + size + params->padding;
+
+  align = MAX (params->align + 1, page_size);
+  if (self->mode != GST_OMX_FRAME_MEMORY_ALIGNED)
+    align = MAX (align, GST_OMX_FRAME_ALLOCATOR_HUGE_PAGE_SIZE);
+
+#ifdef MAP_HUGETLB
+  if (self->mode == GST_OMX_FRAME_MEMORY_HUGETLB) {
+    /* Huge page mappings are aligned to the huge page size already */
+    length = GST_ROUND_UP_N (maxsize + align -
+        GST_OMX_FRAME_ALLOCATOR_HUGE_PAGE_SIZE,
+        GST_OMX_FRAME_ALLOCATOR_HUGE_PAGE_SIZE);
+    base = mmap (NULL, length, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (base != MAP_FAILED)
+      hugetlb = TRUE;
+    else
+      GST_DEBUG_OBJECT (self, "No huge pages for %" G_GSIZE_FORMAT " bytes, "
+          "using transparent huge pages: %s", maxsize, g_strerror (errno));
+  }
+#endif
+
+  if (base == MAP_FAILED) {
+    length = GST_ROUND_UP_N (maxsize + align - page_size, page_size);
+    base = mmap (NULL, length, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+      GST_ERROR_OBJECT (self, "Failed to map %" G_GSIZE_FORMAT " bytes: %s",
+          length, g_strerror (errno));
+      return NULL;
+    }
+  }
+
+  data = (guint8 *) GST_ROUND_UP_N ((guintptr) base, align);
+
+#ifdef MADV_HUGEPAGE
+  if (self->mode != GST_OMX_FRAME_MEMORY_ALIGNED && !hugetlb
+      && madvise (data, GST_ROUND_UP_N (maxsize, page_size),
+          MADV_HUGEPAGE) != 0)
+    GST_DEBUG_OBJECT (self, "Transparent huge pages not available: %s",
+        g_strerror (errno));
+#endif
+
+  /* Fault everything in now instead of on the first frame written */
+  for (i = 0; i < maxsize; i += page_size)
+    ((volatile guint8 *) data)[i] = 0;
+
+  GST_LOG_OBJECT (self, "Mapped %" G_GSIZE_FORMAT " bytes at %p for %"
+      G_GSIZE_FORMAT " bytes at %p%s", length, base, maxsize, data,
+      hugetlb ? " from huge pages" : "");
+
+  mem = g_slice_new (GstOMXFrameMemory);
+  gst_memory_init (GST_MEMORY_CAST (mem), params->flags, allocator, NULL,
+      maxsize, params->align, params->prefix, size);
+  mem->base = base;
+  mem->length = length;
+  mem->data = data;
+
+  return GST_MEMORY_CAST (mem);
+}
+
+static void
+gst_omx_frame_allocator_free (GstAllocator * allocator, GstMemory * mem)
+{
+  GstOMXFrameMemory *fmem = (GstOMXFrameMemory *) mem;
+
+  if (fmem->base)
+    munmap (fmem->base, fmem->length);
+
+  g_slice_free (GstOMXFrameMemory, fmem);
+}
+
+static gpointer
+gst_omx_frame_memory_map (GstMemory * mem, gsize maxsize, GstMapFlags flags)
+{
+  GstOMXFrameMemory *fmem = (GstOMXFrameMemory *) mem;
+
+  return fmem->data;
+}
+
+static void
+gst_omx_frame_memory_unmap (GstMemory * mem)
+{
+}
+
+static GstMemory *
+gst_omx_frame_memory_share (GstMemory * mem, gssize offset, gssize size)
+{
+  GstOMXFrameMemory *fmem = (GstOMXFrameMemory *) mem;
+  GstOMXFrameMemory *sub;
+  GstMemory *parent;
+
+  if ((parent = mem->parent) == NULL)
+    parent = mem;
+
+  if (size == -1)
+    size = mem->size - offset;
+
+  /* The shared memory is always readonly and keeps the parent's
+   * mapping alive */
+  sub = g_slice_new0 (GstOMXFrameMemory);
+  gst_memory_init (GST_MEMORY_CAST (sub),
+      GST_MINI_OBJECT_FLAGS (parent) | GST_MINI_OBJECT_FLAG_LOCK_READONLY,
+      mem->allocator, parent, mem->maxsize, mem->align, mem->offset + offset,
+      size);
+  sub->data = fmem->data;
+
+  return GST_MEMORY_CAST (sub);
+}
+
+static void
+gst_omx_frame_allocator_class_init (GstOMXFrameAllocatorClass * klass)
+{
+  GstAllocatorClass *allocator_class = GST_ALLOCATOR_CLASS (klass);
+
+  allocator_class->alloc = gst_omx_frame_allocator_alloc;
+  allocator_class->free = gst_omx_frame_allocator_free;
+}
+
+static void
+gst_omx_frame_allocator_init (GstOMXFrameAllocator * self)
+{
+  GstAllocator *alloc = GST_ALLOCATOR_CAST (self);
+
+  alloc->mem_type = GST_OMX_FRAME_MEMORY_TYPE;
+  alloc->mem_map = gst_omx_frame_memory_map;
+  alloc->mem_unmap = gst_omx_frame_memory_unmap;
+  alloc->mem_share = gst_omx_frame_memory_share;
+
+  /* default copy & is_span */
+}
+
+/* Returns a new allocator for mode, which must not be
+ * GST_OMX_FRAME_MEMORY_SYSTEM */
+GstAllocator *
+gst_omx_frame_allocator_new (GstOMXFrameMemoryMode mode)
+{
+  GstOMXFrameAllocator *self;
+
+  g_return_val_if_fail (mode != GST_OMX_FRAME_MEMORY_SYSTEM, NULL);
+
+  self = g_object_new (GST_TYPE_OMX_FRAME_ALLOCATOR, NULL);
+  gst_object_ref_sink (self);
+  self->mode = mode;
+
+  return GST_ALLOCATOR_CAST (self);
+}
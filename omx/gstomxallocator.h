@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2026, RidgeRun
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __GST_OMX_ALLOCATOR_H__
+#define __GST_OMX_ALLOCATOR_H__
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_OMX_FRAME_MEMORY_MODE \
+  (gst_omx_frame_memory_mode_get_type())
+
+#define GST_TYPE_OMX_FRAME_ALLOCATOR \
+  (gst_omx_frame_allocator_get_type())
+#define GST_OMX_FRAME_ALLOCATOR(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_OMX_FRAME_ALLOCATOR,GstOMXFrameAllocator))
+#define GST_OMX_FRAME_ALLOCATOR_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_OMX_FRAME_ALLOCATOR,GstOMXFrameAllocatorClass))
+#define GST_IS_OMX_FRAME_ALLOCATOR(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_OMX_FRAME_ALLOCATOR))
+#define GST_IS_OMX_FRAME_ALLOCATOR_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_OMX_FRAME_ALLOCATOR))
+
+#define GST_OMX_FRAME_MEMORY_TYPE "openmax-frame"
+
+typedef struct _GstOMXFrameAllocator GstOMXFrameAllocator;
+typedef struct _GstOMXFrameAllocatorClass GstOMXFrameAllocatorClass;
+
+typedef enum {
+  /* Whatever the buffer pool allocates */
+  GST_OMX_FRAME_MEMORY_SYSTEM = 0,
+  /* Page aligned and pre-faulted */
+  GST_OMX_FRAME_MEMORY_ALIGNED,
+  /* Like aligned, but advised to be backed by transparent huge pages */
+  GST_OMX_FRAME_MEMORY_THP,
+  /* Like aligned, but from the reserved huge pages. Falls back to
+   * transparent huge pages if none are left */
+  GST_OMX_FRAME_MEMORY_HUGETLB
+} GstOMXFrameMemoryMode;
+
+struct _GstOMXFrameAllocator
+{
+  GstAllocator parent;
+
+  GstOMXFrameMemoryMode mode;
+};
+
+struct _GstOMXFrameAllocatorClass
+{
+  GstAllocatorClass parent_class;
+};
+
+GType          gst_omx_frame_memory_mode_get_type (void);
+GType          gst_omx_frame_allocator_get_type (void);
+
+GstAllocator * gst_omx_frame_allocator_new (GstOMXFrameMemoryMode mode);
+
+G_END_DECLS
+
+#endif /* __GST_OMX_ALLOCATOR_H__ */
@@ -121,10 +121,7 @@ gst_omx_audio_dec_open (GstAudioDecoder * decoder)
 
   GST_DEBUG_OBJECT (self, "Opening decoder");
 
-  self->dec =
-      gst_omx_component_new (GST_OBJECT_CAST (self), klass->cdata.core_name,
-      klass->cdata.component_name, klass->cdata.component_role,
-      klass->cdata.hacks);
+  self->dec = gst_omx_component_acquire (GST_OBJECT_CAST (self), &klass->cdata);
   self->started = FALSE;
 
   if (!self->dec)
@@ -138,25 +135,11 @@ gst_omx_audio_dec_open (GstAudioDecoder * decoder)
   out_port_index = klass->cdata.out_port_index;
 
   if (in_port_index == -1 || out_port_index == -1) {
-    OMX_PORT_PARAM_TYPE param;
-    OMX_ERRORTYPE err;
-
-    GST_OMX_INIT_STRUCT (&param);
-
-    err =
-        gst_omx_component_get_parameter (self->dec, OMX_IndexParamAudioInit,
-        &param);
-    if (err != OMX_ErrorNone) {
-      GST_WARNING_OBJECT (self, "Couldn't get port information: %s (0x%08x)",
-          gst_omx_error_to_string (err), err);
+    if (!gst_omx_component_detect_port_indices (self->dec,
+            OMX_IndexParamAudioInit, &in_port_index, &out_port_index)) {
       /* Fallback */
       in_port_index = 0;
       out_port_index = 1;
-    } else {
-      GST_DEBUG_OBJECT (self, "Detected %u ports, starting at %u",
-          (guint) param.nPorts, (guint) param.nStartPortNumber);
-      in_port_index = param.nStartPortNumber + 0;
-      out_port_index = param.nStartPortNumber + 1;
     }
   }
   self->dec_in_port = gst_omx_component_add_port (self->dec, in_port_index);
@@ -206,7 +189,7 @@ gst_omx_audio_dec_close (GstAudioDecoder * decoder)
   self->dec_in_port = NULL;
   self->dec_out_port = NULL;
   if (self->dec)
-    gst_omx_component_free (self->dec);
+    gst_omx_component_release (self->dec);
   self->dec = NULL;
 
   self->started = FALSE;
@@ -989,14 +972,20 @@ gst_omx_audio_dec_flush (GstAudioDecoder * decoder, gboolean hard)
 {
   GstOMXAudioDec *self = GST_OMX_AUDIO_DEC (decoder);
   OMX_ERRORTYPE err = OMX_ErrorNone;
+  gboolean pause;
 
   GST_DEBUG_OBJECT (self, "Flushing decoder");
 
   if (gst_omx_component_get_state (self->dec, 0) == OMX_StateLoaded)
     return;
 
+  /* Components that can flush while Executing skip the state changes and
+   * only park the srcpad task instead of stopping it */
+  pause = !(self->dec->hacks & GST_OMX_HACK_FLUSH_IN_EXECUTING);
+
   /* 0) Pause the components */
-  if (gst_omx_component_get_state (self->dec, 0) == OMX_StateExecuting) {
+  if (pause
+      && gst_omx_component_get_state (self->dec, 0) == OMX_StateExecuting) {
     gst_omx_component_set_state (self->dec, OMX_StatePause);
     gst_omx_component_get_state (self->dec, GST_CLOCK_TIME_NONE);
   }
@@ -1010,13 +999,20 @@ gst_omx_audio_dec_flush (GstAudioDecoder * decoder, gboolean hard)
    * unlock GST_AUDIO_DECODER_STREAM_LOCK to prevent deadlocks
    * caused by using this lock from inside the loop function */
   GST_AUDIO_DECODER_STREAM_UNLOCK (self);
-  gst_pad_stop_task (GST_AUDIO_DECODER_SRC_PAD (decoder));
-  GST_DEBUG_OBJECT (self, "Flushing -- task stopped");
+  if (pause) {
+    gst_pad_stop_task (GST_AUDIO_DECODER_SRC_PAD (decoder));
+    GST_DEBUG_OBJECT (self, "Flushing -- task stopped");
+  } else {
+    gst_pad_pause_task (GST_AUDIO_DECODER_SRC_PAD (decoder));
+    GST_DEBUG_OBJECT (self, "Flushing -- task paused");
+  }
   GST_AUDIO_DECODER_STREAM_LOCK (self);
 
   /* 3) Resume components */
-  gst_omx_component_set_state (self->dec, OMX_StateExecuting);
-  gst_omx_component_get_state (self->dec, GST_CLOCK_TIME_NONE);
+  if (pause) {
+    gst_omx_component_set_state (self->dec, OMX_StateExecuting);
+    gst_omx_component_get_state (self->dec, GST_CLOCK_TIME_NONE);
+  }
 
   /* 4) Unset flushing to allow ports to accept data again */
   gst_omx_port_set_flushing (self->dec_in_port, 5 * GST_SECOND, FALSE);
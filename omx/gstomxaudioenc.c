@@ -54,6 +54,9 @@ enum
   PROP_0
 };
 
+/* Maximum number of input buffers acquired at once for one frame */
+#define GST_OMX_AUDIO_ENC_MAX_INPUT_BATCH 16
+
 /* class initialization */
 #define do_init \
 { \
@@ -109,10 +112,7 @@ gst_omx_audio_enc_open (GstAudioEncoder * encoder)
   GstOMXAudioEncClass *klass = GST_OMX_AUDIO_ENC_GET_CLASS (self);
   gint in_port_index, out_port_index;
 
-  self->enc =
-      gst_omx_component_new (GST_OBJECT_CAST (self), klass->cdata.core_name,
-      klass->cdata.component_name, klass->cdata.component_role,
-      klass->cdata.hacks);
+  self->enc = gst_omx_component_acquire (GST_OBJECT_CAST (self), &klass->cdata);
   self->started = FALSE;
 
   if (!self->enc)
@@ -126,25 +126,11 @@ gst_omx_audio_enc_open (GstAudioEncoder * encoder)
   out_port_index = klass->cdata.out_port_index;
 
   if (in_port_index == -1 || out_port_index == -1) {
-    OMX_PORT_PARAM_TYPE param;
-    OMX_ERRORTYPE err;
-
-    GST_OMX_INIT_STRUCT (&param);
-
-    err =
-        gst_omx_component_get_parameter (self->enc, OMX_IndexParamAudioInit,
-        &param);
-    if (err != OMX_ErrorNone) {
-      GST_WARNING_OBJECT (self, "Couldn't get port information: %s (0x%08x)",
-          gst_omx_error_to_string (err), err);
+    if (!gst_omx_component_detect_port_indices (self->enc,
+            OMX_IndexParamAudioInit, &in_port_index, &out_port_index)) {
       /* Fallback */
       in_port_index = 0;
       out_port_index = 1;
-    } else {
-      GST_DEBUG_OBJECT (self, "Detected %u ports, starting at %u",
-          (guint) param.nPorts, (guint) param.nStartPortNumber);
-      in_port_index = param.nStartPortNumber + 0;
-      out_port_index = param.nStartPortNumber + 1;
     }
   }
 
@@ -194,7 +180,7 @@ gst_omx_audio_enc_close (GstAudioEncoder * encoder)
   self->enc_in_port = NULL;
   self->enc_out_port = NULL;
   if (self->enc)
-    gst_omx_component_free (self->enc);
+    gst_omx_component_release (self->enc);
   self->enc = NULL;
 
   return TRUE;
@@ -933,6 +919,8 @@ gst_omx_audio_enc_handle_frame (GstAudioEncoder * encoder, GstBuffer * inbuf)
   GstOMXAudioEnc *self;
   GstOMXPort *port;
   GstOMXBuffer *buf;
+  GstOMXBuffer *bufs[GST_OMX_AUDIO_ENC_MAX_INPUT_BATCH];
+  guint i, n_bufs = 0, n_wanted;
   gsize size;
   guint offset = 0;
   GstClockTime timestamp, duration, timestamp_offset = 0;
@@ -956,11 +944,18 @@ gst_omx_audio_enc_handle_frame (GstAudioEncoder * encoder, GstBuffer * inbuf)
 
   size = gst_buffer_get_size (inbuf);
   while (offset < size) {
+    /* Get all the buffers needed for the remaining chunks at once */
+    if (port->port_def.nBufferSize == 0)
+      n_wanted = 1;
+    else
+      n_wanted = CLAMP ((size - offset + port->port_def.nBufferSize - 1) /
+          port->port_def.nBufferSize, 1, GST_OMX_AUDIO_ENC_MAX_INPUT_BATCH);
+
     /* Make sure to release the base class stream lock, otherwise
      * _loop() can't call _finish_frame() and we might block forever
      * because no input buffers are released */
     GST_AUDIO_ENCODER_STREAM_UNLOCK (self);
-    acq_ret = gst_omx_port_acquire_buffer (port, &buf);
+    acq_ret = gst_omx_port_acquire_buffers (port, bufs, n_wanted, &n_bufs);
 
     if (acq_ret == GST_OMX_ACQUIRE_BUFFER_ERROR) {
       GST_AUDIO_ENCODER_STREAM_LOCK (self);
@@ -1024,52 +1019,63 @@ gst_omx_audio_enc_handle_frame (GstAudioEncoder * encoder, GstBuffer * inbuf)
     }
     GST_AUDIO_ENCODER_STREAM_LOCK (self);
 
-    g_assert (acq_ret == GST_OMX_ACQUIRE_BUFFER_OK && buf != NULL);
+    g_assert (acq_ret == GST_OMX_ACQUIRE_BUFFER_OK && n_bufs > 0);
+    buf = bufs[0];
 
     if (self->downstream_flow_ret != GST_FLOW_OK) {
-      gst_omx_port_release_buffer (port, buf);
+      gst_omx_port_release_buffers (port, bufs, n_bufs);
       return self->downstream_flow_ret;
     }
 
     if (buf->omx_buf->nAllocLen - buf->omx_buf->nOffset <= 0) {
-      gst_omx_port_release_buffer (port, buf);
+      gst_omx_port_release_buffers (port, bufs, n_bufs);
       goto full_buffer;
     }
 
-    GST_DEBUG_OBJECT (self, "Handling frame at offset %d", offset);
+    for (i = 0; i < n_bufs; i++) {
+      guint chunk;
 
-    /* Copy the buffer content in chunks of size as requested
-     * by the port */
-    buf->omx_buf->nFilledLen =
-        MIN (size - offset, buf->omx_buf->nAllocLen - buf->omx_buf->nOffset);
-    gst_buffer_extract (inbuf, offset,
-        buf->omx_buf->pBuffer + buf->omx_buf->nOffset,
-        buf->omx_buf->nFilledLen);
+      buf = bufs[i];
 
-    /* Interpolate timestamps if we're passing the buffer
-     * in multiple chunks */
-    if (offset != 0 && duration != GST_CLOCK_TIME_NONE) {
-      timestamp_offset = gst_util_uint64_scale (offset, duration, size);
-    }
+      GST_DEBUG_OBJECT (self, "Handling frame at offset %d", offset);
 
-    if (timestamp != GST_CLOCK_TIME_NONE) {
-      GST_OMX_SET_TICKS (buf->omx_buf->nTimeStamp,
-          gst_util_uint64_scale (timestamp + timestamp_offset,
-              OMX_TICKS_PER_SECOND, GST_SECOND));
-      self->last_upstream_ts = timestamp + timestamp_offset;
-    }
-    if (duration != GST_CLOCK_TIME_NONE) {
-      buf->omx_buf->nTickCount =
-          gst_util_uint64_scale (buf->omx_buf->nFilledLen, duration, size);
-      buf->omx_buf->nTickCount =
-          gst_util_uint64_scale (buf->omx_buf->nTickCount,
-          OMX_TICKS_PER_SECOND, GST_SECOND);
-      self->last_upstream_ts += duration;
+      /* Copy the buffer content in chunks of size as requested
+       * by the port. Exactly as many buffers as needed for chunks
+       * of nBufferSize were acquired */
+      chunk = buf->omx_buf->nAllocLen - buf->omx_buf->nOffset;
+      if (n_bufs > 1)
+        chunk = MIN (chunk, port->port_def.nBufferSize);
+      buf->omx_buf->nFilledLen = MIN (size - offset, chunk);
+      gst_buffer_extract (inbuf, offset,
+          buf->omx_buf->pBuffer + buf->omx_buf->nOffset,
+          buf->omx_buf->nFilledLen);
+
+      /* Interpolate timestamps if we're passing the buffer
+       * in multiple chunks */
+      if (offset != 0 && duration != GST_CLOCK_TIME_NONE) {
+        timestamp_offset = gst_util_uint64_scale (offset, duration, size);
+      }
+
+      if (timestamp != GST_CLOCK_TIME_NONE) {
+        GST_OMX_SET_TICKS (buf->omx_buf->nTimeStamp,
+            gst_util_uint64_scale (timestamp + timestamp_offset,
+                OMX_TICKS_PER_SECOND, GST_SECOND));
+        self->last_upstream_ts = timestamp + timestamp_offset;
+      }
+      if (duration != GST_CLOCK_TIME_NONE) {
+        buf->omx_buf->nTickCount =
+            gst_util_uint64_scale (buf->omx_buf->nFilledLen, duration, size);
+        buf->omx_buf->nTickCount =
+            gst_util_uint64_scale (buf->omx_buf->nTickCount,
+            OMX_TICKS_PER_SECOND, GST_SECOND);
+        self->last_upstream_ts += duration;
+      }
+
+      offset += buf->omx_buf->nFilledLen;
     }
 
-    offset += buf->omx_buf->nFilledLen;
     self->started = TRUE;
-    err = gst_omx_port_release_buffer (port, buf);
+    err = gst_omx_port_release_buffers (port, bufs, n_bufs);
     if (err != OMX_ErrorNone)
       goto release_error;
   }
@@ -191,18 +191,31 @@ gst_omx_memory_allocator_alloc (GstAllocator * allocator, GstMemoryFlags flags,
  * been acquired from the port. gst_buffer_pool_acquire_buffer() is
  * supposed to return the buffer that corresponds to the OMX buffer.
  *
- * For buffers provided to upstream, the buffer will be passed to
- * the component manually when it arrives and then unreffed. If the
+ * For buffers provided to upstream, all but one OMX buffer of the port
+ * are wrapped. The remaining one is acquired from the port as usual for
+ * copying input that upstream did not write into one of our buffers, so
+ * that never waits for upstream to release a buffer of the pool. The
+ * buffer will be passed to the component manually when it arrives and
+ * then unreffed. If the
  * buffer is released before reaching the component it will be just put
  * back into the pool as if EmptyBufferDone has happened. If it was
  * passed to the component, it will be back into the pool when it was
- * released and EmptyBufferDone has happened.
+ * released and EmptyBufferDone has happened. For this the GstOMXBuffer
+ * keeps a reference to the buffer while the component uses it, see
+ * gst_omx_port_take_buffer().
  *
  * For buffers provided to downstream, the buffer will be returned
  * back to the component (OMX_FillThisBuffer()) when it is released.
  */
 
 static GQuark gst_omx_buffer_data_quark = 0;
+static GQuark gst_omx_buffer_cookie_quark = 0;
+
+enum
+{
+  PROP_0,
+  PROP_STATS
+};
 
 #define DEBUG_INIT \
   GST_DEBUG_CATEGORY_INIT (gst_omx_buffer_pool_debug_category, "omxbufferpool", 0, \
@@ -218,32 +231,57 @@ static gboolean
 gst_omx_buffer_pool_start (GstBufferPool * bpool)
 {
   GstOMXBufferPool *pool = GST_OMX_BUFFER_POOL (bpool);
+  gboolean ret;
 
   /* Only allow to start the pool if we still are attached
    * to a component and port */
   GST_OBJECT_LOCK (pool);
-  if (!pool->component || !pool->port) {
+  if (!pool->component || !pool->port || pool->deactivated) {
     GST_OBJECT_UNLOCK (pool);
     return FALSE;
   }
   GST_OBJECT_UNLOCK (pool);
 
-  return
-      GST_BUFFER_POOL_CLASS (gst_omx_buffer_pool_parent_class)->start (bpool);
+  /* Input pools are started by upstream, wrap the buffers of the port */
+  if (pool->port->port_def.eDir == OMX_DirInput) {
+    if (!pool->port->buffers
+        || pool->port->buffers->len != pool->port->port_def.nBufferCountActual)
+      return FALSE;
+
+    pool->allocating = TRUE;
+    pool->current_buffer_index = 0;
+    ret =
+        GST_BUFFER_POOL_CLASS (gst_omx_buffer_pool_parent_class)->start
+        (bpool);
+    pool->allocating = FALSE;
+  } else {
+    ret =
+        GST_BUFFER_POOL_CLASS (gst_omx_buffer_pool_parent_class)->start
+        (bpool);
+  }
+
+  GST_OBJECT_LOCK (pool);
+  pool->started = ret;
+  GST_OBJECT_UNLOCK (pool);
+
+  return ret;
 }
 
 static gboolean
 gst_omx_buffer_pool_stop (GstBufferPool * bpool)
 {
   GstOMXBufferPool *pool = GST_OMX_BUFFER_POOL (bpool);
+  gboolean ret;
   gint i = 0;
 
   /* When not using the default GstBufferPool::GstAtomicQueue then
    * GstBufferPool::free_buffer is not called while stopping the pool
-   * (because the queue is empty) */
-  for (i = 0; i < pool->buffers->len; i++)
-    GST_BUFFER_POOL_CLASS (gst_omx_buffer_pool_parent_class)->release_buffer
-        (bpool, g_ptr_array_index (pool->buffers, i));
+   * (because the queue is empty). Input pools use the queue */
+  if (pool->port->port_def.eDir == OMX_DirOutput) {
+    for (i = 0; i < pool->buffers->len; i++)
+      GST_BUFFER_POOL_CLASS (gst_omx_buffer_pool_parent_class)->release_buffer
+          (bpool, g_ptr_array_index (pool->buffers, i));
+  }
 
   /* Remove any buffers that are there */
   g_ptr_array_set_size (pool->buffers, 0);
@@ -254,7 +292,14 @@ gst_omx_buffer_pool_stop (GstBufferPool * bpool)
 
   pool->add_videometa = FALSE;
 
-  return GST_BUFFER_POOL_CLASS (gst_omx_buffer_pool_parent_class)->stop (bpool);
+  ret = GST_BUFFER_POOL_CLASS (gst_omx_buffer_pool_parent_class)->stop (bpool);
+
+  GST_OBJECT_LOCK (pool);
+  pool->started = FALSE;
+  g_cond_broadcast (&pool->stopped);
+  GST_OBJECT_UNLOCK (pool);
+
+  return ret;
 }
 
 static const gchar **
@@ -308,6 +353,20 @@ gst_omx_buffer_pool_set_config (GstBufferPool * bpool, GstStructure * config)
     pool->video_info = info;
   }
 
+  /* Input pools have one buffer per OMX buffer of the port except the
+   * last one, which is kept for copying input that is not from the pool.
+   * The buffer size must match their memory or they are discarded when
+   * released */
+  if (pool->port && pool->port->port_def.eDir == OMX_DirInput) {
+    if (pool->port->port_def.nBufferCountActual < 2)
+      goto too_few_buffers;
+
+    gst_buffer_pool_config_set_params (config, caps,
+        pool->port->port_def.nBufferSize,
+        pool->port->port_def.nBufferCountActual - 1,
+        pool->port->port_def.nBufferCountActual - 1);
+  }
+
   if (pool->caps)
     gst_caps_unref (pool->caps);
   pool->caps = gst_caps_ref (caps);
@@ -337,6 +396,136 @@ wrong_video_caps:
         "failed getting geometry from caps %" GST_PTR_FORMAT, caps);
     return FALSE;
   }
+too_few_buffers:
+  {
+    GST_OBJECT_UNLOCK (pool);
+    GST_WARNING_OBJECT (pool, "port has not enough buffers to share");
+    return FALSE;
+  }
+}
+
+/* Fills offset and stride with the layout of the port's buffers for the
+ * current video info */
+static void
+gst_omx_buffer_pool_get_layout (GstOMXBufferPool * pool,
+    gsize offset[GST_VIDEO_MAX_PLANES], gint stride[GST_VIDEO_MAX_PLANES])
+{
+  const guint nstride = pool->port->port_def.format.video.nStride;
+  guint nslice = pool->port->port_def.format.video.nSliceHeight;
+  gint i;
+
+  /* Components may leave the slice height at 0 if the planes follow each
+   * other without padding lines */
+  if (nslice == 0)
+    nslice = GST_VIDEO_INFO_HEIGHT (&pool->video_info);
+
+  for (i = 0; i < GST_VIDEO_MAX_PLANES; i++) {
+    offset[i] = 0;
+    stride[i] = 0;
+  }
+  stride[0] = nstride;
+
+  switch (GST_VIDEO_INFO_FORMAT (&pool->video_info)) {
+    case GST_VIDEO_FORMAT_ABGR:
+    case GST_VIDEO_FORMAT_ARGB:
+    case GST_VIDEO_FORMAT_BGR:
+    case GST_VIDEO_FORMAT_RGB16:
+    case GST_VIDEO_FORMAT_BGR16:
+    case GST_VIDEO_FORMAT_YUY2:
+    case GST_VIDEO_FORMAT_UYVY:
+    case GST_VIDEO_FORMAT_YVYU:
+    case GST_VIDEO_FORMAT_GRAY8:
+      break;
+    case GST_VIDEO_FORMAT_I420:
+      stride[1] = nstride / 2;
+      offset[1] = offset[0] + stride[0] * nslice;
+      stride[2] = nstride / 2;
+      offset[2] = offset[1] + (stride[1] * nslice / 2);
+      break;
+    case GST_VIDEO_FORMAT_NV12:
+    case GST_VIDEO_FORMAT_NV16:
+      stride[1] = nstride;
+      offset[1] = offset[0] + stride[0] * nslice;
+      break;
+    default:
+      g_assert_not_reached ();
+      break;
+  }
+}
+
+/* Returns TRUE if offset and stride are the default layout of the
+ * current video info, i.e. what elements without GstVideoMeta
+ * support expect */
+static gboolean
+gst_omx_buffer_pool_is_default_layout (GstOMXBufferPool * pool,
+    const gsize offset[GST_VIDEO_MAX_PLANES],
+    const gint stride[GST_VIDEO_MAX_PLANES])
+{
+  GstVideoInfo info;
+  gint i;
+
+  gst_video_info_init (&info);
+  gst_video_info_set_format (&info,
+      GST_VIDEO_INFO_FORMAT (&pool->video_info),
+      GST_VIDEO_INFO_WIDTH (&pool->video_info),
+      GST_VIDEO_INFO_HEIGHT (&pool->video_info));
+
+  for (i = 0; i < GST_VIDEO_INFO_N_PLANES (&pool->video_info); i++) {
+    if (info.stride[i] != stride[i] || info.offset[i] != offset[i])
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Sets the stride and offsets of the video meta of buf from the current
+ * port definition and video info, adding the meta if necessary, and
+ * updates pool->need_copy accordingly.
+ *
+ * NOTE: Only for buffers wrapping our own memory */
+static void
+gst_omx_buffer_pool_update_video_meta (GstOMXBufferPool * pool,
+    GstBuffer * buf)
+{
+  gsize offset[GST_VIDEO_MAX_PLANES];
+  gint stride[GST_VIDEO_MAX_PLANES];
+  GstVideoMeta *meta;
+
+  gst_omx_buffer_pool_get_layout (pool, offset, stride);
+
+  if (pool->add_videometa)
+    pool->need_copy = FALSE;
+  else
+    pool->need_copy =
+        !gst_omx_buffer_pool_is_default_layout (pool, offset, stride);
+
+  /* Metas of pooled buffers can't be removed, after new output settings
+   * the existing one is updated in place */
+  meta = gst_buffer_get_video_meta (buf);
+  if (meta) {
+    gint i;
+
+    meta->format = GST_VIDEO_INFO_FORMAT (&pool->video_info);
+    meta->width = GST_VIDEO_INFO_WIDTH (&pool->video_info);
+    meta->height = GST_VIDEO_INFO_HEIGHT (&pool->video_info);
+    meta->n_planes = GST_VIDEO_INFO_N_PLANES (&pool->video_info);
+    for (i = 0; i < GST_VIDEO_MAX_PLANES; i++) {
+      meta->offset[i] = offset[i];
+      meta->stride[i] = stride[i];
+    }
+  } else if (pool->need_copy || pool->add_videometa) {
+    /* We always add the videometa. It's the job of the user
+     * to copy the buffer if pool->need_copy is TRUE
+     */
+    meta = gst_buffer_add_video_meta_full (buf, GST_VIDEO_FRAME_FLAG_NONE,
+        GST_VIDEO_INFO_FORMAT (&pool->video_info),
+        GST_VIDEO_INFO_WIDTH (&pool->video_info),
+        GST_VIDEO_INFO_HEIGHT (&pool->video_info),
+        GST_VIDEO_INFO_N_PLANES (&pool->video_info), offset, stride);
+    /* Otherwise reset_buffer() removes it on release, and the cookie would
+     * still claim the buffer is up to date */
+    GST_META_FLAG_SET (meta, GST_META_FLAG_POOLED);
+  }
 }
 
 static GstFlowReturn
@@ -348,6 +537,8 @@ gst_omx_buffer_pool_alloc_buffer (GstBufferPool * bpool,
   GstOMXBuffer *omx_buf;
 
   g_return_val_if_fail (pool->allocating, GST_FLOW_ERROR);
+  g_return_val_if_fail ((guint) pool->current_buffer_index <
+      pool->port->buffers->len, GST_FLOW_ERROR);
 
   omx_buf = g_ptr_array_index (pool->port->buffers, pool->current_buffer_index);
   g_return_val_if_fail (omx_buf != NULL, GST_FLOW_ERROR);
@@ -386,10 +577,6 @@ gst_omx_buffer_pool_alloc_buffer (GstBufferPool * bpool,
     pool->need_copy = FALSE;
   } else {
     GstMemory *mem;
-    const guint nstride = pool->port->port_def.format.video.nStride;
-    const guint nslice = pool->port->port_def.format.video.nSliceHeight;
-    gsize offset[GST_VIDEO_MAX_PLANES] = { 0, };
-    gint stride[GST_VIDEO_MAX_PLANES] = { nstride, 0, };
 
     if (pool->output_mode == GST_OMX_BUFFER_MODE_DMABUF) {
       gint fd;
@@ -421,69 +608,20 @@ gst_omx_buffer_pool_alloc_buffer (GstBufferPool * bpool,
     gst_buffer_append_memory (buf, mem);
     g_ptr_array_add (pool->buffers, buf);
 
-    switch (GST_VIDEO_INFO_FORMAT (&pool->video_info)) {
-      case GST_VIDEO_FORMAT_ABGR:
-      case GST_VIDEO_FORMAT_ARGB:
-      case GST_VIDEO_FORMAT_RGB16:
-      case GST_VIDEO_FORMAT_BGR16:
-      case GST_VIDEO_FORMAT_YUY2:
-      case GST_VIDEO_FORMAT_UYVY:
-      case GST_VIDEO_FORMAT_YVYU:
-      case GST_VIDEO_FORMAT_GRAY8:
-        break;
-      case GST_VIDEO_FORMAT_I420:
-        stride[1] = nstride / 2;
-        offset[1] = offset[0] + stride[0] * nslice;
-        stride[2] = nstride / 2;
-        offset[2] = offset[1] + (stride[1] * nslice / 2);
-        break;
-      case GST_VIDEO_FORMAT_NV12:
-      case GST_VIDEO_FORMAT_NV16:
-        stride[1] = nstride;
-        offset[1] = offset[0] + stride[0] * nslice;
-        break;
-      default:
-        g_assert_not_reached ();
-        break;
-    }
-
-    if (pool->add_videometa) {
-      pool->need_copy = FALSE;
-    } else {
-      GstVideoInfo info;
-      gboolean need_copy = FALSE;
-      gint i;
-
-      gst_video_info_init (&info);
-      gst_video_info_set_format (&info,
-          GST_VIDEO_INFO_FORMAT (&pool->video_info),
-          GST_VIDEO_INFO_WIDTH (&pool->video_info),
-          GST_VIDEO_INFO_HEIGHT (&pool->video_info));
-
-      for (i = 0; i < GST_VIDEO_INFO_N_PLANES (&pool->video_info); i++) {
-        if (info.stride[i] != stride[i] || info.offset[i] != offset[i]) {
-          need_copy = TRUE;
-          break;
-        }
-      }
-
-      pool->need_copy = need_copy;
-    }
+    if (pool->port->port_def.eDir == OMX_DirInput)
+      gst_omx_port_set_buffer_shared (pool->port, omx_buf, TRUE);
 
-    if (pool->need_copy || pool->add_videometa) {
-      /* We always add the videometa. It's the job of the user
-       * to copy the buffer if pool->need_copy is TRUE
-       */
-      gst_buffer_add_video_meta_full (buf, GST_VIDEO_FRAME_FLAG_NONE,
-          GST_VIDEO_INFO_FORMAT (&pool->video_info),
-          GST_VIDEO_INFO_WIDTH (&pool->video_info),
-          GST_VIDEO_INFO_HEIGHT (&pool->video_info),
-          GST_VIDEO_INFO_N_PLANES (&pool->video_info), offset, stride);
-    }
+    if (pool->port->port_def.eDomain == OMX_PortDomainVideo
+        && pool->port->port_def.format.video.eCompressionFormat ==
+        OMX_VIDEO_CodingUnused)
+      gst_omx_buffer_pool_update_video_meta (pool, buf);
   }
 
   gst_mini_object_set_qdata (GST_MINI_OBJECT_CAST (buf),
       gst_omx_buffer_data_quark, omx_buf, NULL);
+  gst_mini_object_set_qdata (GST_MINI_OBJECT_CAST (buf),
+      gst_omx_buffer_cookie_quark,
+      GUINT_TO_POINTER (pool->video_info_cookie), NULL);
 
   *buffer = buf;
 
@@ -505,6 +643,15 @@ gst_omx_buffer_pool_free_buffer (GstBufferPool * bpool, GstBuffer * buffer)
   }
   GST_OBJECT_UNLOCK (pool);
 
+  if (pool->port->port_def.eDir == OMX_DirInput) {
+    GstOMXBuffer *omx_buf;
+
+    omx_buf = gst_mini_object_get_qdata (GST_MINI_OBJECT_CAST (buffer),
+        gst_omx_buffer_data_quark);
+    if (omx_buf)
+      gst_omx_port_set_buffer_shared (pool->port, omx_buf, FALSE);
+  }
+
   gst_mini_object_set_qdata (GST_MINI_OBJECT_CAST (buffer),
       gst_omx_buffer_data_quark, NULL, NULL);
 
@@ -548,6 +695,17 @@ gst_omx_buffer_pool_acquire_buffer (GstBufferPool * bpool,
 
       mem->size = omx_buf->omx_buf->nFilledLen;
       mem->offset = omx_buf->omx_buf->nOffset;
+
+      /* Output settings changed without reallocating our buffers */
+      if (G_UNLIKELY (GPOINTER_TO_UINT (gst_mini_object_get_qdata
+                  (GST_MINI_OBJECT_CAST (buf),
+                      gst_omx_buffer_cookie_quark)) !=
+              pool->video_info_cookie)) {
+        gst_omx_buffer_pool_update_video_meta (pool, buf);
+        gst_mini_object_set_qdata (GST_MINI_OBJECT_CAST (buf),
+            gst_omx_buffer_cookie_quark,
+            GUINT_TO_POINTER (pool->video_info_cookie), NULL);
+      }
     }
   } else {
     /* Acquire any buffer that is available to be filled by upstream */
@@ -556,6 +714,16 @@ gst_omx_buffer_pool_acquire_buffer (GstBufferPool * bpool,
         (bpool, buffer, params);
   }
 
+  if (ret == GST_FLOW_OK) {
+    GST_OBJECT_LOCK (pool);
+    pool->n_outstanding++;
+    if (pool->n_outstanding >= pool->buffers->len && !pool->stall_start) {
+      pool->stall_start = g_get_monotonic_time ();
+      pool->n_stalls++;
+    }
+    GST_OBJECT_UNLOCK (pool);
+  }
+
   return ret;
 }
 
@@ -568,11 +736,43 @@ gst_omx_buffer_pool_release_buffer (GstBufferPool * bpool, GstBuffer * buffer)
 
   g_assert (pool->component && pool->port);
 
+  /* The base class also releases the buffers it allocated when starting */
+  GST_OBJECT_LOCK (pool);
+  if (pool->n_outstanding > 0)
+    pool->n_outstanding--;
+  if (pool->stall_start) {
+    pool->stall_time += (g_get_monotonic_time () - pool->stall_start) *
+        GST_USECOND;
+    pool->stall_start = 0;
+  }
+  GST_OBJECT_UNLOCK (pool);
+
+  /* Input buffers are only released after EmptyBufferDone, or if they
+   * never reached the component, and can be filled by upstream again */
+  if (pool->port->port_def.eDir == OMX_DirInput) {
+    GstMemory *mem;
+
+    /* Upstream usually only fills part of the buffer and might append
+     * memory for larger frames. Restore the full OMX memory, the buffer
+     * would be discarded otherwise */
+    if (gst_buffer_n_memory (buffer) > 1)
+      gst_buffer_remove_memory_range (buffer, 1, -1);
+    GST_BUFFER_FLAG_UNSET (buffer, GST_BUFFER_FLAG_TAG_MEMORY);
+
+    mem = gst_buffer_peek_memory (buffer, 0);
+    mem->offset = 0;
+    mem->size = mem->maxsize;
+
+    GST_BUFFER_POOL_CLASS (gst_omx_buffer_pool_parent_class)->release_buffer
+        (bpool, buffer);
+    return;
+  }
+
   if (!pool->allocating && !pool->deactivated) {
     omx_buf =
         gst_mini_object_get_qdata (GST_MINI_OBJECT_CAST (buffer),
         gst_omx_buffer_data_quark);
-    if (pool->port->port_def.eDir == OMX_DirOutput && !omx_buf->used) {
+    if (!omx_buf->used) {
       /* Release back to the port, can be filled again */
       err = gst_omx_port_release_buffer (pool->port, omx_buf);
       if (err != OMX_ErrorNone) {
@@ -580,28 +780,26 @@ gst_omx_buffer_pool_release_buffer (GstBufferPool * bpool, GstBuffer * buffer)
             ("Failed to relase output buffer to component: %s (0x%08x)",
                 gst_omx_error_to_string (err), err));
       }
-    } else if (!omx_buf->used) {
-      /* TODO: Implement.
-       *
-       * If not used (i.e. was not passed to the component) this should do
-       * the same as EmptyBufferDone.
-       * If it is used (i.e. was passed to the component) this should do
-       * nothing until EmptyBufferDone.
-       *
-       * EmptyBufferDone should release the buffer to the pool so it can
-       * be allocated again
-       *
-       * Needs something to call back here in EmptyBufferDone, like keeping
-       * a ref on the buffer in GstOMXBuffer until EmptyBufferDone... which
-       * would ensure that the buffer is always unused when this is called.
-       */
-      g_assert_not_reached ();
-      GST_BUFFER_POOL_CLASS (gst_omx_buffer_pool_parent_class)->release_buffer
-          (bpool, buffer);
     }
   }
 }
 
+static void
+gst_omx_buffer_pool_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstOMXBufferPool *pool = GST_OMX_BUFFER_POOL (object);
+
+  switch (prop_id) {
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_omx_buffer_pool_get_stats (pool));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
 static void
 gst_omx_buffer_pool_finalize (GObject * object)
 {
@@ -627,6 +825,8 @@ gst_omx_buffer_pool_finalize (GObject * object)
     gst_caps_unref (pool->caps);
   pool->caps = NULL;
 
+  g_cond_clear (&pool->stopped);
+
   G_OBJECT_CLASS (gst_omx_buffer_pool_parent_class)->finalize (object);
 }
 
@@ -637,8 +837,11 @@ gst_omx_buffer_pool_class_init (GstOMXBufferPoolClass * klass)
   GstBufferPoolClass *gstbufferpool_class = (GstBufferPoolClass *) klass;
 
   gst_omx_buffer_data_quark = g_quark_from_static_string ("GstOMXBufferData");
+  gst_omx_buffer_cookie_quark =
+      g_quark_from_static_string ("GstOMXBufferCookie");
 
   gobject_class->finalize = gst_omx_buffer_pool_finalize;
+  gobject_class->get_property = gst_omx_buffer_pool_get_property;
   gstbufferpool_class->start = gst_omx_buffer_pool_start;
   gstbufferpool_class->stop = gst_omx_buffer_pool_stop;
   gstbufferpool_class->get_options = gst_omx_buffer_pool_get_options;
@@ -647,12 +850,19 @@ gst_omx_buffer_pool_class_init (GstOMXBufferPoolClass * klass)
   gstbufferpool_class->free_buffer = gst_omx_buffer_pool_free_buffer;
   gstbufferpool_class->acquire_buffer = gst_omx_buffer_pool_acquire_buffer;
   gstbufferpool_class->release_buffer = gst_omx_buffer_pool_release_buffer;
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Where the buffers are, how often and for how long all of them "
+          "were acquired and how often they were copied", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
 gst_omx_buffer_pool_init (GstOMXBufferPool * pool)
 {
   pool->buffers = g_ptr_array_new ();
+  g_cond_init (&pool->stopped);
 }
 
 GstBufferPool *
@@ -681,3 +891,142 @@ gst_omx_buffer_pool_new (GstElement * element, GstOMXComponent * component,
 
   return GST_BUFFER_POOL (pool);
 }
+
+/* Updates the caps and video info of the buffers of an output pool after
+ * the port settings changed but the already allocated buffers are kept.
+ * The video metas of the buffers are updated when they are acquired the
+ * next time, i.e. after the component filled them with the new settings */
+void
+gst_omx_buffer_pool_update_video_info (GstOMXBufferPool * pool,
+    GstCaps * caps, const GstVideoInfo * info)
+{
+  g_return_if_fail (GST_IS_OMX_BUFFER_POOL (pool));
+  g_return_if_fail (caps != NULL && info != NULL);
+
+  GST_OBJECT_LOCK (pool);
+  gst_caps_replace (&pool->caps, caps);
+  pool->video_info = *info;
+  pool->video_info_cookie++;
+  GST_OBJECT_UNLOCK (pool);
+
+  GST_DEBUG_OBJECT (pool, "updated to caps %" GST_PTR_FORMAT, caps);
+}
+
+/* Returns TRUE if the buffers of the pool use the default layout for the
+ * configured caps, i.e. can also be filled by upstream elements without
+ * GstVideoMeta support */
+gboolean
+gst_omx_buffer_pool_has_default_layout (GstOMXBufferPool * pool)
+{
+  gsize offset[GST_VIDEO_MAX_PLANES];
+  gint stride[GST_VIDEO_MAX_PLANES];
+  gboolean ret;
+
+  g_return_val_if_fail (GST_IS_OMX_BUFFER_POOL (pool), FALSE);
+
+  GST_OBJECT_LOCK (pool);
+  gst_omx_buffer_pool_get_layout (pool, offset, stride);
+  ret = gst_omx_buffer_pool_is_default_layout (pool, offset, stride);
+  GST_OBJECT_UNLOCK (pool);
+
+  return ret;
+}
+
+/* Returns the OpenMAX buffer wrapped by buffer if it was acquired from
+ * pool, NULL otherwise */
+GstOMXBuffer *
+gst_omx_buffer_pool_get_omx_buffer (GstOMXBufferPool * pool,
+    GstBuffer * buffer)
+{
+  g_return_val_if_fail (GST_IS_OMX_BUFFER_POOL (pool), NULL);
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+
+  if (buffer->pool != GST_BUFFER_POOL_CAST (pool))
+    return NULL;
+
+  return gst_mini_object_get_qdata (GST_MINI_OBJECT_CAST (buffer),
+      gst_omx_buffer_data_quark);
+}
+
+/* Waits until the deactivated pool stopped, i.e. until all buffers that
+ * were acquired from it were released and freed. Afterwards none of the
+ * port's buffers is referenced by the pool anymore and they can be
+ * deallocated. Returns FALSE if that didn't happen within timeout */
+gboolean
+gst_omx_buffer_pool_wait_stopped (GstOMXBufferPool * pool,
+    GstClockTime timeout)
+{
+  gint64 deadline;
+  gboolean ret;
+
+  g_return_val_if_fail (GST_IS_OMX_BUFFER_POOL (pool), FALSE);
+  g_return_val_if_fail (!gst_buffer_pool_is_active (GST_BUFFER_POOL (pool)),
+      FALSE);
+
+  deadline = g_get_monotonic_time () + timeout / GST_USECOND;
+
+  GST_OBJECT_LOCK (pool);
+  while (pool->started) {
+    if (!g_cond_wait_until (&pool->stopped, GST_OBJECT_GET_LOCK (pool),
+            deadline))
+      break;
+  }
+  ret = !pool->started;
+  GST_OBJECT_UNLOCK (pool);
+
+  return ret;
+}
+
+/* Returns the statistics of pool:
+ *
+ * - buffers: number of buffers of the pool
+ * - component-buffers: buffers the component currently has
+ * - pending-buffers: buffers the component returned that were not
+ *   acquired from the port yet
+ * - outstanding-buffers: buffers acquired from the pool, i.e. held by the
+ *   element and downstream, or upstream for input pools
+ * - stalls, stall-time: how often and for how long in total all buffers
+ *   were acquired from the pool at once
+ * - copies: how many buffers the element copied because downstream
+ *   couldn't handle them
+ */
+GstStructure *
+gst_omx_buffer_pool_get_stats (GstOMXBufferPool * pool)
+{
+  GstStructure *s;
+  GstClockTime stall_time;
+  guint n_used = 0, n_pending = 0;
+
+  g_return_val_if_fail (GST_IS_OMX_BUFFER_POOL (pool), NULL);
+
+  if (pool->port)
+    gst_omx_port_get_buffer_counts (pool->port, &n_used, &n_pending);
+
+  GST_OBJECT_LOCK (pool);
+  stall_time = pool->stall_time;
+  if (pool->stall_start)
+    stall_time += (g_get_monotonic_time () - pool->stall_start) * GST_USECOND;
+
+  s = gst_structure_new ("omx-buffer-pool-stats",
+      "buffers", G_TYPE_UINT, pool->buffers->len,
+      "component-buffers", G_TYPE_UINT, n_used,
+      "pending-buffers", G_TYPE_UINT, n_pending,
+      "outstanding-buffers", G_TYPE_UINT, pool->n_outstanding,
+      "stalls", G_TYPE_UINT64, pool->n_stalls,
+      "stall-time", G_TYPE_UINT64, stall_time,
+      "copies", G_TYPE_UINT64, pool->n_copies, NULL);
+  GST_OBJECT_UNLOCK (pool);
+
+  return s;
+}
+
+/* Counts a copy of one of the pool's buffers for the statistics */
+void
+gst_omx_buffer_pool_add_copy (GstOMXBufferPool * pool)
+{
+  g_return_if_fail (GST_IS_OMX_BUFFER_POOL (pool));
+
+  GST_OBJECT_LOCK (pool);
+  pool->n_copies++;
+  GST_OBJECT_UNLOCK (pool);
+}
@@ -58,6 +58,9 @@ struct _GstOMXBufferPool
   gboolean add_videometa;
   gboolean need_copy;
   GstVideoInfo video_info;
+  /* Incremented whenever video_info changes while our buffers are
+   * allocated, their video metas are updated when acquired again */
+  guint video_info_cookie;
 
   /* Owned by element, element has to stop this pool before
    * it destroys component or port */
@@ -73,6 +76,12 @@ struct _GstOMXBufferPool
   /* TRUE if the pool is not used anymore */
   gboolean deactivated;
 
+  /* TRUE while the pool has its buffers, i.e. from start until the last
+   * buffer was released after deactivating it. Protected by the object
+   * lock, stopped is signalled once it becomes FALSE */
+  gboolean started;
+  GCond stopped;
+
   /* For populating the pool from another one */
   GstBufferPool *other_pool;
   GPtrArray *buffers;
@@ -86,6 +95,16 @@ struct _GstOMXBufferPool
 
   /* The type of buffers produced by the decoder */
   GstOMXBufferMode output_mode;
+
+  /* Statistics, protected by the object lock. A stall is a period in
+   * which all buffers were acquired from the pool, e.g. held downstream,
+   * and none was left for the component. Copies of the buffers are
+   * counted by the element */
+  guint n_outstanding;
+  guint64 n_stalls;
+  GstClockTime stall_time;
+  gint64 stall_start;
+  guint64 n_copies;
 };
 
 struct _GstOMXBufferPoolClass
@@ -96,6 +115,12 @@ struct _GstOMXBufferPoolClass
 GType gst_omx_buffer_pool_get_type (void);
 
 GstBufferPool *gst_omx_buffer_pool_new (GstElement * element, GstOMXComponent * component, GstOMXPort * port, GstOMXBufferMode output_mode);
+void gst_omx_buffer_pool_update_video_info (GstOMXBufferPool * pool, GstCaps * caps, const GstVideoInfo * info);
+gboolean gst_omx_buffer_pool_has_default_layout (GstOMXBufferPool * pool);
+GstOMXBuffer *gst_omx_buffer_pool_get_omx_buffer (GstOMXBufferPool * pool, GstBuffer * buffer);
+gboolean gst_omx_buffer_pool_wait_stopped (GstOMXBufferPool * pool, GstClockTime timeout);
+GstStructure *gst_omx_buffer_pool_get_stats (GstOMXBufferPool * pool);
+void gst_omx_buffer_pool_add_copy (GstOMXBufferPool * pool);
 
 G_END_DECLS
 
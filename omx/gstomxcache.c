@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2026, RidgeRun
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/* Capabilities of components that were queried once are stored in a
+ * key file in the user's cache directory, so that later processes can
+ * skip the queries. Every component has its own group, named after the
+ * core, component name and role.
+ *
+ * The whole cache is dropped when the configuration file changes, the
+ * group of a component when its core library changes. Changes are
+ * detected by the modification time and size of the files.
+ *
+ * The GST_OMX_CACHE_FILE environment variable overrides the location of
+ * the cache, setting it to an empty string disables the cache.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib/gstdio.h>
+
+#include "gstomxcache.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_omx_cache_debug_category);
+#define GST_CAT_DEFAULT gst_omx_cache_debug_category
+
+#define GST_OMX_CACHE_GROUP "gstomx"
+
+G_LOCK_DEFINE_STATIC (cache);
+static GKeyFile *cache = NULL;
+static gchar *cache_file = NULL;
+static gchar *config_file = NULL;
+
+/* Returns NULL if the file does not exist */
+static gchar *
+gst_omx_cache_get_stamp (const gchar * filename)
+{
+  GStatBuf st;
+
+  if (!filename || g_stat (filename, &st) != 0)
+    return NULL;
+
+  return g_strdup_printf ("%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT,
+      (gint64) st.st_mtime, (gint64) st.st_size);
+}
+
+static gchar *
+gst_omx_cache_get_group (const GstOMXClassData * cdata)
+{
+  return g_strdup_printf ("%s:%s:%s", cdata->core_name,
+      cdata->component_name, GST_STR_NULL (cdata->component_role));
+}
+
+/* NOTE: Must be called while holding the cache lock */
+static gboolean
+gst_omx_cache_load_unlocked (void)
+{
+  gchar *stamp, *cached_stamp, *cached_config_file;
+
+  if (cache)
+    return TRUE;
+
+  if (!cache_file)
+    return FALSE;
+
+  cache = g_key_file_new ();
+  if (!g_key_file_load_from_file (cache, cache_file, G_KEY_FILE_NONE, NULL))
+    GST_DEBUG ("No cache in '%s' yet", cache_file);
+
+  stamp = gst_omx_cache_get_stamp (config_file);
+  cached_stamp =
+      g_key_file_get_string (cache, GST_OMX_CACHE_GROUP, "config-stamp", NULL);
+  cached_config_file =
+      g_key_file_get_string (cache, GST_OMX_CACHE_GROUP, "config-file", NULL);
+
+  if (!stamp || g_strcmp0 (stamp, cached_stamp) != 0
+      || g_strcmp0 (config_file, cached_config_file) != 0) {
+    GST_DEBUG ("Configuration '%s' changed, dropping cache", config_file);
+
+    g_key_file_free (cache);
+    cache = g_key_file_new ();
+    g_key_file_set_string (cache, GST_OMX_CACHE_GROUP, "config-file",
+        config_file);
+    g_key_file_set_string (cache, GST_OMX_CACHE_GROUP, "config-stamp",
+        GST_STR_NULL (stamp));
+  }
+
+  g_free (stamp);
+  g_free (cached_stamp);
+  g_free (cached_config_file);
+
+  return TRUE;
+}
+
+/* NOTE: Must be called while holding the cache lock */
+static void
+gst_omx_cache_save_unlocked (void)
+{
+  GError *err = NULL;
+  gchar *data, *dir;
+  gsize length;
+
+  dir = g_path_get_dirname (cache_file);
+  g_mkdir_with_parents (dir, 0755);
+  g_free (dir);
+
+  data = g_key_file_to_data (cache, &length, NULL);
+  if (!g_file_set_contents (cache_file, data, length, &err)) {
+    GST_WARNING ("Failed to write cache '%s': %s", cache_file, err->message);
+    g_error_free (err);
+  }
+  g_free (data);
+}
+
+/* Sets the configuration file the cache depends on, called once
+ * after the configuration was loaded */
+void
+gst_omx_cache_init (const gchar * config)
+{
+  const gchar *env;
+
+  GST_DEBUG_CATEGORY_INIT (gst_omx_cache_debug_category, "omxcache", 0,
+      "gst-omx capability cache");
+
+  G_LOCK (cache);
+  g_free (config_file);
+  config_file = g_strdup (config);
+
+  g_free (cache_file);
+  if ((env = g_getenv ("GST_OMX_CACHE_FILE")))
+    cache_file = *env ? g_strdup (env) : NULL;
+  else
+    cache_file = g_build_filename (g_get_user_cache_dir (), "gstreamer-1.0",
+        "gstomx.cache", NULL);
+
+  if (cache) {
+    g_key_file_free (cache);
+    cache = NULL;
+  }
+  G_UNLOCK (cache);
+
+  GST_DEBUG ("Using cache '%s'", GST_STR_NULL (cache_file));
+}
+
+/* Returns FALSE if nothing is cached for key, values must be freed
+ * with g_free() otherwise */
+gboolean
+gst_omx_cache_get_integers (const GstOMXClassData * cdata, const gchar * key,
+    gint ** values, gsize * n_values)
+{
+  gchar *group, *stamp = NULL, *cached_stamp = NULL;
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (cdata != NULL, FALSE);
+  g_return_val_if_fail (key != NULL, FALSE);
+  g_return_val_if_fail (values != NULL, FALSE);
+  g_return_val_if_fail (n_values != NULL, FALSE);
+
+  group = gst_omx_cache_get_group (cdata);
+
+  G_LOCK (cache);
+  if (!gst_omx_cache_load_unlocked ())
+    goto done;
+
+  stamp = gst_omx_cache_get_stamp (cdata->core_name);
+  cached_stamp = g_key_file_get_string (cache, group, "core-stamp", NULL);
+  if (!stamp || g_strcmp0 (stamp, cached_stamp) != 0)
+    goto done;
+
+  *values = g_key_file_get_integer_list (cache, group, key, n_values, NULL);
+  ret = (*values != NULL);
+
+done:
+  G_UNLOCK (cache);
+
+  GST_DEBUG ("%s '%s' for %s", (ret ? "Found" : "No cached"), key, group);
+
+  g_free (stamp);
+  g_free (cached_stamp);
+  g_free (group);
+
+  return ret;
+}
+
+/* Stores values for key and writes the cache to disk */
+void
+gst_omx_cache_set_integers (const GstOMXClassData * cdata, const gchar * key,
+    const gint * values, gsize n_values)
+{
+  gchar *group, *stamp, *cached_stamp;
+
+  g_return_if_fail (cdata != NULL);
+  g_return_if_fail (key != NULL);
+  g_return_if_fail (values != NULL || n_values == 0);
+
+  group = gst_omx_cache_get_group (cdata);
+  stamp = gst_omx_cache_get_stamp (cdata->core_name);
+
+  G_LOCK (cache);
+  if (!stamp || !gst_omx_cache_load_unlocked ())
+    goto done;
+
+  cached_stamp = g_key_file_get_string (cache, group, "core-stamp", NULL);
+  if (g_strcmp0 (stamp, cached_stamp) != 0) {
+    g_key_file_remove_group (cache, group, NULL);
+    g_key_file_set_string (cache, group, "core-stamp", stamp);
+  }
+  g_free (cached_stamp);
+
+  g_key_file_set_integer_list (cache, group, key, (gint *) values, n_values);
+  gst_omx_cache_save_unlocked ();
+
+  GST_DEBUG ("Stored '%s' for %s", key, group);
+
+done:
+  G_UNLOCK (cache);
+
+  g_free (stamp);
+  g_free (group);
+}
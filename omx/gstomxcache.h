@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2026, RidgeRun
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __GST_OMX_CACHE_H__
+#define __GST_OMX_CACHE_H__
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+
+#include "gstomx.h"
+
+G_BEGIN_DECLS
+
+void      gst_omx_cache_init (const gchar * config_file);
+
+gboolean  gst_omx_cache_get_integers (const GstOMXClassData * cdata, const gchar * key, gint ** values, gsize * n_values);
+void      gst_omx_cache_set_integers (const GstOMXClassData * cdata, const gchar * key, const gint * values, gsize n_values);
+
+G_END_DECLS
+
+#endif /* __GST_OMX_CACHE_H__ */
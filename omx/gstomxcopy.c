@@ -0,0 +1,666 @@
+/*
+ * Copyright (C) 2026, RidgeRun
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/* Copies of video planes between buffers with different strides, e.g.
+ * from the output buffers of a component into the ones downstream
+ * wants.
+ *
+ * The kernel is selected at runtime from the ones the CPU supports, the
+ * GST_OMX_COPY environment variable forces one by name. Streaming copies
+ * write the destination with non-temporal stores where the kernel has
+ * them. They are meant for frames larger than the last level cache,
+ * which would only evict everything else from it.
+ *
+ * Frames too large for one thread are split into bands of lines, one for
+ * each of the threads of a GstOMXCopyPool. The calling thread copies one
+ * band itself and waits for helper threads to copy the others. All pools
+ * share the same non-exclusive helper threads, so many elements copying
+ * at the same time don't start more threads than the largest pool asks
+ * for.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <unistd.h>
+
+#include "gstomxcopy.h"
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define GST_OMX_COPY_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined (__ARM_NEON) || defined (__ARM_NEON__)
+#define GST_OMX_COPY_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+GST_DEBUG_CATEGORY_STATIC (gst_omx_copy_debug_category);
+#define GST_CAT_DEFAULT gst_omx_copy_debug_category
+
+/* Used if the size of the last level cache is unknown */
+#define GST_OMX_COPY_DEFAULT_LLC_SIZE (2 * 1024 * 1024)
+
+/* Smaller bands are not worth waking up a thread for */
+#define GST_OMX_COPY_MIN_BAND_SIZE (128 * 1024)
+
+/* Contiguous memory is split into lines of this size for the bands */
+#define GST_OMX_COPY_MEMORY_LINE_SIZE 4096
+
+typedef void (*GstOMXCopyPlaneFunc) (guint8 * dest, gint dest_stride,
+    const guint8 * src, gint src_stride, gint width, gint height,
+    gboolean streaming);
+
+struct _GstOMXCopyPool
+{
+  guint n_threads;
+};
+
+/* Shared by all pools, started with the first one and never freed. The
+ * maximum number of threads only grows, protected by copy_threads_lock */
+static GMutex copy_threads_lock;
+static GThreadPool *copy_threads = NULL;
+
+/* The bands of one gst_omx_copy_planes() call */
+typedef struct
+{
+  GMutex lock;
+  GCond cond;
+  /* Protected by lock */
+  guint n_pending;
+} GstOMXCopyBatch;
+
+/* Lines of every plane a thread copies */
+typedef struct
+{
+  GstOMXCopyBatch *batch;
+  GstOMXCopyPlane parts[GST_OMX_COPY_MAX_PLANES];
+  guint n_parts;
+  gboolean streaming;
+} GstOMXCopyBand;
+
+static const gchar *impl_names[] = { "scalar", "sse2", "avx", "neon" };
+
+/* Only set from plugin_init() */
+static GstOMXCopyImpl copy_impl = GST_OMX_COPY_IMPL_SCALAR;
+static GstOMXCopyPlaneFunc copy_func = NULL;
+static gsize llc_size = GST_OMX_COPY_DEFAULT_LLC_SIZE;
+
+static void
+gst_omx_copy_plane_scalar (guint8 * dest, gint dest_stride,
+    const guint8 * src, gint src_stride, gint width, gint height,
+    gboolean streaming)
+{
+  gint h;
+
+  for (h = 0; h < height; h++) {
+    memcpy (dest, src, width);
+    dest += dest_stride;
+    src += src_stride;
+  }
+}
+
+#ifdef GST_OMX_COPY_HAVE_X86
+static inline void __attribute__ ((target ("sse2")))
+gst_omx_copy_line_sse2 (guint8 * dest, const guint8 * src, gint width,
+    gboolean streaming)
+{
+  if (streaming) {
+    /* Non-temporal stores need an aligned destination */
+    gint head = MIN (width, (gint) (-(guintptr) dest & 15));
+
+    memcpy (dest, src, head);
+    dest += head;
+    src += head;
+    width -= head;
+
+    for (; width >= 64; width -= 64, src += 64, dest += 64) {
+      __m128i a = _mm_loadu_si128 ((const __m128i *) src);
+      __m128i b = _mm_loadu_si128 ((const __m128i *) (src + 16));
+      __m128i c = _mm_loadu_si128 ((const __m128i *) (src + 32));
+      __m128i d = _mm_loadu_si128 ((const __m128i *) (src + 48));
+
+      _mm_stream_si128 ((__m128i *) dest, a);
+      _mm_stream_si128 ((__m128i *) (dest + 16), b);
+      _mm_stream_si128 ((__m128i *) (dest + 32), c);
+      _mm_stream_si128 ((__m128i *) (dest + 48), d);
+    }
+    for (; width >= 16; width -= 16, src += 16, dest += 16)
+      _mm_stream_si128 ((__m128i *) dest,
+          _mm_loadu_si128 ((const __m128i *) src));
+  } else {
+    for (; width >= 64; width -= 64, src += 64, dest += 64) {
+      __m128i a = _mm_loadu_si128 ((const __m128i *) src);
+      __m128i b = _mm_loadu_si128 ((const __m128i *) (src + 16));
+      __m128i c = _mm_loadu_si128 ((const __m128i *) (src + 32));
+      __m128i d = _mm_loadu_si128 ((const __m128i *) (src + 48));
+
+      _mm_storeu_si128 ((__m128i *) dest, a);
+      _mm_storeu_si128 ((__m128i *) (dest + 16), b);
+      _mm_storeu_si128 ((__m128i *) (dest + 32), c);
+      _mm_storeu_si128 ((__m128i *) (dest + 48), d);
+    }
+    for (; width >= 16; width -= 16, src += 16, dest += 16)
+      _mm_storeu_si128 ((__m128i *) dest,
+          _mm_loadu_si128 ((const __m128i *) src));
+  }
+
+  memcpy (dest, src, width);
+}
+
+static void __attribute__ ((target ("sse2")))
+gst_omx_copy_plane_sse2 (guint8 * dest, gint dest_stride,
+    const guint8 * src, gint src_stride, gint width, gint height,
+    gboolean streaming)
+{
+  gint h;
+
+  for (h = 0; h < height; h++) {
+    gst_omx_copy_line_sse2 (dest, src, width, streaming);
+    dest += dest_stride;
+    src += src_stride;
+  }
+
+  /* Non-temporal stores are weakly ordered, make them visible before
+   * the frame is passed on */
+  if (streaming)
+    _mm_sfence ();
+}
+
+static inline void __attribute__ ((target ("avx")))
+gst_omx_copy_line_avx (guint8 * dest, const guint8 * src, gint width,
+    gboolean streaming)
+{
+  if (streaming) {
+    gint head = MIN (width, (gint) (-(guintptr) dest & 31));
+
+    memcpy (dest, src, head);
+    dest += head;
+    src += head;
+    width -= head;
+
+    for (; width >= 128; width -= 128, src += 128, dest += 128) {
+      __m256i a = _mm256_loadu_si256 ((const __m256i *) src);
+      __m256i b = _mm256_loadu_si256 ((const __m256i *) (src + 32));
+      __m256i c = _mm256_loadu_si256 ((const __m256i *) (src + 64));
+      __m256i d = _mm256_loadu_si256 ((const __m256i *) (src + 96));
+
+      _mm256_stream_si256 ((__m256i *) dest, a);
+      _mm256_stream_si256 ((__m256i *) (dest + 32), b);
+      _mm256_stream_si256 ((__m256i *) (dest + 64), c);
+      _mm256_stream_si256 ((__m256i *) (dest + 96), d);
+    }
+    for (; width >= 32; width -= 32, src += 32, dest += 32)
+      _mm256_stream_si256 ((__m256i *) dest,
+          _mm256_loadu_si256 ((const __m256i *) src));
+  } else {
+    for (; width >= 128; width -= 128, src += 128, dest += 128) {
+      __m256i a = _mm256_loadu_si256 ((const __m256i *) src);
+      __m256i b = _mm256_loadu_si256 ((const __m256i *) (src + 32));
+      __m256i c = _mm256_loadu_si256 ((const __m256i *) (src + 64));
+      __m256i d = _mm256_loadu_si256 ((const __m256i *) (src + 96));
+
+      _mm256_storeu_si256 ((__m256i *) dest, a);
+      _mm256_storeu_si256 ((__m256i *) (dest + 32), b);
+      _mm256_storeu_si256 ((__m256i *) (dest + 64), c);
+      _mm256_storeu_si256 ((__m256i *) (dest + 96), d);
+    }
+    for (; width >= 32; width -= 32, src += 32, dest += 32)
+      _mm256_storeu_si256 ((__m256i *) dest,
+          _mm256_loadu_si256 ((const __m256i *) src));
+  }
+
+  memcpy (dest, src, width);
+}
+
+static void __attribute__ ((target ("avx")))
+gst_omx_copy_plane_avx (guint8 * dest, gint dest_stride,
+    const guint8 * src, gint src_stride, gint width, gint height,
+    gboolean streaming)
+{
+  gint h;
+
+  for (h = 0; h < height; h++) {
+    gst_omx_copy_line_avx (dest, src, width, streaming);
+    dest += dest_stride;
+    src += src_stride;
+  }
+
+  if (streaming)
+    _mm_sfence ();
+}
+#endif /* GST_OMX_COPY_HAVE_X86 */
+
+#ifdef GST_OMX_COPY_HAVE_NEON
+/* The NEON intrinsics have no non-temporal stores, the cores switch to
+ * not allocating in the cache on long streams of writes themselves */
+static void
+gst_omx_copy_plane_neon (guint8 * dest, gint dest_stride,
+    const guint8 * src, gint src_stride, gint width, gint height,
+    gboolean streaming)
+{
+  gint h, w;
+
+  for (h = 0; h < height; h++) {
+    const guint8 *s = src;
+    guint8 *d = dest;
+
+    for (w = width; w >= 64; w -= 64, s += 64, d += 64) {
+      uint8x16_t a = vld1q_u8 (s);
+      uint8x16_t b = vld1q_u8 (s + 16);
+      uint8x16_t c = vld1q_u8 (s + 32);
+      uint8x16_t e = vld1q_u8 (s + 48);
+
+      vst1q_u8 (d, a);
+      vst1q_u8 (d + 16, b);
+      vst1q_u8 (d + 32, c);
+      vst1q_u8 (d + 48, e);
+    }
+    for (; w >= 16; w -= 16, s += 16, d += 16)
+      vst1q_u8 (d, vld1q_u8 (s));
+    memcpy (d, s, w);
+
+    dest += dest_stride;
+    src += src_stride;
+  }
+}
+#endif /* GST_OMX_COPY_HAVE_NEON */
+
+static GstOMXCopyPlaneFunc
+gst_omx_copy_get_func (GstOMXCopyImpl impl)
+{
+  switch (impl) {
+#ifdef GST_OMX_COPY_HAVE_X86
+    case GST_OMX_COPY_IMPL_SSE2:
+      return gst_omx_copy_plane_sse2;
+    case GST_OMX_COPY_IMPL_AVX:
+      return gst_omx_copy_plane_avx;
+#endif
+#ifdef GST_OMX_COPY_HAVE_NEON
+    case GST_OMX_COPY_IMPL_NEON:
+      return gst_omx_copy_plane_neon;
+#endif
+    default:
+      return gst_omx_copy_plane_scalar;
+  }
+}
+
+/* Returns the size of the largest cache, from sysfs if the C library
+ * doesn't know it, which is the case on most ARM systems */
+static gsize
+gst_omx_copy_get_llc_size (void)
+{
+  guint64 size = 0;
+  gint i, max_level = 0;
+
+#ifdef _SC_LEVEL3_CACHE_SIZE
+  {
+    glong sc_size = sysconf (_SC_LEVEL3_CACHE_SIZE);
+
+    if (sc_size <= 0)
+      sc_size = sysconf (_SC_LEVEL2_CACHE_SIZE);
+    if (sc_size > 0)
+      return sc_size;
+  }
+#endif
+
+  for (i = 0;; i++) {
+    gchar *path, *contents, *end;
+    guint64 cache_size;
+    gint level;
+
+    path = g_strdup_printf ("/sys/devices/system/cpu/cpu0/cache/index%d/level",
+        i);
+    if (!g_file_get_contents (path, &contents, NULL, NULL)) {
+      g_free (path);
+      break;
+    }
+    g_free (path);
+    level = g_ascii_strtoll (contents, NULL, 10);
+    g_free (contents);
+
+    if (level < max_level)
+      continue;
+
+    path = g_strdup_printf ("/sys/devices/system/cpu/cpu0/cache/index%d/size",
+        i);
+    if (g_file_get_contents (path, &contents, NULL, NULL)) {
+      cache_size = g_ascii_strtoull (contents, &end, 10);
+      if (*end == 'K')
+        cache_size *= 1024;
+      else if (*end == 'M')
+        cache_size *= 1024 * 1024;
+
+      if (cache_size > 0) {
+        max_level = level;
+        size = cache_size;
+      }
+      g_free (contents);
+    }
+    g_free (path);
+  }
+
+  return size > 0 ? size : GST_OMX_COPY_DEFAULT_LLC_SIZE;
+}
+
+void
+gst_omx_copy_init (void)
+{
+  const gchar *env;
+  gint impl;
+
+  GST_DEBUG_CATEGORY_INIT (gst_omx_copy_debug_category, "omxcopy", 0,
+      "gst-omx plane copies");
+
+  llc_size = gst_omx_copy_get_llc_size ();
+
+  /* Later kernels are faster */
+  copy_impl = GST_OMX_COPY_IMPL_SCALAR;
+  for (impl = GST_OMX_COPY_IMPL_SCALAR; impl < GST_OMX_COPY_IMPL_LAST; impl++)
+    if (gst_omx_copy_impl_is_supported (impl))
+      copy_impl = impl;
+
+  if ((env = g_getenv ("GST_OMX_COPY"))) {
+    for (impl = GST_OMX_COPY_IMPL_SCALAR; impl < GST_OMX_COPY_IMPL_LAST;
+        impl++)
+      if (g_strcmp0 (env, impl_names[impl]) == 0)
+        break;
+
+    if (impl < GST_OMX_COPY_IMPL_LAST && gst_omx_copy_impl_is_supported (impl))
+      copy_impl = impl;
+    else
+      GST_WARNING ("Copy kernel '%s' is not supported, using '%s'", env,
+          impl_names[copy_impl]);
+  }
+
+  copy_func = gst_omx_copy_get_func (copy_impl);
+
+  GST_INFO ("Using %s copies, streaming frames larger than %" G_GSIZE_FORMAT
+      " bytes", impl_names[copy_impl], llc_size);
+}
+
+const gchar *
+gst_omx_copy_impl_get_name (GstOMXCopyImpl impl)
+{
+  g_return_val_if_fail (impl < GST_OMX_COPY_IMPL_LAST, NULL);
+
+  return impl_names[impl];
+}
+
+gboolean
+gst_omx_copy_impl_is_supported (GstOMXCopyImpl impl)
+{
+  switch (impl) {
+    case GST_OMX_COPY_IMPL_SCALAR:
+      return TRUE;
+#ifdef GST_OMX_COPY_HAVE_X86
+    case GST_OMX_COPY_IMPL_SSE2:
+      __builtin_cpu_init ();
+      return __builtin_cpu_supports ("sse2");
+    case GST_OMX_COPY_IMPL_AVX:
+      __builtin_cpu_init ();
+      return __builtin_cpu_supports ("avx");
+#endif
+#ifdef GST_OMX_COPY_HAVE_NEON
+    case GST_OMX_COPY_IMPL_NEON:
+      return TRUE;
+#endif
+    default:
+      return FALSE;
+  }
+}
+
+/* Returns TRUE if a frame of size bytes should be copied with
+ * streaming, i.e. doesn't fit into the last level cache */
+gboolean
+gst_omx_copy_use_streaming (gsize size)
+{
+  return size > llc_size;
+}
+
+static void
+gst_omx_copy_plane_func (GstOMXCopyPlaneFunc func, guint8 * dest,
+    gint dest_stride, const guint8 * src, gint src_stride, gint width,
+    gint height, gboolean streaming)
+{
+  if (width <= 0 || height <= 0)
+    return;
+
+  /* Planes without padding are copied as one line */
+  if (dest_stride == width && src_stride == width
+      && height <= G_MAXINT / width) {
+    width *= height;
+    height = 1;
+  }
+
+  func (dest, dest_stride, src, src_stride, width, height, streaming);
+}
+
+/* Copies height lines of width bytes from src to dest with the best
+ * kernel, see gst_omx_copy_use_streaming() for streaming */
+void
+gst_omx_copy_plane (guint8 * dest, gint dest_stride, const guint8 * src,
+    gint src_stride, gint width, gint height, gboolean streaming)
+{
+  gst_omx_copy_plane_func (copy_func ? copy_func : gst_omx_copy_plane_scalar,
+      dest, dest_stride, src, src_stride, width, height, streaming);
+}
+
+/* Like gst_omx_copy_plane() with a specific kernel. Returns FALSE if the
+ * CPU doesn't support it */
+gboolean
+gst_omx_copy_plane_with_impl (GstOMXCopyImpl impl, guint8 * dest,
+    gint dest_stride, const guint8 * src, gint src_stride, gint width,
+    gint height, gboolean streaming)
+{
+  g_return_val_if_fail (impl < GST_OMX_COPY_IMPL_LAST, FALSE);
+
+  if (!gst_omx_copy_impl_is_supported (impl))
+    return FALSE;
+
+  gst_omx_copy_plane_func (gst_omx_copy_get_func (impl), dest, dest_stride,
+      src, src_stride, width, height, streaming);
+
+  return TRUE;
+}
+
+static void
+gst_omx_copy_band (GstOMXCopyBand * band)
+{
+  guint i;
+
+  for (i = 0; i < band->n_parts; i++)
+    gst_omx_copy_plane (band->parts[i].dest, band->parts[i].dest_stride,
+        band->parts[i].src, band->parts[i].src_stride, band->parts[i].width,
+        band->parts[i].height, band->streaming);
+}
+
+static void
+gst_omx_copy_pool_run_band (GstOMXCopyBand * band, gpointer user_data)
+{
+  GstOMXCopyBatch *batch = band->batch;
+
+  gst_omx_copy_band (band);
+
+  g_mutex_lock (&batch->lock);
+  if (--batch->n_pending == 0)
+    g_cond_signal (&batch->cond);
+  g_mutex_unlock (&batch->lock);
+}
+
+/* Returns a pool that splits copies for n_threads helper threads, which
+ * must not be 0. The threads are shared with all other pools */
+GstOMXCopyPool *
+gst_omx_copy_pool_new (guint n_threads)
+{
+  GstOMXCopyPool *pool;
+
+  g_return_val_if_fail (n_threads > 0, NULL);
+
+  g_mutex_lock (&copy_threads_lock);
+  if (!copy_threads) {
+    /* Non-exclusive threads are only started when there are bands and
+     * can't fail to be created */
+    copy_threads =
+        g_thread_pool_new ((GFunc) gst_omx_copy_pool_run_band, NULL,
+        n_threads, FALSE, NULL);
+    GST_DEBUG ("Using up to %u shared copy threads", n_threads);
+  } else if (g_thread_pool_get_max_threads (copy_threads) < (gint) n_threads) {
+    g_thread_pool_set_max_threads (copy_threads, n_threads, NULL);
+    GST_DEBUG ("Using up to %u shared copy threads", n_threads);
+  }
+  g_mutex_unlock (&copy_threads_lock);
+
+  pool = g_slice_new0 (GstOMXCopyPool);
+  pool->n_threads = n_threads;
+
+  return pool;
+}
+
+/* NOTE: gst_omx_copy_planes() waits for all its bands, so there is no
+ * work of the pool left in the shared threads */
+void
+gst_omx_copy_pool_free (GstOMXCopyPool * pool)
+{
+  g_return_if_fail (pool != NULL);
+
+  g_slice_free (GstOMXCopyPool, pool);
+}
+
+guint
+gst_omx_copy_pool_get_n_threads (GstOMXCopyPool * pool)
+{
+  g_return_val_if_fail (pool != NULL, 0);
+
+  return pool->n_threads;
+}
+
+/* Copies n_planes planes, at most GST_OMX_COPY_MAX_PLANES. The planes are
+ * split into bands of lines of about the same size, one for every thread
+ * of pool and one for the calling thread. Without a pool, or for small
+ * frames, everything is copied by the calling thread */
+void
+gst_omx_copy_planes (GstOMXCopyPool * pool, const GstOMXCopyPlane * planes,
+    guint n_planes, gboolean streaming)
+{
+  GstOMXCopyBatch batch;
+  GstOMXCopyBand *bands;
+  guint64 size = 0, offset = 0;
+  guint i, n_bands = 1;
+
+  g_return_if_fail (n_planes <= GST_OMX_COPY_MAX_PLANES);
+
+  for (i = 0; i < n_planes; i++)
+    if (planes[i].width > 0 && planes[i].height > 0)
+      size += (guint64) planes[i].width * planes[i].height;
+
+  if (pool)
+    n_bands = MIN (pool->n_threads + 1, size / GST_OMX_COPY_MIN_BAND_SIZE);
+
+  if (n_bands <= 1) {
+    for (i = 0; i < n_planes; i++)
+      gst_omx_copy_plane (planes[i].dest, planes[i].dest_stride,
+          planes[i].src, planes[i].src_stride, planes[i].width,
+          planes[i].height, streaming);
+    return;
+  }
+
+  /* Band b gets the lines starting in the bytes [b, b + 1) * size / n_bands
+   * of all planes one after another, so a band can have parts of several
+   * planes */
+  bands = g_new0 (GstOMXCopyBand, n_bands);
+  for (i = 0; i < n_planes; i++) {
+    const GstOMXCopyPlane *plane = &planes[i];
+    gint line = 0, end_line;
+    guint b;
+
+    if (plane->width <= 0 || plane->height <= 0)
+      continue;
+
+    while (line < plane->height) {
+      GstOMXCopyPlane *part;
+      guint64 band_end;
+
+      b = (offset + (guint64) line * plane->width) * n_bands / size;
+      band_end = (b + 1) * size / n_bands;
+      end_line = (band_end - offset + plane->width - 1) / plane->width;
+      end_line = CLAMP (end_line, line + 1, plane->height);
+
+      part = &bands[b].parts[bands[b].n_parts++];
+      *part = *plane;
+      part->dest += (gsize) line * plane->dest_stride;
+      part->src += (gsize) line * plane->src_stride;
+      part->height = end_line - line;
+
+      line = end_line;
+    }
+
+    offset += (guint64) plane->width * plane->height;
+  }
+
+  g_mutex_init (&batch.lock);
+  g_cond_init (&batch.cond);
+  batch.n_pending = n_bands - 1;
+
+  for (i = 0; i < n_bands; i++) {
+    bands[i].batch = &batch;
+    bands[i].streaming = streaming;
+    if (i > 0)
+      g_thread_pool_push (copy_threads, &bands[i], NULL);
+  }
+
+  gst_omx_copy_band (&bands[0]);
+
+  g_mutex_lock (&batch.lock);
+  while (batch.n_pending > 0)
+    g_cond_wait (&batch.cond, &batch.lock);
+  g_mutex_unlock (&batch.lock);
+
+  g_cond_clear (&batch.cond);
+  g_mutex_clear (&batch.lock);
+  g_free (bands);
+}
+
+/* Like gst_omx_copy_planes() for size contiguous bytes */
+void
+gst_omx_copy_memory (GstOMXCopyPool * pool, guint8 * dest,
+    const guint8 * src, gsize size, gboolean streaming)
+{
+  GstOMXCopyPlane planes[2];
+  gsize n_lines = size / GST_OMX_COPY_MEMORY_LINE_SIZE;
+
+  planes[0].dest = dest;
+  planes[0].dest_stride = GST_OMX_COPY_MEMORY_LINE_SIZE;
+  planes[0].src = src;
+  planes[0].src_stride = GST_OMX_COPY_MEMORY_LINE_SIZE;
+  planes[0].width = GST_OMX_COPY_MEMORY_LINE_SIZE;
+  planes[0].height = n_lines;
+
+  planes[1].dest = dest + n_lines * GST_OMX_COPY_MEMORY_LINE_SIZE;
+  planes[1].dest_stride = 0;
+  planes[1].src = src + n_lines * GST_OMX_COPY_MEMORY_LINE_SIZE;
+  planes[1].src_stride = 0;
+  planes[1].width = size % GST_OMX_COPY_MEMORY_LINE_SIZE;
+  planes[1].height = 1;
+
+  gst_omx_copy_planes (pool, planes, 2, streaming);
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2026, RidgeRun
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __GST_OMX_COPY_H__
+#define __GST_OMX_COPY_H__
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+  /* memcpy() per line, always supported */
+  GST_OMX_COPY_IMPL_SCALAR = 0,
+  GST_OMX_COPY_IMPL_SSE2,
+  GST_OMX_COPY_IMPL_AVX,
+  GST_OMX_COPY_IMPL_NEON,
+  GST_OMX_COPY_IMPL_LAST
+} GstOMXCopyImpl;
+
+#define GST_OMX_COPY_MAX_PLANES 4
+
+typedef struct _GstOMXCopyPlane GstOMXCopyPlane;
+typedef struct _GstOMXCopyPool GstOMXCopyPool;
+
+/* height lines of width bytes */
+struct _GstOMXCopyPlane
+{
+  guint8 *dest;
+  gint dest_stride;
+  const guint8 *src;
+  gint src_stride;
+  gint width;
+  gint height;
+};
+
+void            gst_omx_copy_init (void);
+
+const gchar *   gst_omx_copy_impl_get_name (GstOMXCopyImpl impl);
+gboolean        gst_omx_copy_impl_is_supported (GstOMXCopyImpl impl);
+
+gboolean        gst_omx_copy_use_streaming (gsize size);
+
+void            gst_omx_copy_plane (guint8 * dest, gint dest_stride, const guint8 * src, gint src_stride, gint width, gint height, gboolean streaming);
+gboolean        gst_omx_copy_plane_with_impl (GstOMXCopyImpl impl, guint8 * dest, gint dest_stride, const guint8 * src, gint src_stride, gint width, gint height, gboolean streaming);
+
+GstOMXCopyPool *gst_omx_copy_pool_new (guint n_threads);
+void            gst_omx_copy_pool_free (GstOMXCopyPool * pool);
+guint           gst_omx_copy_pool_get_n_threads (GstOMXCopyPool * pool);
+
+void            gst_omx_copy_planes (GstOMXCopyPool * pool, const GstOMXCopyPlane * planes, guint n_planes, gboolean streaming);
+void            gst_omx_copy_memory (GstOMXCopyPool * pool, guint8 * dest, const guint8 * src, gsize size, gboolean streaming);
+
+G_END_DECLS
+
+#endif /* __GST_OMX_COPY_H__ */
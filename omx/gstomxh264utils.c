@@ -46,6 +46,32 @@ gst_omx_h264_utils_get_profile_from_str (const gchar * profile)
   return OMX_VIDEO_AVCProfileMax;
 }
 
+/* Returns NULL for profiles without caps representation */
+const gchar *
+gst_omx_h264_utils_get_str_from_profile (OMX_VIDEO_AVCPROFILETYPE profile)
+{
+  switch (profile) {
+    case OMX_VIDEO_AVCProfileBaseline:
+      return "baseline";
+    case OMX_VIDEO_AVCProfileMain:
+      return "main";
+    case OMX_VIDEO_AVCProfileExtended:
+      return "extended";
+    case OMX_VIDEO_AVCProfileHigh:
+      return "high";
+    case OMX_VIDEO_AVCProfileHigh10:
+      return "high-10";
+    case OMX_VIDEO_AVCProfileHigh422:
+      return "high-4:2:2";
+    case OMX_VIDEO_AVCProfileHigh444:
+      return "high-4:4:4";
+    default:
+      break;
+  }
+
+  return NULL;
+}
+
 OMX_VIDEO_AVCLEVELTYPE
 gst_omx_h264_utils_get_level_from_str (const gchar * level)
 {
@@ -29,6 +29,8 @@ OMX_VIDEO_AVCPROFILETYPE gst_omx_h264_utils_get_profile_from_str (const
     gchar * profile);
 OMX_VIDEO_AVCLEVELTYPE gst_omx_h264_utils_get_level_from_str (const gchar *
     level);
+const gchar *gst_omx_h264_utils_get_str_from_profile (OMX_VIDEO_AVCPROFILETYPE
+    profile);
 
 G_END_DECLS
 #endif /* __GST_OMX_H264_UTILS_H__ */
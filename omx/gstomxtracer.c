@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2026, RidgeRun
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/**
+ * SECTION:gstomxtracer
+ * @short_description: timing of the buffers passed to OpenMAX IL components
+ *
+ * The "omx" tracer collects, for every component, histograms of
+ *
+ * - residency: time between passing a buffer to the component and the
+ *   component returning it, i.e. the time spent in the codec,
+ * - queue-wait: time a returned buffer waited in the port's pending
+ *   buffers until the element picked it up again,
+ * - blocked: time threads were blocked waiting for the component.
+ *
+ * The histograms are logged when a component is freed and when the
+ * tracer is destroyed, e.g.
+ *
+ * |[
+ * GST_TRACERS="omx" GST_DEBUG="GST_TRACER:7" gst-launch-1.0 ...
+ * ]|
+ *
+ * Histogram buckets are powers of two microseconds, a bucket "64:12"
+ * means 12 samples took at least 32us and less than 64us.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstomxtracer.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_omx_tracer_debug_category);
+#define GST_CAT_DEFAULT gst_omx_tracer_debug_category
+
+#define GST_OMX_TRACER_N_BUCKETS 32
+
+typedef struct
+{
+  guint64 count;
+  guint64 sum;
+  guint64 min, max;
+  guint64 buckets[GST_OMX_TRACER_N_BUCKETS];
+} GstOMXTracerHistogram;
+
+struct _GstOMXTracerStats
+{
+  gchar *name;
+
+  GMutex lock;
+  GstOMXTracerHistogram histograms[GST_OMX_TRACER_METRIC_LAST];
+};
+
+static const gchar *metric_names[GST_OMX_TRACER_METRIC_LAST] = {
+  "residency",
+  "queue-wait",
+  "blocked",
+};
+
+gint gst_omx_tracer_active = 0;
+
+/* Stats of all components that are alive */
+G_LOCK_DEFINE_STATIC (stats);
+static GList *stats_list = NULL;
+
+static GstTracerRecord *tr_histogram = NULL;
+
+#define gst_omx_tracer_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE (GstOMXTracer, gst_omx_tracer, GST_TYPE_TRACER,
+    GST_DEBUG_CATEGORY_INIT (gst_omx_tracer_debug_category, "omxtracer", 0,
+        "debug category for the omx tracer"));
+
+static gchar *
+gst_omx_tracer_histogram_to_string (const GstOMXTracerHistogram * histogram)
+{
+  GString *s = g_string_new (NULL);
+  guint i;
+
+  for (i = 0; i < GST_OMX_TRACER_N_BUCKETS; i++) {
+    if (histogram->buckets[i] == 0)
+      continue;
+
+    if (s->len > 0)
+      g_string_append_c (s, ',');
+
+    if (i == GST_OMX_TRACER_N_BUCKETS - 1)
+      g_string_append (s, "inf");
+    else
+      g_string_append_printf (s, "%" G_GUINT64_FORMAT,
+          G_GUINT64_CONSTANT (1) << i);
+    g_string_append_printf (s, ":%" G_GUINT64_FORMAT, histogram->buckets[i]);
+  }
+
+  return g_string_free (s, FALSE);
+}
+
+/* NOTE: Must be called while holding stats->lock */
+static void
+gst_omx_tracer_stats_publish (GstOMXTracerStats * stats)
+{
+  guint i;
+
+  for (i = 0; i < GST_OMX_TRACER_METRIC_LAST; i++) {
+    const GstOMXTracerHistogram *histogram = &stats->histograms[i];
+    gchar *buckets;
+
+    if (histogram->count == 0)
+      continue;
+
+    buckets = gst_omx_tracer_histogram_to_string (histogram);
+    gst_tracer_record_log (tr_histogram, stats->name, metric_names[i],
+        histogram->count, histogram->min, histogram->max,
+        histogram->sum / histogram->count, buckets);
+    g_free (buckets);
+  }
+}
+
+/* Returns NULL if no "omx" tracer is active. name identifies the
+ * component in the logged records */
+GstOMXTracerStats *
+gst_omx_tracer_stats_new (const gchar * name)
+{
+  GstOMXTracerStats *stats;
+  guint i;
+
+  if (!GST_OMX_TRACER_IS_ACTIVE ())
+    return NULL;
+
+  stats = g_slice_new0 (GstOMXTracerStats);
+  stats->name = g_strdup (name);
+  g_mutex_init (&stats->lock);
+  for (i = 0; i < GST_OMX_TRACER_METRIC_LAST; i++)
+    stats->histograms[i].min = G_MAXUINT64;
+
+  G_LOCK (stats);
+  stats_list = g_list_prepend (stats_list, stats);
+  G_UNLOCK (stats);
+
+  return stats;
+}
+
+/* Logs the histograms one last time */
+void
+gst_omx_tracer_stats_free (GstOMXTracerStats * stats)
+{
+  g_return_if_fail (stats != NULL);
+
+  G_LOCK (stats);
+  stats_list = g_list_remove (stats_list, stats);
+  G_UNLOCK (stats);
+
+  g_mutex_lock (&stats->lock);
+  if (GST_OMX_TRACER_IS_ACTIVE ())
+    gst_omx_tracer_stats_publish (stats);
+  g_mutex_unlock (&stats->lock);
+
+  g_mutex_clear (&stats->lock);
+  g_free (stats->name);
+  g_slice_free (GstOMXTracerStats, stats);
+}
+
+void
+gst_omx_tracer_stats_add (GstOMXTracerStats * stats, GstOMXTracerMetric metric,
+    gint64 usecs)
+{
+  GstOMXTracerHistogram *histogram;
+  guint64 value;
+  guint bucket;
+
+  g_return_if_fail (stats != NULL);
+  g_return_if_fail (metric < GST_OMX_TRACER_METRIC_LAST);
+
+  value = MAX (usecs, 0);
+  bucket = MIN (g_bit_storage (value), GST_OMX_TRACER_N_BUCKETS - 1);
+  if (value == 0)
+    bucket = 0;
+
+  histogram = &stats->histograms[metric];
+
+  g_mutex_lock (&stats->lock);
+  histogram->count++;
+  histogram->sum += value;
+  histogram->min = MIN (histogram->min, value);
+  histogram->max = MAX (histogram->max, value);
+  histogram->buckets[bucket]++;
+  g_mutex_unlock (&stats->lock);
+}
+
+static void
+gst_omx_tracer_constructed (GObject * object)
+{
+  G_OBJECT_CLASS (parent_class)->constructed (object);
+
+  g_atomic_int_inc (&gst_omx_tracer_active);
+  GST_DEBUG_OBJECT (object, "omx tracer active");
+}
+
+static void
+gst_omx_tracer_finalize (GObject * object)
+{
+  GList *l;
+
+  /* Components that are still alive at this point are usually leaked,
+   * their numbers are still useful */
+  G_LOCK (stats);
+  for (l = stats_list; l; l = l->next) {
+    GstOMXTracerStats *stats = l->data;
+
+    g_mutex_lock (&stats->lock);
+    gst_omx_tracer_stats_publish (stats);
+    g_mutex_unlock (&stats->lock);
+  }
+  G_UNLOCK (stats);
+
+  g_atomic_int_dec_and_test (&gst_omx_tracer_active);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_omx_tracer_class_init (GstOMXTracerClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->constructed = gst_omx_tracer_constructed;
+  gobject_class->finalize = gst_omx_tracer_finalize;
+
+  tr_histogram = gst_tracer_record_new ("omx-histogram.class",
+      "component", GST_TYPE_STRUCTURE, gst_structure_new ("scope",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          "related-to", GST_TYPE_TRACER_VALUE_SCOPE,
+          GST_TRACER_VALUE_SCOPE_ELEMENT, NULL),
+      "metric", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          "description", G_TYPE_STRING,
+          "residency, queue-wait or blocked", NULL),
+      "count", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_UINT64,
+          "description", G_TYPE_STRING, "number of samples",
+          "flags", GST_TYPE_TRACER_VALUE_FLAGS,
+          GST_TRACER_VALUE_FLAGS_AGGREGATED, NULL),
+      "min", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_UINT64,
+          "description", G_TYPE_STRING, "minimum in microseconds",
+          "flags", GST_TYPE_TRACER_VALUE_FLAGS,
+          GST_TRACER_VALUE_FLAGS_AGGREGATED, NULL),
+      "max", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_UINT64,
+          "description", G_TYPE_STRING, "maximum in microseconds",
+          "flags", GST_TYPE_TRACER_VALUE_FLAGS,
+          GST_TRACER_VALUE_FLAGS_AGGREGATED, NULL),
+      "mean", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_UINT64,
+          "description", G_TYPE_STRING, "mean in microseconds",
+          "flags", GST_TYPE_TRACER_VALUE_FLAGS,
+          GST_TRACER_VALUE_FLAGS_AGGREGATED, NULL),
+      "histogram", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          "description", G_TYPE_STRING,
+          "comma separated upper bound in microseconds:count pairs",
+          "flags", GST_TYPE_TRACER_VALUE_FLAGS,
+          GST_TRACER_VALUE_FLAGS_AGGREGATED, NULL), NULL);
+  GST_OBJECT_FLAG_SET (tr_histogram, GST_OBJECT_FLAG_MAY_BE_LEAKED);
+}
+
+static void
+gst_omx_tracer_init (GstOMXTracer * self)
+{
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2026, RidgeRun
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __GST_OMX_TRACER_H__
+#define __GST_OMX_TRACER_H__
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_OMX_TRACER \
+  (gst_omx_tracer_get_type())
+#define GST_OMX_TRACER(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_OMX_TRACER,GstOMXTracer))
+#define GST_OMX_TRACER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_OMX_TRACER,GstOMXTracerClass))
+#define GST_IS_OMX_TRACER(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_OMX_TRACER))
+#define GST_IS_OMX_TRACER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_OMX_TRACER))
+
+typedef struct _GstOMXTracer GstOMXTracer;
+typedef struct _GstOMXTracerClass GstOMXTracerClass;
+typedef struct _GstOMXTracerStats GstOMXTracerStats;
+
+typedef enum {
+  /* Between {Empty,Fill}ThisBuffer() and the buffer done callback */
+  GST_OMX_TRACER_METRIC_RESIDENCY,
+  /* Between a buffer being put in and taken from the pending buffers */
+  GST_OMX_TRACER_METRIC_QUEUE_WAIT,
+  /* Time a thread was blocked waiting for messages from the component */
+  GST_OMX_TRACER_METRIC_BLOCKED,
+  GST_OMX_TRACER_METRIC_LAST
+} GstOMXTracerMetric;
+
+struct _GstOMXTracer
+{
+  GstTracer parent;
+};
+
+struct _GstOMXTracerClass
+{
+  GstTracerClass parent_class;
+};
+
+/* Number of "omx" tracers that are currently alive, checked before
+ * taking any timestamps that are only needed for tracing */
+extern gint gst_omx_tracer_active;
+
+#define GST_OMX_TRACER_IS_ACTIVE() \
+  G_UNLIKELY (g_atomic_int_get (&gst_omx_tracer_active) > 0)
+
+GType               gst_omx_tracer_get_type (void);
+
+GstOMXTracerStats * gst_omx_tracer_stats_new (const gchar * name);
+void                gst_omx_tracer_stats_free (GstOMXTracerStats * stats);
+void                gst_omx_tracer_stats_add (GstOMXTracerStats * stats, GstOMXTracerMetric metric, gint64 usecs);
+
+G_END_DECLS
+
+#endif /* __GST_OMX_TRACER_H__ */
@@ -27,6 +27,8 @@
 #endif
 
 #include "gstomxvideo.h"
+#include "gstomxcache.h"
+#include "gstomxh264utils.h"
 
 #include <math.h>
 
@@ -100,6 +102,37 @@ gst_omx_video_get_supported_colorformats (GstOMXPort * port,
   gint old_index;
   GstOMXVideoNegotiationMap *m;
   GstVideoFormat f;
+  gchar *cache_key = NULL;
+  gint *cached;
+  gsize i, n_cached;
+
+  /* Components from gst_omx_component_acquire() have their formats
+   * cached across processes, querying them can take a long time. Only
+   * the formats of input ports and the ones probed without a stream don't
+   * depend on the stream, the output formats of decoders might e.g.
+   * depend on its size or bit depth */
+  if (comp->pool_cdata && (!state || port->port_def.eDir == OMX_DirInput)) {
+    cache_key = g_strdup_printf ("color-formats-%u", (guint) port->index);
+    if (gst_omx_cache_get_integers (comp->pool_cdata, cache_key, &cached,
+            &n_cached)) {
+      for (i = 0; i < n_cached; i++) {
+        f = gst_omx_video_get_format_from_omx (cached[i]);
+        if (f == GST_VIDEO_FORMAT_UNKNOWN)
+          continue;
+
+        m = g_slice_new (GstOMXVideoNegotiationMap);
+        m->format = f;
+        m->type = cached[i];
+        negotiation_map = g_list_append (negotiation_map, m);
+        GST_DEBUG_OBJECT (comp->parent, "Component supports %s (%d), cached",
+            gst_video_format_to_string (f), cached[i]);
+      }
+      g_free (cached);
+      g_free (cache_key);
+
+      return negotiation_map;
+    }
+  }
 
   GST_OMX_INIT_STRUCT (&param);
   param.nPortIndex = port->index;
@@ -141,6 +174,18 @@ gst_omx_video_get_supported_colorformats (GstOMXPort * port,
     old_index = param.nIndex++;
   } while (err == OMX_ErrorNone);
 
+  if (cache_key && negotiation_map) {
+    GList *l;
+
+    n_cached = g_list_length (negotiation_map);
+    cached = g_new (gint, n_cached);
+    for (l = negotiation_map, i = 0; l; l = l->next, i++)
+      cached[i] = ((GstOMXVideoNegotiationMap *) l->data)->type;
+    gst_omx_cache_set_integers (comp->pool_cdata, cache_key, cached, n_cached);
+    g_free (cached);
+  }
+  g_free (cache_key);
+
   return negotiation_map;
 }
 
@@ -161,46 +206,395 @@ gst_omx_video_get_caps_for_map (GList * map)
   return caps;
 }
 
+/* Some components never stop enumerating */
+#define GST_OMX_VIDEO_MAX_PROBED_PROFILES 64
+
+static GstCaps *
+gst_omx_video_probe_formats (GstOMXPort * port)
+{
+  GList *map;
+  GstCaps *caps;
+
+  map = gst_omx_video_get_supported_colorformats (port, NULL);
+  caps = gst_omx_video_get_caps_for_map (map);
+  g_list_free_full (map, (GDestroyNotify) gst_omx_video_negotiation_map_free);
+
+  if (gst_caps_is_empty (caps)) {
+    gst_caps_unref (caps);
+    return NULL;
+  }
+
+  return caps;
+}
+
+static gboolean
+gst_omx_video_list_contains_string (const GValue * list, const gchar * str)
+{
+  guint i;
+
+  for (i = 0; i < gst_value_list_get_size (list); i++) {
+    if (g_str_equal (g_value_get_string (gst_value_list_get_value (list, i)),
+            str))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+static GstCaps *
+gst_omx_video_probe_profiles (GstOMXPort * port, const gchar * media_type)
+{
+  OMX_VIDEO_PARAM_PROFILELEVELTYPE param;
+  OMX_ERRORTYPE err;
+  GValue profiles = G_VALUE_INIT;
+  GstCaps *caps = NULL;
+
+  /* Only H.264 profiles are mapped to caps for now */
+  if (!g_str_equal (media_type, "video/x-h264"))
+    return NULL;
+
+  g_value_init (&profiles, GST_TYPE_LIST);
+
+  GST_OMX_INIT_STRUCT (&param);
+  param.nPortIndex = port->index;
+
+  for (param.nProfileIndex = 0;
+      param.nProfileIndex < GST_OMX_VIDEO_MAX_PROBED_PROFILES;
+      param.nProfileIndex++) {
+    const gchar *profile;
+    GValue v = G_VALUE_INIT;
+
+    err =
+        gst_omx_component_get_parameter (port->comp,
+        OMX_IndexParamVideoProfileLevelQuerySupported, &param);
+    if (err != OMX_ErrorNone)
+      break;
+
+    /* Components list every profile once per supported level */
+    profile = gst_omx_h264_utils_get_str_from_profile (param.eProfile);
+    if (!profile || gst_omx_video_list_contains_string (&profiles, profile))
+      continue;
+
+    GST_DEBUG_OBJECT (port->comp->parent, "Component supports profile %s",
+        profile);
+    g_value_init (&v, G_TYPE_STRING);
+    g_value_set_string (&v, profile);
+    gst_value_list_append_value (&profiles, &v);
+    g_value_unset (&v);
+  }
+
+  if (gst_value_list_get_size (&profiles) > 0) {
+    caps = gst_caps_new_empty_simple (media_type);
+    gst_caps_set_value (caps, "profile", &profiles);
+  }
+  g_value_unset (&profiles);
+
+  return caps;
+}
+
+/* Only restricts the system memory structures of caps that have the
+ * same media type as probed, and never to empty caps */
+static GstCaps *
+gst_omx_video_narrow_caps (GstCaps * caps, GstCaps * probed)
+{
+  const gchar *media_type;
+  GstCaps *narrowed;
+  guint i;
+
+  media_type = gst_structure_get_name (gst_caps_get_structure (probed, 0));
+  narrowed = gst_caps_new_empty ();
+
+  for (i = 0; i < gst_caps_get_size (caps); i++) {
+    GstStructure *s = gst_caps_get_structure (caps, i);
+    GstCapsFeatures *f = gst_caps_get_features (caps, i);
+    GstCaps *tmp, *intersection;
+
+    tmp = gst_caps_new_empty ();
+    gst_caps_append_structure_full (tmp, gst_structure_copy (s),
+        gst_caps_features_copy (f));
+
+    if (gst_structure_has_name (s, media_type)
+        && gst_caps_features_is_equal (f,
+            GST_CAPS_FEATURES_MEMORY_SYSTEM_MEMORY)) {
+      intersection = gst_caps_intersect (tmp, probed);
+      if (!gst_caps_is_empty (intersection))
+        gst_caps_replace (&tmp, intersection);
+      gst_caps_unref (intersection);
+    }
+
+    narrowed = gst_caps_merge (narrowed, tmp);
+  }
+  gst_caps_unref (caps);
+
+  return narrowed;
+}
+
+/* Restricts the template caps of the direction pad to what the component
+ * reports: the color formats of raw video ports and the profiles of
+ * encoded video output ports. Creates a component of its own, this
+ * is only called while registering the elements. Takes ownership of
+ * caps */
+GstCaps *
+gst_omx_video_probe_template_caps (const GstOMXClassData * cdata,
+    GstPadDirection direction, GstCaps * caps)
+{
+  GstOMXComponent *comp;
+  GstOMXPort *port;
+  GstCaps *probed = NULL;
+  const gchar *media_type;
+  gint in_port_index, out_port_index;
+
+  g_return_val_if_fail (cdata != NULL, caps);
+  g_return_val_if_fail (caps != NULL, NULL);
+
+  if (gst_caps_is_empty (caps) || gst_caps_is_any (caps))
+    return caps;
+
+  media_type = gst_structure_get_name (gst_caps_get_structure (caps, 0));
+  if (!g_str_has_prefix (media_type, "video/"))
+    return caps;
+
+  comp =
+      gst_omx_component_new (NULL, cdata->core_name, cdata->component_name,
+      cdata->component_role, cdata->hacks);
+  if (!comp) {
+    GST_WARNING ("Failed to create %s for probing", cdata->component_name);
+    return caps;
+  }
+
+  in_port_index = cdata->in_port_index;
+  out_port_index = cdata->out_port_index;
+  if (in_port_index == -1 || out_port_index == -1) {
+    if (!gst_omx_component_detect_port_indices (comp,
+            OMX_IndexParamVideoInit, &in_port_index, &out_port_index)) {
+      /* Fallback */
+      in_port_index = 0;
+      out_port_index = 1;
+    }
+  }
+
+  port =
+      gst_omx_component_add_port (comp,
+      direction == GST_PAD_SINK ? in_port_index : out_port_index);
+  if (!port)
+    goto done;
+
+  if (g_str_equal (media_type, "video/x-raw"))
+    probed = gst_omx_video_probe_formats (port);
+  else if (direction == GST_PAD_SRC)
+    /* Upstream caps often come without a profile, which a template
+     * with a profile would not accept */
+    probed = gst_omx_video_probe_profiles (port, media_type);
+
+  if (probed) {
+    GST_DEBUG ("%s supports %" GST_PTR_FORMAT, cdata->component_name, probed);
+    caps = gst_omx_video_narrow_caps (caps, probed);
+    gst_caps_unref (probed);
+  }
+
+done:
+  gst_omx_component_free (comp);
+
+  return caps;
+}
+
 void
 gst_omx_video_negotiation_map_free (GstOMXVideoNegotiationMap * m)
 {
   g_slice_free (GstOMXVideoNegotiationMap, m);
 }
 
+/* Frames handed to the component and not finished yet, ordered by PTS
+ * and then decoding order. Frames without PTS come last. Each frame is
+ * referenced once by the index.
+ *
+ * NOTE: Not thread-safe, the elements only use it with their stream
+ * lock */
+struct _GstOMXVideoFrameIndex
+{
+  GSequence *frames;
+};
+
+static gint
+gst_omx_video_frame_index_compare (gconstpointer a, gconstpointer b,
+    gpointer user_data)
+{
+  const GstVideoCodecFrame *frame_a = a, *frame_b = b;
+
+  if (frame_a->pts != frame_b->pts)
+    return frame_a->pts < frame_b->pts ? -1 : 1;
+  if (frame_a->system_frame_number != frame_b->system_frame_number)
+    return frame_a->system_frame_number < frame_b->system_frame_number ?
+        -1 : 1;
+
+  return 0;
+}
+
+/* g_sequence_is_empty() needs GLib 2.48 */
+static gboolean
+gst_omx_video_frame_index_is_empty (GstOMXVideoFrameIndex * index)
+{
+  return g_sequence_iter_is_end (g_sequence_get_begin_iter (index->frames));
+}
+
+GstOMXVideoFrameIndex *
+gst_omx_video_frame_index_new (void)
+{
+  GstOMXVideoFrameIndex *index = g_slice_new0 (GstOMXVideoFrameIndex);
+
+  index->frames = g_sequence_new (NULL);
+
+  return index;
+}
+
+void
+gst_omx_video_frame_index_free (GstOMXVideoFrameIndex * index)
+{
+  g_return_if_fail (index != NULL);
+
+  gst_omx_video_frame_index_clear (index);
+  g_sequence_free (index->frames);
+  g_slice_free (GstOMXVideoFrameIndex, index);
+}
+
+/* Adds frame to the index, which keeps a reference until the frame is
+ * removed again. The PTS of frame must not change while it's indexed */
+void
+gst_omx_video_frame_index_add (GstOMXVideoFrameIndex * index,
+    GstVideoCodecFrame * frame)
+{
+  g_return_if_fail (index != NULL);
+  g_return_if_fail (frame != NULL);
+
+  g_sequence_insert_sorted (index->frames, gst_video_codec_frame_ref (frame),
+      gst_omx_video_frame_index_compare, NULL);
+}
+
+/* Returns the frame with the PTS nearest to the timestamp of buf, and the
+ * oldest of them (the first one in decoding order) if several are equally
+ * near, or NULL if the index is empty.
+ * With remove the frame is removed from the index, i.e. buf is its output.
+ * Otherwise the caller gets a new reference */
 GstVideoCodecFrame *
-gst_omx_video_find_nearest_frame (GstOMXBuffer * buf, GList * frames)
+gst_omx_video_frame_index_find_nearest (GstOMXVideoFrameIndex * index,
+    GstOMXBuffer * buf, gboolean remove)
 {
-  GstVideoCodecFrame *best = NULL;
-  GstClockTimeDiff best_diff = G_MAXINT64;
-  GstClockTime timestamp;
-  GList *l;
+  GstVideoCodecFrame key = { 0, };
+  GstVideoCodecFrame *lower = NULL, *upper = NULL, *best;
+  GSequenceIter *iter, *best_iter;
 
-  timestamp =
+  g_return_val_if_fail (index != NULL, NULL);
+  g_return_val_if_fail (buf != NULL, NULL);
+
+  if (gst_omx_video_frame_index_is_empty (index))
+    return NULL;
+
+  key.pts =
       gst_util_uint64_scale (GST_OMX_GET_TICKS (buf->omx_buf->nTimeStamp),
       GST_SECOND, OMX_TICKS_PER_SECOND);
 
-  for (l = frames; l; l = l->next) {
-    GstVideoCodecFrame *tmp = l->data;
-    GstClockTimeDiff diff = ABS (GST_CLOCK_DIFF (timestamp, tmp->pts));
+  if (!GST_CLOCK_TIME_IS_VALID (key.pts)) {
+    /* Nothing to match, output is in PTS order */
+    best_iter = g_sequence_get_begin_iter (index->frames);
+  } else {
+    /* The first frame after the key and the last one before or at it */
+    iter = g_sequence_search (index->frames, &key,
+        gst_omx_video_frame_index_compare, NULL);
+    if (!g_sequence_iter_is_end (iter))
+      upper = g_sequence_get (iter);
+    if (!g_sequence_iter_is_begin (iter)) {
+      GSequenceIter *prev = g_sequence_iter_prev (iter);
 
-    if (diff < best_diff) {
-      best = tmp;
-      best_diff = diff;
+      /* The oldest frame with the same PTS */
+      lower = g_sequence_get (prev);
+      while (!g_sequence_iter_is_begin (prev)) {
+        GstVideoCodecFrame *tmp =
+            g_sequence_get (g_sequence_iter_prev (prev));
+
+        if (tmp->pts != lower->pts)
+          break;
+        prev = g_sequence_iter_prev (prev);
+        lower = tmp;
+      }
 
-      if (diff == 0)
-        break;
+      if (!upper || key.pts - lower->pts < upper->pts - key.pts
+          || (key.pts - lower->pts == upper->pts - key.pts
+              && lower->system_frame_number < upper->system_frame_number))
+        iter = prev;
     }
+    best_iter = iter;
   }
 
-  if (best)
+  best = g_sequence_get (best_iter);
+  if (remove)
+    g_sequence_remove (best_iter);
+  else
     gst_video_codec_frame_ref (best);
 
-  g_list_foreach (frames, (GFunc) gst_video_codec_frame_unref, NULL);
-  g_list_free (frames);
-
   return best;
 }
 
+/* Removes and returns the oldest frame with a PTS before timestamp, or
+ * the first frame without PTS if timestamp is invalid. Returns NULL if
+ * there is no such frame. The caller owns the index's reference */
+GstVideoCodecFrame *
+gst_omx_video_frame_index_pop_older (GstOMXVideoFrameIndex * index,
+    GstClockTime timestamp)
+{
+  GstVideoCodecFrame *frame;
+  GSequenceIter *iter;
+
+  g_return_val_if_fail (index != NULL, NULL);
+
+  if (gst_omx_video_frame_index_is_empty (index))
+    return NULL;
+
+  if (GST_CLOCK_TIME_IS_VALID (timestamp)) {
+    iter = g_sequence_get_begin_iter (index->frames);
+    frame = g_sequence_get (iter);
+    if (frame->pts >= timestamp)
+      return NULL;
+  } else {
+    GstVideoCodecFrame key = { 0, };
+
+    key.pts = GST_CLOCK_TIME_NONE;
+    iter = g_sequence_search (index->frames, &key,
+        gst_omx_video_frame_index_compare, NULL);
+    /* Only the frame without PTS and number 0 is before the key */
+    if (!g_sequence_iter_is_begin (iter)) {
+      GSequenceIter *prev = g_sequence_iter_prev (iter);
+
+      frame = g_sequence_get (prev);
+      if (!GST_CLOCK_TIME_IS_VALID (frame->pts))
+        iter = prev;
+    }
+    if (g_sequence_iter_is_end (iter))
+      return NULL;
+    frame = g_sequence_get (iter);
+    if (GST_CLOCK_TIME_IS_VALID (frame->pts))
+      return NULL;
+  }
+
+  g_sequence_remove (iter);
+
+  return frame;
+}
+
+/* Drops all frames, e.g. after the base class discarded its own list
+ * when flushing */
+void
+gst_omx_video_frame_index_clear (GstOMXVideoFrameIndex * index)
+{
+  g_return_if_fail (index != NULL);
+
+  while (!gst_omx_video_frame_index_is_empty (index)) {
+    GSequenceIter *iter = g_sequence_get_begin_iter (index->frames);
+
+    gst_video_codec_frame_unref (g_sequence_get (iter));
+    g_sequence_remove (iter);
+  }
+}
+
 OMX_U32
 gst_omx_video_calculate_framerate_q16 (GstVideoInfo * info)
 {
@@ -222,3 +616,53 @@ gst_omx_video_is_equal_framerate_q16 (OMX_U32 q16_a, OMX_U32 q16_b)
    * an unnecessary re-negotiation. */
   return fabs (((gdouble) q16_a) - ((gdouble) q16_b)) / (gdouble) q16_b < 0.01;
 }
+
+/* Hardware codecs usually specify their throughput in 16x16 macroblocks
+ * per second. Variable or unknown framerates count as 30 fps */
+guint
+gst_omx_video_get_macroblocks_per_second (GstVideoInfo * info)
+{
+  guint64 macroblocks;
+
+  macroblocks = (guint64) GST_ROUND_UP_16 (info->width) / 16 *
+      GST_ROUND_UP_16 (info->height) / 16;
+
+  if (info->fps_n > 0 && info->fps_d > 0)
+    macroblocks = gst_util_uint64_scale_ceil (macroblocks, info->fps_n,
+        info->fps_d);
+  else
+    macroblocks *= 30;
+
+  return MIN (macroblocks, G_MAXUINT);
+}
+
+/* Reserves the capacity needed for info, see gst_omx_component_reserve().
+ * Posts an error with details about the missing capacity otherwise, so
+ * applications can place the stream elsewhere */
+gboolean
+gst_omx_video_reserve (GstElement * element, GstOMXComponent * comp,
+    const GstOMXClassData * cdata, GstVideoInfo * info)
+{
+  GstOMXAdmissionReturn ret;
+  guint macroblocks;
+
+  macroblocks = gst_omx_video_get_macroblocks_per_second (info);
+
+  ret = gst_omx_component_reserve (comp, cdata, macroblocks);
+  if (ret == GST_OMX_ADMISSION_OK)
+    return TRUE;
+
+  GST_ELEMENT_ERROR_WITH_DETAILS (element, RESOURCE, BUSY,
+      ("Not enough hardware capacity for %dx%d at %d/%d fps", info->width,
+          info->height, info->fps_n, info->fps_d),
+      ("%s: %s", cdata->component_name,
+          gst_omx_admission_return_to_string (ret)),
+      ("reason", G_TYPE_STRING, gst_omx_admission_return_to_string (ret),
+          "core-name", G_TYPE_STRING, cdata->core_name,
+          "component-name", G_TYPE_STRING, cdata->component_name,
+          "macroblocks", G_TYPE_UINT, macroblocks,
+          "max-macroblocks", G_TYPE_UINT, cdata->max_macroblocks,
+          "max-instances", G_TYPE_UINT, cdata->max_instances, NULL));
+
+  return FALSE;
+}
@@ -49,16 +49,41 @@ gst_omx_video_get_supported_colorformats (GstOMXPort * port,
 
 GstCaps * gst_omx_video_get_caps_for_map(GList * map);
 
+GstCaps *
+gst_omx_video_probe_template_caps (const GstOMXClassData * cdata,
+    GstPadDirection direction, GstCaps * caps);
+
 void
 gst_omx_video_negotiation_map_free (GstOMXVideoNegotiationMap * m);
 
+typedef struct _GstOMXVideoFrameIndex GstOMXVideoFrameIndex;
+
+GstOMXVideoFrameIndex * gst_omx_video_frame_index_new (void);
+
+void gst_omx_video_frame_index_free (GstOMXVideoFrameIndex * index);
+
+void gst_omx_video_frame_index_add (GstOMXVideoFrameIndex * index,
+    GstVideoCodecFrame * frame);
+
 GstVideoCodecFrame *
-gst_omx_video_find_nearest_frame (GstOMXBuffer * buf, GList * frames);
+gst_omx_video_frame_index_find_nearest (GstOMXVideoFrameIndex * index,
+    GstOMXBuffer * buf, gboolean remove);
+
+GstVideoCodecFrame *
+gst_omx_video_frame_index_pop_older (GstOMXVideoFrameIndex * index,
+    GstClockTime timestamp);
+
+void gst_omx_video_frame_index_clear (GstOMXVideoFrameIndex * index);
 
 OMX_U32 gst_omx_video_calculate_framerate_q16 (GstVideoInfo * info);
 
 gboolean gst_omx_video_is_equal_framerate_q16 (OMX_U32 q16_a, OMX_U32 q16_b);
 
+guint gst_omx_video_get_macroblocks_per_second (GstVideoInfo * info);
+
+gboolean gst_omx_video_reserve (GstElement * element, GstOMXComponent * comp,
+    const GstOMXClassData * cdata, GstVideoInfo * info);
+
 G_END_DECLS
 
 #endif /* __GST_OMX_VIDEO_H__ */
@@ -56,7 +56,12 @@ GST_DEBUG_CATEGORY_STATIC (gst_omx_video_dec_debug_category);
 #define GST_CAT_DEFAULT gst_omx_video_dec_debug_category
 
 /* prototypes */
+static void gst_omx_video_dec_constructed (GObject * object);
 static void gst_omx_video_dec_finalize (GObject * object);
+static void gst_omx_video_dec_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_omx_video_dec_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
 
 static GstStateChangeReturn
 gst_omx_video_dec_change_state (GstElement * element,
@@ -74,6 +79,8 @@ static GstFlowReturn gst_omx_video_dec_handle_frame (GstVideoDecoder * decoder,
 static GstFlowReturn gst_omx_video_dec_finish (GstVideoDecoder * decoder);
 static gboolean gst_omx_video_dec_decide_allocation (GstVideoDecoder * bdec,
     GstQuery * query);
+static gboolean gst_omx_video_dec_propose_allocation (GstVideoDecoder * bdec,
+    GstQuery * query);
 
 static GstFlowReturn gst_omx_video_dec_drain (GstVideoDecoder * decoder);
 
@@ -84,9 +91,29 @@ static OMX_ERRORTYPE gst_omx_video_dec_deallocate_output_buffers (GstOMXVideoDec
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_POST_STARTUP_TIMELINE,
+  PROP_MAX_OUTPUT_BUFFERS,
+  PROP_COPY_THREAD,
+  PROP_COPY_WORKERS,
+  PROP_FRAME_MEMORY,
+  PROP_STATS
 };
 
+#define GST_OMX_VIDEO_DEC_POST_STARTUP_TIMELINE_DEFAULT FALSE
+#define GST_OMX_VIDEO_DEC_MAX_OUTPUT_BUFFERS_DEFAULT 0
+#define GST_OMX_VIDEO_DEC_COPY_THREAD_DEFAULT FALSE
+#define GST_OMX_VIDEO_DEC_COPY_WORKERS_DEFAULT -1
+
+/* Output port usage is checked once per this many microseconds. More
+ * output buffers are wanted if the component had none for more than
+ * 1/GST_OMX_VIDEO_DEC_STARVED_FRACTION of the time */
+#define GST_OMX_VIDEO_DEC_USAGE_WINDOW G_USEC_PER_SEC
+#define GST_OMX_VIDEO_DEC_STARVED_FRACTION 10
+
+/* Maximum number of input buffers acquired at once for one frame */
+#define GST_OMX_VIDEO_DEC_MAX_INPUT_BATCH 16
+
 /* class initialization */
 
 #define DEBUG_INIT \
@@ -104,7 +131,61 @@ gst_omx_video_dec_class_init (GstOMXVideoDecClass * klass)
   GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
   GstVideoDecoderClass *video_decoder_class = GST_VIDEO_DECODER_CLASS (klass);
 
+  gobject_class->constructed = gst_omx_video_dec_constructed;
   gobject_class->finalize = gst_omx_video_dec_finalize;
+  gobject_class->set_property = gst_omx_video_dec_set_property;
+  gobject_class->get_property = gst_omx_video_dec_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_POST_STARTUP_TIMELINE,
+      g_param_spec_boolean ("post-startup-timeline", "Post startup timeline",
+          "Post an element message with the time spent in each startup "
+          "phase after the first decoded frame",
+          GST_OMX_VIDEO_DEC_POST_STARTUP_TIMELINE_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_OUTPUT_BUFFERS,
+      g_param_spec_uint ("max-output-buffers", "Max output buffers",
+          "Allocate more output buffers, up to this many, if downstream "
+          "holds them long enough for the component to stall. Applied when "
+          "the output port is reconfigured next (0 = fixed number)",
+          0, G_MAXUINT, GST_OMX_VIDEO_DEC_MAX_OUTPUT_BUFFERS_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_COPY_THREAD,
+      g_param_spec_boolean ("copy-thread", "Copy thread",
+          "If the output has to be copied because downstream can't handle "
+          "the component's strides, copy each frame on a helper thread "
+          "while the previous one is pushed downstream",
+          GST_OMX_VIDEO_DEC_COPY_THREAD_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_COPY_WORKERS,
+      g_param_spec_int ("copy-workers", "Copy workers",
+          "Number of threads helping to copy each frame if the output has "
+          "to be copied, shared with all other decoders "
+          "(-1 = online cores minus one, 0 = none)",
+          -1, 256, GST_OMX_VIDEO_DEC_COPY_WORKERS_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_FRAME_MEMORY,
+      g_param_spec_enum ("frame-memory", "Frame memory",
+          "Memory for the output frames allocated in system memory, e.g. "
+          "for OMX_UseBuffer() or copies. Defaults to the frame-memory key "
+          "of the configuration file", GST_TYPE_OMX_FRAME_MEMORY_MODE,
+          GST_OMX_FRAME_MEMORY_SYSTEM,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Number of output buffers, for how long the component had none "
+          "of them to fill and the statistics of the buffer pools",
+          GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
   element_class->change_state =
       GST_DEBUG_FUNCPTR (gst_omx_video_dec_change_state);
@@ -122,6 +203,8 @@ gst_omx_video_dec_class_init (GstOMXVideoDecClass * klass)
   video_decoder_class->drain = GST_DEBUG_FUNCPTR (gst_omx_video_dec_drain);
   video_decoder_class->decide_allocation =
       GST_DEBUG_FUNCPTR (gst_omx_video_dec_decide_allocation);
+  video_decoder_class->propose_allocation =
+      GST_DEBUG_FUNCPTR (gst_omx_video_dec_propose_allocation);
 
   klass->cdata.type = GST_OMX_COMPONENT_TYPE_FILTER;
   klass->cdata.default_src_template_caps =
@@ -138,6 +221,10 @@ static void
 gst_omx_video_dec_init (GstOMXVideoDec * self)
 {
   self->dmabuf = FALSE;
+  self->post_startup_timeline = GST_OMX_VIDEO_DEC_POST_STARTUP_TIMELINE_DEFAULT;
+  self->max_output_buffers = GST_OMX_VIDEO_DEC_MAX_OUTPUT_BUFFERS_DEFAULT;
+  self->copy_thread = GST_OMX_VIDEO_DEC_COPY_THREAD_DEFAULT;
+  self->copy_workers = GST_OMX_VIDEO_DEC_COPY_WORKERS_DEFAULT;
 
   gst_video_decoder_set_packetized (GST_VIDEO_DECODER (self), TRUE);
   gst_video_decoder_set_use_default_pad_acceptcaps (GST_VIDEO_DECODER_CAST
@@ -146,6 +233,14 @@ gst_omx_video_dec_init (GstOMXVideoDec * self)
 
   g_mutex_init (&self->drain_lock);
   g_cond_init (&self->drain_cond);
+
+  g_queue_init (&self->copy_jobs);
+  g_mutex_init (&self->copy_lock);
+  g_cond_init (&self->copy_cond);
+
+  gst_omx_state_changes_init (&self->state_changes);
+
+  self->frame_index = gst_omx_video_frame_index_new ();
 }
 
 static gboolean
@@ -157,11 +252,9 @@ gst_omx_video_dec_open (GstVideoDecoder * decoder)
 
   GST_DEBUG_OBJECT (self, "Opening decoder");
 
-  self->dec =
-      gst_omx_component_new (GST_OBJECT_CAST (self), klass->cdata.core_name,
-      klass->cdata.component_name, klass->cdata.component_role,
-      klass->cdata.hacks);
+  self->dec = gst_omx_component_acquire (GST_OBJECT_CAST (self), &klass->cdata);
   self->started = FALSE;
+  self->startup_timeline_posted = FALSE;
 
   if (!self->dec)
     return FALSE;
@@ -174,25 +267,11 @@ gst_omx_video_dec_open (GstVideoDecoder * decoder)
   out_port_index = klass->cdata.out_port_index;
 
   if (in_port_index == -1 || out_port_index == -1) {
-    OMX_PORT_PARAM_TYPE param;
-    OMX_ERRORTYPE err;
-
-    GST_OMX_INIT_STRUCT (&param);
-
-    err =
-        gst_omx_component_get_parameter (self->dec, OMX_IndexParamVideoInit,
-        &param);
-    if (err != OMX_ErrorNone) {
-      GST_WARNING_OBJECT (self, "Couldn't get port information: %s (0x%08x)",
-          gst_omx_error_to_string (err), err);
+    if (!gst_omx_component_detect_port_indices (self->dec,
+            OMX_IndexParamVideoInit, &in_port_index, &out_port_index)) {
       /* Fallback */
       in_port_index = 0;
       out_port_index = 1;
-    } else {
-      GST_DEBUG_OBJECT (self, "Detected %u ports, starting at %u",
-          (guint) param.nPorts, (guint) param.nStartPortNumber);
-      in_port_index = param.nStartPortNumber + 0;
-      out_port_index = param.nStartPortNumber + 1;
     }
   }
   self->dec_in_port = gst_omx_component_add_port (self->dec, in_port_index);
@@ -276,6 +355,45 @@ gst_omx_video_dec_open (GstVideoDecoder * decoder)
   return TRUE;
 }
 
+/* The pools are read by the "stats" property, so they are only replaced
+ * with the object lock. Takes ownership of new_pool */
+static void
+gst_omx_video_dec_replace_pool (GstOMXVideoDec * self, GstBufferPool ** pool,
+    GstBufferPool * new_pool)
+{
+  GstBufferPool *old_pool;
+
+  GST_OBJECT_LOCK (self);
+  old_pool = *pool;
+  *pool = new_pool;
+  GST_OBJECT_UNLOCK (self);
+
+  if (old_pool)
+    gst_object_unref (old_pool);
+}
+
+/* Buffers of the input pool wrap the memory of the OMX buffers, so they
+ * are only deallocated after upstream released all of them */
+static OMX_ERRORTYPE
+gst_omx_video_dec_deallocate_in_buffers (GstOMXVideoDec * self)
+{
+  if (self->in_port_pool) {
+    GST_OMX_BUFFER_POOL (self->in_port_pool)->deactivated = TRUE;
+    gst_buffer_pool_set_active (self->in_port_pool, FALSE);
+
+    if (!gst_omx_buffer_pool_wait_stopped (GST_OMX_BUFFER_POOL
+            (self->in_port_pool), 5 * GST_SECOND)) {
+      GST_ERROR_OBJECT (self, "Upstream still holds buffers of the input "
+          "pool, not deallocating them");
+      return OMX_ErrorTimeout;
+    }
+
+    gst_omx_video_dec_replace_pool (self, &self->in_port_pool, NULL);
+  }
+
+  return gst_omx_port_deallocate_buffers (self->dec_in_port);
+}
+
 static gboolean
 gst_omx_video_dec_shutdown (GstOMXVideoDec * self)
 {
@@ -283,6 +401,9 @@ gst_omx_video_dec_shutdown (GstOMXVideoDec * self)
 
   GST_DEBUG_OBJECT (self, "Shutting down decoder");
 
+  /* Let the state changes started in stop() finish */
+  gst_omx_state_changes_wait (&self->state_changes, 5 * GST_SECOND);
+
 #if defined (USE_OMX_TARGET_RPI) && defined (HAVE_GST_GL)
   state = gst_omx_component_get_state (self->egl_render, 0);
   if (state > OMX_StateLoaded || state == OMX_StateInvalid) {
@@ -295,7 +416,7 @@ gst_omx_video_dec_shutdown (GstOMXVideoDec * self)
     gst_omx_component_set_state (self->egl_render, OMX_StateLoaded);
     gst_omx_component_set_state (self->dec, OMX_StateLoaded);
 
-    gst_omx_port_deallocate_buffers (self->dec_in_port);
+    gst_omx_video_dec_deallocate_in_buffers (self);
     gst_omx_video_dec_deallocate_output_buffers (self);
     gst_omx_close_tunnel (self->dec_out_port, self->egl_in_port);
     if (state > OMX_StateLoaded) {
@@ -315,7 +436,7 @@ gst_omx_video_dec_shutdown (GstOMXVideoDec * self)
       gst_omx_component_get_state (self->dec, 5 * GST_SECOND);
     }
     gst_omx_component_set_state (self->dec, OMX_StateLoaded);
-    gst_omx_port_deallocate_buffers (self->dec_in_port);
+    gst_omx_video_dec_deallocate_in_buffers (self);
     gst_omx_video_dec_deallocate_output_buffers (self);
     if (state > OMX_StateLoaded)
       gst_omx_component_get_state (self->dec, 5 * GST_SECOND);
@@ -337,7 +458,7 @@ gst_omx_video_dec_close (GstVideoDecoder * decoder)
   self->dec_in_port = NULL;
   self->dec_out_port = NULL;
   if (self->dec)
-    gst_omx_component_free (self->dec);
+    gst_omx_component_release (self->dec);
   self->dec = NULL;
 
 #if defined (USE_OMX_TARGET_RPI) && defined (HAVE_GST_GL)
@@ -355,6 +476,17 @@ gst_omx_video_dec_close (GstVideoDecoder * decoder)
   return TRUE;
 }
 
+static void
+gst_omx_video_dec_constructed (GObject * object)
+{
+  GstOMXVideoDec *self = GST_OMX_VIDEO_DEC (object);
+
+  G_OBJECT_CLASS (gst_omx_video_dec_parent_class)->constructed (object);
+
+  /* The class data of the subclass is not available in instance init */
+  self->frame_memory = GST_OMX_VIDEO_DEC_GET_CLASS (self)->cdata.frame_memory;
+}
+
 static void
 gst_omx_video_dec_finalize (GObject * object)
 {
@@ -363,9 +495,101 @@ gst_omx_video_dec_finalize (GObject * object)
   g_mutex_clear (&self->drain_lock);
   g_cond_clear (&self->drain_cond);
 
+  g_mutex_clear (&self->copy_lock);
+  g_cond_clear (&self->copy_cond);
+
+  gst_omx_state_changes_clear (&self->state_changes);
+
+  gst_omx_video_frame_index_free (self->frame_index);
+
   G_OBJECT_CLASS (gst_omx_video_dec_parent_class)->finalize (object);
 }
 
+static void
+gst_omx_video_dec_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstOMXVideoDec *self = GST_OMX_VIDEO_DEC (object);
+
+  switch (prop_id) {
+    case PROP_POST_STARTUP_TIMELINE:
+      self->post_startup_timeline = g_value_get_boolean (value);
+      break;
+    case PROP_MAX_OUTPUT_BUFFERS:
+      self->max_output_buffers = g_value_get_uint (value);
+      break;
+    case PROP_COPY_THREAD:
+      self->copy_thread = g_value_get_boolean (value);
+      break;
+    case PROP_COPY_WORKERS:
+      self->copy_workers = g_value_get_int (value);
+      break;
+    case PROP_FRAME_MEMORY:
+      self->frame_memory = g_value_get_enum (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_omx_video_dec_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstOMXVideoDec *self = GST_OMX_VIDEO_DEC (object);
+
+  switch (prop_id) {
+    case PROP_POST_STARTUP_TIMELINE:
+      g_value_set_boolean (value, self->post_startup_timeline);
+      break;
+    case PROP_MAX_OUTPUT_BUFFERS:
+      g_value_set_uint (value, self->max_output_buffers);
+      break;
+    case PROP_COPY_THREAD:
+      g_value_set_boolean (value, self->copy_thread);
+      break;
+    case PROP_COPY_WORKERS:
+      g_value_set_int (value, self->copy_workers);
+      break;
+    case PROP_FRAME_MEMORY:
+      g_value_set_enum (value, self->frame_memory);
+      break;
+    case PROP_STATS:{
+      GstStructure *s, *pool_stats;
+
+      GST_OBJECT_LOCK (self);
+      s = gst_structure_new ("omx-video-dec-stats",
+          "output-buffers", G_TYPE_UINT, self->output_buffers,
+          "output-starved-time", G_TYPE_UINT64, self->output_starved_time,
+          NULL);
+      if (self->in_port_pool) {
+        pool_stats =
+            gst_omx_buffer_pool_get_stats (GST_OMX_BUFFER_POOL
+            (self->in_port_pool));
+        gst_structure_set (s, "input-pool", GST_TYPE_STRUCTURE, pool_stats,
+            NULL);
+        gst_structure_free (pool_stats);
+      }
+      if (self->out_port_pool) {
+        pool_stats =
+            gst_omx_buffer_pool_get_stats (GST_OMX_BUFFER_POOL
+            (self->out_port_pool));
+        gst_structure_set (s, "output-pool", GST_TYPE_STRUCTURE, pool_stats,
+            NULL);
+        gst_structure_free (pool_stats);
+      }
+      GST_OBJECT_UNLOCK (self);
+
+      g_value_take_boxed (value, s);
+      break;
+    }
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
 static GstStateChangeReturn
 gst_omx_video_dec_change_state (GstElement * element, GstStateChange transition)
 {
@@ -384,6 +608,7 @@ gst_omx_video_dec_change_state (GstElement * element, GstStateChange transition)
       self->draining = FALSE;
       self->started = FALSE;
       self->use_buffers = FALSE;
+      self->video_meta = FALSE;
       break;
     case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
       break;
@@ -434,6 +659,29 @@ gst_omx_video_dec_change_state (GstElement * element, GstStateChange transition)
   return ret;
 }
 
+/* Returns the threads helping with copies, NULL if the calling thread
+ * copies on its own
+ *
+ * NOTE: Must be called from the srcpad task */
+static GstOMXCopyPool *
+gst_omx_video_dec_get_copy_pool (GstOMXVideoDec * self)
+{
+  gint n_threads = self->copy_workers;
+
+  if (self->copy_pool)
+    return self->copy_pool;
+
+  if (n_threads < 0)
+    n_threads = g_get_num_processors () - 1;
+  if (n_threads <= 0)
+    return NULL;
+
+  GST_DEBUG_OBJECT (self, "Copying with %d helper threads", n_threads);
+  self->copy_pool = gst_omx_copy_pool_new (n_threads);
+
+  return self->copy_pool;
+}
+
 static gboolean
 gst_omx_video_dec_fill_buffer (GstOMXVideoDec * self,
     GstOMXBuffer * inbuf, GstBuffer * outbuf)
@@ -442,7 +690,7 @@ gst_omx_video_dec_fill_buffer (GstOMXVideoDec * self,
       gst_video_decoder_get_output_state (GST_VIDEO_DECODER (self));
   GstVideoInfo *vinfo = &state->info;
   OMX_PARAM_PORTDEFINITIONTYPE *port_def = &self->dec_out_port->port_def;
-  gboolean ret = FALSE;
+  gboolean ret = FALSE, streaming;
   GstVideoFrame frame;
 
   if (vinfo->width != port_def->format.video.nFrameWidth ||
@@ -454,6 +702,10 @@ gst_omx_video_dec_fill_buffer (GstOMXVideoDec * self,
     goto done;
   }
 
+  /* Frames that don't fit into the cache would only evict everything
+   * else from it */
+  streaming = gst_omx_copy_use_streaming (gst_buffer_get_size (outbuf));
+
   /* Same strides and everything */
   if (gst_buffer_get_size (outbuf) == inbuf->omx_buf->nFilledLen) {
     GstMapInfo map = GST_MAP_INFO_INIT;
@@ -463,9 +715,9 @@ gst_omx_video_dec_fill_buffer (GstOMXVideoDec * self,
       goto done;
     }
 
-    memcpy (map.data,
+    gst_omx_copy_memory (gst_omx_video_dec_get_copy_pool (self), map.data,
         inbuf->omx_buf->pBuffer + inbuf->omx_buf->nOffset,
-        inbuf->omx_buf->nFilledLen);
+        inbuf->omx_buf->nFilledLen, streaming);
     gst_buffer_unmap (outbuf, &map);
     ret = TRUE;
     goto done;
@@ -474,12 +726,14 @@ gst_omx_video_dec_fill_buffer (GstOMXVideoDec * self,
   /* Different strides */
   if (gst_video_frame_map (&frame, vinfo, outbuf, GST_MAP_WRITE)) {
     const guint nstride = port_def->format.video.nStride;
-    const guint nslice = port_def->format.video.nSliceHeight;
+    const guint nslice = port_def->format.video.nSliceHeight ?
+        port_def->format.video.nSliceHeight : GST_VIDEO_INFO_HEIGHT (vinfo);
     guint src_stride[GST_VIDEO_MAX_PLANES] = { nstride, 0, };
     guint src_size[GST_VIDEO_MAX_PLANES] = { nstride * nslice, 0, };
     gint dst_width[GST_VIDEO_MAX_PLANES] = { 0, };
     gint dst_height[GST_VIDEO_MAX_PLANES] =
         { GST_VIDEO_INFO_HEIGHT (vinfo), 0, };
+    GstOMXCopyPlane planes[GST_VIDEO_MAX_PLANES];
     const guint8 *src;
     guint p;
 
@@ -488,6 +742,9 @@ gst_omx_video_dec_fill_buffer (GstOMXVideoDec * self,
       case GST_VIDEO_FORMAT_ARGB:
         dst_width[0] = GST_VIDEO_INFO_WIDTH (vinfo) * 4;
         break;
+      case GST_VIDEO_FORMAT_BGR:
+        dst_width[0] = GST_VIDEO_INFO_WIDTH (vinfo) * 3;
+        break;
       case GST_VIDEO_FORMAT_RGB16:
       case GST_VIDEO_FORMAT_BGR16:
       case GST_VIDEO_FORMAT_YUY2:
@@ -530,20 +787,18 @@ gst_omx_video_dec_fill_buffer (GstOMXVideoDec * self,
 
     src = inbuf->omx_buf->pBuffer + inbuf->omx_buf->nOffset;
     for (p = 0; p < GST_VIDEO_INFO_N_PLANES (vinfo); p++) {
-      const guint8 *data;
-      guint8 *dst;
-      guint h;
-
-      dst = GST_VIDEO_FRAME_PLANE_DATA (&frame, p);
-      data = src;
-      for (h = 0; h < dst_height[p]; h++) {
-        memcpy (dst, data, dst_width[p]);
-        dst += GST_VIDEO_FRAME_PLANE_STRIDE (&frame, p);
-        data += src_stride[p];
-      }
+      planes[p].dest = GST_VIDEO_FRAME_PLANE_DATA (&frame, p);
+      planes[p].dest_stride = GST_VIDEO_FRAME_PLANE_STRIDE (&frame, p);
+      planes[p].src = src;
+      planes[p].src_stride = src_stride[p];
+      planes[p].width = dst_width[p];
+      planes[p].height = dst_height[p];
       src += src_size[p];
     }
 
+    gst_omx_copy_planes (gst_omx_video_dec_get_copy_pool (self), planes,
+        GST_VIDEO_INFO_N_PLANES (vinfo), streaming);
+
     gst_video_frame_unmap (&frame);
     ret = TRUE;
   } else {
@@ -604,10 +859,21 @@ gst_omx_video_dec_allocate_output_buffers (GstOMXVideoDec * self)
       goto done;
     }
 
+    add_videometa = self->video_meta
+        || gst_buffer_pool_config_has_option (config,
+        GST_BUFFER_POOL_OPTION_VIDEO_META);
+
     /* Need at least 4 buffers for anything meaningful */
     min = MAX (min + port->port_def.nBufferCountMin, 4);
     if (max == 0) {
       max = min;
+    } else if (max < min && add_videometa) {
+      /* Can't use downstream's buffers, but ours can be pushed with
+       * whatever layout the port has */
+      GST_DEBUG_OBJECT (self, "Using our own %u buffers instead of at most "
+          "%u of downstream", min, max);
+      self->use_buffers = FALSE;
+      max = min;
     } else if (max < min) {
       /* Can't use pool because can't have enough buffers */
       gst_caps_replace (&caps, NULL);
@@ -615,8 +881,6 @@ gst_omx_video_dec_allocate_output_buffers (GstOMXVideoDec * self)
       min = max;
     }
 
-    add_videometa = gst_buffer_pool_config_has_option (config,
-        GST_BUFFER_POOL_OPTION_VIDEO_META);
     gst_structure_free (config);
 
 #if defined (HAVE_GST_GL)
@@ -636,6 +900,15 @@ gst_omx_video_dec_allocate_output_buffers (GstOMXVideoDec * self)
     GST_DEBUG_OBJECT (self, "No pool available, not negotiated yet");
   }
 
+  /* Downstream pools only provide as many buffers as they were
+   * configured for */
+  self->min_output_buffers = min;
+  if (self->wanted_output_buffers > min && !self->use_buffers && !eglimage) {
+    GST_DEBUG_OBJECT (self, "Using %u instead of %u buffers after stalls",
+        self->wanted_output_buffers, min);
+    min = max = self->wanted_output_buffers;
+  }
+
 #if defined (HAVE_GST_GL)
   /* Will retry without EGLImage */
   if (self->eglimage && !eglimage) {
@@ -647,9 +920,9 @@ gst_omx_video_dec_allocate_output_buffers (GstOMXVideoDec * self)
 #endif
 
   if (caps)
-    self->out_port_pool =
+    gst_omx_video_dec_replace_pool (self, &self->out_port_pool,
         gst_omx_buffer_pool_new (GST_ELEMENT_CAST (self), self->dec, port,
-        self->dmabuf);
+            self->dmabuf));
 
 #if defined (HAVE_GST_GL)
   if (eglimage) {
@@ -996,8 +1269,7 @@ gst_omx_video_dec_allocate_output_buffers (GstOMXVideoDec * self)
 
     if (!gst_buffer_pool_set_config (self->out_port_pool, config)) {
       GST_INFO_OBJECT (self, "Failed to set config on internal pool");
-      gst_object_unref (self->out_port_pool);
-      self->out_port_pool = NULL;
+      gst_omx_video_dec_replace_pool (self, &self->out_port_pool, NULL);
       goto done;
     }
 
@@ -1005,14 +1277,12 @@ gst_omx_video_dec_allocate_output_buffers (GstOMXVideoDec * self)
     /* This now allocates all the buffers */
     if (!gst_buffer_pool_set_active (self->out_port_pool, TRUE)) {
       GST_INFO_OBJECT (self, "Failed to activate internal pool");
-      gst_object_unref (self->out_port_pool);
-      self->out_port_pool = NULL;
+      gst_omx_video_dec_replace_pool (self, &self->out_port_pool, NULL);
     } else {
       GST_OMX_BUFFER_POOL (self->out_port_pool)->allocating = FALSE;
     }
   } else if (self->out_port_pool) {
-    gst_object_unref (self->out_port_pool);
-    self->out_port_pool = NULL;
+    gst_omx_video_dec_replace_pool (self, &self->out_port_pool, NULL);
   }
 
 done:
@@ -1020,6 +1290,12 @@ done:
     GST_DEBUG_OBJECT (self,
         "Not using our internal pool and copying buffers for downstream");
 
+  if (err == OMX_ErrorNone) {
+    GST_OBJECT_LOCK (self);
+    self->output_buffers = port->port_def.nBufferCountActual;
+    GST_OBJECT_UNLOCK (self);
+  }
+
   if (caps)
     gst_caps_unref (caps);
   if (pool)
@@ -1041,8 +1317,7 @@ gst_omx_video_dec_deallocate_output_buffers (GstOMXVideoDec * self)
     gst_buffer_pool_wait_released (self->out_port_pool);
 #endif
     GST_OMX_BUFFER_POOL (self->out_port_pool)->deactivated = TRUE;
-    gst_object_unref (self->out_port_pool);
-    self->out_port_pool = NULL;
+    gst_omx_video_dec_replace_pool (self, &self->out_port_pool, NULL);
   }
 #if defined (USE_OMX_TARGET_RPI) && defined (HAVE_GST_GL)
   err =
@@ -1188,10 +1463,7 @@ gst_omx_video_dec_reconfigure_output_port (GstOMXVideoDec * self)
               OMX_StateExecuting) != OMX_ErrorNone)
         goto no_egl;
 
-      if (gst_omx_component_get_state (self->egl_render,
-              GST_CLOCK_TIME_NONE) != OMX_StateExecuting)
-        goto no_egl;
-
+      /* Prepare the ports while egl_render goes to Executing */
       err =
           gst_omx_port_set_flushing (self->dec_out_port, 5 * GST_SECOND, FALSE);
       if (err != OMX_ErrorNone)
@@ -1207,6 +1479,10 @@ gst_omx_video_dec_reconfigure_output_port (GstOMXVideoDec * self)
       if (err != OMX_ErrorNone)
         goto no_egl;
 
+      if (gst_omx_component_get_state (self->egl_render,
+              GST_CLOCK_TIME_NONE) != OMX_StateExecuting)
+        goto no_egl;
+
       err = gst_omx_port_populate (self->egl_out_port);
       if (err != OMX_ErrorNone)
         goto no_egl;
@@ -1339,73 +1615,357 @@ done:
 
 static void
 gst_omx_video_dec_clean_older_frames (GstOMXVideoDec * self,
-    GstOMXBuffer * buf, GList * frames)
+    GstOMXBuffer * buf)
 {
-  GList *l;
+  GstVideoCodecFrame *tmp;
   GstClockTime timestamp;
 
   timestamp =
       gst_util_uint64_scale (GST_OMX_GET_TICKS (buf->omx_buf->nTimeStamp),
       GST_SECOND, OMX_TICKS_PER_SECOND);
 
-  if (GST_CLOCK_TIME_IS_VALID (timestamp)) {
-    /* We could release all frames stored with pts < timestamp since the
-     * decoder will likely output frames in display order */
-    for (l = frames; l; l = l->next) {
-      GstVideoCodecFrame *tmp = l->data;
+  /* With a valid timestamp we could release all frames stored with
+   * pts < timestamp since the decoder will likely output frames in display
+   * order. Otherwise we will release all frames with invalid timestamp
+   * because we don't even know if they will be output some day. */
+  while ((tmp = gst_omx_video_frame_index_pop_older (self->frame_index,
+              timestamp))) {
+    GST_LOG_OBJECT (self,
+        "discarding %s frame %p (#%d) PTS:%" GST_TIME_FORMAT " DTS:%"
+        GST_TIME_FORMAT, GST_CLOCK_TIME_IS_VALID (timestamp) ? "ghost" :
+        "untimed", tmp, tmp->system_frame_number, GST_TIME_ARGS (tmp->pts),
+        GST_TIME_ARGS (tmp->dts));
+    gst_video_decoder_release_frame (GST_VIDEO_DECODER (self), tmp);
+  }
+}
+
+typedef struct
+{
+  GstVideoInfo info;
+  GstOMXCopyPool *pool;
+  GstVideoCodecFrame *frame;
+  /* Buffer of the output port pool, frame->output_buffer is the copy */
+  GstBuffer *inbuf;
+  /* Protected by copy_lock */
+  gboolean done;
+  gboolean copied;
+} GstOMXVideoDecCopyJob;
+
+/* Copies inbuf, laid out as described by its video meta, into outbuf which
+ * has the default layout of info, with the help of the threads of pool if
+ * not NULL */
+static gboolean
+copy_frame (GstOMXCopyPool * pool, const GstVideoInfo * info,
+    GstBuffer * inbuf, GstBuffer * outbuf)
+{
+  GstVideoFrame in_frame, out_frame;
+  GstOMXCopyPlane planes[GST_VIDEO_MAX_PLANES];
+  gboolean ret = TRUE;
+  guint p, c;
 
-      if (tmp->pts < timestamp) {
-        GST_LOG_OBJECT (self,
-            "discarding ghost frame %p (#%d) PTS:%" GST_TIME_FORMAT " DTS:%"
-            GST_TIME_FORMAT, tmp, tmp->system_frame_number,
-            GST_TIME_ARGS (tmp->pts), GST_TIME_ARGS (tmp->dts));
-        gst_video_decoder_release_frame (GST_VIDEO_DECODER (self), tmp);
-      } else {
-        gst_video_codec_frame_unref (tmp);
-      }
+  if (!gst_video_frame_map (&in_frame, info, inbuf, GST_MAP_READ))
+    return FALSE;
+
+  if (!gst_video_frame_map (&out_frame, info, outbuf, GST_MAP_WRITE)) {
+    gst_video_frame_unmap (&in_frame);
+    return FALSE;
+  }
+
+  for (p = 0; p < GST_VIDEO_FRAME_N_PLANES (&in_frame); p++) {
+    /* The first component of the plane gives the size of its lines */
+    for (c = 0; c < GST_VIDEO_FRAME_N_COMPONENTS (&in_frame); c++)
+      if (GST_VIDEO_FRAME_COMP_PLANE (&in_frame, c) == p)
+        break;
+
+    /* Tiles and packed components can't be copied as lines of bytes */
+    if (GST_VIDEO_FORMAT_INFO_IS_TILED (in_frame.info.finfo)
+        || c == GST_VIDEO_FRAME_N_COMPONENTS (&in_frame)
+        || GST_VIDEO_FRAME_COMP_PSTRIDE (&in_frame, c) == 0) {
+      ret = gst_video_frame_copy (&out_frame, &in_frame);
+      goto done;
     }
-  } else {
-    /* We will release all frames with invalid timestamp because we don't even
-     * know if they will be output some day. */
-    for (l = frames; l; l = l->next) {
-      GstVideoCodecFrame *tmp = l->data;
 
-      if (!GST_CLOCK_TIME_IS_VALID (tmp->pts)) {
-        GST_LOG_OBJECT (self,
-            "discarding frame %p (#%d) with invalid PTS:%" GST_TIME_FORMAT
-            " DTS:%" GST_TIME_FORMAT, tmp, tmp->system_frame_number,
-            GST_TIME_ARGS (tmp->pts), GST_TIME_ARGS (tmp->dts));
-        gst_video_decoder_release_frame (GST_VIDEO_DECODER (self), tmp);
-      } else {
-        gst_video_codec_frame_unref (tmp);
-      }
+    planes[p].dest = GST_VIDEO_FRAME_PLANE_DATA (&out_frame, p);
+    planes[p].dest_stride = GST_VIDEO_FRAME_PLANE_STRIDE (&out_frame, p);
+    planes[p].src = GST_VIDEO_FRAME_PLANE_DATA (&in_frame, p);
+    planes[p].src_stride = GST_VIDEO_FRAME_PLANE_STRIDE (&in_frame, p);
+    planes[p].width = GST_VIDEO_FRAME_COMP_WIDTH (&in_frame, c) *
+        GST_VIDEO_FRAME_COMP_PSTRIDE (&in_frame, c);
+    planes[p].height = GST_VIDEO_FRAME_COMP_HEIGHT (&in_frame, c);
+  }
+
+  gst_omx_copy_planes (pool, planes, GST_VIDEO_FRAME_N_PLANES (&in_frame),
+      gst_omx_copy_use_streaming (GST_VIDEO_INFO_SIZE (info)));
+
+done:
+  gst_video_frame_unmap (&out_frame);
+  gst_video_frame_unmap (&in_frame);
+
+  return ret;
+}
+
+/* Runs in copy_threads, or in the srcpad task without a copy thread */
+static void
+gst_omx_video_dec_run_copy_job (GstOMXVideoDecCopyJob * job,
+    GstOMXVideoDec * self)
+{
+  gboolean copied;
+
+  copied = copy_frame (job->pool, &job->info, job->inbuf,
+      job->frame->output_buffer);
+
+  /* Give the buffer back to the component right away */
+  gst_buffer_unref (job->inbuf);
+  job->inbuf = NULL;
+
+  g_mutex_lock (&self->copy_lock);
+  job->copied = copied;
+  job->done = TRUE;
+  g_cond_broadcast (&self->copy_cond);
+  g_mutex_unlock (&self->copy_lock);
+}
+
+static void
+gst_omx_video_dec_wait_copy_job (GstOMXVideoDec * self,
+    GstOMXVideoDecCopyJob * job)
+{
+  g_mutex_lock (&self->copy_lock);
+  while (!job->done)
+    g_cond_wait (&self->copy_cond, &self->copy_lock);
+  g_mutex_unlock (&self->copy_lock);
+}
+
+/* Finishes the oldest copied frames until at most max_pending copies are
+ * left, returns the first flow return that is not OK
+ *
+ * NOTE: Must be called with the stream lock */
+static GstFlowReturn
+gst_omx_video_dec_finish_copies (GstOMXVideoDec * self, guint max_pending)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  while (g_queue_get_length (&self->copy_jobs) > max_pending) {
+    GstOMXVideoDecCopyJob *job = g_queue_pop_head (&self->copy_jobs);
+    GstFlowReturn flow_ret;
+
+    gst_omx_video_dec_wait_copy_job (self, job);
+
+    if (job->copied) {
+      flow_ret =
+          gst_video_decoder_finish_frame (GST_VIDEO_DECODER (self), job->frame);
+    } else {
+      GST_ERROR_OBJECT (self, "Failed to copy frame");
+      gst_buffer_replace (&job->frame->output_buffer, NULL);
+      gst_video_decoder_drop_frame (GST_VIDEO_DECODER (self), job->frame);
+      flow_ret = GST_FLOW_ERROR;
     }
+
+    if (ret == GST_FLOW_OK)
+      ret = flow_ret;
+
+    g_slice_free (GstOMXVideoDecCopyJob, job);
   }
 
-  g_list_free (frames);
+  return ret;
 }
 
-static GstBuffer *
-copy_frame (const GstVideoInfo * info, GstBuffer * outbuf)
+/* Drops the frames still being copied, e.g. when flushing */
+static void
+gst_omx_video_dec_discard_copies (GstOMXVideoDec * self)
 {
-  GstVideoInfo out_info, tmp_info;
-  GstBuffer *tmpbuf;
-  GstVideoFrame out_frame, tmp_frame;
+  GstOMXVideoDecCopyJob *job;
 
-  out_info = *info;
-  tmp_info = *info;
+  while ((job = g_queue_pop_head (&self->copy_jobs))) {
+    gst_omx_video_dec_wait_copy_job (self, job);
+    gst_video_codec_frame_unref (job->frame);
+    g_slice_free (GstOMXVideoDecCopyJob, job);
+  }
+}
 
-  tmpbuf = gst_buffer_new_and_alloc (out_info.size);
+/* Finishes frame with a copy of inbuf, a buffer of the output port pool
+ * that downstream can't handle, in a buffer of the negotiated pool. With
+ * a copy thread the frame is only finished after the next one, so that
+ * copying one frame overlaps with pushing the previous one.
+ *
+ * NOTE: Must be called with the stream lock */
+static GstFlowReturn
+gst_omx_video_dec_copy_output_frame (GstOMXVideoDec * self,
+    GstVideoCodecFrame * frame, GstBuffer * inbuf)
+{
+  GstOMXVideoDecCopyJob *job;
+  GstFlowReturn flow_ret;
 
-  gst_video_frame_map (&out_frame, &out_info, outbuf, GST_MAP_READ);
-  gst_video_frame_map (&tmp_frame, &tmp_info, tmpbuf, GST_MAP_WRITE);
-  gst_video_frame_copy (&tmp_frame, &out_frame);
-  gst_video_frame_unmap (&out_frame);
-  gst_video_frame_unmap (&tmp_frame);
+  flow_ret =
+      gst_video_decoder_allocate_output_frame (GST_VIDEO_DECODER (self), frame);
+  if (flow_ret != GST_FLOW_OK) {
+    gst_buffer_unref (inbuf);
+    gst_video_decoder_drop_frame (GST_VIDEO_DECODER (self), frame);
+    return flow_ret;
+  }
+
+  gst_omx_buffer_pool_add_copy (GST_OMX_BUFFER_POOL (self->out_port_pool));
 
-  gst_buffer_unref (outbuf);
+  job = g_slice_new0 (GstOMXVideoDecCopyJob);
+  job->info = GST_OMX_BUFFER_POOL (self->out_port_pool)->video_info;
+  job->pool = gst_omx_video_dec_get_copy_pool (self);
+  job->frame = frame;
+  job->inbuf = inbuf;
+  g_queue_push_tail (&self->copy_jobs, job);
 
-  return tmpbuf;
+  if (!self->copy_threads) {
+    gst_omx_video_dec_run_copy_job (job, self);
+    return gst_omx_video_dec_finish_copies (self, 0);
+  }
+
+  g_thread_pool_push (self->copy_threads, job, NULL);
+
+  return gst_omx_video_dec_finish_copies (self, 1);
+}
+
+/* Posts the phases from opening the decoder until the first frame was
+ * decoded, once per component */
+static void
+gst_omx_video_dec_post_startup_timeline (GstOMXVideoDec * self,
+    GstOMXComponent * comp)
+{
+  GstStructure *s;
+
+  if (!(s = gst_omx_component_take_timeline (comp)))
+    return;
+
+  GST_DEBUG_OBJECT (self, "Startup timeline: %" GST_PTR_FORMAT, s);
+  gst_element_post_message (GST_ELEMENT_CAST (self),
+      gst_message_new_element (GST_OBJECT_CAST (self), s));
+  self->startup_timeline_posted = TRUE;
+}
+
+/* Checks once per usage window how long the component had no output
+ * buffer to fill because all of them were waiting for us or downstream.
+ * With max-output-buffers set, more buffers are wanted after stalls and
+ * fewer if the component always had some to spare. The new number is
+ * only used when the output port is reconfigured next. */
+static void
+gst_omx_video_dec_update_output_usage (GstOMXVideoDec * self,
+    GstOMXPort * port)
+{
+  gint64 now, elapsed, starved;
+  guint min_used, n, wanted;
+
+  now = g_get_monotonic_time ();
+  if (self->usage_window_start == 0) {
+    gst_omx_port_take_usage (port, NULL, NULL);
+    self->usage_window_start = now;
+    return;
+  }
+
+  elapsed = now - self->usage_window_start;
+  if (elapsed < GST_OMX_VIDEO_DEC_USAGE_WINDOW)
+    return;
+
+  gst_omx_port_take_usage (port, &starved, &min_used);
+  self->usage_window_start = now;
+
+  GST_OBJECT_LOCK (self);
+  self->output_starved_time += starved * GST_USECOND;
+  n = self->output_buffers;
+  GST_OBJECT_UNLOCK (self);
+
+  if (self->max_output_buffers == 0 || n == 0)
+    return;
+
+  wanted = MAX (self->wanted_output_buffers, n);
+  if (starved * GST_OMX_VIDEO_DEC_STARVED_FRACTION > elapsed)
+    wanted = MIN (wanted + 1, MAX (self->max_output_buffers, n));
+  else if (starved == 0 && min_used > 1 && wanted == n
+      && n > self->min_output_buffers)
+    wanted = n - 1;
+
+  if (wanted != self->wanted_output_buffers) {
+    GST_DEBUG_OBJECT (self, "Starved for %" G_GINT64_FORMAT "us of %"
+        G_GINT64_FORMAT "us, at least %u of %u buffers queued, want %u "
+        "buffers", starved, elapsed, min_used, n, wanted);
+    self->wanted_output_buffers = wanted;
+  }
+}
+
+/* Components with the keeps-output-buffers hack continue to fill the
+ * buffers that are already allocated after new output settings, as long
+ * as they are still large enough. In that case only the caps are updated
+ * instead of disabling the port and reallocating all buffers.
+ *
+ * Returns TRUE if the port was reconfigured this way */
+static gboolean
+gst_omx_video_dec_reuse_output_buffers (GstOMXVideoDec * self,
+    GstOMXPort * port)
+{
+  GstVideoCodecState *state;
+  OMX_PARAM_PORTDEFINITIONTYPE port_def;
+  GstVideoFormat format;
+
+  if (!(self->dec->hacks & GST_OMX_HACK_KEEPS_OUTPUT_BUFFERS))
+    return FALSE;
+
+#if defined (HAVE_GST_GL)
+  if (self->eglimage)
+    return FALSE;
+#endif
+
+  /* Downstream buffers have the size of the old caps */
+  if (self->out_port_pool
+      && GST_OMX_BUFFER_POOL (self->out_port_pool)->other_pool)
+    return FALSE;
+
+  gst_omx_port_get_port_definition (port, &port_def);
+  format =
+      gst_omx_video_get_format_from_omx (port_def.format.video.eColorFormat);
+
+  state = gst_video_decoder_get_output_state (GST_VIDEO_DECODER (self));
+  if (!state)
+    return FALSE;
+  if (GST_VIDEO_INFO_FORMAT (&state->info) != format) {
+    gst_video_codec_state_unref (state);
+    return FALSE;
+  }
+  gst_video_codec_state_unref (state);
+
+  if (!gst_omx_port_buffers_fit (port))
+    return FALSE;
+
+  /* Take the chance to apply the adaptive number of buffers */
+  if (self->wanted_output_buffers
+      && self->wanted_output_buffers != port->buffers->len)
+    return FALSE;
+
+  GST_DEBUG_OBJECT (self,
+      "Keeping output buffers: format %s (%d), width %u, height %u",
+      gst_video_format_to_string (format),
+      port_def.format.video.eColorFormat,
+      (guint) port_def.format.video.nFrameWidth,
+      (guint) port_def.format.video.nFrameHeight);
+
+  GST_VIDEO_DECODER_STREAM_LOCK (self);
+
+  state = gst_video_decoder_set_output_state (GST_VIDEO_DECODER (self),
+      format, port_def.format.video.nFrameWidth,
+      port_def.format.video.nFrameHeight, self->input_state);
+  gst_video_codec_state_unref (state);
+
+  if (!gst_video_decoder_negotiate (GST_VIDEO_DECODER (self))) {
+    GST_VIDEO_DECODER_STREAM_UNLOCK (self);
+    GST_DEBUG_OBJECT (self, "Failed to negotiate, reallocating buffers");
+    return FALSE;
+  }
+
+  if (self->out_port_pool) {
+    state = gst_video_decoder_get_output_state (GST_VIDEO_DECODER (self));
+    gst_omx_buffer_pool_update_video_info (GST_OMX_BUFFER_POOL
+        (self->out_port_pool), state->caps, &state->info);
+    gst_video_codec_state_unref (state);
+  }
+
+  GST_VIDEO_DECODER_STREAM_UNLOCK (self);
+
+  return gst_omx_port_mark_reconfigured (port) == OMX_ErrorNone;
 }
 
 static void
@@ -1414,7 +1974,7 @@ gst_omx_video_dec_loop (GstOMXVideoDec * self)
   GstOMXPort *port;
   GstOMXBuffer *buf = NULL;
   GstVideoCodecFrame *frame;
-  GstFlowReturn flow_ret = GST_FLOW_OK;
+  GstFlowReturn flow_ret = GST_FLOW_OK, copy_ret = GST_FLOW_OK;
   GstOMXAcquireBufferReturn acq_return;
   GstClockTimeDiff deadline;
   OMX_ERRORTYPE err;
@@ -1425,6 +1985,18 @@ gst_omx_video_dec_loop (GstOMXVideoDec * self)
   port = self->dec_out_port;
 #endif
 
+  /* Don't hold back a copied frame while waiting for the component */
+  if (!g_queue_is_empty (&self->copy_jobs)
+      && !gst_omx_port_has_pending_buffers (port)) {
+    GST_VIDEO_DECODER_STREAM_LOCK (self);
+    flow_ret = gst_omx_video_dec_finish_copies (self, 0);
+    if (flow_ret != GST_FLOW_OK) {
+      self->downstream_flow_ret = flow_ret;
+      goto flow_error;
+    }
+    GST_VIDEO_DECODER_STREAM_UNLOCK (self);
+  }
+
   acq_return = gst_omx_port_acquire_buffer (port, &buf);
   if (acq_return == GST_OMX_ACQUIRE_BUFFER_ERROR) {
     goto component_error;
@@ -1434,6 +2006,12 @@ gst_omx_video_dec_loop (GstOMXVideoDec * self)
     goto eos;
   }
 
+  gst_omx_video_dec_update_output_usage (self, port);
+
+  if (G_UNLIKELY (self->post_startup_timeline
+          && !self->startup_timeline_posted))
+    gst_omx_video_dec_post_startup_timeline (self, port->comp);
+
   if (!gst_pad_has_current_caps (GST_VIDEO_DECODER_SRC_PAD (self)) ||
       acq_return == GST_OMX_ACQUIRE_BUFFER_RECONFIGURE) {
     GstVideoCodecState *state;
@@ -1442,6 +2020,23 @@ gst_omx_video_dec_loop (GstOMXVideoDec * self)
 
     GST_DEBUG_OBJECT (self, "Port settings have changed, updating caps");
 
+    if (!g_queue_is_empty (&self->copy_jobs)) {
+      GST_VIDEO_DECODER_STREAM_LOCK (self);
+      flow_ret = gst_omx_video_dec_finish_copies (self, 0);
+      if (flow_ret != GST_FLOW_OK) {
+        if (buf)
+          gst_omx_port_release_buffer (port, buf);
+        self->downstream_flow_ret = flow_ret;
+        goto flow_error;
+      }
+      GST_VIDEO_DECODER_STREAM_UNLOCK (self);
+    }
+
+    if (acq_return == GST_OMX_ACQUIRE_BUFFER_RECONFIGURE
+        && gst_omx_port_is_enabled (port)
+        && gst_omx_video_dec_reuse_output_buffers (self, port))
+      return;
+
     /* Reallocate all buffers */
     if (acq_return == GST_OMX_ACQUIRE_BUFFER_RECONFIGURE
         && gst_omx_port_is_enabled (port)) {
@@ -1537,8 +2132,9 @@ gst_omx_video_dec_loop (GstOMXVideoDec * self)
       (guint64) GST_OMX_GET_TICKS (buf->omx_buf->nTimeStamp));
 
   GST_VIDEO_DECODER_STREAM_LOCK (self);
-  frame = gst_omx_video_find_nearest_frame (buf,
-      gst_video_decoder_get_frames (GST_VIDEO_DECODER (self)));
+  /* All paths below finish or drop the frame */
+  frame = gst_omx_video_frame_index_find_nearest (self->frame_index, buf,
+      TRUE);
 
   /* So we have a timestamped OMX buffer and get, or not, corresponding frame.
    * Assuming decoder output frames in display order, frames preceding this
@@ -1546,8 +2142,14 @@ gst_omx_video_dec_loop (GstOMXVideoDec * self)
    * stream, corrupted input data...
    * In any cases, not likely to be seen again. so drop it before they pile up
    * and use all the memory. */
-  gst_omx_video_dec_clean_older_frames (self, buf,
-      gst_video_decoder_get_frames (GST_VIDEO_DECODER (self)));
+  gst_omx_video_dec_clean_older_frames (self, buf);
+
+  /* Frames still being copied are pushed first, unless this one is copied
+   * too and can be copied while they are pushed */
+  if (!frame || !self->out_port_pool
+      || !GST_OMX_BUFFER_POOL (self->out_port_pool)->need_copy
+      || (buf->omx_buf->nFilledLen == 0 && !buf->eglimage))
+    copy_ret = gst_omx_video_dec_finish_copies (self, 0);
 
   if (frame
       && (deadline = gst_video_decoder_get_max_decode_time
@@ -1589,12 +2191,28 @@ gst_omx_video_dec_loop (GstOMXVideoDec * self)
         goto invalid_buffer;
       }
 
-      if (GST_OMX_BUFFER_POOL (self->out_port_pool)->need_copy)
+      buf = NULL;
+
+      if (GST_OMX_BUFFER_POOL (self->out_port_pool)->need_copy) {
+        GstBuffer *inbuf = outbuf;
+        gboolean copied;
+
+        gst_omx_buffer_pool_add_copy (GST_OMX_BUFFER_POOL
+            (self->out_port_pool));
         outbuf =
-            copy_frame (&GST_OMX_BUFFER_POOL (self->out_port_pool)->video_info,
+            gst_video_decoder_allocate_output_buffer (GST_VIDEO_DECODER
+            (self));
+        copied = outbuf
+            && copy_frame (gst_omx_video_dec_get_copy_pool (self),
+            &GST_OMX_BUFFER_POOL (self->out_port_pool)->video_info, inbuf,
             outbuf);
-
-      buf = NULL;
+        gst_buffer_unref (inbuf);
+        if (!copied) {
+          if (outbuf)
+            gst_buffer_unref (outbuf);
+          goto invalid_buffer;
+        }
+      }
     } else {
       outbuf =
           gst_video_decoder_allocate_output_buffer (GST_VIDEO_DECODER (self));
@@ -1633,15 +2251,13 @@ gst_omx_video_dec_loop (GstOMXVideoDec * self)
         goto invalid_buffer;
       }
 
-      if (GST_OMX_BUFFER_POOL (self->out_port_pool)->need_copy)
-        outbuf =
-            copy_frame (&GST_OMX_BUFFER_POOL (self->out_port_pool)->video_info,
-            outbuf);
-
-      frame->output_buffer = outbuf;
-
-      flow_ret =
-          gst_video_decoder_finish_frame (GST_VIDEO_DECODER (self), frame);
+      if (GST_OMX_BUFFER_POOL (self->out_port_pool)->need_copy) {
+        flow_ret = gst_omx_video_dec_copy_output_frame (self, frame, outbuf);
+      } else {
+        frame->output_buffer = outbuf;
+        flow_ret =
+            gst_video_decoder_finish_frame (GST_VIDEO_DECODER (self), frame);
+      }
       frame = NULL;
       buf = NULL;
     } else {
@@ -1670,6 +2286,9 @@ gst_omx_video_dec_loop (GstOMXVideoDec * self)
     frame = NULL;
   }
 
+  if (flow_ret == GST_FLOW_OK)
+    flow_ret = copy_ret;
+
   GST_DEBUG_OBJECT (self, "Finished frame: %s", gst_flow_get_name (flow_ret));
 
   if (buf) {
@@ -1689,6 +2308,7 @@ gst_omx_video_dec_loop (GstOMXVideoDec * self)
 
 component_error:
   {
+    gst_omx_video_dec_discard_copies (self);
     GST_ELEMENT_ERROR (self, LIBRARY, FAILED, (NULL),
         ("OpenMAX component in error state %s (0x%08x)",
             gst_omx_component_get_last_error_string (self->dec),
@@ -1703,6 +2323,7 @@ component_error:
 flushing:
   {
     GST_DEBUG_OBJECT (self, "Flushing -- stopping task");
+    gst_omx_video_dec_discard_copies (self);
     g_mutex_lock (&self->drain_lock);
     if (self->draining) {
       self->draining = FALSE;
@@ -1751,6 +2372,8 @@ eos:
 
 flow_error:
   {
+    gst_omx_video_dec_discard_copies (self);
+
     if (flow_ret == GST_FLOW_EOS) {
       GST_DEBUG_OBJECT (self, "EOS");
 
@@ -1839,6 +2462,19 @@ gst_omx_video_dec_start (GstVideoDecoder * decoder)
   self->last_upstream_ts = 0;
   self->downstream_flow_ret = GST_FLOW_OK;
   self->use_buffers = FALSE;
+  self->share_input = TRUE;
+  self->wanted_output_buffers = 0;
+  self->min_output_buffers = 0;
+  self->usage_window_start = 0;
+
+  if (self->copy_thread)
+    self->copy_threads =
+        g_thread_pool_new ((GFunc) gst_omx_video_dec_run_copy_job, self, 1,
+        FALSE, NULL);
+
+  GST_OBJECT_LOCK (self);
+  self->output_starved_time = 0;
+  GST_OBJECT_UNLOCK (self);
 
   return TRUE;
 }
@@ -1862,11 +2498,27 @@ gst_omx_video_dec_stop (GstVideoDecoder * decoder)
 
   gst_pad_stop_task (GST_VIDEO_DECODER_SRC_PAD (decoder));
 
+  self->populate_pending = FALSE;
+  gst_omx_state_changes_wait (&self->state_changes, 5 * GST_SECOND);
+
+  gst_omx_video_frame_index_clear (self->frame_index);
+  gst_omx_video_dec_discard_copies (self);
+  if (self->copy_threads)
+    g_thread_pool_free (self->copy_threads, FALSE, TRUE);
+  self->copy_threads = NULL;
+  if (self->copy_pool)
+    gst_omx_copy_pool_free (self->copy_pool);
+  self->copy_pool = NULL;
+
+  /* Not waited for here, so that the components of all elements of the
+   * pipeline go to Idle at the same time. close() waits for them */
   if (gst_omx_component_get_state (self->dec, 0) > OMX_StateIdle)
-    gst_omx_component_set_state (self->dec, OMX_StateIdle);
+    gst_omx_state_changes_add (&self->state_changes, self->dec, OMX_StateIdle);
+  gst_omx_component_unreserve (self->dec);
 #if defined (USE_OMX_TARGET_RPI) && defined (HAVE_GST_GL)
   if (gst_omx_component_get_state (self->egl_render, 0) > OMX_StateIdle)
-    gst_omx_component_set_state (self->egl_render, OMX_StateIdle);
+    gst_omx_state_changes_add (&self->state_changes, self->egl_render,
+        OMX_StateIdle);
 #endif
 
   self->downstream_flow_ret = GST_FLOW_FLUSHING;
@@ -1877,11 +2529,6 @@ gst_omx_video_dec_stop (GstVideoDecoder * decoder)
   g_cond_broadcast (&self->drain_cond);
   g_mutex_unlock (&self->drain_lock);
 
-  gst_omx_component_get_state (self->dec, 5 * GST_SECOND);
-#if defined (USE_OMX_TARGET_RPI) && defined (HAVE_GST_GL)
-  gst_omx_component_get_state (self->egl_render, 1 * GST_SECOND);
-#endif
-
   gst_buffer_replace (&self->codec_data, NULL);
 
   if (self->input_state)
@@ -2075,7 +2722,7 @@ gst_omx_video_dec_disable (GstOMXVideoDec * self)
     if (gst_omx_port_wait_buffers_released (self->dec_in_port,
             5 * GST_SECOND) != OMX_ErrorNone)
       return FALSE;
-    if (gst_omx_port_deallocate_buffers (self->dec_in_port) != OMX_ErrorNone)
+    if (gst_omx_video_dec_deallocate_in_buffers (self) != OMX_ErrorNone)
       return FALSE;
     if (gst_omx_port_wait_enabled (self->dec_in_port,
             1 * GST_SECOND) != OMX_ErrorNone)
@@ -2197,12 +2844,13 @@ can_use_dynamic_buffer_mode (GstOMXVideoDec * self, GstBuffer * inbuf)
 }
 
 /* Choose the allocation mode for input buffers depending of what's supported by
- * the component and the size/alignment of the input buffer. */
+ * the component and the size/alignment of the input buffer. inbuf is NULL
+ * if the component is enabled before the first frame. */
 static GstOMXBufferAllocation
 gst_omx_video_dec_pick_input_allocation_mode (GstOMXVideoDec * self,
     GstBuffer * inbuf)
 {
-  if (!gst_omx_is_dynamic_allocation_supported ())
+  if (!gst_omx_is_dynamic_allocation_supported () || !inbuf)
     return GST_OMX_BUFFER_ALLOCATION_ALLOCATE_BUFFER;
 
   if (can_use_dynamic_buffer_mode (self, inbuf)) {
@@ -2215,6 +2863,46 @@ gst_omx_video_dec_pick_input_allocation_mode (GstOMXVideoDec * self,
   return GST_OMX_BUFFER_ALLOCATION_ALLOCATE_BUFFER;
 }
 
+/* Waits for the state changes started by enable() and flush() and
+ * populates the output port if they resumed the components.
+ *
+ * NOTE: Must be called with the stream lock */
+static gboolean
+gst_omx_video_dec_finish_state_changes (GstOMXVideoDec * self)
+{
+  OMX_ERRORTYPE err;
+
+  err = gst_omx_state_changes_wait (&self->state_changes, GST_CLOCK_TIME_NONE);
+  if (err != OMX_ErrorNone) {
+    GST_ERROR_OBJECT (self, "Failed to change state: %s (0x%08x)",
+        gst_omx_error_to_string (err), err);
+    self->populate_pending = FALSE;
+    return FALSE;
+  }
+
+  if (!self->populate_pending)
+    return TRUE;
+  self->populate_pending = FALSE;
+
+#if defined (USE_OMX_TARGET_RPI) && defined (HAVE_GST_GL)
+  if (self->eglimage) {
+    err = gst_omx_port_populate (self->egl_out_port);
+    gst_omx_port_mark_reconfigured (self->egl_out_port);
+  } else {
+    err = gst_omx_port_populate (self->dec_out_port);
+  }
+#else
+  err = gst_omx_port_populate (self->dec_out_port);
+#endif
+
+  if (err != OMX_ErrorNone) {
+    GST_WARNING_OBJECT (self, "Failed to populate output port: %s (0x%08x)",
+        gst_omx_error_to_string (err), err);
+  }
+
+  return TRUE;
+}
+
 static gboolean
 gst_omx_video_dec_enable (GstOMXVideoDec * self, GstBuffer * input)
 {
@@ -2260,7 +2948,7 @@ gst_omx_video_dec_enable (GstOMXVideoDec * self, GstBuffer * input)
               1 * GST_SECOND) != OMX_ErrorNone)
         return FALSE;
 
-      if (gst_omx_component_set_state (self->dec,
+      if (gst_omx_state_changes_add (&self->state_changes, self->dec,
               OMX_StateIdle) != OMX_ErrorNone)
         return FALSE;
 
@@ -2268,7 +2956,7 @@ gst_omx_video_dec_enable (GstOMXVideoDec * self, GstBuffer * input)
       if (!gst_omx_video_dec_allocate_in_buffers (self))
         return FALSE;
     } else {
-      if (gst_omx_component_set_state (self->dec,
+      if (gst_omx_state_changes_add (&self->state_changes, self->dec,
               OMX_StateIdle) != OMX_ErrorNone)
         return FALSE;
 
@@ -2279,17 +2967,14 @@ gst_omx_video_dec_enable (GstOMXVideoDec * self, GstBuffer * input)
         return FALSE;
     }
 
-    if (gst_omx_component_get_state (self->dec,
-            GST_CLOCK_TIME_NONE) != OMX_StateIdle)
+    if (gst_omx_state_changes_wait (&self->state_changes,
+            GST_CLOCK_TIME_NONE) != OMX_ErrorNone)
       return FALSE;
 
-    if (gst_omx_component_set_state (self->dec,
+    /* Waited for before the first frame is passed to the component */
+    if (gst_omx_state_changes_add (&self->state_changes, self->dec,
             OMX_StateExecuting) != OMX_ErrorNone)
       return FALSE;
-
-    if (gst_omx_component_get_state (self->dec,
-            GST_CLOCK_TIME_NONE) != OMX_StateExecuting)
-      return FALSE;
   }
 
   /* Unset flushing to allow ports to accept data again */
@@ -2325,6 +3010,10 @@ gst_omx_video_dec_set_format (GstVideoDecoder * decoder,
 
   GST_DEBUG_OBJECT (self, "Setting new caps %" GST_PTR_FORMAT, state->caps);
 
+  /* A flush might still be resuming the components */
+  if (!gst_omx_video_dec_finish_state_changes (self))
+    return FALSE;
+
   if (!self->dmabuf
       && gst_caps_features_contains (gst_caps_get_features (state->caps, 0),
           GST_CAPS_FEATURE_MEMORY_DMABUF)) {
@@ -2365,6 +3054,10 @@ gst_omx_video_dec_set_format (GstVideoDecoder * decoder,
     return TRUE;
   }
 
+  if (!gst_omx_video_reserve (GST_ELEMENT_CAST (self), self->dec,
+          &klass->cdata, info))
+    return FALSE;
+
   if (needs_disable && is_format_change) {
     if (!gst_omx_video_dec_disable (self))
       return FALSE;
@@ -2412,26 +3105,45 @@ static gboolean
 gst_omx_video_dec_flush (GstVideoDecoder * decoder)
 {
   GstOMXVideoDec *self = GST_OMX_VIDEO_DEC (decoder);
-  OMX_ERRORTYPE err = OMX_ErrorNone;
+  gboolean pause;
 
   GST_DEBUG_OBJECT (self, "Flushing decoder");
 
+  /* The base class discards all pending frames after this */
+  gst_omx_video_frame_index_clear (self->frame_index);
+
+  /* The output port is populated again below */
+  self->populate_pending = FALSE;
+  if (gst_omx_state_changes_wait (&self->state_changes,
+          GST_CLOCK_TIME_NONE) != OMX_ErrorNone)
+    GST_WARNING_OBJECT (self, "Previous state change failed");
+
   if (gst_omx_component_get_state (self->dec, 0) == OMX_StateLoaded)
     return TRUE;
 
-  /* 0) Pause the components */
-  if (gst_omx_component_get_state (self->dec, 0) == OMX_StateExecuting) {
-    gst_omx_component_set_state (self->dec, OMX_StatePause);
-    gst_omx_component_get_state (self->dec, GST_CLOCK_TIME_NONE);
-  }
+  /* Components that can flush while Executing skip the state changes and
+   * only park the srcpad task instead of stopping it */
+  pause = !(self->dec->hacks & GST_OMX_HACK_FLUSH_IN_EXECUTING);
 #if defined (USE_OMX_TARGET_RPI) && defined (HAVE_GST_GL)
-  if (self->eglimage) {
-    if (gst_omx_component_get_state (self->egl_render, 0) == OMX_StateExecuting) {
-      gst_omx_component_set_state (self->egl_render, OMX_StatePause);
-      gst_omx_component_get_state (self->egl_render, GST_CLOCK_TIME_NONE);
+  if (self->eglimage)
+    pause = TRUE;
+#endif
+
+  /* 0) Pause the components, both state changes run at the same time */
+  if (pause) {
+    if (gst_omx_component_get_state (self->dec, 0) == OMX_StateExecuting)
+      gst_omx_state_changes_add (&self->state_changes, self->dec,
+          OMX_StatePause);
+#if defined (USE_OMX_TARGET_RPI) && defined (HAVE_GST_GL)
+    if (self->eglimage) {
+      if (gst_omx_component_get_state (self->egl_render,
+              0) == OMX_StateExecuting)
+        gst_omx_state_changes_add (&self->state_changes, self->egl_render,
+            OMX_StatePause);
     }
-  }
 #endif
+    gst_omx_state_changes_wait (&self->state_changes, GST_CLOCK_TIME_NONE);
+  }
 
   /* 1) Flush the ports */
   GST_DEBUG_OBJECT (self, "flushing ports");
@@ -2449,19 +3161,27 @@ gst_omx_video_dec_flush (GstVideoDecoder * decoder)
    * unlock GST_VIDEO_DECODER_STREAM_LOCK to prevent deadlocks
    * caused by using this lock from inside the loop function */
   GST_VIDEO_DECODER_STREAM_UNLOCK (self);
-  gst_pad_stop_task (GST_VIDEO_DECODER_SRC_PAD (decoder));
-  GST_DEBUG_OBJECT (self, "Flushing -- task stopped");
+  if (pause) {
+    gst_pad_stop_task (GST_VIDEO_DECODER_SRC_PAD (decoder));
+    GST_DEBUG_OBJECT (self, "Flushing -- task stopped");
+  } else {
+    gst_pad_pause_task (GST_VIDEO_DECODER_SRC_PAD (decoder));
+    GST_DEBUG_OBJECT (self, "Flushing -- task paused");
+  }
   GST_VIDEO_DECODER_STREAM_LOCK (self);
 
-  /* 3) Resume components */
-  gst_omx_component_set_state (self->dec, OMX_StateExecuting);
-  gst_omx_component_get_state (self->dec, GST_CLOCK_TIME_NONE);
+  /* 3) Resume components. This is waited for with the next frame or caps,
+   * so that all decoders of a pipeline resume at the same time when it is
+   * flushed by a seek */
+  if (pause) {
+    gst_omx_state_changes_add (&self->state_changes, self->dec,
+        OMX_StateExecuting);
 #if defined (USE_OMX_TARGET_RPI) && defined (HAVE_GST_GL)
-  if (self->eglimage) {
-    gst_omx_component_set_state (self->egl_render, OMX_StateExecuting);
-    gst_omx_component_get_state (self->egl_render, GST_CLOCK_TIME_NONE);
-  }
+    if (self->eglimage)
+      gst_omx_state_changes_add (&self->state_changes, self->egl_render,
+          OMX_StateExecuting);
 #endif
+  }
 
   /* 4) Unset flushing to allow ports to accept data again */
   gst_omx_port_set_flushing (self->dec_in_port, 5 * GST_SECOND, FALSE);
@@ -2471,19 +3191,11 @@ gst_omx_video_dec_flush (GstVideoDecoder * decoder)
   if (self->eglimage) {
     gst_omx_port_set_flushing (self->egl_in_port, 5 * GST_SECOND, FALSE);
     gst_omx_port_set_flushing (self->egl_out_port, 5 * GST_SECOND, FALSE);
-    err = gst_omx_port_populate (self->egl_out_port);
-    gst_omx_port_mark_reconfigured (self->egl_out_port);
-  } else {
-    err = gst_omx_port_populate (self->dec_out_port);
   }
-#else
-  err = gst_omx_port_populate (self->dec_out_port);
 #endif
 
-  if (err != OMX_ErrorNone) {
-    GST_WARNING_OBJECT (self, "Failed to populate output port: %s (0x%08x)",
-        gst_omx_error_to_string (err), err);
-  }
+  /* 5) Populate the output port once the components are resumed */
+  self->populate_pending = TRUE;
 
   /* Reset our state */
   self->last_upstream_ts = 0;
@@ -2494,6 +3206,69 @@ gst_omx_video_dec_flush (GstVideoDecoder * decoder)
   return TRUE;
 }
 
+/* Stops offering the input buffers to upstream before they are
+ * reallocated. The input pool is deactivated when the buffers are
+ * deallocated, so upstream is asked to pick another pool first, and the
+ * current frame is copied if it is from the pool so that all of its
+ * buffers can return.
+ *
+ * NOTE: Must be called without the stream lock */
+static void
+gst_omx_video_dec_unshare_in_buffers (GstOMXVideoDec * self,
+    GstVideoCodecFrame * frame)
+{
+  GST_DEBUG_OBJECT (self, "Not sharing input buffers with upstream anymore");
+
+  GST_VIDEO_DECODER_STREAM_LOCK (self);
+  self->share_input = FALSE;
+  GST_VIDEO_DECODER_STREAM_UNLOCK (self);
+
+  if (gst_omx_buffer_pool_get_omx_buffer (GST_OMX_BUFFER_POOL
+          (self->in_port_pool), frame->input_buffer)) {
+    GstBuffer *copy = gst_buffer_copy_deep (frame->input_buffer);
+
+    gst_buffer_replace (&frame->input_buffer, copy);
+    gst_buffer_unref (copy);
+  }
+
+  gst_pad_push_event (GST_VIDEO_DECODER_SINK_PAD (self),
+      gst_event_new_reconfigure ());
+}
+
+/* Takes the OMX buffer for passing (a chunk of) inbuf to the component:
+ * the one wrapped by inbuf if it was acquired from our input pool, or the
+ * one that is not shared with upstream to copy into. The OMX buffer keeps
+ * the pool buffer alive until EmptyBufferDone. inbuf is NULL for codec
+ * data.
+ *
+ * NOTE: Must be called without the stream lock */
+static GstOMXAcquireBufferReturn
+gst_omx_video_dec_acquire_pool_buffer (GstOMXVideoDec * self,
+    GstBuffer * inbuf, GstOMXBuffer ** buf)
+{
+  GstOMXBufferPool *pool = GST_OMX_BUFFER_POOL (self->in_port_pool);
+  GstOMXAcquireBufferReturn ret;
+  GstOMXBuffer *omx_buf = NULL;
+
+  if (inbuf)
+    omx_buf = gst_omx_buffer_pool_get_omx_buffer (pool, inbuf);
+
+  /* Upstream might not use the pool at all or only for some frames. Don't
+   * wait for the pool then, upstream might hold all of its buffers */
+  if (!omx_buf)
+    return gst_omx_port_acquire_buffer (self->dec_in_port, buf);
+
+  ret = gst_omx_port_take_buffer (self->dec_in_port, omx_buf);
+  if (ret != GST_OMX_ACQUIRE_BUFFER_OK)
+    return ret;
+
+  g_assert (omx_buf->pool_buffer == NULL);
+  omx_buf->pool_buffer = gst_buffer_ref (inbuf);
+  *buf = omx_buf;
+
+  return GST_OMX_ACQUIRE_BUFFER_OK;
+}
+
 static GstFlowReturn
 gst_omx_video_dec_handle_frame (GstVideoDecoder * decoder,
     GstVideoCodecFrame * frame)
@@ -2503,6 +3278,8 @@ gst_omx_video_dec_handle_frame (GstVideoDecoder * decoder,
   GstOMXVideoDecClass *klass;
   GstOMXPort *port;
   GstOMXBuffer *buf;
+  GstOMXBuffer *bufs[GST_OMX_VIDEO_DEC_MAX_INPUT_BATCH];
+  guint i, n_bufs = 0, n_wanted;
   GstBuffer *codec_data = NULL;
   guint offset = 0, size;
   GstClockTime timestamp, duration;
@@ -2532,6 +3309,9 @@ gst_omx_video_dec_handle_frame (GstVideoDecoder * decoder,
         return FALSE;
     }
 
+    if (!gst_omx_video_dec_finish_state_changes (self))
+      goto component_error;
+
     GST_DEBUG_OBJECT (self, "Starting task");
     gst_pad_start_task (GST_VIDEO_DECODER_SRC_PAD (self),
         (GstTaskFunction) gst_omx_video_dec_loop, decoder, NULL);
@@ -2552,15 +3332,35 @@ gst_omx_video_dec_handle_frame (GstVideoDecoder * decoder,
     }
   }
 
+  /* Matched with the output buffer of the component by its PTS */
+  gst_omx_video_frame_index_add (self->frame_index, frame);
+
   port = self->dec_in_port;
 
   size = gst_buffer_get_size (frame->input_buffer);
   while (!done) {
+    /* When copying, get all the buffers needed for the remaining
+     * chunks of the frame at once */
+    if (self->codec_data || self->in_port_pool
+        || self->input_allocation ==
+        GST_OMX_BUFFER_ALLOCATION_USE_BUFFER_DYNAMIC
+        || port->port_def.nBufferSize == 0)
+      n_wanted = 1;
+    else
+      n_wanted = CLAMP ((size - offset + port->port_def.nBufferSize - 1) /
+          port->port_def.nBufferSize, 1, GST_OMX_VIDEO_DEC_MAX_INPUT_BATCH);
+
     /* Make sure to release the base class stream lock, otherwise
      * _loop() can't call _finish_frame() and we might block forever
      * because no input buffers are released */
     GST_VIDEO_DECODER_STREAM_UNLOCK (self);
-    acq_ret = gst_omx_port_acquire_buffer (port, &buf);
+    if (self->in_port_pool) {
+      acq_ret = gst_omx_video_dec_acquire_pool_buffer (self,
+          self->codec_data ? NULL : frame->input_buffer, &bufs[0]);
+      n_bufs = 1;
+    } else {
+      acq_ret = gst_omx_port_acquire_buffers (port, bufs, n_wanted, &n_bufs);
+    }
 
     if (acq_ret == GST_OMX_ACQUIRE_BUFFER_ERROR) {
       GST_VIDEO_DECODER_STREAM_LOCK (self);
@@ -2569,6 +3369,10 @@ gst_omx_video_dec_handle_frame (GstVideoDecoder * decoder,
       GST_VIDEO_DECODER_STREAM_LOCK (self);
       goto flushing;
     } else if (acq_ret == GST_OMX_ACQUIRE_BUFFER_RECONFIGURE) {
+      /* The new buffers are not shared with upstream anymore */
+      if (self->in_port_pool)
+        gst_omx_video_dec_unshare_in_buffers (self, frame);
+
       /* Reallocate all buffers */
       err = gst_omx_port_set_enabled (port, FALSE);
       if (err != OMX_ErrorNone) {
@@ -2582,7 +3386,7 @@ gst_omx_video_dec_handle_frame (GstVideoDecoder * decoder,
         goto reconfigure_error;
       }
 
-      err = gst_omx_port_deallocate_buffers (port);
+      err = gst_omx_video_dec_deallocate_in_buffers (self);
       if (err != OMX_ErrorNone) {
         GST_VIDEO_DECODER_STREAM_LOCK (self);
         goto reconfigure_error;
@@ -2623,15 +3427,16 @@ gst_omx_video_dec_handle_frame (GstVideoDecoder * decoder,
     }
     GST_VIDEO_DECODER_STREAM_LOCK (self);
 
-    g_assert (acq_ret == GST_OMX_ACQUIRE_BUFFER_OK && buf != NULL);
+    g_assert (acq_ret == GST_OMX_ACQUIRE_BUFFER_OK && n_bufs > 0);
+    buf = bufs[0];
 
     if (buf->omx_buf->nAllocLen - buf->omx_buf->nOffset <= 0) {
-      gst_omx_port_release_buffer (port, buf);
+      gst_omx_port_release_buffers (port, bufs, n_bufs);
       goto full_buffer;
     }
 
     if (self->downstream_flow_ret != GST_FLOW_OK) {
-      gst_omx_port_release_buffer (port, buf);
+      gst_omx_port_release_buffers (port, bufs, n_bufs);
       goto flow_error;
     }
 
@@ -2682,79 +3487,118 @@ gst_omx_video_dec_handle_frame (GstVideoDecoder * decoder,
 
     /* Now handle the frame */
 
-    if (self->input_allocation == GST_OMX_BUFFER_ALLOCATION_USE_BUFFER_DYNAMIC) {
-      /* Transfer the buffer content per memory rather than mapping the full
-       * buffer to prevent copies. */
-      GstMemory *mem = gst_buffer_peek_memory (frame->input_buffer, memory_idx);
+    for (i = 0; i < n_bufs; i++) {
+      buf = bufs[i];
 
-      GST_LOG_OBJECT (self,
-          "Transferring %" G_GSIZE_FORMAT " bytes to the component",
-          gst_memory_get_sizes (mem, NULL, NULL));
+      if (self->input_allocation ==
+          GST_OMX_BUFFER_ALLOCATION_USE_BUFFER_DYNAMIC) {
+        /* Transfer the buffer content per memory rather than mapping the full
+         * buffer to prevent copies. */
+        GstMemory *mem =
+            gst_buffer_peek_memory (frame->input_buffer, memory_idx);
 
-      if (!gst_omx_buffer_map_memory (buf, mem))
-        goto map_failed;
+        GST_LOG_OBJECT (self,
+            "Transferring %" G_GSIZE_FORMAT " bytes to the component",
+            gst_memory_get_sizes (mem, NULL, NULL));
 
-      if (!check_input_alignment (self, &buf->map)) {
-        GST_ELEMENT_ERROR (self, STREAM, FORMAT, (NULL),
-            ("input buffer now has wrong alignment/stride, can't use dynamic allocation any more"));
-        return FALSE;
+        if (!gst_omx_buffer_map_memory (buf, mem))
+          goto map_failed;
+
+        if (!check_input_alignment (self, &buf->map)) {
+          GST_ELEMENT_ERROR (self, STREAM, FORMAT, (NULL),
+              ("input buffer now has wrong alignment/stride, can't use dynamic allocation any more"));
+          return FALSE;
+        }
+
+        memory_idx++;
+        if (memory_idx == gst_buffer_n_memory (frame->input_buffer))
+          done = TRUE;
+      } else if (offset == 0 && buf->pool_buffer == frame->input_buffer) {
+        /* Upstream wrote the frame into our buffer already. Larger frames
+         * have more memory appended, which is copied into the same buffer
+         * once the component returned it */
+        GstMemory *mem = gst_buffer_peek_memory (frame->input_buffer, 0);
+
+        buf->omx_buf->nOffset = mem->offset;
+        buf->omx_buf->nFilledLen = mem->size;
+
+        GST_LOG_OBJECT (self, "Passing %d bytes in place to the component",
+            (guint) buf->omx_buf->nFilledLen);
+
+        offset += buf->omx_buf->nFilledLen;
+        if (offset == size)
+          done = TRUE;
+      } else {
+        guint chunk = buf->omx_buf->nAllocLen - buf->omx_buf->nOffset;
+
+        /* Copy the buffer content in chunks of size as requested
+         * by the port. Exactly as many buffers as needed for chunks
+         * of nBufferSize were acquired */
+        if (n_bufs > 1)
+          chunk = MIN (chunk, port->port_def.nBufferSize);
+        buf->omx_buf->nFilledLen = MIN (size - offset, chunk);
+
+        GST_LOG_OBJECT (self,
+            "Copying %d bytes (frame offset %d) to the component",
+            (guint) buf->omx_buf->nFilledLen, offset);
+
+        gst_buffer_extract (frame->input_buffer, offset,
+            buf->omx_buf->pBuffer + buf->omx_buf->nOffset,
+            buf->omx_buf->nFilledLen);
+
+        offset += buf->omx_buf->nFilledLen;
+        if (offset == size)
+          done = TRUE;
       }
 
-      memory_idx++;
-      if (memory_idx == gst_buffer_n_memory (frame->input_buffer))
-        done = TRUE;
-    } else {
-      /* Copy the buffer content in chunks of size as requested
-       * by the port */
-      buf->omx_buf->nFilledLen =
-          MIN (size - offset, buf->omx_buf->nAllocLen - buf->omx_buf->nOffset);
-
-      GST_LOG_OBJECT (self,
-          "Copying %d bytes (frame offset %d) to the component",
-          (guint) buf->omx_buf->nFilledLen, offset);
-
-      gst_buffer_extract (frame->input_buffer, offset,
-          buf->omx_buf->pBuffer + buf->omx_buf->nOffset,
-          buf->omx_buf->nFilledLen);
-
-      offset += buf->omx_buf->nFilledLen;
-      if (offset == size)
-        done = TRUE;
-    }
+      if (timestamp != GST_CLOCK_TIME_NONE) {
+        GST_OMX_SET_TICKS (buf->omx_buf->nTimeStamp,
+            gst_util_uint64_scale (timestamp, OMX_TICKS_PER_SECOND,
+                GST_SECOND));
+        self->last_upstream_ts = timestamp;
+      } else {
+        GST_OMX_SET_TICKS (buf->omx_buf->nTimeStamp, G_GUINT64_CONSTANT (0));
+      }
 
-    if (timestamp != GST_CLOCK_TIME_NONE) {
-      GST_OMX_SET_TICKS (buf->omx_buf->nTimeStamp,
-          gst_util_uint64_scale (timestamp, OMX_TICKS_PER_SECOND, GST_SECOND));
-      self->last_upstream_ts = timestamp;
-    } else {
-      GST_OMX_SET_TICKS (buf->omx_buf->nTimeStamp, G_GUINT64_CONSTANT (0));
-    }
+      if (duration != GST_CLOCK_TIME_NONE && first_ouput_buffer) {
+        buf->omx_buf->nTickCount =
+            gst_util_uint64_scale (duration, OMX_TICKS_PER_SECOND, GST_SECOND);
+        self->last_upstream_ts += duration;
+      } else {
+        buf->omx_buf->nTickCount = 0;
+      }
 
-    if (duration != GST_CLOCK_TIME_NONE && first_ouput_buffer) {
-      buf->omx_buf->nTickCount =
-          gst_util_uint64_scale (duration, OMX_TICKS_PER_SECOND, GST_SECOND);
-      self->last_upstream_ts += duration;
-    } else {
-      buf->omx_buf->nTickCount = 0;
-    }
+      if (first_ouput_buffer && GST_VIDEO_CODEC_FRAME_IS_SYNC_POINT (frame))
+        buf->omx_buf->nFlags |= OMX_BUFFERFLAG_SYNCFRAME;
 
-    if (first_ouput_buffer && GST_VIDEO_CODEC_FRAME_IS_SYNC_POINT (frame))
-      buf->omx_buf->nFlags |= OMX_BUFFERFLAG_SYNCFRAME;
+      /* TODO: Set flags
+       *   - OMX_BUFFERFLAG_DECODEONLY for buffers that are outside
+       *     the segment
+       */
 
-    /* TODO: Set flags
-     *   - OMX_BUFFERFLAG_DECODEONLY for buffers that are outside
-     *     the segment
-     */
+      if (done)
+        buf->omx_buf->nFlags |= OMX_BUFFERFLAG_ENDOFFRAME;
 
-    if (done)
-      buf->omx_buf->nFlags |= OMX_BUFFERFLAG_ENDOFFRAME;
+      first_ouput_buffer = FALSE;
+    }
 
     self->started = TRUE;
-    err = gst_omx_port_release_buffer (port, buf);
+    err = gst_omx_port_release_buffers (port, bufs, n_bufs);
     if (err != OMX_ErrorNone)
       goto release_error;
+  }
 
-    first_ouput_buffer = FALSE;
+  /* Only the metadata of the input is needed from now on, let the buffer
+   * go back to the pool as soon as the component is done */
+  if (self->in_port_pool
+      && gst_omx_buffer_pool_get_omx_buffer (GST_OMX_BUFFER_POOL
+          (self->in_port_pool), frame->input_buffer)) {
+    GstBuffer *meta_buf = gst_buffer_new ();
+
+    gst_buffer_copy_into (meta_buf, frame->input_buffer,
+        GST_BUFFER_COPY_METADATA, 0, -1);
+    gst_buffer_replace (&frame->input_buffer, meta_buf);
+    gst_buffer_unref (meta_buf);
   }
 
   gst_video_codec_frame_unref (frame);
@@ -2921,6 +3765,39 @@ gst_omx_video_dec_finish (GstVideoDecoder * decoder)
   return GST_FLOW_OK;
 }
 
+/* Replaces the system memory allocator of the pool negotiated with
+ * downstream, its buffers might be passed to the component with
+ * OMX_UseBuffer() or be the destination of copies */
+static void
+gst_omx_video_dec_set_frame_allocator (GstOMXVideoDec * self,
+    GstStructure * config)
+{
+  GstAllocator *allocator = NULL;
+  GstAllocationParams params;
+  guint32 align;
+
+  gst_allocation_params_init (&params);
+  gst_buffer_pool_config_get_allocator (config, &allocator, &params);
+  if (allocator
+      && g_strcmp0 (allocator->mem_type, GST_ALLOCATOR_SYSMEM) != 0) {
+    GST_DEBUG_OBJECT (self, "Keeping %s memory of downstream",
+        allocator->mem_type);
+    return;
+  }
+
+  /* The OMX alignment is the alignment itself, GStreamer uses a mask */
+  align = self->dec_out_port->port_def.nBufferAlignment;
+  if (align > 0 && (align & (align - 1)) == 0)
+    params.align |= align - 1;
+
+  allocator = gst_omx_frame_allocator_new (self->frame_memory);
+  gst_buffer_pool_config_set_allocator (config, allocator, &params);
+  gst_object_unref (allocator);
+
+  GST_DEBUG_OBJECT (self, "Using frame memory aligned to %" G_GSIZE_FORMAT
+      " bytes", params.align + 1);
+}
+
 static gboolean
 gst_omx_video_dec_decide_allocation (GstVideoDecoder * bdec, GstQuery * query)
 {
@@ -2972,6 +3849,13 @@ gst_omx_video_dec_decide_allocation (GstVideoDecoder * bdec, GstQuery * query)
   }
 #endif /* defined (HAVE_GST_GL) */
 
+  /* Downstream might reject the option on its pool config below, but
+   * can still be given our own buffers with any layout */
+  self->video_meta =
+      gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+  GST_DEBUG_OBJECT (self, "Downstream %s GstVideoMeta",
+      self->video_meta ? "supports" : "doesn't support");
+
   self->use_buffers = FALSE;
   if (gst_query_get_n_allocation_pools (query) > 0) {
     gst_query_parse_nth_allocation_pool (query, 0, &pool, NULL, NULL, NULL);
@@ -2992,12 +3876,117 @@ gst_omx_video_dec_decide_allocation (GstVideoDecoder * bdec, GstQuery * query)
   g_assert (pool != NULL);
 
   config = gst_buffer_pool_get_config (pool);
-  if (gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL)) {
+  if (self->video_meta) {
     gst_buffer_pool_config_add_option (config,
         GST_BUFFER_POOL_OPTION_VIDEO_META);
   }
+  if (self->frame_memory != GST_OMX_FRAME_MEMORY_SYSTEM)
+    gst_omx_video_dec_set_frame_allocator (self, config);
   gst_buffer_pool_set_config (pool, config);
   gst_object_unref (pool);
 
   return TRUE;
 }
+
+/* Returns the pool of the input port's buffers for upstream to write the
+ * bitstream into, enabling the component if needed. Only possible before
+ * the first frame if the component allocates its input buffers.
+ *
+ * NOTE: Must be called with the stream lock */
+static GstBufferPool *
+gst_omx_video_dec_get_in_port_pool (GstOMXVideoDec * self, GstCaps * caps)
+{
+  OMX_PARAM_PORTDEFINITIONTYPE port_def;
+  GstBufferPool *pool;
+  GstStructure *config;
+
+  if (!self->input_state || !gst_caps_is_equal (caps, self->input_state->caps))
+    return NULL;
+
+  if (self->in_port_pool)
+    return gst_object_ref (self->in_port_pool);
+
+  /* Upstream buffers are used directly in dynamic mode already */
+  if (gst_omx_is_dynamic_allocation_supported ())
+    return NULL;
+
+  /* The buffers might already be passed around without the pool */
+  if (!self->share_input || self->started || self->dec_in_port->buffers)
+    return NULL;
+
+  /* One buffer more than the component needs is kept out of the pool for
+   * copying input that isn't from it */
+  gst_omx_port_get_port_definition (self->dec_in_port, &port_def);
+  if (port_def.nBufferCountActual < port_def.nBufferCountMin + 1) {
+    port_def.nBufferCountActual = port_def.nBufferCountMin + 1;
+    if (gst_omx_port_update_port_definition (self->dec_in_port,
+            &port_def) != OMX_ErrorNone)
+      return NULL;
+  }
+
+  pool = gst_omx_buffer_pool_new (GST_ELEMENT_CAST (self), self->dec,
+      self->dec_in_port, GST_OMX_BUFFER_MODE_SYSTEM_MEMORY);
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps, 0, 0, 0);
+  if (!gst_buffer_pool_set_config (pool, config))
+    goto error;
+
+  if (!gst_omx_video_dec_enable (self, NULL))
+    goto error;
+
+  /* Update the size and number of buffers to the allocated ones */
+  config = gst_buffer_pool_get_config (pool);
+  if (!gst_buffer_pool_set_config (pool, config))
+    goto error;
+
+  GST_DEBUG_OBJECT (self, "Offering %u input buffers to upstream",
+      self->dec_in_port->buffers->len);
+  gst_omx_video_dec_replace_pool (self, &self->in_port_pool,
+      gst_object_ref (pool));
+
+  return pool;
+
+error:
+  gst_object_unref (pool);
+  return NULL;
+}
+
+static gboolean
+gst_omx_video_dec_propose_allocation (GstVideoDecoder * bdec, GstQuery * query)
+{
+  GstOMXVideoDec *self = GST_OMX_VIDEO_DEC (bdec);
+  GstBufferPool *pool;
+  GstCaps *caps;
+
+  gst_query_parse_allocation (query, &caps, NULL);
+
+  if (!caps) {
+    GST_WARNING_OBJECT (self, "allocation query does not contain caps");
+    return FALSE;
+  }
+
+  GST_VIDEO_DECODER_STREAM_LOCK (self);
+  pool = gst_omx_video_dec_get_in_port_pool (self, caps);
+  GST_VIDEO_DECODER_STREAM_UNLOCK (self);
+
+  /* Frames that don't fit into a single buffer can still be passed as
+   * buffers from elsewhere or with more memory appended */
+  if (pool) {
+    GstStructure *config;
+    guint size, num_buffers;
+
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_get_params (config, NULL, &size, &num_buffers,
+        NULL);
+    gst_structure_free (config);
+
+    gst_query_add_allocation_pool (query, pool, size, num_buffers,
+        num_buffers);
+    gst_object_unref (pool);
+  }
+
+  return
+      GST_VIDEO_DECODER_CLASS
+      (gst_omx_video_dec_parent_class)->propose_allocation (bdec, query);
+}
@@ -30,6 +30,8 @@
 #include <gst/video/gstvideodecoder.h>
 
 #include "gstomx.h"
+#include "gstomxcopy.h"
+#include "gstomxvideo.h"
 
 G_BEGIN_DECLS
 
@@ -70,6 +72,10 @@ struct _GstOMXVideoDec
 
   GstClockTime last_upstream_ts;
 
+  /* Frames passed to the component and not output yet, protected by
+   * the stream lock */
+  GstOMXVideoFrameIndex *frame_index;
+
   /* Draining state */
   GMutex drain_lock;
   GCond drain_cond;
@@ -77,12 +83,56 @@ struct _GstOMXVideoDec
   gboolean draining;
 
   GstFlowReturn downstream_flow_ret;
+
+  /* State changes of the components that are not waited for yet, they
+   * finish while other elements change their states. Only used from the
+   * streaming thread or with the stream lock */
+  GstOMXStateChanges state_changes;
+  /* TRUE if the output port must be populated once they finished */
+  gboolean populate_pending;
+
+  /* properties */
+  gboolean post_startup_timeline;
+  /* TRUE once the startup timeline was posted after opening */
+  gboolean startup_timeline_posted;
+  guint max_output_buffers;
+  gboolean copy_thread;
+  gint copy_workers;
+  GstOMXFrameMemoryMode frame_memory;
+
+  /* Adaptive number of output buffers: the number to allocate at the
+   * next reconfiguration of the output port, the number needed without
+   * stalls and since when the port usage is measured. The current number
+   * and the total time the component was starved are in the stats,
+   * protected by the object lock */
+  guint wanted_output_buffers;
+  guint min_output_buffers;
+  gint64 usage_window_start;
+  guint output_buffers;
+  GstClockTime output_starved_time;
+
+  /* Output frames being copied from the output port pool into buffers
+   * of the negotiated pool, in output order, only used by the srcpad
+   * task. The copies run in copy_threads if "copy-thread" is set */
+  GThreadPool *copy_threads;
+  GQueue copy_jobs;
+  GMutex copy_lock;
+  GCond copy_cond;
+
+  /* Splits each copied frame into bands of lines for the shared copy
+   * threads, created by the srcpad task with the first copy */
+  GstOMXCopyPool *copy_pool;
+
   /* Initially FALSE. Switched to TRUE when all requirements
    * are met to try setting up the decoder with OMX_UseBuffer.
    * Switched to FALSE if this trial fails so that the decoder
    * can fallback to OMX_AllocateBuffer. */
   gboolean use_buffers;
 
+  /* TRUE if downstream handles GstVideoMeta, our output buffers are then
+   * pushed with the strides and offsets of the port instead of copied */
+  gboolean video_meta;
+
 #if defined (USE_OMX_TARGET_RPI)
   GstOMXComponent *egl_render;
   GstOMXPort *egl_in_port, *egl_out_port;
@@ -95,6 +145,11 @@ struct _GstOMXVideoDec
   /* TRUE if decoder is producing dmabuf */
   gboolean dmabuf;
   GstOMXBufferAllocation input_allocation;
+
+  /* FALSE once the input buffers were reallocated after being shared
+   * with upstream, they are not offered to upstream again until the
+   * next start. Protected by the stream lock */
+  gboolean share_input;
 };
 
 struct _GstOMXVideoDecClass
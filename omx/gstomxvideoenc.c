@@ -28,6 +28,7 @@
 
 #include "gstomxvideo.h"
 #include "gstomxvideoenc.h"
+#include "gstomxbufferpool.h"
 
 #ifdef USE_OMX_TARGET_RPI
 #include <OMX_Broadcom.h>
@@ -100,7 +101,9 @@ enum
   PROP_TARGET_BITRATE,
   PROP_QUANT_I_FRAMES,
   PROP_QUANT_P_FRAMES,
-  PROP_QUANT_B_FRAMES
+  PROP_QUANT_B_FRAMES,
+  PROP_POST_STARTUP_TIMELINE,
+  PROP_STATS
 };
 
 /* FIXME: Better defaults */
@@ -109,6 +112,7 @@ enum
 #define GST_OMX_VIDEO_ENC_QUANT_I_FRAMES_DEFAULT (0xffffffff)
 #define GST_OMX_VIDEO_ENC_QUANT_P_FRAMES_DEFAULT (0xffffffff)
 #define GST_OMX_VIDEO_ENC_QUANT_B_FRAMES_DEFAULT (0xffffffff)
+#define GST_OMX_VIDEO_ENC_POST_STARTUP_TIMELINE_DEFAULT FALSE
 
 /* class initialization */
 #define do_init \
@@ -169,6 +173,19 @@ gst_omx_video_enc_class_init (GstOMXVideoEncClass * klass)
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
           GST_PARAM_MUTABLE_READY));
 
+  g_object_class_install_property (gobject_class, PROP_POST_STARTUP_TIMELINE,
+      g_param_spec_boolean ("post-startup-timeline", "Post startup timeline",
+          "Post an element message with the time spent in each startup "
+          "phase after the first encoded frame",
+          GST_OMX_VIDEO_ENC_POST_STARTUP_TIMELINE_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Statistics of the input buffer pool offered to upstream",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   element_class->change_state =
       GST_DEBUG_FUNCPTR (gst_omx_video_enc_change_state);
 
@@ -203,9 +220,14 @@ gst_omx_video_enc_init (GstOMXVideoEnc * self)
   self->quant_i_frames = GST_OMX_VIDEO_ENC_QUANT_I_FRAMES_DEFAULT;
   self->quant_p_frames = GST_OMX_VIDEO_ENC_QUANT_P_FRAMES_DEFAULT;
   self->quant_b_frames = GST_OMX_VIDEO_ENC_QUANT_B_FRAMES_DEFAULT;
+  self->post_startup_timeline = GST_OMX_VIDEO_ENC_POST_STARTUP_TIMELINE_DEFAULT;
 
   g_mutex_init (&self->drain_lock);
   g_cond_init (&self->drain_cond);
+
+  gst_omx_state_changes_init (&self->state_changes);
+
+  self->frame_index = gst_omx_video_frame_index_new ();
 }
 
 static gboolean
@@ -215,11 +237,9 @@ gst_omx_video_enc_open (GstVideoEncoder * encoder)
   GstOMXVideoEncClass *klass = GST_OMX_VIDEO_ENC_GET_CLASS (self);
   gint in_port_index, out_port_index;
 
-  self->enc =
-      gst_omx_component_new (GST_OBJECT_CAST (self), klass->cdata.core_name,
-      klass->cdata.component_name, klass->cdata.component_role,
-      klass->cdata.hacks);
+  self->enc = gst_omx_component_acquire (GST_OBJECT_CAST (self), &klass->cdata);
   self->started = FALSE;
+  self->startup_timeline_posted = FALSE;
 
   if (!self->enc)
     return FALSE;
@@ -232,25 +252,11 @@ gst_omx_video_enc_open (GstVideoEncoder * encoder)
   out_port_index = klass->cdata.out_port_index;
 
   if (in_port_index == -1 || out_port_index == -1) {
-    OMX_PORT_PARAM_TYPE param;
-    OMX_ERRORTYPE err;
-
-    GST_OMX_INIT_STRUCT (&param);
-
-    err =
-        gst_omx_component_get_parameter (self->enc, OMX_IndexParamVideoInit,
-        &param);
-    if (err != OMX_ErrorNone) {
-      GST_WARNING_OBJECT (self, "Couldn't get port information: %s (0x%08x)",
-          gst_omx_error_to_string (err), err);
+    if (!gst_omx_component_detect_port_indices (self->enc,
+            OMX_IndexParamVideoInit, &in_port_index, &out_port_index)) {
       /* Fallback */
       in_port_index = 0;
       out_port_index = 1;
-    } else {
-      GST_DEBUG_OBJECT (self, "Detected %u ports, starting at %u",
-          (guint) param.nPorts, (guint) param.nStartPortNumber);
-      in_port_index = param.nStartPortNumber + 0;
-      out_port_index = param.nStartPortNumber + 1;
     }
   }
 
@@ -356,6 +362,45 @@ gst_omx_video_enc_open (GstVideoEncoder * encoder)
   return TRUE;
 }
 
+/* The pool is read by the "stats" property, so it is only replaced
+ * with the object lock. Takes ownership of new_pool */
+static void
+gst_omx_video_enc_replace_in_port_pool (GstOMXVideoEnc * self,
+    GstBufferPool * new_pool)
+{
+  GstBufferPool *old_pool;
+
+  GST_OBJECT_LOCK (self);
+  old_pool = self->in_port_pool;
+  self->in_port_pool = new_pool;
+  GST_OBJECT_UNLOCK (self);
+
+  if (old_pool)
+    gst_object_unref (old_pool);
+}
+
+/* Buffers of the input pool wrap the memory of the OMX buffers, so they
+ * are only deallocated after upstream released all of them */
+static OMX_ERRORTYPE
+gst_omx_video_enc_deallocate_in_buffers (GstOMXVideoEnc * self)
+{
+  if (self->in_port_pool) {
+    GST_OMX_BUFFER_POOL (self->in_port_pool)->deactivated = TRUE;
+    gst_buffer_pool_set_active (self->in_port_pool, FALSE);
+
+    if (!gst_omx_buffer_pool_wait_stopped (GST_OMX_BUFFER_POOL
+            (self->in_port_pool), 5 * GST_SECOND)) {
+      GST_ERROR_OBJECT (self, "Upstream still holds buffers of the input "
+          "pool, not deallocating them");
+      return OMX_ErrorTimeout;
+    }
+
+    gst_omx_video_enc_replace_in_port_pool (self, NULL);
+  }
+
+  return gst_omx_port_deallocate_buffers (self->enc_in_port);
+}
+
 static gboolean
 gst_omx_video_enc_shutdown (GstOMXVideoEnc * self)
 {
@@ -363,6 +408,9 @@ gst_omx_video_enc_shutdown (GstOMXVideoEnc * self)
 
   GST_DEBUG_OBJECT (self, "Shutting down encoder");
 
+  /* Let the state change started in stop() finish */
+  gst_omx_state_changes_wait (&self->state_changes, 5 * GST_SECOND);
+
   state = gst_omx_component_get_state (self->enc, 0);
   if (state > OMX_StateLoaded || state == OMX_StateInvalid) {
     if (state > OMX_StateIdle) {
@@ -370,7 +418,7 @@ gst_omx_video_enc_shutdown (GstOMXVideoEnc * self)
       gst_omx_component_get_state (self->enc, 5 * GST_SECOND);
     }
     gst_omx_component_set_state (self->enc, OMX_StateLoaded);
-    gst_omx_port_deallocate_buffers (self->enc_in_port);
+    gst_omx_video_enc_deallocate_in_buffers (self);
     gst_omx_port_deallocate_buffers (self->enc_out_port);
     if (state > OMX_StateLoaded)
       gst_omx_component_get_state (self->enc, 5 * GST_SECOND);
@@ -392,7 +440,7 @@ gst_omx_video_enc_close (GstVideoEncoder * encoder)
   self->enc_in_port = NULL;
   self->enc_out_port = NULL;
   if (self->enc)
-    gst_omx_component_free (self->enc);
+    gst_omx_component_release (self->enc);
   self->enc = NULL;
 
   self->started = FALSE;
@@ -408,6 +456,10 @@ gst_omx_video_enc_finalize (GObject * object)
   g_mutex_clear (&self->drain_lock);
   g_cond_clear (&self->drain_cond);
 
+  gst_omx_state_changes_clear (&self->state_changes);
+
+  gst_omx_video_frame_index_free (self->frame_index);
+
   G_OBJECT_CLASS (gst_omx_video_enc_parent_class)->finalize (object);
 }
 
@@ -448,6 +500,9 @@ gst_omx_video_enc_set_property (GObject * object, guint prop_id,
     case PROP_QUANT_B_FRAMES:
       self->quant_b_frames = g_value_get_uint (value);
       break;
+    case PROP_POST_STARTUP_TIMELINE:
+      self->post_startup_timeline = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -476,6 +531,27 @@ gst_omx_video_enc_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_QUANT_B_FRAMES:
       g_value_set_uint (value, self->quant_b_frames);
       break;
+    case PROP_POST_STARTUP_TIMELINE:
+      g_value_set_boolean (value, self->post_startup_timeline);
+      break;
+    case PROP_STATS:{
+      GstStructure *s, *pool_stats;
+
+      GST_OBJECT_LOCK (self);
+      s = gst_structure_new_empty ("omx-video-enc-stats");
+      if (self->in_port_pool) {
+        pool_stats =
+            gst_omx_buffer_pool_get_stats (GST_OMX_BUFFER_POOL
+            (self->in_port_pool));
+        gst_structure_set (s, "input-pool", GST_TYPE_STRUCTURE, pool_stats,
+            NULL);
+        gst_structure_free (pool_stats);
+      }
+      GST_OBJECT_UNLOCK (self);
+
+      g_value_take_boxed (value, s);
+      break;
+    }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -576,8 +652,9 @@ gst_omx_video_enc_handle_output_frame (GstOMXVideoEnc * self, GstOMXPort * port,
         self->input_state);
     state->codec_data = codec_data;
     gst_video_codec_state_unref (state);
-    if (!gst_video_encoder_negotiate (GST_VIDEO_ENCODER (self))) {
+    if (frame)
       gst_video_codec_frame_unref (frame);
+    if (!gst_video_encoder_negotiate (GST_VIDEO_ENCODER (self))) {
       GST_ERROR_OBJECT (self,
           "Downstream element refused to negotiate codec_data in the caps");
       return GST_FLOW_NOT_NEGOTIATED;
@@ -637,6 +714,22 @@ gst_omx_video_enc_handle_output_frame (GstOMXVideoEnc * self, GstOMXPort * port,
   return flow_ret;
 }
 
+/* Posts the phases from opening the encoder until the first frame was
+ * encoded, once per component */
+static void
+gst_omx_video_enc_post_startup_timeline (GstOMXVideoEnc * self)
+{
+  GstStructure *s;
+
+  if (!(s = gst_omx_component_take_timeline (self->enc)))
+    return;
+
+  GST_DEBUG_OBJECT (self, "Startup timeline: %" GST_PTR_FORMAT, s);
+  gst_element_post_message (GST_ELEMENT_CAST (self),
+      gst_message_new_element (GST_OBJECT_CAST (self), s));
+  self->startup_timeline_posted = TRUE;
+}
+
 static void
 gst_omx_video_enc_loop (GstOMXVideoEnc * self)
 {
@@ -659,6 +752,10 @@ gst_omx_video_enc_loop (GstOMXVideoEnc * self)
     goto eos;
   }
 
+  if (G_UNLIKELY (self->post_startup_timeline
+          && !self->startup_timeline_posted))
+    gst_omx_video_enc_post_startup_timeline (self);
+
   if (!gst_pad_has_current_caps (GST_VIDEO_ENCODER_SRC_PAD (self))
       || acq_return == GST_OMX_ACQUIRE_BUFFER_RECONFIGURE) {
     GstCaps *caps;
@@ -758,8 +855,11 @@ gst_omx_video_enc_loop (GstOMXVideoEnc * self)
       (guint64) GST_OMX_GET_TICKS (buf->omx_buf->nTimeStamp));
 
   GST_VIDEO_ENCODER_STREAM_LOCK (self);
-  frame = gst_omx_video_find_nearest_frame (buf,
-      gst_video_encoder_get_frames (GST_VIDEO_ENCODER (self)));
+  /* Codec data is output before the frame it belongs to, everything else
+   * finishes the frame */
+  frame = gst_omx_video_frame_index_find_nearest (self->frame_index, buf,
+      !(buf->omx_buf->nFlags & OMX_BUFFERFLAG_CODECCONFIG)
+      || buf->omx_buf->nFilledLen == 0);
 
   g_assert (klass->handle_output_frame);
   flow_ret = klass->handle_output_frame (self, self->enc_out_port, buf, frame);
@@ -907,6 +1007,7 @@ gst_omx_video_enc_start (GstVideoEncoder * encoder)
 
   self->last_upstream_ts = 0;
   self->downstream_flow_ret = GST_FLOW_OK;
+  self->share_input = TRUE;
 
   return TRUE;
 }
@@ -925,8 +1026,15 @@ gst_omx_video_enc_stop (GstVideoEncoder * encoder)
 
   gst_pad_stop_task (GST_VIDEO_ENCODER_SRC_PAD (encoder));
 
+  gst_omx_state_changes_wait (&self->state_changes, 5 * GST_SECOND);
+
+  gst_omx_video_frame_index_clear (self->frame_index);
+
+  /* Not waited for here, so that the components of all elements of the
+   * pipeline go to Idle at the same time. close() waits for it */
   if (gst_omx_component_get_state (self->enc, 0) > OMX_StateIdle)
-    gst_omx_component_set_state (self->enc, OMX_StateIdle);
+    gst_omx_state_changes_add (&self->state_changes, self->enc, OMX_StateIdle);
+  gst_omx_component_unreserve (self->enc);
 
   self->downstream_flow_ret = GST_FLOW_FLUSHING;
   self->started = FALSE;
@@ -940,8 +1048,6 @@ gst_omx_video_enc_stop (GstVideoEncoder * encoder)
   g_cond_broadcast (&self->drain_cond);
   g_mutex_unlock (&self->drain_lock);
 
-  gst_omx_component_get_state (self->enc, 5 * GST_SECOND);
-
   return TRUE;
 }
 
@@ -1019,7 +1125,7 @@ gst_omx_video_enc_disable (GstOMXVideoEnc * self)
     if (gst_omx_port_wait_buffers_released (self->enc_in_port,
             5 * GST_SECOND) != OMX_ErrorNone)
       return FALSE;
-    if (gst_omx_port_deallocate_buffers (self->enc_in_port) != OMX_ErrorNone)
+    if (gst_omx_video_enc_deallocate_in_buffers (self) != OMX_ErrorNone)
       return FALSE;
     if (gst_omx_port_wait_enabled (self->enc_in_port,
             1 * GST_SECOND) != OMX_ErrorNone)
@@ -1055,7 +1161,8 @@ gst_omx_video_enc_configure_input_buffer (GstOMXVideoEnc * self,
 
   gst_omx_port_get_port_definition (self->enc_in_port, &port_def);
 
-  meta = gst_buffer_get_video_meta (input);
+  /* No input yet if the buffers are allocated for the input pool */
+  meta = input ? gst_buffer_get_video_meta (input) : NULL;
   if (meta) {
     /* Use the stride and slice height of the first plane */
     stride = meta->stride[0];
@@ -1066,8 +1173,9 @@ gst_omx_video_enc_configure_input_buffer (GstOMXVideoEnc * self,
         "adjusting stride (%d) and slice-height (%d) using input buffer meta",
         stride, slice_height);
   } else {
-    GST_WARNING_OBJECT (self,
-        "input buffer doesn't provide video meta, can't adjust stride and slice height");
+    if (input)
+      GST_WARNING_OBJECT (self,
+          "input buffer doesn't provide video meta, can't adjust stride and slice height");
 
     stride = info->stride[0];
     slice_height = info->height;
@@ -1197,7 +1305,7 @@ static GstOMXBufferAllocation
 gst_omx_video_enc_pick_input_allocation_mode (GstOMXVideoEnc * self,
     GstBuffer * inbuf)
 {
-  if (!gst_omx_is_dynamic_allocation_supported ())
+  if (!inbuf || !gst_omx_is_dynamic_allocation_supported ())
     return GST_OMX_BUFFER_ALLOCATION_ALLOCATE_BUFFER;
 
   if (can_use_dynamic_buffer_mode (self, inbuf)) {
@@ -1256,7 +1364,7 @@ gst_omx_video_enc_enable (GstOMXVideoEnc * self, GstBuffer * input)
               1 * GST_SECOND) != OMX_ErrorNone)
         return FALSE;
 
-      if (gst_omx_component_set_state (self->enc,
+      if (gst_omx_state_changes_add (&self->state_changes, self->enc,
               OMX_StateIdle) != OMX_ErrorNone)
         return FALSE;
 
@@ -1264,7 +1372,7 @@ gst_omx_video_enc_enable (GstOMXVideoEnc * self, GstBuffer * input)
       if (!gst_omx_video_enc_allocate_in_buffers (self))
         return FALSE;
     } else {
-      if (gst_omx_component_set_state (self->enc,
+      if (gst_omx_state_changes_add (&self->state_changes, self->enc,
               OMX_StateIdle) != OMX_ErrorNone)
         return FALSE;
 
@@ -1275,17 +1383,14 @@ gst_omx_video_enc_enable (GstOMXVideoEnc * self, GstBuffer * input)
         return FALSE;
     }
 
-    if (gst_omx_component_get_state (self->enc,
-            GST_CLOCK_TIME_NONE) != OMX_StateIdle)
+    if (gst_omx_state_changes_wait (&self->state_changes,
+            GST_CLOCK_TIME_NONE) != OMX_ErrorNone)
       return FALSE;
 
-    if (gst_omx_component_set_state (self->enc,
+    /* Waited for before the first frame is passed to the component */
+    if (gst_omx_state_changes_add (&self->state_changes, self->enc,
             OMX_StateExecuting) != OMX_ErrorNone)
       return FALSE;
-
-    if (gst_omx_component_get_state (self->enc,
-            GST_CLOCK_TIME_NONE) != OMX_StateExecuting)
-      return FALSE;
   }
 
   /* Unset flushing to allow ports to accept data again */
@@ -1321,6 +1426,15 @@ gst_omx_video_enc_set_format (GstVideoEncoder * encoder,
   GST_DEBUG_OBJECT (self, "Setting new format %s",
       gst_video_format_to_string (info->finfo->format));
 
+  /* enable() might still be starting the component */
+  if (gst_omx_state_changes_wait (&self->state_changes,
+          GST_CLOCK_TIME_NONE) != OMX_ErrorNone)
+    return FALSE;
+
+  if (!gst_omx_video_reserve (GST_ELEMENT_CAST (self), self->enc,
+          &klass->cdata, info))
+    return FALSE;
+
   gst_omx_port_get_port_definition (self->enc_in_port, &port_def);
 
   needs_disable =
@@ -1478,6 +1592,13 @@ gst_omx_video_enc_flush (GstVideoEncoder * encoder)
 
   GST_DEBUG_OBJECT (self, "Flushing encoder");
 
+  /* The base class discards all pending frames after this */
+  gst_omx_video_frame_index_clear (self->frame_index);
+
+  if (gst_omx_state_changes_wait (&self->state_changes,
+          GST_CLOCK_TIME_NONE) != OMX_ErrorNone)
+    GST_WARNING_OBJECT (self, "Previous state change failed");
+
   if (gst_omx_component_get_state (self->enc, 0) == OMX_StateLoaded)
     return TRUE;
 
@@ -1707,6 +1828,66 @@ done:
   return ret;
 }
 
+/* Stops offering the input buffers to upstream before they are
+ * reallocated. The input pool is deactivated when the buffers are
+ * deallocated, so upstream is asked to pick another pool first, and the
+ * current frame is copied if it is from the pool so that all of its
+ * buffers can return.
+ *
+ * NOTE: Must be called without the stream lock */
+static void
+gst_omx_video_enc_unshare_in_buffers (GstOMXVideoEnc * self,
+    GstVideoCodecFrame * frame)
+{
+  GST_DEBUG_OBJECT (self, "Not sharing input buffers with upstream anymore");
+
+  GST_VIDEO_ENCODER_STREAM_LOCK (self);
+  self->share_input = FALSE;
+  GST_VIDEO_ENCODER_STREAM_UNLOCK (self);
+
+  if (gst_omx_buffer_pool_get_omx_buffer (GST_OMX_BUFFER_POOL
+          (self->in_port_pool), frame->input_buffer)) {
+    GstBuffer *copy = gst_buffer_copy_deep (frame->input_buffer);
+
+    gst_buffer_replace (&frame->input_buffer, copy);
+    gst_buffer_unref (copy);
+  }
+
+  gst_pad_push_event (GST_VIDEO_ENCODER_SINK_PAD (self),
+      gst_event_new_reconfigure ());
+}
+
+/* Gets the OMX buffer that is wrapped by inbuf if upstream rendered into
+ * a buffer of our input pool, or the one that is not shared with upstream
+ * to copy inbuf into. The OMX buffer keeps the pool buffer alive until
+ * EmptyBufferDone.
+ *
+ * NOTE: Must be called without the stream lock */
+static GstOMXAcquireBufferReturn
+gst_omx_video_enc_acquire_pool_buffer (GstOMXVideoEnc * self,
+    GstBuffer * inbuf, GstOMXBuffer ** buf)
+{
+  GstOMXBufferPool *pool = GST_OMX_BUFFER_POOL (self->in_port_pool);
+  GstOMXAcquireBufferReturn ret;
+  GstOMXBuffer *omx_buf;
+
+  /* Upstream might not use the pool at all. Don't wait for the pool then,
+   * upstream might hold all of its buffers */
+  omx_buf = gst_omx_buffer_pool_get_omx_buffer (pool, inbuf);
+  if (!omx_buf)
+    return gst_omx_port_acquire_buffer (self->enc_in_port, buf);
+
+  ret = gst_omx_port_take_buffer (self->enc_in_port, omx_buf);
+  if (ret != GST_OMX_ACQUIRE_BUFFER_OK)
+    return ret;
+
+  g_assert (omx_buf->pool_buffer == NULL);
+  omx_buf->pool_buffer = gst_buffer_ref (inbuf);
+  *buf = omx_buf;
+
+  return GST_OMX_ACQUIRE_BUFFER_OK;
+}
+
 static GstFlowReturn
 gst_omx_video_enc_handle_frame (GstVideoEncoder * encoder,
     GstVideoCodecFrame * frame)
@@ -1743,11 +1924,18 @@ gst_omx_video_enc_handle_frame (GstVideoEncoder * encoder,
         return FALSE;
     }
 
+    if (gst_omx_state_changes_wait (&self->state_changes,
+            GST_CLOCK_TIME_NONE) != OMX_ErrorNone)
+      goto component_error;
+
     GST_DEBUG_OBJECT (self, "Starting task");
     gst_pad_start_task (GST_VIDEO_ENCODER_SRC_PAD (self),
         (GstTaskFunction) gst_omx_video_enc_loop, self, NULL);
   }
 
+  /* Matched with the output buffer of the component by its PTS */
+  gst_omx_video_frame_index_add (self->frame_index, frame);
+
   port = self->enc_in_port;
 
   while (acq_ret != GST_OMX_ACQUIRE_BUFFER_OK) {
@@ -1757,7 +1945,11 @@ gst_omx_video_enc_handle_frame (GstVideoEncoder * encoder,
      * _loop() can't call _finish_frame() and we might block forever
      * because no input buffers are released */
     GST_VIDEO_ENCODER_STREAM_UNLOCK (self);
-    acq_ret = gst_omx_port_acquire_buffer (port, &buf);
+    if (self->in_port_pool)
+      acq_ret = gst_omx_video_enc_acquire_pool_buffer (self,
+          frame->input_buffer, &buf);
+    else
+      acq_ret = gst_omx_port_acquire_buffer (port, &buf);
 
     if (acq_ret == GST_OMX_ACQUIRE_BUFFER_ERROR) {
       GST_VIDEO_ENCODER_STREAM_LOCK (self);
@@ -1766,6 +1958,10 @@ gst_omx_video_enc_handle_frame (GstVideoEncoder * encoder,
       GST_VIDEO_ENCODER_STREAM_LOCK (self);
       goto flushing;
     } else if (acq_ret == GST_OMX_ACQUIRE_BUFFER_RECONFIGURE) {
+      /* The new buffers are not shared with upstream anymore */
+      if (self->in_port_pool)
+        gst_omx_video_enc_unshare_in_buffers (self, frame);
+
       /* Reallocate all buffers */
       err = gst_omx_port_set_enabled (port, FALSE);
       if (err != OMX_ErrorNone) {
@@ -1779,7 +1975,7 @@ gst_omx_video_enc_handle_frame (GstVideoEncoder * encoder,
         goto reconfigure_error;
       }
 
-      err = gst_omx_port_deallocate_buffers (port);
+      err = gst_omx_video_enc_deallocate_in_buffers (self);
       if (err != OMX_ErrorNone) {
         GST_VIDEO_ENCODER_STREAM_LOCK (self);
         goto reconfigure_error;
@@ -1864,9 +2060,24 @@ gst_omx_video_enc_handle_frame (GstVideoEncoder * encoder,
             gst_omx_error_to_string (err), err);
     }
 
-    /* Copy the buffer content in chunks of size as requested
-     * by the port */
-    if (!gst_omx_video_enc_fill_buffer (self, frame->input_buffer, buf)) {
+    if (buf->pool_buffer) {
+      GstBuffer *meta_buf = gst_buffer_new ();
+
+      /* Upstream rendered into our buffer already, which has the default
+       * layout */
+      buf->omx_buf->nOffset = 0;
+      buf->omx_buf->nFilledLen = port->port_def.nBufferSize;
+
+      /* Only the metadata of the input is needed from now on, let the
+       * buffer go back to the pool as soon as the component is done */
+      gst_buffer_copy_into (meta_buf, frame->input_buffer,
+          GST_BUFFER_COPY_METADATA, 0, -1);
+      gst_buffer_replace (&frame->input_buffer, meta_buf);
+      gst_buffer_unref (meta_buf);
+    } else if (!gst_omx_video_enc_fill_buffer (self, frame->input_buffer,
+            buf)) {
+      /* Copy the buffer content in chunks of size as requested
+       * by the port */
       gst_omx_port_release_buffer (port, buf);
       goto buffer_fill_error;
     }
@@ -2030,11 +2241,85 @@ gst_omx_video_enc_drain (GstOMXVideoEnc * self)
   return GST_FLOW_OK;
 }
 
+/* Returns the pool of the input port's buffers for upstream to render
+ * into, enabling the component if needed. Only possible before the first
+ * frame if the component allocates its input buffers and they have the
+ * default layout, as upstream might not support GstVideoMeta.
+ *
+ * NOTE: Must be called with the stream lock */
+static GstBufferPool *
+gst_omx_video_enc_get_in_port_pool (GstOMXVideoEnc * self, GstCaps * caps)
+{
+  OMX_PARAM_PORTDEFINITIONTYPE port_def;
+  GstBufferPool *pool;
+  GstStructure *config;
+
+  if (!self->input_state || !gst_caps_is_equal (caps, self->input_state->caps))
+    return NULL;
+
+  if (self->in_port_pool)
+    return gst_object_ref (self->in_port_pool);
+
+  /* Upstream buffers are used directly in dynamic mode already */
+  if (gst_omx_is_dynamic_allocation_supported ())
+    return NULL;
+
+  /* The buffers might already be passed around without the pool */
+  if (!self->share_input || self->started || self->enc_in_port->buffers)
+    return NULL;
+
+  if (!gst_omx_video_enc_configure_input_buffer (self, NULL))
+    return NULL;
+
+  /* One buffer more than the component needs is kept out of the pool for
+   * copying input that isn't from it */
+  gst_omx_port_get_port_definition (self->enc_in_port, &port_def);
+  if (port_def.nBufferCountActual < port_def.nBufferCountMin + 1) {
+    port_def.nBufferCountActual = port_def.nBufferCountMin + 1;
+    if (gst_omx_port_update_port_definition (self->enc_in_port,
+            &port_def) != OMX_ErrorNone)
+      return NULL;
+  }
+
+  pool = gst_omx_buffer_pool_new (GST_ELEMENT_CAST (self), self->enc,
+      self->enc_in_port, GST_OMX_BUFFER_MODE_SYSTEM_MEMORY);
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps, 0, 0, 0);
+  if (!gst_buffer_pool_set_config (pool, config))
+    goto error;
+
+  if (!gst_omx_buffer_pool_has_default_layout (GST_OMX_BUFFER_POOL (pool))) {
+    GST_DEBUG_OBJECT (self, "Input buffers have a custom layout, not "
+        "offering them to upstream");
+    goto error;
+  }
+
+  if (!gst_omx_video_enc_enable (self, NULL))
+    goto error;
+
+  /* Update the size and number of buffers to the allocated ones */
+  config = gst_buffer_pool_get_config (pool);
+  if (!gst_buffer_pool_set_config (pool, config))
+    goto error;
+
+  GST_DEBUG_OBJECT (self, "Offering %u input buffers to upstream",
+      self->enc_in_port->buffers->len);
+  gst_omx_video_enc_replace_in_port_pool (self, gst_object_ref (pool));
+
+  return pool;
+
+error:
+  gst_object_unref (pool);
+  return NULL;
+}
+
 static gboolean
 gst_omx_video_enc_propose_allocation (GstVideoEncoder * encoder,
     GstQuery * query)
 {
   GstOMXVideoEnc *self = GST_OMX_VIDEO_ENC (encoder);
+  GstBufferPool *pool;
   guint num_buffers;
   GstCaps *caps;
   GstVideoInfo info;
@@ -2053,11 +2338,29 @@ gst_omx_video_enc_propose_allocation (GstVideoEncoder * encoder,
 
   gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
 
-  num_buffers = self->enc_in_port->port_def.nBufferCountMin + 1;
-  GST_DEBUG_OBJECT (self,
-      "request at least %d buffers of size %" G_GSIZE_FORMAT, num_buffers,
-      info.size);
-  gst_query_add_allocation_pool (query, NULL, info.size, num_buffers, 0);
+  GST_VIDEO_ENCODER_STREAM_LOCK (self);
+  pool = gst_omx_video_enc_get_in_port_pool (self, caps);
+  GST_VIDEO_ENCODER_STREAM_UNLOCK (self);
+
+  if (pool) {
+    GstStructure *config;
+    guint size;
+
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_get_params (config, NULL, &size, &num_buffers,
+        NULL);
+    gst_structure_free (config);
+
+    gst_query_add_allocation_pool (query, pool, size, num_buffers,
+        num_buffers);
+    gst_object_unref (pool);
+  } else {
+    num_buffers = self->enc_in_port->port_def.nBufferCountMin + 1;
+    GST_DEBUG_OBJECT (self,
+        "request at least %d buffers of size %" G_GSIZE_FORMAT, num_buffers,
+        info.size);
+    gst_query_add_allocation_pool (query, NULL, info.size, num_buffers, 0);
+  }
 
   return
       GST_VIDEO_ENCODER_CLASS
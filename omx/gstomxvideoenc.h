@@ -26,6 +26,7 @@
 #include <gst/video/gstvideoencoder.h>
 
 #include "gstomx.h"
+#include "gstomxvideo.h"
 
 G_BEGIN_DECLS
 
@@ -63,6 +64,10 @@ struct _GstOMXVideoEnc
 
   GstClockTime last_upstream_ts;
 
+  /* Frames passed to the component and not output yet, protected by
+   * the stream lock */
+  GstOMXVideoFrameIndex *frame_index;
+
   /* Draining state */
   GMutex drain_lock;
   GCond drain_cond;
@@ -75,10 +80,26 @@ struct _GstOMXVideoEnc
   guint32 quant_i_frames;
   guint32 quant_p_frames;
   guint32 quant_b_frames;
+  gboolean post_startup_timeline;
+
+  /* TRUE once the startup timeline was posted after opening */
+  gboolean startup_timeline_posted;
 
   GstFlowReturn downstream_flow_ret;
 
+  /* State changes of the component that are not waited for yet, they
+   * finish while other elements change their states. Only used from the
+   * streaming thread or with the stream lock */
+  GstOMXStateChanges state_changes;
+
   GstOMXBufferAllocation input_allocation;
+  /* Pool of the buffers of the input port, offered to upstream to
+   * render into them directly if the component allocates them */
+  GstBufferPool *in_port_pool;
+  /* FALSE once the input buffers were reallocated after being shared
+   * with upstream, they are not offered to upstream again until the
+   * next start. Protected by the stream lock */
+  gboolean share_input;
 };
 
 struct _GstOMXVideoEncClass
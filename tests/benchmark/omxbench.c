@@ -0,0 +1,968 @@
+/* GStreamer
+ *
+ * throughput and latency benchmark for the OpenMAX IL elements
+ *
+ * Copyright (C) 2026, RidgeRun
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Runs decoder and encoder pipelines against the mock OpenMAX IL core of
+ * tests/mockomx at several resolutions and buffer counts and reports,
+ * as JSON:
+ *
+ *   fps                    output frames per second
+ *   cpu_us_per_frame       process CPU time (user + system) per frame
+ *   latency_p50_us,
+ *   latency_p99_us         time between a buffer entering the element and
+ *                          the matching output buffer leaving it
+ *   allocations_per_frame  calls to the malloc family per frame, -1 if
+ *                          not supported on this platform
+ *   startup_us             time from PLAYING to the first output frame
+ *
+ * Everything but the startup time is measured between the first and the
+ * last output frame, so negotiation and buffer allocation do not skew the
+ * steady state numbers. The input is generated once and pushed from an
+ * appsrc without copying, so the numbers are dominated by the elements.
+ *
+ * The decoders are additionally run with repeated flushing seeks back to
+ * the start of the stream, the "-seek" results report
+ *
+ *   flush_p50_us,
+ *   flush_p99_us           time the flushing seek blocked the application
+ *   seek_p50_us,
+ *   seek_p99_us            time from the seek to the first output frame
+ *                          after it
+ *
+ * To compare against the Pause/Executing round-trip, run with a
+ * configuration without the flush-in-executing hack.
+ *
+ * The "video-decoder-copy" results are from a decoder whose output has
+ * strides fakesink can't handle, up to 8K and with an increasing number
+ * of "copy-workers", to show how the copies scale with the threads.
+ *
+ * The "video-decoder-acquire" results are from a decoder that splits every
+ * frame over many small input buffers, once with the fast path of
+ * gst_omx_port_acquire_buffers() and once without it, to show what
+ * acquiring buffers costs. Without it the mock core signals an event for
+ * every input buffer it returns, so every acquire goes through the
+ * message handling and all the checks again.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <gst/gst.h>
+
+#if defined (__GLIBC__)
+/* Count allocations by interposing the malloc family. The executable's
+ * definitions take precedence over the C library for all loaded
+ * libraries, including the plugins */
+#define HAVE_ALLOCATION_COUNTING 1
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+extern void *__libc_memalign (size_t alignment, size_t size);
+
+static volatile gint n_allocations = 0;
+
+void *
+malloc (size_t size)
+{
+  g_atomic_int_inc (&n_allocations);
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size)
+{
+  g_atomic_int_inc (&n_allocations);
+  return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+  g_atomic_int_inc (&n_allocations);
+  return __libc_realloc (ptr, size);
+}
+
+void *
+memalign (size_t alignment, size_t size)
+{
+  g_atomic_int_inc (&n_allocations);
+  return __libc_memalign (alignment, size);
+}
+
+void *
+aligned_alloc (size_t alignment, size_t size)
+{
+  g_atomic_int_inc (&n_allocations);
+  return __libc_memalign (alignment, size);
+}
+
+int
+posix_memalign (void **memptr, size_t alignment, size_t size)
+{
+  void *ptr;
+
+  if (alignment % sizeof (void *) != 0
+      || (alignment & (alignment - 1)) != 0)
+    return EINVAL;
+
+  g_atomic_int_inc (&n_allocations);
+  ptr = __libc_memalign (alignment, size);
+  if (!ptr)
+    return ENOMEM;
+
+  *memptr = ptr;
+  return 0;
+}
+#endif
+
+typedef enum
+{
+  BENCH_VIDEO_DECODER,
+  BENCH_VIDEO_DECODER_COPY,
+  BENCH_VIDEO_DECODER_ACQUIRE,
+  BENCH_VIDEO_ENCODER,
+  BENCH_AUDIO_DECODER,
+  BENCH_AUDIO_ENCODER,
+} BenchKind;
+
+typedef struct
+{
+  const gchar *name;
+  BenchKind kind;
+  const gchar *element;
+} BenchScenario;
+
+static const BenchScenario scenarios[] = {
+  {"video-decoder", BENCH_VIDEO_DECODER, "omxh264dec"},
+  {"video-decoder-copy", BENCH_VIDEO_DECODER_COPY, "omxh264dec"},
+  {"video-decoder-acquire", BENCH_VIDEO_DECODER_ACQUIRE, "omxh264dec"},
+  {"video-encoder", BENCH_VIDEO_ENCODER, "omxh264enc"},
+  {"audio-decoder", BENCH_AUDIO_DECODER, "omxaacdec"},
+  {"audio-encoder", BENCH_AUDIO_ENCODER, "omxaacenc"},
+};
+
+static const struct
+{
+  guint width, height;
+} resolutions[] = {
+  {320, 240},
+  {1280, 720},
+  {1920, 1080},
+};
+
+static const struct
+{
+  guint width, height;
+} copy_resolutions[] = {
+  {1920, 1080},
+  {3840, 2160},
+  {7680, 4320},
+};
+
+static const guint buffer_counts[] = { 2, 4, 8 };
+
+/* Buffers of the copy runs, and the stride alignment of the mock that
+ * pads the lines of all copy resolutions */
+#define COPY_BUFFERS 4
+#define COPY_STRIDE_ALIGN 4096
+
+/* Input buffers of the acquire runs, every frame needs
+ * ACQUIRE_FRAME_SIZE / ACQUIRE_BUFFER_SIZE of them */
+#define ACQUIRE_BUFFERS 16
+#define ACQUIRE_BUFFER_SIZE 1024
+#define ACQUIRE_FRAME_SIZE (64 * 1024)
+
+#define AUDIO_RATE 48000
+#define AUDIO_CHANNELS 2
+#define AUDIO_FRAME_SAMPLES 1024
+
+/* Output frames between two seeks */
+#define SEEK_INTERVAL_FRAMES 10
+#define SEEK_TIMEOUT (10 * G_TIME_SPAN_SECOND)
+
+/* When an input buffer entered the element */
+typedef struct
+{
+  GstClockTime pts;
+  gint64 time;
+} BenchInTime;
+
+typedef struct
+{
+  const BenchScenario *scenario;
+  guint width, height;
+  guint buffers;
+  guint n_frames;
+  guint n_seeks;
+  gint copy_workers;
+  gboolean acquire_fast_path;
+
+  /* Input */
+  GstBuffer *payload;
+  GstClockTime duration;
+  guint n_pushed;
+
+  /* Output, protected by lock */
+  GMutex lock;
+  GCond cond;
+  /* Indexed by frame number modulo n_in_times, time is 0 once the output
+   * was seen. Allocated before the run to not disturb the measurements */
+  BenchInTime *in_times;
+  guint n_in_times;
+  GArray *latencies;
+  guint n_out;
+  gint64 start_time;
+  gint64 first_time, last_time;
+  gint64 first_cpu, last_cpu;
+  gint first_allocations, last_allocations;
+
+  /* Seeking, protected by lock */
+  GArray *flush_latencies;
+  GArray *seek_latencies;
+  gint64 seek_time;
+  gboolean seek_flushed;
+  guint n_out_since_seek;
+} BenchRun;
+
+static gint64
+get_cpu_time (void)
+{
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_SELF, &usage) != 0)
+    return 0;
+
+  return (gint64) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) *
+      G_USEC_PER_SEC + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static gint
+get_allocations (void)
+{
+#ifdef HAVE_ALLOCATION_COUNTING
+  return g_atomic_int_get (&n_allocations);
+#else
+  return 0;
+#endif
+}
+
+static gboolean
+is_video (const BenchScenario * scenario)
+{
+  return scenario->kind == BENCH_VIDEO_DECODER
+      || scenario->kind == BENCH_VIDEO_DECODER_COPY
+      || scenario->kind == BENCH_VIDEO_DECODER_ACQUIRE
+      || scenario->kind == BENCH_VIDEO_ENCODER;
+}
+
+static GstCaps *
+bench_run_get_caps (BenchRun * run)
+{
+  switch (run->scenario->kind) {
+    case BENCH_VIDEO_DECODER:
+    case BENCH_VIDEO_DECODER_COPY:
+    case BENCH_VIDEO_DECODER_ACQUIRE:
+      return gst_caps_new_simple ("video/x-h264",
+          "stream-format", G_TYPE_STRING, "byte-stream",
+          "alignment", G_TYPE_STRING, "au",
+          "width", G_TYPE_INT, run->width, "height", G_TYPE_INT, run->height,
+          "framerate", GST_TYPE_FRACTION, 30, 1, NULL);
+    case BENCH_VIDEO_ENCODER:
+      return gst_caps_new_simple ("video/x-raw",
+          "format", G_TYPE_STRING, "NV12",
+          "width", G_TYPE_INT, run->width, "height", G_TYPE_INT, run->height,
+          "framerate", GST_TYPE_FRACTION, 30, 1, NULL);
+    case BENCH_AUDIO_DECODER:
+      return gst_caps_new_simple ("audio/mpeg",
+          "mpegversion", G_TYPE_INT, 4,
+          "stream-format", G_TYPE_STRING, "adts",
+          "framed", G_TYPE_BOOLEAN, TRUE,
+          "rate", G_TYPE_INT, AUDIO_RATE,
+          "channels", G_TYPE_INT, AUDIO_CHANNELS, NULL);
+    case BENCH_AUDIO_ENCODER:
+      return gst_caps_new_simple ("audio/x-raw",
+          "format", G_TYPE_STRING, "S16LE",
+          "layout", G_TYPE_STRING, "interleaved",
+          "rate", G_TYPE_INT, AUDIO_RATE,
+          "channels", G_TYPE_INT, AUDIO_CHANNELS,
+          "channel-mask", GST_TYPE_BITMASK, G_GUINT64_CONSTANT (0x3), NULL);
+  }
+
+  g_assert_not_reached ();
+  return NULL;
+}
+
+/* One input buffer that is pushed over and over again */
+static GstBuffer *
+bench_run_create_payload (BenchRun * run)
+{
+  GstBuffer *buf;
+  gsize size = 0;
+
+  switch (run->scenario->kind) {
+    case BENCH_VIDEO_DECODER:
+    case BENCH_VIDEO_DECODER_COPY:
+      size = MAX (run->width * run->height / 8, 64);
+      break;
+    case BENCH_VIDEO_DECODER_ACQUIRE:
+      size = ACQUIRE_FRAME_SIZE;
+      break;
+    case BENCH_VIDEO_ENCODER:
+      size = run->width * run->height * 3 / 2;
+      break;
+    case BENCH_AUDIO_DECODER:
+      size = 256;
+      break;
+    case BENCH_AUDIO_ENCODER:
+      size = AUDIO_FRAME_SAMPLES * AUDIO_CHANNELS * 2;
+      break;
+  }
+
+  buf = gst_buffer_new_allocate (NULL, size, NULL);
+  gst_buffer_memset (buf, 0, 0, size);
+
+  if (run->scenario->kind == BENCH_VIDEO_DECODER
+      || run->scenario->kind == BENCH_VIDEO_DECODER_COPY
+      || run->scenario->kind == BENCH_VIDEO_DECODER_ACQUIRE) {
+    static const guint8 idr[] = { 0x00, 0x00, 0x00, 0x01, 0x65, 0x88 };
+
+    gst_buffer_fill (buf, 0, idr, sizeof (idr));
+  } else if (run->scenario->kind == BENCH_AUDIO_DECODER) {
+    /* AAC LC, 48kHz, stereo */
+    guint8 adts[] = { 0xff, 0xf1, 0x4c, 0x80, 0x00, 0x00, 0xfc };
+
+    adts[3] |= (size >> 11) & 0x3;
+    adts[4] = (size >> 3) & 0xff;
+    adts[5] = ((size & 0x7) << 5) | 0x1f;
+    gst_buffer_fill (buf, 0, adts, sizeof (adts));
+  }
+
+  return buf;
+}
+
+static void
+bench_need_data (GstElement * src, guint length, BenchRun * run)
+{
+  GstBuffer *buf;
+  GstFlowReturn flow;
+
+  if (run->n_pushed >= run->n_frames) {
+    g_signal_emit_by_name (src, "end-of-stream", &flow);
+    return;
+  }
+
+  /* Only copies the metadata, the memory is shared */
+  buf = gst_buffer_copy (run->payload);
+  GST_BUFFER_PTS (buf) = run->n_pushed * run->duration;
+  GST_BUFFER_DURATION (buf) = run->duration;
+  g_signal_emit_by_name (src, "push-buffer", buf, &flow);
+  gst_buffer_unref (buf);
+
+  run->n_pushed++;
+}
+
+/* Flushing seeks are always back to the start, the position is in
+ * nanoseconds as the appsrc is in time format */
+static gboolean
+bench_seek_data (GstElement * src, guint64 position, BenchRun * run)
+{
+  run->n_pushed = position / run->duration;
+
+  return TRUE;
+}
+
+/* The input timestamps are multiples of the frame duration */
+static BenchInTime *
+bench_run_get_in_time (BenchRun * run, GstClockTime pts)
+{
+  return &run->in_times[(pts / run->duration) % run->n_in_times];
+}
+
+static GstPadProbeReturn
+bench_sink_probe (GstPad * pad, GstPadProbeInfo * info, BenchRun * run)
+{
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+  gint64 now = g_get_monotonic_time ();
+  BenchInTime *in_time;
+
+  if (!GST_BUFFER_PTS_IS_VALID (buf))
+    return GST_PAD_PROBE_OK;
+
+  g_mutex_lock (&run->lock);
+  in_time = bench_run_get_in_time (run, GST_BUFFER_PTS (buf));
+  in_time->pts = GST_BUFFER_PTS (buf);
+  in_time->time = now;
+  g_mutex_unlock (&run->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+bench_src_probe (GstPad * pad, GstPadProbeInfo * info, BenchRun * run)
+{
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstClockTime pts = GST_BUFFER_PTS (buf);
+  gint64 now = g_get_monotonic_time ();
+  gint64 cpu = get_cpu_time ();
+  gint allocations = get_allocations ();
+  BenchInTime *in_time;
+
+  g_mutex_lock (&run->lock);
+  if (run->n_out == 0) {
+    run->first_time = now;
+    run->first_cpu = cpu;
+    run->first_allocations = allocations;
+  }
+  run->last_time = now;
+  run->last_cpu = cpu;
+  run->last_allocations = allocations;
+  run->n_out++;
+
+  if (run->seek_time > 0 && run->seek_flushed) {
+    gint64 latency = now - run->seek_time;
+
+    g_array_append_val (run->seek_latencies, latency);
+    run->seek_time = 0;
+  }
+  run->n_out_since_seek++;
+  g_cond_signal (&run->cond);
+
+  /* Decoders and encoders keep the timestamps of their input */
+  if (GST_BUFFER_PTS_IS_VALID (buf)) {
+    in_time = bench_run_get_in_time (run, pts);
+    if (in_time->time > 0 && in_time->pts == pts) {
+      gint64 latency = now - in_time->time;
+
+      g_array_append_val (run->latencies, latency);
+      in_time->time = 0;
+    }
+  }
+  g_mutex_unlock (&run->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+bench_src_event_probe (GstPad * pad, GstPadProbeInfo * info, BenchRun * run)
+{
+  GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP) {
+    g_mutex_lock (&run->lock);
+    run->seek_flushed = TRUE;
+    g_mutex_unlock (&run->lock);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Waits until the element produced some frames since the last seek,
+ * returns FALSE on timeout */
+static gboolean
+bench_run_wait_frames (BenchRun * run)
+{
+  gint64 deadline = g_get_monotonic_time () + SEEK_TIMEOUT;
+  gboolean ret = TRUE;
+
+  g_mutex_lock (&run->lock);
+  while (ret && (run->n_out_since_seek < SEEK_INTERVAL_FRAMES
+          || run->seek_time > 0))
+    ret = g_cond_wait_until (&run->cond, &run->lock, deadline);
+  g_mutex_unlock (&run->lock);
+
+  return ret;
+}
+
+static gboolean
+bench_run_seeks (BenchRun * run, GstElement * pipeline, GstElement * src)
+{
+  GstFlowReturn flow;
+  guint i;
+
+  for (i = 0; i < run->n_seeks; i++) {
+    gint64 start, flush;
+
+    if (!bench_run_wait_frames (run)) {
+      g_printerr ("Timeout waiting for output before seek %u\n", i);
+      return FALSE;
+    }
+
+    start = g_get_monotonic_time ();
+    g_mutex_lock (&run->lock);
+    run->seek_time = start;
+    run->seek_flushed = FALSE;
+    run->n_out_since_seek = 0;
+    g_mutex_unlock (&run->lock);
+
+    if (!gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+            GST_SEEK_FLAG_FLUSH, 0)) {
+      g_printerr ("Seek %u failed\n", i);
+      return FALSE;
+    }
+
+    flush = g_get_monotonic_time () - start;
+    g_mutex_lock (&run->lock);
+    g_array_append_val (run->flush_latencies, flush);
+    g_mutex_unlock (&run->lock);
+  }
+
+  if (!bench_run_wait_frames (run)) {
+    g_printerr ("Timeout waiting for output after the last seek\n");
+    return FALSE;
+  }
+
+  g_signal_emit_by_name (src, "end-of-stream", &flow);
+
+  return TRUE;
+}
+
+static gboolean
+bench_run_pipeline (BenchRun * run, GstElement * pipeline, GstElement * src)
+{
+  GstBus *bus;
+  GstMessage *msg;
+  gboolean ret = FALSE;
+
+  run->start_time = g_get_monotonic_time ();
+  if (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    g_printerr ("Failed to start the pipeline\n");
+    return FALSE;
+  }
+
+  if (run->n_seeks > 0 && !bench_run_seeks (run, pipeline, src)) {
+    gst_element_set_state (pipeline, GST_STATE_NULL);
+    return FALSE;
+  }
+
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    GError *err = NULL;
+    gchar *debug = NULL;
+
+    gst_message_parse_error (msg, &err, &debug);
+    g_printerr ("Error from %s: %s (%s)\n", GST_MESSAGE_SRC_NAME (msg),
+        err->message, GST_STR_NULL (debug));
+    g_error_free (err);
+    g_free (debug);
+  } else {
+    ret = TRUE;
+  }
+
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+
+  return ret;
+}
+
+static gint
+compare_latency (gconstpointer a, gconstpointer b)
+{
+  gint64 la = *(const gint64 *) a;
+  gint64 lb = *(const gint64 *) b;
+
+  return la < lb ? -1 : (la > lb ? 1 : 0);
+}
+
+/* latencies must be sorted */
+static gint64
+get_percentile (GArray * latencies, guint percentile)
+{
+  if (latencies->len == 0)
+    return -1;
+
+  return g_array_index (latencies, gint64,
+      (latencies->len - 1) * percentile / 100);
+}
+
+static void
+bench_run_append_json (BenchRun * run, GString * json)
+{
+  gdouble elapsed, fps = 0.0, cpu = 0.0, allocations = -1.0;
+  guint n_intervals;
+  gchar fps_str[G_ASCII_DTOSTR_BUF_SIZE];
+  gchar cpu_str[G_ASCII_DTOSTR_BUF_SIZE];
+  gchar allocations_str[G_ASCII_DTOSTR_BUF_SIZE];
+  gchar *variant_str;
+
+  g_array_sort (run->latencies, compare_latency);
+
+  n_intervals = run->n_out > 1 ? run->n_out - 1 : 0;
+  elapsed = run->last_time - run->first_time;
+  if (n_intervals > 0 && elapsed > 0) {
+    fps = n_intervals * (gdouble) G_USEC_PER_SEC / elapsed;
+    cpu = (run->last_cpu - run->first_cpu) / (gdouble) n_intervals;
+#ifdef HAVE_ALLOCATION_COUNTING
+    allocations = (run->last_allocations - run->first_allocations) /
+        (gdouble) n_intervals;
+#endif
+  }
+
+  g_ascii_formatd (fps_str, sizeof (fps_str), "%.2f", fps);
+  g_ascii_formatd (cpu_str, sizeof (cpu_str), "%.2f", cpu);
+  g_ascii_formatd (allocations_str, sizeof (allocations_str), "%.2f",
+      allocations);
+  if (run->scenario->kind == BENCH_VIDEO_DECODER_COPY)
+    variant_str = g_strdup_printf ("      \"copy_workers\": %d,\n",
+        run->copy_workers);
+  else if (run->scenario->kind == BENCH_VIDEO_DECODER_ACQUIRE)
+    variant_str = g_strdup_printf ("      \"acquire_fast_path\": %s,\n"
+        "      \"acquires_per_frame\": %u,\n",
+        run->acquire_fast_path ? "true" : "false",
+        ACQUIRE_FRAME_SIZE / ACQUIRE_BUFFER_SIZE);
+  else
+    variant_str = g_strdup ("");
+
+  g_string_append_printf (json,
+      "    {\n"
+      "      \"name\": \"%s\",\n"
+      "      \"element\": \"%s\",\n"
+      "      \"width\": %u,\n"
+      "      \"height\": %u,\n"
+      "      \"buffers\": %u,\n"
+      "%s"
+      "      \"frames\": %u,\n"
+      "      \"fps\": %s,\n"
+      "      \"cpu_us_per_frame\": %s,\n"
+      "      \"latency_p50_us\": %" G_GINT64_FORMAT ",\n"
+      "      \"latency_p99_us\": %" G_GINT64_FORMAT ",\n"
+      "      \"allocations_per_frame\": %s,\n"
+      "      \"startup_us\": %" G_GINT64_FORMAT "\n"
+      "    }",
+      run->scenario->name, run->scenario->element, run->width, run->height,
+      run->buffers, variant_str, run->n_out, fps_str, cpu_str,
+      get_percentile (run->latencies, 50), get_percentile (run->latencies, 99),
+      allocations_str, run->n_out > 0 ? run->first_time - run->start_time : -1);
+
+  g_free (variant_str);
+}
+
+static void
+bench_run_append_seek_json (BenchRun * run, GString * json)
+{
+  g_array_sort (run->flush_latencies, compare_latency);
+  g_array_sort (run->seek_latencies, compare_latency);
+
+  g_string_append_printf (json,
+      "    {\n"
+      "      \"name\": \"%s-seek\",\n"
+      "      \"element\": \"%s\",\n"
+      "      \"width\": %u,\n"
+      "      \"height\": %u,\n"
+      "      \"buffers\": %u,\n"
+      "      \"seeks\": %u,\n"
+      "      \"flush_p50_us\": %" G_GINT64_FORMAT ",\n"
+      "      \"flush_p99_us\": %" G_GINT64_FORMAT ",\n"
+      "      \"seek_p50_us\": %" G_GINT64_FORMAT ",\n"
+      "      \"seek_p99_us\": %" G_GINT64_FORMAT "\n"
+      "    }",
+      run->scenario->name, run->scenario->element, run->width, run->height,
+      run->buffers, run->n_seeks,
+      get_percentile (run->flush_latencies, 50),
+      get_percentile (run->flush_latencies, 99),
+      get_percentile (run->seek_latencies, 50),
+      get_percentile (run->seek_latencies, 99));
+}
+
+/* Runs n_frames through the element, or if n_seeks is not 0 seeks back
+ * n_seeks times to the start after some frames. variant is the number of
+ * copy workers of the copy scenario and whether the acquire scenario uses
+ * the fast path, it is not used otherwise */
+static gboolean
+bench_run (const BenchScenario * scenario, guint width, guint height,
+    guint buffers, guint n_frames, guint n_seeks, gint variant,
+    GString * json)
+{
+  BenchRun run = { 0, };
+  GstElement *pipeline, *src, *element;
+  GstPad *pad;
+  GstCaps *caps;
+  gchar *description, *options;
+  GError *err = NULL;
+  gboolean ret;
+
+  run.scenario = scenario;
+  run.width = width;
+  run.height = height;
+  run.buffers = buffers;
+  run.n_frames = n_seeks > 0 ? G_MAXUINT : n_frames;
+  run.n_seeks = n_seeks;
+  run.copy_workers = variant;
+  run.acquire_fast_path = scenario->kind != BENCH_VIDEO_DECODER_ACQUIRE
+      || variant;
+  run.duration = is_video (scenario) ?
+      gst_util_uint64_scale (1, GST_SECOND, 30) :
+      gst_util_uint64_scale (AUDIO_FRAME_SAMPLES, GST_SECOND, AUDIO_RATE);
+  run.payload = bench_run_create_payload (&run);
+  /* With seeks the same frame numbers are used again after every seek, far
+   * less than n_frames of them are in flight at any time */
+  run.n_in_times = MAX (n_frames, 1);
+  run.in_times = g_new0 (BenchInTime, run.n_in_times);
+  run.latencies = g_array_sized_new (FALSE, FALSE, sizeof (gint64), n_frames);
+  run.flush_latencies =
+      g_array_sized_new (FALSE, FALSE, sizeof (gint64), n_seeks);
+  run.seek_latencies =
+      g_array_sized_new (FALSE, FALSE, sizeof (gint64), n_seeks);
+  g_mutex_init (&run.lock);
+  g_cond_init (&run.cond);
+
+  if (scenario->kind == BENCH_VIDEO_DECODER_COPY) {
+    options = g_strdup_printf ("in-buffers=%u,out-buffers=%u,stride-align=%u",
+        buffers, buffers, COPY_STRIDE_ALIGN);
+    description = g_strdup_printf ("appsrc name=src format=time ! "
+        "%s name=omx copy-workers=%d ! fakesink sync=false",
+        scenario->element, run.copy_workers);
+  } else if (scenario->kind == BENCH_VIDEO_DECODER_ACQUIRE) {
+    options = g_strdup_printf ("in-buffers=%u,in-buffer-size=%u,"
+        "out-buffers=%u,flag-events=%d", buffers, ACQUIRE_BUFFER_SIZE,
+        buffers, !run.acquire_fast_path);
+    description = g_strdup_printf ("appsrc name=src format=time ! "
+        "%s name=omx ! fakesink sync=false", scenario->element);
+  } else {
+    options = g_strdup_printf ("in-buffers=%u,out-buffers=%u", buffers,
+        buffers);
+    description = g_strdup_printf ("appsrc name=src format=time ! "
+        "%s name=omx ! fakesink sync=false", scenario->element);
+  }
+  g_setenv ("MOCKOMX_OPTIONS", options, TRUE);
+  g_free (options);
+
+  pipeline = gst_parse_launch (description, &err);
+  g_free (description);
+  if (!pipeline) {
+    g_printerr ("Failed to create the %s pipeline: %s\n", scenario->name,
+        err ? err->message : "unknown error");
+    g_clear_error (&err);
+    ret = FALSE;
+    goto done;
+  }
+  g_clear_error (&err);
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  caps = bench_run_get_caps (&run);
+  g_object_set (src, "caps", caps, NULL);
+  gst_caps_unref (caps);
+  g_signal_connect (src, "need-data", G_CALLBACK (bench_need_data), &run);
+  if (n_seeks > 0) {
+    gst_util_set_object_arg (G_OBJECT (src), "stream-type", "seekable");
+    g_signal_connect (src, "seek-data", G_CALLBACK (bench_seek_data), &run);
+  }
+
+  element = gst_bin_get_by_name (GST_BIN (pipeline), "omx");
+  pad = gst_element_get_static_pad (element, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) bench_sink_probe, &run, NULL);
+  gst_object_unref (pad);
+  pad = gst_element_get_static_pad (element, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) bench_src_probe, &run, NULL);
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+      (GstPadProbeCallback) bench_src_event_probe, &run, NULL);
+  gst_object_unref (pad);
+  gst_object_unref (element);
+
+  ret = bench_run_pipeline (&run, pipeline, src);
+  gst_object_unref (src);
+  gst_object_unref (pipeline);
+
+  if (ret) {
+    if (json->len > 0 && json->str[json->len - 1] == '}')
+      g_string_append (json, ",\n");
+    if (n_seeks > 0)
+      bench_run_append_seek_json (&run, json);
+    else
+      bench_run_append_json (&run, json);
+  } else {
+    g_printerr ("%s%s %ux%u with %u buffers failed\n", scenario->name,
+        n_seeks > 0 ? "-seek" : "", width, height, buffers);
+  }
+
+done:
+  g_cond_clear (&run.cond);
+  g_mutex_clear (&run.lock);
+  g_array_unref (run.seek_latencies);
+  g_array_unref (run.flush_latencies);
+  g_array_unref (run.latencies);
+  g_free (run.in_times);
+  gst_buffer_unref (run.payload);
+
+  return ret;
+}
+
+int
+main (int argc, char **argv)
+{
+  gchar *output = NULL, *filter = NULL;
+  gint n_frames = 300, n_seeks = 50;
+  GOptionEntry options[] = {
+    {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+        "Write the results to FILE instead of stdout", "FILE"},
+    {"frames", 'n', 0, G_OPTION_ARG_INT, &n_frames,
+        "Number of frames per run (default: 300)", "N"},
+    {"filter", 'f', 0, G_OPTION_ARG_STRING, &filter,
+        "Only run the scenarios whose name contains STRING", "STRING"},
+    {"seeks", 's', 0, G_OPTION_ARG_INT, &n_seeks,
+        "Number of seeks per decoder seek run, 0 to disable (default: 50)",
+        "N"},
+    {NULL}
+  };
+  GOptionContext *ctx;
+  GString *json, *results;
+  GError *err = NULL;
+  gboolean ok = TRUE;
+  gint max_copy_workers;
+  guint i, j, k;
+
+  /* Use the mock core unless told otherwise. Needs to be set before the
+   * plugin is loaded */
+  if (!g_getenv ("GST_OMX_CONFIG_DIR"))
+    g_setenv ("GST_OMX_CONFIG_DIR", MOCKOMX_CONFIG_DIR, TRUE);
+
+  ctx = g_option_context_new ("- benchmark the OpenMAX IL elements");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Failed to parse options: %s\n", err->message);
+    g_clear_error (&err);
+    g_option_context_free (ctx);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (n_frames < 2) {
+    g_printerr ("At least 2 frames are needed\n");
+    return 1;
+  }
+
+  results = g_string_new (NULL);
+  for (i = 0; i < G_N_ELEMENTS (scenarios); i++) {
+    const BenchScenario *scenario = &scenarios[i];
+    guint n_resolutions = is_video (scenario) ? G_N_ELEMENTS (resolutions) : 1;
+
+    if (scenario->kind == BENCH_VIDEO_DECODER_COPY
+        || scenario->kind == BENCH_VIDEO_DECODER_ACQUIRE
+        || (filter && !strstr (scenario->name, filter)))
+      continue;
+
+    for (j = 0; j < n_resolutions; j++) {
+      for (k = 0; k < G_N_ELEMENTS (buffer_counts); k++) {
+        guint width = is_video (scenario) ? resolutions[j].width : 0;
+        guint height = is_video (scenario) ? resolutions[j].height : 0;
+
+        ok &= bench_run (scenario, width, height, buffer_counts[k], n_frames,
+            0, -1, results);
+      }
+    }
+  }
+
+  /* 0, 1, 3, 7, ... copy workers up to all other cores */
+  max_copy_workers = MAX (g_get_num_processors () - 1, 0);
+  for (i = 0; i < G_N_ELEMENTS (scenarios); i++) {
+    const BenchScenario *scenario = &scenarios[i];
+
+    if (scenario->kind != BENCH_VIDEO_DECODER_COPY
+        || (filter && !strstr (scenario->name, filter)))
+      continue;
+
+    for (j = 0; j < G_N_ELEMENTS (copy_resolutions); j++) {
+      gint copy_workers = 0;
+
+      while (TRUE) {
+        ok &= bench_run (scenario, copy_resolutions[j].width,
+            copy_resolutions[j].height, COPY_BUFFERS, n_frames, 0,
+            copy_workers, results);
+
+        if (copy_workers == max_copy_workers)
+          break;
+        copy_workers = MIN (2 * copy_workers + 1, max_copy_workers);
+      }
+    }
+  }
+
+  /* With and without the fast path */
+  for (i = 0; i < G_N_ELEMENTS (scenarios); i++) {
+    const BenchScenario *scenario = &scenarios[i];
+
+    if (scenario->kind != BENCH_VIDEO_DECODER_ACQUIRE
+        || (filter && !strstr (scenario->name, filter)))
+      continue;
+
+    for (k = 0; k < 2; k++)
+      ok &= bench_run (scenario, resolutions[0].width, resolutions[0].height,
+          ACQUIRE_BUFFERS, n_frames, 0, k == 0, results);
+  }
+
+  for (i = 0; i < G_N_ELEMENTS (scenarios) && n_seeks > 0; i++) {
+    const BenchScenario *scenario = &scenarios[i];
+    gchar *name;
+    gboolean skip;
+
+    if (scenario->kind != BENCH_VIDEO_DECODER
+        && scenario->kind != BENCH_AUDIO_DECODER)
+      continue;
+
+    name = g_strconcat (scenario->name, "-seek", NULL);
+    skip = filter && !strstr (name, filter);
+    g_free (name);
+    if (skip)
+      continue;
+
+    for (k = 0; k < G_N_ELEMENTS (buffer_counts); k++) {
+      guint width = is_video (scenario) ? resolutions[0].width : 0;
+      guint height = is_video (scenario) ? resolutions[0].height : 0;
+
+      ok &= bench_run (scenario, width, height, buffer_counts[k], n_frames,
+          n_seeks, -1, results);
+    }
+  }
+
+  json = g_string_new ("{\n  \"results\": [\n");
+  g_string_append (json, results->str);
+  g_string_append (json, "\n  ]\n}\n");
+  g_string_free (results, TRUE);
+
+  if (output) {
+    if (!g_file_set_contents (output, json->str, json->len, &err)) {
+      g_printerr ("Failed to write %s: %s\n", output, err->message);
+      g_clear_error (&err);
+      ok = FALSE;
+    }
+  } else {
+    g_print ("%s", json->str);
+  }
+
+  g_string_free (json, TRUE);
+  g_free (output);
+  g_free (filter);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,255 @@
+/* GStreamer
+ *
+ * unit tests for the plane copy kernels
+ *
+ * Copyright (C) 2026, RidgeRun
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+
+/* The kernels are internal to the plugin */
+#include "../../../omx/gstomxcopy.c"
+
+#define PADDING_BYTE 0xa5
+
+/* Copies a plane with impl from a source at offset bytes from an aligned
+ * address and checks every line against the source, and that the padding
+ * of the destination was not touched */
+static void
+check_copy (GstOMXCopyImpl impl, gint width, gint height, gint offset,
+    gboolean streaming)
+{
+  gint src_stride = width + offset + 13;
+  gint dest_stride = width + 3 * offset + 7;
+  guint8 *src, *dest;
+  gint x, y;
+
+  src = g_malloc (src_stride * height + 64);
+  dest = g_malloc (dest_stride * height + 64);
+  for (x = 0; x < src_stride * height + 64; x++)
+    src[x] = g_random_int ();
+  memset (dest, PADDING_BYTE, dest_stride * height + 64);
+
+  fail_unless (gst_omx_copy_plane_with_impl (impl, dest + 5 * offset,
+          dest_stride, src + offset, src_stride, width, height, streaming));
+
+  for (y = 0; y < height; y++) {
+    const guint8 *s = src + offset + y * src_stride;
+    const guint8 *d = dest + 5 * offset + y * dest_stride;
+
+    fail_unless (memcmp (d, s, width) == 0, "%s copy of line %d differs "
+        "(width %d, offset %d, streaming %d)", impl_names[impl], y, width,
+        offset, streaming);
+    for (x = width; x < dest_stride; x++)
+      fail_unless_equals_int (d[x], PADDING_BYTE);
+  }
+  for (x = 0; x < 5 * offset; x++)
+    fail_unless_equals_int (dest[x], PADDING_BYTE);
+
+  g_free (src);
+  g_free (dest);
+}
+
+/* Every kernel the CPU supports produces the same output as memcpy(),
+ * for widths around the vector sizes and misaligned lines */
+GST_START_TEST (test_copy_kernels)
+{
+  static const gint widths[] = { 1, 15, 16, 17, 31, 32, 33, 63, 64, 65,
+    127, 128, 129, 176, 352, 1283, 1920
+  };
+  gint impl, streaming, offset;
+  guint i;
+
+  for (impl = 0; impl < GST_OMX_COPY_IMPL_LAST; impl++) {
+    if (!gst_omx_copy_impl_is_supported (impl)) {
+      GST_INFO ("Skipping unsupported %s copies", impl_names[impl]);
+      continue;
+    }
+
+    for (streaming = 0; streaming <= 1; streaming++)
+      for (i = 0; i < G_N_ELEMENTS (widths); i++)
+        for (offset = 0; offset < 4; offset++)
+          check_copy (impl, widths[i], 5, offset, streaming);
+  }
+}
+
+GST_END_TEST;
+
+/* Planes without padding are copied in one go */
+GST_START_TEST (test_copy_contiguous)
+{
+  guint8 src[64 * 48], dest[64 * 48];
+  guint i;
+
+  for (i = 0; i < sizeof (src); i++)
+    src[i] = i;
+
+  gst_omx_copy_init ();
+  gst_omx_copy_plane (dest, 64, src, 64, 64, 48, FALSE);
+  fail_unless (memcmp (dest, src, sizeof (src)) == 0);
+
+  memset (dest, 0, sizeof (dest));
+  gst_omx_copy_plane (dest, 64, src, 64, 64, 48, TRUE);
+  fail_unless (memcmp (dest, src, sizeof (src)) == 0);
+}
+
+GST_END_TEST;
+
+/* The best supported kernel is used unless the environment asks for
+ * another supported one */
+GST_START_TEST (test_copy_select)
+{
+  GstOMXCopyImpl best;
+
+  g_unsetenv ("GST_OMX_COPY");
+  gst_omx_copy_init ();
+  best = copy_impl;
+  fail_unless (gst_omx_copy_impl_is_supported (best));
+
+  g_setenv ("GST_OMX_COPY", "scalar", TRUE);
+  gst_omx_copy_init ();
+  fail_unless_equals_int (copy_impl, GST_OMX_COPY_IMPL_SCALAR);
+
+  g_setenv ("GST_OMX_COPY", "unknown", TRUE);
+  gst_omx_copy_init ();
+  fail_unless_equals_int (copy_impl, best);
+
+  g_unsetenv ("GST_OMX_COPY");
+}
+
+GST_END_TEST;
+
+/* Frames split into bands for several threads are copied like with one
+ * thread, also if the bands span several planes */
+GST_START_TEST (test_copy_pool)
+{
+  static const guint thread_counts[] = { 1, 2, 3, 7 };
+  const gint width = 1920, height = 1080, src_stride = 2048;
+  gsize src_size = src_stride * height * 3 / 2;
+  gsize dest_size = width * height * 3 / 2;
+  guint8 *src, *dest;
+  guint i;
+  gint y;
+
+  src = g_malloc (src_size);
+  dest = g_malloc (dest_size);
+  for (i = 0; i < src_size; i++)
+    src[i] = g_random_int ();
+
+  for (i = 0; i < G_N_ELEMENTS (thread_counts); i++) {
+    GstOMXCopyPool *pool = gst_omx_copy_pool_new (thread_counts[i]);
+    GstOMXCopyPlane planes[2] = {
+      {dest, width, src, src_stride, width, height},
+      {dest + width * height, width, src + src_stride * height, src_stride,
+          width, height / 2},
+    };
+
+    fail_unless (pool != NULL);
+    fail_unless_equals_int (gst_omx_copy_pool_get_n_threads (pool),
+        thread_counts[i]);
+
+    /* NV12 with padded lines */
+    memset (dest, 0, dest_size);
+    gst_omx_copy_planes (pool, planes, 2, FALSE);
+    for (y = 0; y < height * 3 / 2; y++)
+      fail_unless (memcmp (dest + y * width, src + y * src_stride,
+              width) == 0, "Line %d differs with %u threads", y,
+          thread_counts[i]);
+
+    /* Everything, with an odd size */
+    memset (dest, 0, dest_size);
+    gst_omx_copy_memory (pool, dest, src, dest_size - 1, TRUE);
+    fail_unless (memcmp (dest, src, dest_size - 1) == 0);
+    fail_unless_equals_int (dest[dest_size - 1], 0);
+
+    gst_omx_copy_pool_free (pool);
+  }
+
+  g_free (src);
+  g_free (dest);
+}
+
+GST_END_TEST;
+
+#define SHARED_COPY_SIZE (4 * 1024 * 1024)
+
+/* Copies through a pool of its own and returns TRUE if all copies were
+ * correct */
+static gpointer
+copy_with_pool (const guint8 * src)
+{
+  GstOMXCopyPool *pool = gst_omx_copy_pool_new (3);
+  guint8 *dest = g_malloc (SHARED_COPY_SIZE);
+  gboolean ok = TRUE;
+  guint i;
+
+  for (i = 0; i < 10 && ok; i++) {
+    memset (dest, 0, SHARED_COPY_SIZE);
+    gst_omx_copy_memory (pool, dest, src, SHARED_COPY_SIZE, FALSE);
+    ok = memcmp (dest, src, SHARED_COPY_SIZE) == 0;
+  }
+
+  gst_omx_copy_pool_free (pool);
+  g_free (dest);
+
+  return GINT_TO_POINTER (ok);
+}
+
+/* The bands of pools used at the same time from several threads all go
+ * to the same helper threads */
+GST_START_TEST (test_copy_pool_shared)
+{
+  GThread *threads[4];
+  guint8 *src;
+  guint i;
+
+  src = g_malloc (SHARED_COPY_SIZE);
+  for (i = 0; i < SHARED_COPY_SIZE; i++)
+    src[i] = g_random_int ();
+
+  for (i = 0; i < G_N_ELEMENTS (threads); i++)
+    threads[i] = g_thread_new ("copy", (GThreadFunc) copy_with_pool, src);
+  for (i = 0; i < G_N_ELEMENTS (threads); i++)
+    fail_unless (g_thread_join (threads[i]), "Copy %u differs", i);
+
+  g_free (src);
+}
+
+GST_END_TEST;
+
+static Suite *
+copy_suite (void)
+{
+  Suite *s = suite_create ("copy");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_copy_kernels);
+  tcase_add_test (tc_chain, test_copy_contiguous);
+  tcase_add_test (tc_chain, test_copy_select);
+  tcase_add_test (tc_chain, test_copy_pool);
+  tcase_add_test (tc_chain, test_copy_pool_shared);
+
+  return s;
+}
+
+GST_CHECK_MAIN (copy);
@@ -0,0 +1,1758 @@
+/* GStreamer
+ *
+ * unit tests running the elements against the mock OpenMAX IL core
+ *
+ * Copyright (C) 2026, RidgeRun
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideodecoder.h>
+#include <gmodule.h>
+
+#include "../../mockomx/mockomx.h"
+
+#define PIPELINE_TIMEOUT (10 * GST_SECOND)
+
+/* Runs a pipeline until EOS or an error and returns the type of the
+ * message that stopped it */
+static GstMessageType
+run_pipeline (GstElement * pipeline)
+{
+  GstBus *bus;
+  GstMessage *msg;
+  GstMessageType type;
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_ASYNC);
+
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, PIPELINE_TIMEOUT,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL, "Pipeline timed out");
+
+  type = GST_MESSAGE_TYPE (msg);
+  if (type == GST_MESSAGE_ERROR) {
+    GError *err = NULL;
+    gchar *debug = NULL;
+
+    gst_message_parse_error (msg, &err, &debug);
+    GST_INFO ("Pipeline error from %s: %s (%s)", GST_MESSAGE_SRC_NAME (msg),
+        err->message, GST_STR_NULL (debug));
+    g_error_free (err);
+    g_free (debug);
+  }
+
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+
+  return type;
+}
+
+static GstMessageType
+run_pipeline_description (const gchar * description)
+{
+  GstElement *pipeline;
+  GstMessageType type;
+  GError *err = NULL;
+
+  GST_INFO ("Running '%s'", description);
+  pipeline = gst_parse_launch (description, &err);
+  fail_unless (pipeline != NULL, "Failed to create '%s': %s", description,
+      err ? err->message : "unknown error");
+  g_clear_error (&err);
+
+  type = run_pipeline (pipeline);
+  gst_object_unref (pipeline);
+
+  return type;
+}
+
+static void
+teardown (void)
+{
+  g_unsetenv ("MOCKOMX_OPTIONS");
+}
+
+GST_START_TEST (test_mockomx_video_enc_dec)
+{
+  fail_unless_equals_int (run_pipeline_description
+      ("videotestsrc num-buffers=60 ! "
+          "video/x-raw,format=NV12,width=320,height=240,framerate=30/1 ! "
+          "omxh264enc ! omxh264dec ! fakesink"), GST_MESSAGE_EOS);
+}
+
+GST_END_TEST;
+
+static GstPadProbeReturn
+count_pooled_probe (GstPad * pad, GstPadProbeInfo * info, guint * n_pooled)
+{
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  if (buffer->pool
+      && g_strcmp0 (G_OBJECT_TYPE_NAME (buffer->pool), "GstOMXBufferPool") == 0)
+    (*n_pooled)++;
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* The encoder offers its input buffers to upstream, which renders into
+ * them directly */
+GST_START_TEST (test_mockomx_video_enc_input_pool)
+{
+  GstElement *pipeline, *enc;
+  GstPad *pad;
+  GError *err = NULL;
+  guint n_pooled = 0;
+
+  pipeline = gst_parse_launch ("videotestsrc num-buffers=60 ! "
+      "video/x-raw,format=I420,width=320,height=240,framerate=30/1 ! "
+      "omxh264enc name=enc ! omxh264dec ! fakesink", &err);
+  fail_unless (pipeline != NULL, "Failed to create pipeline: %s",
+      err ? err->message : "unknown error");
+  g_clear_error (&err);
+
+  enc = gst_bin_get_by_name (GST_BIN (pipeline), "enc");
+  pad = gst_element_get_static_pad (enc, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) count_pooled_probe, &n_pooled, NULL);
+  gst_object_unref (pad);
+  gst_object_unref (enc);
+
+  fail_unless_equals_int (run_pipeline (pipeline), GST_MESSAGE_EOS);
+  fail_unless_equals_int (n_pooled, 60);
+
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
+/* New input port settings while upstream renders into the input pool
+ * make the encoder reallocate private input buffers, upstream continues
+ * with buffers from elsewhere */
+GST_START_TEST (test_mockomx_video_enc_input_pool_reconfigure)
+{
+  GstElement *pipeline, *enc;
+  GstPad *pad;
+  GError *err = NULL;
+  guint n_pooled = 0;
+
+  g_setenv ("MOCKOMX_OPTIONS", "in-psc-after=10", TRUE);
+
+  pipeline = gst_parse_launch ("videotestsrc num-buffers=60 ! "
+      "video/x-raw,format=I420,width=320,height=240,framerate=30/1 ! "
+      "omxh264enc name=enc ! fakesink", &err);
+  fail_unless (pipeline != NULL, "Failed to create pipeline: %s",
+      err ? err->message : "unknown error");
+  g_clear_error (&err);
+
+  enc = gst_bin_get_by_name (GST_BIN (pipeline), "enc");
+  pad = gst_element_get_static_pad (enc, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) count_pooled_probe, &n_pooled, NULL);
+  gst_object_unref (pad);
+  gst_object_unref (enc);
+
+  fail_unless_equals_int (run_pipeline (pipeline), GST_MESSAGE_EOS);
+  fail_unless (n_pooled >= 10);
+  fail_unless (n_pooled < 60);
+
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
+/* The decoder offers its input buffers to upstream elements asking for
+ * them. Frames larger than one buffer are passed with more memory appended
+ * or in other buffers and copied */
+GST_START_TEST (test_mockomx_video_dec_input_pool)
+{
+  GstHarness *h;
+  GstStructure *config;
+  GstBuffer *buf;
+  guint i, size;
+
+  h = gst_harness_new ("omxh264dec");
+  gst_harness_set_src_caps_str (h, "video/x-h264,stream-format=byte-stream,"
+      "alignment=au,width=320,height=240,framerate=30/1");
+  gst_harness_negotiate (h);
+
+  for (i = 0; i < 30; i++) {
+    buf = gst_harness_create_buffer (h, 1024);
+    fail_unless (buf->pool != NULL);
+    fail_unless_equals_string (G_OBJECT_TYPE_NAME (buf->pool),
+        "GstOMXBufferPool");
+
+    config = gst_buffer_pool_get_config (buf->pool);
+    fail_unless (gst_buffer_pool_config_get_params (config, NULL, &size,
+            NULL, NULL));
+    gst_structure_free (config);
+
+    if (i == 10) {
+      gst_buffer_append_memory (buf, gst_allocator_alloc (NULL, size, NULL));
+    } else if (i == 20) {
+      gst_buffer_unref (buf);
+      buf = gst_buffer_new_allocate (NULL, 2 * size + 1, NULL);
+    }
+
+    gst_buffer_memset (buf, 0, 0, gst_buffer_get_size (buf));
+    GST_BUFFER_PTS (buf) = gst_util_uint64_scale (i, GST_SECOND, 30);
+    GST_BUFFER_DURATION (buf) = gst_util_uint64_scale (1, GST_SECOND, 30);
+    fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+  }
+
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+  fail_unless_equals_int (gst_harness_buffers_received (h), 30);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* Upstream holding all buffers of the decoder's input pool while passing
+ * other buffers must not block the decoder */
+GST_START_TEST (test_mockomx_video_dec_input_pool_held)
+{
+  GstHarness *h;
+  GstStructure *config;
+  GstBuffer *buf, **held;
+  guint i, n_held;
+
+  h = gst_harness_new ("omxh264dec");
+  gst_harness_set_src_caps_str (h, "video/x-h264,stream-format=byte-stream,"
+      "alignment=au,width=320,height=240,framerate=30/1");
+  gst_harness_negotiate (h);
+
+  buf = gst_harness_create_buffer (h, 1024);
+  fail_unless (buf->pool != NULL);
+  config = gst_buffer_pool_get_config (buf->pool);
+  fail_unless (gst_buffer_pool_config_get_params (config, NULL, NULL,
+          &n_held, NULL));
+  gst_structure_free (config);
+  fail_unless (n_held > 0);
+
+  held = g_new (GstBuffer *, n_held);
+  held[0] = buf;
+  for (i = 1; i < n_held; i++)
+    held[i] = gst_harness_create_buffer (h, 1024);
+
+  for (i = 0; i < 10 + n_held; i++) {
+    if (i < 10)
+      buf = gst_buffer_new_allocate (NULL, 1024, NULL);
+    else
+      buf = held[i - 10];
+
+    gst_buffer_memset (buf, 0, 0, gst_buffer_get_size (buf));
+    GST_BUFFER_PTS (buf) = gst_util_uint64_scale (i, GST_SECOND, 30);
+    GST_BUFFER_DURATION (buf) = gst_util_uint64_scale (1, GST_SECOND, 30);
+    fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+  }
+  g_free (held);
+
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+  fail_unless_equals_int (gst_harness_buffers_received (h), 10 + n_held);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* New input port settings while upstream writes into the input pool make
+ * the decoder reallocate private input buffers, upstream continues with
+ * buffers from elsewhere */
+GST_START_TEST (test_mockomx_video_dec_input_pool_reconfigure)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+  guint i;
+
+  g_setenv ("MOCKOMX_OPTIONS", "in-psc-after=5", TRUE);
+
+  h = gst_harness_new ("omxh264dec");
+  gst_harness_set_src_caps_str (h, "video/x-h264,stream-format=byte-stream,"
+      "alignment=au,width=320,height=240,framerate=30/1");
+  gst_harness_negotiate (h);
+
+  for (i = 0; i < 30; i++) {
+    buf = gst_harness_create_buffer (h, 1024);
+    if (i == 0)
+      fail_unless_equals_string (G_OBJECT_TYPE_NAME (buf->pool),
+          "GstOMXBufferPool");
+    else if (i == 29)
+      fail_if (buf->pool && g_strcmp0 (G_OBJECT_TYPE_NAME (buf->pool),
+              "GstOMXBufferPool") == 0);
+
+    gst_buffer_memset (buf, 0, 0, gst_buffer_get_size (buf));
+    GST_BUFFER_PTS (buf) = gst_util_uint64_scale (i, GST_SECOND, 30);
+    GST_BUFFER_DURATION (buf) = gst_util_uint64_scale (1, GST_SECOND, 30);
+    fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+  }
+
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+  fail_unless_equals_int (gst_harness_buffers_received (h), 30);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_mockomx_video_resolution_change)
+{
+  /* Signal new output settings every 10 frames and decode to a
+   * different size than the input */
+  g_setenv ("MOCKOMX_OPTIONS",
+      "psc-interval=10,width=176,height=144,stride-align=64", TRUE);
+
+  fail_unless_equals_int (run_pipeline_description
+      ("videotestsrc num-buffers=60 ! "
+          "video/x-raw,format=I420,width=320,height=240,framerate=30/1 ! "
+          "omxh264enc ! omxh264dec ! fakesink"), GST_MESSAGE_EOS);
+}
+
+GST_END_TEST;
+
+/* The output formats of the decoder depend on the stream, wide streams
+ * are only decoded to NV12 by the mock. The formats of one stream must not
+ * be used for the next one */
+GST_START_TEST (test_mockomx_video_dec_output_formats)
+{
+  fail_unless_equals_int (run_pipeline_description
+      ("videotestsrc num-buffers=5 ! "
+          "video/x-raw,format=NV12,width=2048,height=1088,framerate=30/1 ! "
+          "omxh264enc ! omxh264dec ! video/x-raw,format=I420 ! fakesink"),
+      GST_MESSAGE_ERROR);
+
+  fail_unless_equals_int (run_pipeline_description
+      ("videotestsrc num-buffers=5 ! "
+          "video/x-raw,format=NV12,width=2048,height=1088,framerate=30/1 ! "
+          "omxh264enc ! omxh264dec ! video/x-raw,format=NV12 ! fakesink"),
+      GST_MESSAGE_EOS);
+
+  fail_unless_equals_int (run_pipeline_description
+      ("videotestsrc num-buffers=5 ! "
+          "video/x-raw,format=NV12,width=320,height=240,framerate=30/1 ! "
+          "omxh264enc ! omxh264dec ! video/x-raw,format=I420 ! fakesink"),
+      GST_MESSAGE_EOS);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_mockomx_audio_enc_dec)
+{
+  fail_unless_equals_int (run_pipeline_description
+      ("audiotestsrc num-buffers=50 ! "
+          "audio/x-raw,format=S16LE,rate=48000,channels=2 ! "
+          "omxaacenc ! omxaacdec ! fakesink"), GST_MESSAGE_EOS);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_mockomx_audio_sink)
+{
+  fail_unless_equals_int (run_pipeline_description
+      ("audiotestsrc num-buffers=10 ! "
+          "audio/x-raw,format=S16LE,rate=48000,channels=2 ! "
+          "omxanalogaudiosink"), GST_MESSAGE_EOS);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_mockomx_latency)
+{
+  g_setenv ("MOCKOMX_OPTIONS", "latency=2000,in-buffers=2,out-buffers=2",
+      TRUE);
+
+  fail_unless_equals_int (run_pipeline_description
+      ("videotestsrc num-buffers=30 ! "
+          "video/x-raw,format=NV12,width=320,height=240,framerate=30/1 ! "
+          "omxh264enc ! omxh264dec ! fakesink"), GST_MESSAGE_EOS);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_mockomx_message_stress)
+{
+  GString *description;
+  gint i;
+
+  /* Several chains with only two buffers per port keep the streaming threads
+   * of every element waiting on their component while the mock threads keep
+   * producing buffer-done messages. A lost wakeup stalls the pipeline. */
+  g_setenv ("MOCKOMX_OPTIONS", "in-buffers=2,out-buffers=2", TRUE);
+
+  description = g_string_new (NULL);
+  for (i = 0; i < 4; i++)
+    g_string_append (description, "videotestsrc num-buffers=200 ! "
+        "video/x-raw,format=NV12,width=176,height=144,framerate=30/1 ! "
+        "omxh264enc ! omxh264dec ! fakesink ");
+
+  for (i = 0; i < 3; i++)
+    fail_unless_equals_int (run_pipeline_description (description->str),
+        GST_MESSAGE_EOS);
+
+  g_string_free (description, TRUE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_mockomx_error)
+{
+  /* 0x80001009 is OMX_ErrorHardware */
+  g_setenv ("MOCKOMX_OPTIONS", "error-after=10,error=0x80001009", TRUE);
+
+  fail_unless_equals_int (run_pipeline_description
+      ("videotestsrc num-buffers=60 ! "
+          "video/x-raw,format=NV12,width=320,height=240,framerate=30/1 ! "
+          "omxh264enc ! fakesink"), GST_MESSAGE_ERROR);
+}
+
+GST_END_TEST;
+
+/* omxh264dec keeps up to 2 unused components, every stream after the
+ * first one reuses the decoder that changed its output resolution */
+GST_START_TEST (test_mockomx_component_pool)
+{
+  const gchar *description = "videotestsrc num-buffers=20 ! "
+      "video/x-raw,format=NV12,width=320,height=240,framerate=30/1 ! "
+      "omxh264enc ! omxh264dec ! fakesink";
+  GModule *core;
+  guint i, n_decoders, n_encoders;
+
+  g_setenv ("MOCKOMX_OPTIONS", "psc-interval=5,width=176,height=144", TRUE);
+  core = open_mock_core ();
+
+  /* Also probes the caps of the decoder with components of its own */
+  fail_unless_equals_int (run_pipeline_description (description),
+      GST_MESSAGE_EOS);
+  n_decoders = get_mock_handle_count (core, "video_decoder.avc");
+  n_encoders = get_mock_handle_count (core, "video_encoder.avc");
+
+  for (i = 0; i < 2; i++)
+    fail_unless_equals_int (run_pipeline_description (description),
+        GST_MESSAGE_EOS);
+
+  /* Only omxh264dec has a pool-size */
+  fail_unless_equals_int (get_mock_handle_count (core, "video_decoder.avc"),
+      n_decoders);
+  fail_unless_equals_int (get_mock_handle_count (core, "video_encoder.avc"),
+      n_encoders + 2);
+
+  g_module_close (core);
+}
+
+GST_END_TEST;
+
+static gboolean
+timeline_has_phase (const GstStructure * timeline, const gchar * name)
+{
+  const GValue *phases;
+  guint i;
+
+  phases = gst_structure_get_value (timeline, "phases");
+  fail_unless (phases != NULL);
+
+  for (i = 0; i < gst_value_array_get_size (phases); i++) {
+    const GstStructure *phase =
+        gst_value_get_structure (gst_value_array_get_value (phases, i));
+
+    if (g_strcmp0 (gst_structure_get_string (phase, "name"), name) == 0)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+GST_START_TEST (test_mockomx_startup_timeline)
+{
+  GstElement *pipeline;
+  GstBus *bus;
+  GstMessage *msg;
+  GstStructure *timeline = NULL;
+  GstClockTime first_frame = GST_CLOCK_TIME_NONE;
+  GError *err = NULL;
+
+  pipeline = gst_parse_launch ("videotestsrc num-buffers=10 ! "
+      "video/x-raw,format=NV12,width=320,height=240,framerate=30/1 ! "
+      "omxh264enc ! omxh264dec name=dec post-startup-timeline=true ! "
+      "fakesink", &err);
+  fail_unless (pipeline != NULL, "Failed to create pipeline: %s",
+      err ? err->message : "unknown error");
+  g_clear_error (&err);
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_ASYNC);
+
+  bus = gst_element_get_bus (pipeline);
+  while ((msg = gst_bus_timed_pop_filtered (bus, PIPELINE_TIMEOUT,
+              GST_MESSAGE_EOS | GST_MESSAGE_ERROR | GST_MESSAGE_ELEMENT))) {
+    GstMessageType type = GST_MESSAGE_TYPE (msg);
+
+    if (type == GST_MESSAGE_ELEMENT
+        && gst_message_has_name (msg, "omx-startup-timeline")) {
+      fail_unless (timeline == NULL, "Timeline posted more than once");
+      fail_unless_equals_string (GST_MESSAGE_SRC_NAME (msg), "dec");
+      timeline = gst_structure_copy (gst_message_get_structure (msg));
+    }
+    gst_message_unref (msg);
+
+    fail_if (type == GST_MESSAGE_ERROR);
+    if (type == GST_MESSAGE_EOS)
+      break;
+  }
+  gst_object_unref (bus);
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (pipeline);
+
+  fail_unless (timeline != NULL, "No timeline posted");
+  GST_INFO ("Startup timeline: %" GST_PTR_FORMAT, timeline);
+
+  fail_unless (gst_structure_get_clock_time (timeline, "time-to-first-frame",
+          &first_frame));
+  fail_unless (GST_CLOCK_TIME_IS_VALID (first_frame));
+  fail_unless (timeline_has_phase (timeline, "state-idle"));
+  fail_unless (timeline_has_phase (timeline, "state-executing"));
+  fail_unless (timeline_has_phase (timeline, "port-allocate"));
+  fail_unless (timeline_has_phase (timeline, "first-empty-this-buffer"));
+  fail_unless (timeline_has_phase (timeline, "first-fill-buffer-done"));
+
+  gst_structure_free (timeline);
+}
+
+GST_END_TEST;
+
+static GstCaps *
+get_template_caps (const gchar * element_name, const gchar * templ_name)
+{
+  GstElementFactory *factory;
+  const GList *l;
+  GstCaps *caps = NULL;
+
+  factory = gst_element_factory_find (element_name);
+  fail_unless (factory != NULL);
+
+  for (l = gst_element_factory_get_static_pad_templates (factory); l;
+      l = l->next) {
+    GstStaticPadTemplate *templ = l->data;
+
+    if (g_str_equal (templ->name_template, templ_name))
+      caps = gst_static_pad_template_get_caps (templ);
+  }
+  gst_object_unref (factory);
+
+  fail_unless (caps != NULL);
+
+  return caps;
+}
+
+static gboolean
+caps_can_intersect_string (GstCaps * caps, const gchar * str)
+{
+  GstCaps *other = gst_caps_from_string (str);
+  gboolean ret;
+
+  ret = gst_caps_can_intersect (caps, other);
+  gst_caps_unref (other);
+
+  return ret;
+}
+
+/* The mock components only support NV12 and I420 and encode in the
+ * baseline profile, see probe-caps in the configuration */
+GST_START_TEST (test_mockomx_probe_caps)
+{
+  GstCaps *caps;
+
+  caps = get_template_caps ("omxh264dec", "src");
+  fail_unless (caps_can_intersect_string (caps, "video/x-raw,format=NV12"));
+  fail_unless (caps_can_intersect_string (caps, "video/x-raw,format=I420"));
+  fail_if (caps_can_intersect_string (caps, "video/x-raw,format=YUY2"));
+  gst_caps_unref (caps);
+
+  caps = get_template_caps ("omxh264enc", "sink");
+  fail_unless (caps_can_intersect_string (caps, "video/x-raw,format=NV12"));
+  fail_if (caps_can_intersect_string (caps, "video/x-raw,format=RGB16"));
+  gst_caps_unref (caps);
+
+  caps = get_template_caps ("omxh264enc", "src");
+  fail_unless (caps_can_intersect_string (caps,
+          "video/x-h264,profile=baseline"));
+  fail_if (caps_can_intersect_string (caps, "video/x-h264,profile=high"));
+  gst_caps_unref (caps);
+
+  /* Not probed */
+  caps = get_template_caps ("omxmpeg4videodec", "src");
+  fail_unless (caps_can_intersect_string (caps, "video/x-raw,format=YUY2"));
+  gst_caps_unref (caps);
+}
+
+GST_END_TEST;
+
+/* Opens the core the elements are configured with. It is the same library
+ * the plugin opens, with the same counters, and stays loaded until the
+ * module is closed again even if the plugin releases it */
+static GModule *
+open_mock_core (void)
+{
+  GKeyFile *config;
+  GModule *module;
+  gchar *path, *core_name;
+  GError *err = NULL;
+
+  config = g_key_file_new ();
+  path = g_build_filename (MOCKOMX_CONFIG_DIR, "gstomx.conf", NULL);
+  fail_unless (g_key_file_load_from_file (config, path, G_KEY_FILE_NONE,
+          &err), "Failed to load %s: %s", path, err ? err->message : "");
+  core_name = g_key_file_get_string (config, "omxh264dec", "core-name", NULL);
+  fail_unless (core_name != NULL);
+  g_key_file_free (config);
+  g_free (path);
+
+  module = g_module_open (core_name, G_MODULE_BIND_LAZY);
+  fail_unless (module != NULL, "Failed to open %s: %s", core_name,
+      g_module_error ());
+  g_free (core_name);
+
+  return module;
+}
+
+/* Returns how many mock components with the given role were created */
+static guint
+get_mock_handle_count (GModule * core, const gchar * role)
+{
+  MockOMXGetHandleCount get_handle_count;
+  guint n_created = 0;
+
+  fail_unless (g_module_symbol (core, "MockOMX_GetHandleCount",
+          (gpointer *) & get_handle_count));
+  fail_unless (get_handle_count (role, &n_created));
+
+  return n_created;
+}
+
+/* Returns how often the port of the mock components with the given role
+ * was disabled and how many buffers were added to it */
+static void
+get_mock_port_counters (GModule * core, const gchar * role, guint port_index,
+    guint * n_disabled, guint * n_buffers_added)
+{
+  MockOMXGetPortCounters get_port_counters;
+
+  fail_unless (g_module_symbol (core, "MockOMX_GetPortCounters",
+          (gpointer *) & get_port_counters));
+  fail_unless (get_port_counters (role, port_index, n_disabled,
+          n_buffers_added));
+}
+
+static GstPadProbeReturn
+count_widths_probe (GstPad * pad, GstPadProbeInfo * info, GArray * widths)
+{
+  GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+  GstCaps *caps;
+  gint width;
+
+  if (GST_EVENT_TYPE (event) != GST_EVENT_CAPS)
+    return GST_PAD_PROBE_OK;
+
+  gst_event_parse_caps (event, &caps);
+  fail_unless (gst_structure_get_int (gst_caps_get_structure (caps, 0),
+          "width", &width));
+  g_array_append_val (widths, width);
+
+  return GST_PAD_PROBE_OK;
+}
+
+typedef struct
+{
+  GModule *core;
+  gboolean taken;
+  guint n_disabled;
+  guint n_buffers_added;
+} MockPortCounters;
+
+/* Takes the output port counters of the mock MPEG-4 decoder once the
+ * first frame was decoded, after the initial port setup */
+static GstPadProbeReturn
+take_counters_probe (GstPad * pad, GstPadProbeInfo * info,
+    MockPortCounters * counters)
+{
+  if (!counters->taken) {
+    get_mock_port_counters (counters->core, "video_decoder.mpeg4", 1,
+        &counters->n_disabled, &counters->n_buffers_added);
+    counters->taken = TRUE;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* omxmpeg4videodec has the keeps-output-buffers hack, the mock decoder
+ * halves and restores the output size every 10 frames without the port
+ * being disabled */
+GST_START_TEST (test_mockomx_adaptive_resolution_change)
+{
+  GstElement *pipeline, *sink;
+  GArray *widths;
+  GstPad *pad;
+  GError *err = NULL;
+  MockPortCounters initial = { NULL, FALSE, 0, 0 };
+  guint n_disabled, n_buffers_added;
+  guint i, n_changes = 0;
+
+  g_setenv ("MOCKOMX_OPTIONS", "adaptive=1,psc-interval=10,psc-halve=1",
+      TRUE);
+  initial.core = open_mock_core ();
+
+  pipeline = gst_parse_launch ("videotestsrc num-buffers=60 ! "
+      "video/x-raw,format=I420,width=320,height=240,framerate=30/1 ! "
+      "omxmpeg4videoenc ! omxmpeg4videodec ! fakesink name=sink", &err);
+  fail_unless (pipeline != NULL, "Failed to create pipeline: %s",
+      err ? err->message : "unknown error");
+  g_clear_error (&err);
+
+  widths = g_array_new (FALSE, FALSE, sizeof (gint));
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  pad = gst_element_get_static_pad (sink, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      (GstPadProbeCallback) count_widths_probe, widths, NULL);
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) take_counters_probe, &initial, NULL);
+  gst_object_unref (pad);
+  gst_object_unref (sink);
+
+  fail_unless_equals_int (run_pipeline (pipeline), GST_MESSAGE_EOS);
+
+  /* The size changes neither disabled the output port nor reallocated
+   * its buffers */
+  fail_unless (initial.taken);
+  get_mock_port_counters (initial.core, "video_decoder.mpeg4", 1,
+      &n_disabled, &n_buffers_added);
+  fail_unless_equals_int (n_disabled, initial.n_disabled);
+  fail_unless_equals_int (n_buffers_added, initial.n_buffers_added);
+
+  /* 320, 160, 320, ... */
+  for (i = 1; i < widths->len; i++) {
+    if (g_array_index (widths, gint, i) != g_array_index (widths, gint,
+            i - 1))
+      n_changes++;
+  }
+  fail_unless_equals_int (g_array_index (widths, gint, 0), 320);
+  fail_unless (n_changes >= 2, "Only %u size changes", n_changes);
+
+  g_array_unref (widths);
+  gst_object_unref (pipeline);
+  g_module_close (initial.core);
+}
+
+GST_END_TEST;
+
+/* omxmpeg4videoenc has a budget of 9000 macroblocks/s, which is exactly
+ * one 320x240 stream at 30 fps */
+GST_START_TEST (test_mockomx_admission)
+{
+  const gchar *branch = "videotestsrc num-buffers=30 ! "
+      "video/x-raw,format=NV12,width=320,height=240,framerate=30/1 ! "
+      "omxmpeg4videoenc ! fakesink ";
+  GstElement *pipeline;
+  GstBus *bus;
+  GstMessage *msg;
+  const GstStructure *details = NULL;
+  gchar *description;
+  GError *err = NULL;
+
+  fail_unless_equals_int (run_pipeline_description (branch), GST_MESSAGE_EOS);
+
+  description = g_strconcat (branch, branch, NULL);
+  pipeline = gst_parse_launch (description, &err);
+  fail_unless (pipeline != NULL, "Failed to create '%s': %s", description,
+      err ? err->message : "unknown error");
+  g_clear_error (&err);
+  g_free (description);
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_ASYNC);
+
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, PIPELINE_TIMEOUT,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL, "Pipeline timed out");
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_ERROR);
+
+  gst_message_parse_error_details (msg, &details);
+  fail_unless (details != NULL);
+  fail_unless_equals_string (gst_structure_get_string (details,
+          "component-name"), "OMX.mock.video_encoder.mpeg4");
+  fail_unless_equals_string (gst_structure_get_string (details, "reason"),
+      "no-throughput");
+
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (pipeline);
+
+  /* Everything was given back */
+  fail_unless_equals_int (run_pipeline_description (branch), GST_MESSAGE_EOS);
+}
+
+GST_END_TEST;
+
+#define THROUGHPUT_FRAMES 200
+#define THROUGHPUT_FRAME_SIZE (64 * 1024)
+
+static void
+throughput_need_data (GstElement * src, guint length, guint * n_pushed)
+{
+  GstBuffer *buf;
+  GstFlowReturn flow;
+
+  if (*n_pushed == THROUGHPUT_FRAMES) {
+    g_signal_emit_by_name (src, "end-of-stream", &flow);
+    return;
+  }
+
+  buf = gst_buffer_new_allocate (NULL, THROUGHPUT_FRAME_SIZE, NULL);
+  gst_buffer_memset (buf, 0, 0, THROUGHPUT_FRAME_SIZE);
+  GST_BUFFER_PTS (buf) = gst_util_uint64_scale (*n_pushed, GST_SECOND, 30);
+  GST_BUFFER_DURATION (buf) = gst_util_uint64_scale (1, GST_SECOND, 30);
+  g_signal_emit_by_name (src, "push-buffer", buf, &flow);
+  gst_buffer_unref (buf);
+
+  (*n_pushed)++;
+}
+
+/* Splits every frame over many small input buffers, so the decoder spends
+ * most of its time acquiring and releasing input buffers */
+GST_START_TEST (test_mockomx_acquire_throughput)
+{
+  GstElement *pipeline, *src;
+  GError *err = NULL;
+  guint n_pushed = 0, n_acquired;
+  gint64 start, elapsed;
+
+  g_setenv ("MOCKOMX_OPTIONS", "in-buffer-size=1024,in-buffers=16", TRUE);
+
+  pipeline = gst_parse_launch ("appsrc name=src format=time "
+      "caps=video/x-h264,stream-format=byte-stream,alignment=au,"
+      "width=320,height=240,framerate=30/1 ! omxh264dec ! fakesink", &err);
+  fail_unless (pipeline != NULL, "Failed to create pipeline: %s",
+      err ? err->message : "unknown error");
+  g_clear_error (&err);
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  g_signal_connect (src, "need-data", G_CALLBACK (throughput_need_data),
+      &n_pushed);
+  gst_object_unref (src);
+
+  start = g_get_monotonic_time ();
+  fail_unless_equals_int (run_pipeline (pipeline), GST_MESSAGE_EOS);
+  elapsed = MAX (g_get_monotonic_time () - start, 1);
+
+  fail_unless_equals_int (n_pushed, THROUGHPUT_FRAMES);
+  n_acquired = THROUGHPUT_FRAMES * (THROUGHPUT_FRAME_SIZE / 1024);
+  GST_INFO ("Acquired %u input buffers in %" G_GINT64_FORMAT " us, "
+      "%.0f buffers/s", n_acquired, elapsed, n_acquired * 1e6 / elapsed);
+
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
+#define SEEK_FRAMES 30
+
+typedef struct
+{
+  GMutex lock;
+  GCond cond;
+  guint n_pushed;
+  guint n_out;
+} SeekTest;
+
+static void
+seek_need_data (GstElement * src, guint length, SeekTest * test)
+{
+  GstBuffer *buf;
+  GstFlowReturn flow;
+
+  if (test->n_pushed >= SEEK_FRAMES) {
+    g_signal_emit_by_name (src, "end-of-stream", &flow);
+    return;
+  }
+
+  buf = gst_buffer_new_allocate (NULL, 1024, NULL);
+  gst_buffer_memset (buf, 0, 0, 1024);
+  GST_BUFFER_PTS (buf) = gst_util_uint64_scale (test->n_pushed, GST_SECOND,
+      30);
+  GST_BUFFER_DURATION (buf) = gst_util_uint64_scale (1, GST_SECOND, 30);
+  g_signal_emit_by_name (src, "push-buffer", buf, &flow);
+  gst_buffer_unref (buf);
+
+  test->n_pushed++;
+}
+
+static gboolean
+seek_seek_data (GstElement * src, guint64 position, SeekTest * test)
+{
+  test->n_pushed = gst_util_uint64_scale (position, 30, GST_SECOND);
+
+  return TRUE;
+}
+
+static void
+seek_handoff (GstElement * sink, GstBuffer * buf, GstPad * pad,
+    SeekTest * test)
+{
+  g_mutex_lock (&test->lock);
+  test->n_out++;
+  g_cond_signal (&test->cond);
+  g_mutex_unlock (&test->lock);
+}
+
+static void
+seek_wait_output (SeekTest * test, guint n_out)
+{
+  gint64 deadline = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;
+
+  g_mutex_lock (&test->lock);
+  while (test->n_out < n_out)
+    fail_unless (g_cond_wait_until (&test->cond, &test->lock, deadline),
+        "Timeout waiting for output");
+  g_mutex_unlock (&test->lock);
+}
+
+static void
+run_seek_test (const gchar * caps, const gchar * decoder)
+{
+  SeekTest test = { 0, };
+  GstElement *pipeline, *src, *sink;
+  GstBus *bus;
+  GstMessage *msg;
+  gchar *description;
+  GError *err = NULL;
+  guint i;
+
+  g_mutex_init (&test.lock);
+  g_cond_init (&test.cond);
+
+  description = g_strdup_printf ("appsrc name=src format=time "
+      "stream-type=seekable caps=%s ! %s ! fakesink name=sink sync=false "
+      "signal-handoffs=true", caps, decoder);
+  pipeline = gst_parse_launch (description, &err);
+  fail_unless (pipeline != NULL, "Failed to create '%s': %s", description,
+      err ? err->message : "unknown error");
+  g_clear_error (&err);
+  g_free (description);
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  g_signal_connect (src, "need-data", G_CALLBACK (seek_need_data), &test);
+  g_signal_connect (src, "seek-data", G_CALLBACK (seek_seek_data), &test);
+  gst_object_unref (src);
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (seek_handoff), &test);
+  gst_object_unref (sink);
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_ASYNC);
+
+  /* The decoder keeps producing output after every flush */
+  for (i = 1; i <= 5; i++) {
+    seek_wait_output (&test, 5);
+    g_mutex_lock (&test.lock);
+    test.n_out = 0;
+    g_mutex_unlock (&test.lock);
+
+    fail_unless (gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+            GST_SEEK_FLAG_FLUSH, 0));
+  }
+
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, PIPELINE_TIMEOUT,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL, "Pipeline timed out");
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (pipeline);
+  g_cond_clear (&test.cond);
+  g_mutex_clear (&test.lock);
+}
+
+/* omxh264dec flushes in Executing state, omxmpeg4videodec goes through
+ * the Pause state */
+GST_START_TEST (test_mockomx_seek)
+{
+  run_seek_test ("video/x-h264,stream-format=byte-stream,alignment=au,"
+      "width=320,height=240,framerate=30/1", "omxh264dec");
+  run_seek_test ("video/mpeg,mpegversion=4,systemstream=false,parsed=true,"
+      "width=320,height=240,framerate=30/1", "omxmpeg4videodec");
+}
+
+GST_END_TEST;
+
+static GstPadProbeReturn
+stall_probe (GstPad * pad, GstPadProbeInfo * info, guint * n_buffers)
+{
+  /* Longer than a usage window, so the component is known to have had no
+   * output buffer for most of it */
+  if (++(*n_buffers) == 10)
+    g_usleep (3 * G_USEC_PER_SEC / 2);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Runs a decoder with downstream blocking once on the 10th output buffer
+ * and returns the number of output buffers it used last */
+static guint
+run_stalled_downstream (guint max_output_buffers, GstClockTime * starved)
+{
+  GstElement *pipeline, *dec;
+  GstStructure *stats = NULL;
+  GstPad *pad;
+  gchar *description;
+  GError *err = NULL;
+  guint n, n_buffers = 0;
+
+  description = g_strdup_printf ("videotestsrc num-buffers=40 ! "
+      "video/x-raw,format=I420,width=320,height=240,framerate=30/1 ! "
+      "omxh264enc ! omxh264dec name=dec max-output-buffers=%u ! fakesink",
+      max_output_buffers);
+  pipeline = gst_parse_launch (description, &err);
+  fail_unless (pipeline != NULL, "Failed to create pipeline: %s",
+      err ? err->message : "unknown error");
+  g_clear_error (&err);
+  g_free (description);
+
+  dec = gst_bin_get_by_name (GST_BIN (pipeline), "dec");
+  pad = gst_element_get_static_pad (dec, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) stall_probe, &n_buffers, NULL);
+  gst_object_unref (pad);
+
+  fail_unless_equals_int (run_pipeline (pipeline), GST_MESSAGE_EOS);
+
+  g_object_get (dec, "stats", &stats, NULL);
+  fail_unless (stats != NULL);
+  fail_unless (gst_structure_get (stats, "output-buffers", G_TYPE_UINT, &n,
+          "output-starved-time", G_TYPE_UINT64, starved, NULL));
+  GST_INFO ("Decoder stats: %" GST_PTR_FORMAT, stats);
+  gst_structure_free (stats);
+  gst_object_unref (dec);
+
+  gst_object_unref (pipeline);
+
+  return n;
+}
+
+/* After the component had no output buffer to fill for a while, the
+ * decoder allocates one more, but only when the output port is
+ * reconfigured next */
+GST_START_TEST (test_mockomx_adaptive_output_buffers)
+{
+  GstClockTime starved;
+  guint n_fixed, n_adaptive;
+
+  g_setenv ("MOCKOMX_OPTIONS", "psc-after=20", TRUE);
+
+  n_fixed = run_stalled_downstream (0, &starved);
+  fail_unless (starved >= GST_SECOND);
+
+  n_adaptive = run_stalled_downstream (16, &starved);
+  fail_unless_equals_int (n_adaptive, n_fixed + 1);
+
+  /* Without new output settings the buffers are kept */
+  g_unsetenv ("MOCKOMX_OPTIONS");
+
+  n_adaptive = run_stalled_downstream (16, &starved);
+  fail_unless (starved >= GST_SECOND);
+  fail_unless_equals_int (n_adaptive, n_fixed);
+}
+
+GST_END_TEST;
+
+static GstPadProbeReturn
+count_copied_probe (GstPad * pad, GstPadProbeInfo * info, guint * n_copied)
+{
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  if (buffer->pool
+      && g_strcmp0 (G_OBJECT_TYPE_NAME (buffer->pool),
+          "GstVideoBufferPool") == 0)
+    (*n_copied)++;
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Output with strides fakesink can't handle is copied into buffers of the
+ * negotiated pool, on the srcpad task or on a helper thread */
+GST_START_TEST (test_mockomx_video_dec_copy_thread)
+{
+  gint copy_thread;
+
+  g_setenv ("MOCKOMX_OPTIONS", "width=176,height=144,stride-align=64", TRUE);
+
+  for (copy_thread = 0; copy_thread <= 1; copy_thread++) {
+    GstElement *pipeline, *dec;
+    GstPad *pad;
+    gchar *description;
+    GError *err = NULL;
+    guint n_copied = 0;
+
+    description = g_strdup_printf ("videotestsrc num-buffers=60 ! "
+        "video/x-raw,format=I420,width=176,height=144,framerate=30/1 ! "
+        "omxh264enc ! omxh264dec name=dec copy-thread=%d ! fakesink",
+        copy_thread);
+    pipeline = gst_parse_launch (description, &err);
+    fail_unless (pipeline != NULL, "Failed to create pipeline: %s",
+        err ? err->message : "unknown error");
+    g_clear_error (&err);
+    g_free (description);
+
+    dec = gst_bin_get_by_name (GST_BIN (pipeline), "dec");
+    pad = gst_element_get_static_pad (dec, "src");
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+        (GstPadProbeCallback) count_copied_probe, &n_copied, NULL);
+    gst_object_unref (pad);
+    gst_object_unref (dec);
+
+    fail_unless_equals_int (run_pipeline (pipeline), GST_MESSAGE_EOS);
+    fail_unless_equals_int (n_copied, 60);
+
+    gst_object_unref (pipeline);
+  }
+}
+
+GST_END_TEST;
+
+/* Copies of frames large enough to be split are the same with helper
+ * threads, also together with the copy thread */
+GST_START_TEST (test_mockomx_video_dec_copy_workers)
+{
+  static const gint copy_workers[] = { 0, 3 };
+  guint i;
+
+  g_setenv ("MOCKOMX_OPTIONS", "width=640,height=480,stride-align=512",
+      TRUE);
+
+  for (i = 0; i < G_N_ELEMENTS (copy_workers); i++) {
+    GstElement *pipeline, *dec;
+    GstPad *pad;
+    gchar *description;
+    GError *err = NULL;
+    guint n_copied = 0;
+
+    description = g_strdup_printf ("videotestsrc num-buffers=60 ! "
+        "video/x-raw,format=I420,width=640,height=480,framerate=30/1 ! "
+        "omxh264enc ! omxh264dec name=dec copy-workers=%d copy-thread=%d ! "
+        "fakesink", copy_workers[i], copy_workers[i] > 0);
+    pipeline = gst_parse_launch (description, &err);
+    fail_unless (pipeline != NULL, "Failed to create pipeline: %s",
+        err ? err->message : "unknown error");
+    g_clear_error (&err);
+    g_free (description);
+
+    dec = gst_bin_get_by_name (GST_BIN (pipeline), "dec");
+    pad = gst_element_get_static_pad (dec, "src");
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+        (GstPadProbeCallback) count_copied_probe, &n_copied, NULL);
+    gst_object_unref (pad);
+    gst_object_unref (dec);
+
+    fail_unless_equals_int (run_pipeline (pipeline), GST_MESSAGE_EOS);
+    fail_unless_equals_int (n_copied, 60);
+
+    gst_object_unref (pipeline);
+  }
+}
+
+GST_END_TEST;
+
+static GstPadProbeReturn
+count_frame_memory_probe (GstPad * pad, GstPadProbeInfo * info,
+    guint * n_frame_memory)
+{
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  if (gst_buffer_n_memory (buffer) == 1
+      && gst_memory_is_type (gst_buffer_peek_memory (buffer, 0),
+          "openmax-frame"))
+    (*n_frame_memory)++;
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* The negotiated pool allocates frame memory for the copies of output
+ * fakesink can't handle. There are usually no huge pages reserved, so
+ * hugetlb falls back to transparent huge pages */
+GST_START_TEST (test_mockomx_frame_memory)
+{
+  static const gchar *modes[] = { "aligned", "thp", "hugetlb" };
+  GstElement *dec;
+  GParamSpec *pspec;
+  GEnumValue *value;
+  gint mode;
+  guint i;
+
+  /* Default from the configuration file */
+  dec = gst_element_factory_make ("omxmpeg4videodec", NULL);
+  fail_unless (dec != NULL);
+  g_object_get (dec, "frame-memory", &mode, NULL);
+  pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (dec),
+      "frame-memory");
+  value = g_enum_get_value (G_PARAM_SPEC_ENUM (pspec)->enum_class, mode);
+  fail_unless (value != NULL);
+  fail_unless_equals_string (value->value_nick, "aligned");
+  gst_object_unref (dec);
+
+  g_setenv ("MOCKOMX_OPTIONS", "width=176,height=144,stride-align=64", TRUE);
+
+  for (i = 0; i < G_N_ELEMENTS (modes); i++) {
+    GstElement *pipeline;
+    GstPad *pad;
+    gchar *description;
+    GError *err = NULL;
+    guint n_frame_memory = 0;
+
+    description = g_strdup_printf ("videotestsrc num-buffers=60 ! "
+        "video/x-raw,format=I420,width=176,height=144,framerate=30/1 ! "
+        "omxh264enc ! omxh264dec name=dec frame-memory=%s ! fakesink",
+        modes[i]);
+    pipeline = gst_parse_launch (description, &err);
+    fail_unless (pipeline != NULL, "Failed to create pipeline: %s",
+        err ? err->message : "unknown error");
+    g_clear_error (&err);
+    g_free (description);
+
+    dec = gst_bin_get_by_name (GST_BIN (pipeline), "dec");
+    pad = gst_element_get_static_pad (dec, "src");
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+        (GstPadProbeCallback) count_frame_memory_probe, &n_frame_memory,
+        NULL);
+    gst_object_unref (pad);
+    gst_object_unref (dec);
+
+    fail_unless_equals_int (run_pipeline (pipeline), GST_MESSAGE_EOS);
+    fail_unless_equals_int (n_frame_memory, 60);
+
+    gst_object_unref (pipeline);
+  }
+}
+
+GST_END_TEST;
+
+/* Statistics of the encoder and decoder and their pools, taken when the
+ * decoder finished */
+typedef struct
+{
+  GstStructure *enc_stats;
+  GstStructure *dec_stats;
+} PoolStats;
+
+static GstPadProbeReturn
+get_pool_stats_probe (GstPad * pad, GstPadProbeInfo * info, PoolStats * stats)
+{
+  GstElement *dec, *enc;
+
+  if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) != GST_EVENT_EOS)
+    return GST_PAD_PROBE_OK;
+
+  dec = gst_pad_get_parent_element (pad);
+  enc = gst_bin_get_by_name (GST_BIN (GST_OBJECT_PARENT (dec)), "enc");
+  g_object_get (dec, "stats", &stats->dec_stats, NULL);
+  g_object_get (enc, "stats", &stats->enc_stats, NULL);
+  gst_object_unref (enc);
+  gst_object_unref (dec);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+run_pool_stats (gint width, PoolStats * stats)
+{
+  GstElement *pipeline, *dec;
+  GstPad *pad;
+  gchar *description;
+  GError *err = NULL;
+
+  description = g_strdup_printf ("videotestsrc num-buffers=60 ! "
+      "video/x-raw,format=I420,width=%d,height=144,framerate=30/1 ! "
+      "omxh264enc name=enc ! omxh264dec name=dec ! fakesink", width);
+  pipeline = gst_parse_launch (description, &err);
+  fail_unless (pipeline != NULL, "Failed to create pipeline: %s",
+      err ? err->message : "unknown error");
+  g_clear_error (&err);
+  g_free (description);
+
+  dec = gst_bin_get_by_name (GST_BIN (pipeline), "dec");
+  pad = gst_element_get_static_pad (dec, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      (GstPadProbeCallback) get_pool_stats_probe, stats, NULL);
+  gst_object_unref (pad);
+  gst_object_unref (dec);
+
+  fail_unless_equals_int (run_pipeline (pipeline), GST_MESSAGE_EOS);
+  fail_unless (stats->dec_stats != NULL && stats->enc_stats != NULL);
+  GST_INFO ("Encoder stats: %" GST_PTR_FORMAT, stats->enc_stats);
+  GST_INFO ("Decoder stats: %" GST_PTR_FORMAT, stats->dec_stats);
+
+  gst_object_unref (pipeline);
+}
+
+/* The encoder and decoder report the occupancy of their pools, and the
+ * decoder counts the output buffers it copied */
+GST_START_TEST (test_mockomx_pool_stats)
+{
+  PoolStats stats = { NULL, NULL };
+  const GstStructure *pool_stats;
+  guint n_buffers, n_outstanding;
+  guint64 n_copies, n_stalls;
+
+  /* The encoder offers its input buffers to upstream and the decoder
+   * pushes its output buffers */
+  run_pool_stats (320, &stats);
+
+  pool_stats = gst_value_get_structure (gst_structure_get_value
+      (stats.enc_stats, "input-pool"));
+  fail_unless (pool_stats != NULL);
+  fail_unless (gst_structure_get (pool_stats, "buffers", G_TYPE_UINT,
+          &n_buffers, "outstanding-buffers", G_TYPE_UINT, &n_outstanding,
+          "stalls", G_TYPE_UINT64, &n_stalls, NULL));
+  fail_unless (n_buffers > 0);
+  fail_unless (n_outstanding <= n_buffers);
+
+  pool_stats = gst_value_get_structure (gst_structure_get_value
+      (stats.dec_stats, "output-pool"));
+  fail_unless (pool_stats != NULL);
+  fail_unless (gst_structure_get (pool_stats, "copies", G_TYPE_UINT64,
+          &n_copies, NULL));
+  fail_unless_equals_int (n_copies, 0);
+
+  gst_structure_free (stats.enc_stats);
+  gst_structure_free (stats.dec_stats);
+  stats.enc_stats = stats.dec_stats = NULL;
+
+  /* Output with strides fakesink can't handle is copied */
+  g_setenv ("MOCKOMX_OPTIONS", "width=176,height=144,stride-align=64", TRUE);
+  run_pool_stats (176, &stats);
+
+  pool_stats = gst_value_get_structure (gst_structure_get_value
+      (stats.dec_stats, "output-pool"));
+  fail_unless (pool_stats != NULL);
+  fail_unless (gst_structure_get (pool_stats, "buffers", G_TYPE_UINT,
+          &n_buffers, "copies", G_TYPE_UINT64, &n_copies, NULL));
+  fail_unless (n_buffers > 0);
+  fail_unless_equals_int (n_copies, 60);
+
+  gst_structure_free (stats.enc_stats);
+  gst_structure_free (stats.dec_stats);
+}
+
+GST_END_TEST;
+
+static GstPadProbeReturn
+propose_video_meta_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  GstQuery *query = GST_PAD_PROBE_INFO_QUERY (info);
+
+  if (GST_QUERY_TYPE (query) == GST_QUERY_ALLOCATION
+      && !gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE,
+          NULL))
+    gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Output buffers with padded lines and planes */
+typedef struct
+{
+  guint n_buffers;
+  guint n_layout_ok;
+} VideoMetaOutput;
+
+static GstPadProbeReturn
+check_video_meta_probe (GstPad * pad, GstPadProbeInfo * info,
+    VideoMetaOutput * output)
+{
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstVideoMeta *meta;
+
+  if (!buffer->pool
+      || g_strcmp0 (G_OBJECT_TYPE_NAME (buffer->pool),
+          "GstOMXBufferPool") != 0)
+    return GST_PAD_PROBE_OK;
+  output->n_buffers++;
+
+  /* 176x144 with the stride aligned to 64 and slice height to 32 */
+  meta = gst_buffer_get_video_meta (buffer);
+  if (meta && meta->n_planes == 3 && meta->stride[0] == 192
+      && meta->stride[1] == 96 && meta->stride[2] == 96
+      && meta->offset[0] == 0 && meta->offset[1] == 192 * 160
+      && meta->offset[2] == 192 * 160 + 96 * 80)
+    output->n_layout_ok++;
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Downstream handling GstVideoMeta gets the output buffers of the
+ * component with their strides and offsets instead of copies */
+GST_START_TEST (test_mockomx_video_dec_video_meta)
+{
+  GstElement *pipeline, *dec;
+  GstPad *pad;
+  GError *err = NULL;
+  VideoMetaOutput output = { 0, 0 };
+
+  g_setenv ("MOCKOMX_OPTIONS",
+      "width=176,height=144,stride-align=64,slice-height-align=32", TRUE);
+
+  pipeline = gst_parse_launch ("videotestsrc num-buffers=60 ! "
+      "video/x-raw,format=I420,width=176,height=144,framerate=30/1 ! "
+      "omxh264enc ! omxh264dec name=dec ! fakesink", &err);
+  fail_unless (pipeline != NULL, "Failed to create pipeline: %s",
+      err ? err->message : "unknown error");
+  g_clear_error (&err);
+
+  dec = gst_bin_get_by_name (GST_BIN (pipeline), "dec");
+  pad = gst_element_get_static_pad (dec, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM,
+      propose_video_meta_probe, NULL, NULL);
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) check_video_meta_probe, &output, NULL);
+  gst_object_unref (pad);
+  gst_object_unref (dec);
+
+  fail_unless_equals_int (run_pipeline (pipeline), GST_MESSAGE_EOS);
+  fail_unless_equals_int (output.n_buffers, 60);
+  fail_unless_equals_int (output.n_layout_ok, 60);
+
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
+static GstPadProbeReturn
+check_pts_probe (GstPad * pad, GstPadProbeInfo * info, guint * n_buffers)
+{
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  /* Header buffers of the encoder don't belong to a frame */
+  if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_HEADER))
+    return GST_PAD_PROBE_OK;
+
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buffer),
+      gst_util_uint64_scale (*n_buffers, GST_SECOND, 30));
+  (*n_buffers)++;
+
+  return GST_PAD_PROBE_OK;
+}
+
+#define MATCHING_FRAMES 8
+
+typedef struct
+{
+  const gchar *options;
+  /* PTS of the input frames in decoding order, in frames */
+  guint pts[MATCHING_FRAMES];
+  /* Input frames the output buffers belong to */
+  guint n_outputs;
+  guint outputs[MATCHING_FRAMES];
+} MatchingRun;
+
+static const MatchingRun matching_runs[] = {
+  /* Output timestamps that are off by a quarter of a frame still get the
+   * nearest frame, and the third frame that has no output is released by
+   * the next one */
+  {"ts-shift=10000,drop-frame=3", {0, 1, 2, 3, 4, 5, 6, 7},
+      7, {0, 1, 3, 4, 5, 6, 7}},
+  /* Of two frames with the same PTS the oldest is output first */
+  {NULL, {0, 1, 2, 2, 3, 4, 5, 6}, 8, {0, 1, 2, 3, 4, 5, 6, 7}},
+  /* The P-frame has no output. The output of the B-frame decoded after it
+   * is right between both and gets the frame decoded first, the B-frame
+   * is released */
+  {"ts-shift=20000,drop-frame=2", {0, 2, 1, 3, 4, 5, 6, 7},
+      7, {0, 1, 3, 4, 5, 6, 7}},
+};
+
+typedef struct
+{
+  const MatchingRun *run;
+  guint n_pushed;
+  guint n_out;
+} MatchingTest;
+
+static GstClockTime
+matching_pts (const MatchingRun * run, guint n)
+{
+  return gst_util_uint64_scale (run->pts[n], GST_SECOND, 25);
+}
+
+/* Unique per frame, so the output buffers tell which frame they belong
+ * to even if the PTS is the same */
+static GstClockTime
+matching_duration (guint n)
+{
+  return gst_util_uint64_scale (1, GST_SECOND, 25) + n;
+}
+
+static void
+matching_need_data (GstElement * src, guint length, MatchingTest * test)
+{
+  GstBuffer *buf;
+  GstFlowReturn flow;
+
+  if (test->n_pushed == MATCHING_FRAMES) {
+    g_signal_emit_by_name (src, "end-of-stream", &flow);
+    return;
+  }
+
+  buf = gst_buffer_new_allocate (NULL, 1024, NULL);
+  gst_buffer_memset (buf, 0, 0, 1024);
+  GST_BUFFER_PTS (buf) = matching_pts (test->run, test->n_pushed);
+  GST_BUFFER_DURATION (buf) = matching_duration (test->n_pushed);
+  g_signal_emit_by_name (src, "push-buffer", buf, &flow);
+  gst_buffer_unref (buf);
+
+  test->n_pushed++;
+}
+
+static GstPadProbeReturn
+check_matching_probe (GstPad * pad, GstPadProbeInfo * info,
+    MatchingTest * test)
+{
+  GstVideoDecoder *dec = GST_VIDEO_DECODER (GST_PAD_PARENT (pad));
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  GList *frames, *l;
+  guint n;
+
+  fail_unless (test->n_out < test->run->n_outputs);
+  n = test->run->outputs[test->n_out++];
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buffer),
+      matching_pts (test->run, n));
+  fail_unless_equals_uint64 (GST_BUFFER_DURATION (buffer),
+      matching_duration (n));
+
+  /* Frames before the output one were released, skipped ones too */
+  frames = gst_video_decoder_get_frames (dec);
+  for (l = frames; l; l = l->next) {
+    GstVideoCodecFrame *frame = l->data;
+
+    fail_unless (frame->pts >= GST_BUFFER_PTS (buffer),
+        "Frame %u with PTS %" GST_TIME_FORMAT " was not released",
+        frame->system_frame_number, GST_TIME_ARGS (frame->pts));
+  }
+  g_list_free_full (frames, (GDestroyNotify) gst_video_codec_frame_unref);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+run_frame_matching (const MatchingRun * run)
+{
+  GstElement *pipeline, *src, *dec;
+  GstPad *pad;
+  GError *err = NULL;
+  MatchingTest test = { run, 0, 0 };
+
+  if (run->options)
+    g_setenv ("MOCKOMX_OPTIONS", run->options, TRUE);
+  else
+    g_unsetenv ("MOCKOMX_OPTIONS");
+
+  pipeline = gst_parse_launch ("appsrc name=src format=time "
+      "caps=video/x-h264,stream-format=byte-stream,alignment=au,"
+      "width=176,height=144,framerate=25/1 ! omxh264dec name=dec ! fakesink",
+      &err);
+  fail_unless (pipeline != NULL, "Failed to create pipeline: %s",
+      err ? err->message : "unknown error");
+  g_clear_error (&err);
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  g_signal_connect (src, "need-data", G_CALLBACK (matching_need_data), &test);
+  gst_object_unref (src);
+
+  dec = gst_bin_get_by_name (GST_BIN (pipeline), "dec");
+  pad = gst_element_get_static_pad (dec, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) check_matching_probe, &test, NULL);
+  gst_object_unref (pad);
+  gst_object_unref (dec);
+
+  fail_unless_equals_int (run_pipeline (pipeline), GST_MESSAGE_EOS);
+  fail_unless_equals_int (test.n_pushed, MATCHING_FRAMES);
+  fail_unless_equals_int (test.n_out, run->n_outputs);
+
+  gst_object_unref (pipeline);
+}
+
+/* The output buffers of the encoder and decoder are matched with the
+ * frame they belong to, even if the component shifts their timestamps,
+ * skips a frame or gets several frames with the same PTS. Ties are
+ * resolved in decoding order */
+GST_START_TEST (test_mockomx_frame_matching)
+{
+  GstElement *pipeline, *enc, *dec;
+  GstPad *pad;
+  GError *err = NULL;
+  guint n_encoded = 0, n_decoded = 0, i;
+
+  pipeline = gst_parse_launch ("videotestsrc num-buffers=60 ! "
+      "video/x-raw,format=I420,width=176,height=144,framerate=30/1 ! "
+      "omxh264enc name=enc ! omxh264dec name=dec ! fakesink", &err);
+  fail_unless (pipeline != NULL, "Failed to create pipeline: %s",
+      err ? err->message : "unknown error");
+  g_clear_error (&err);
+
+  enc = gst_bin_get_by_name (GST_BIN (pipeline), "enc");
+  pad = gst_element_get_static_pad (enc, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) check_pts_probe, &n_encoded, NULL);
+  gst_object_unref (pad);
+  gst_object_unref (enc);
+
+  dec = gst_bin_get_by_name (GST_BIN (pipeline), "dec");
+  pad = gst_element_get_static_pad (dec, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) check_pts_probe, &n_decoded, NULL);
+  gst_object_unref (pad);
+  gst_object_unref (dec);
+
+  fail_unless_equals_int (run_pipeline (pipeline), GST_MESSAGE_EOS);
+  fail_unless_equals_int (n_encoded, 60);
+  fail_unless_equals_int (n_decoded, 60);
+
+  gst_object_unref (pipeline);
+
+  for (i = 0; i < G_N_ELEMENTS (matching_runs); i++)
+    run_frame_matching (&matching_runs[i]);
+}
+
+GST_END_TEST;
+
+/* Stopping a pipeline changes the states of the components of all of its
+ * elements at the same time */
+GST_START_TEST (test_mockomx_state_change_overlap)
+{
+  const gchar *branch = "videotestsrc num-buffers=10 ! "
+      "video/x-raw,format=NV12,width=320,height=240,framerate=30/1 ! "
+      "omxh264enc ! omxh264dec ! fakesink";
+  MockOMXTakeStateChangeOverlap take_overlap;
+  GstElement *pipeline;
+  GstBus *bus;
+  GstMessage *msg;
+  GModule *core;
+  gchar *description;
+  GError *err = NULL;
+
+  g_setenv ("MOCKOMX_OPTIONS", "state-latency=100000", TRUE);
+  core = open_mock_core ();
+  fail_unless (g_module_symbol (core, "MockOMX_TakeStateChangeOverlap",
+          (gpointer *) & take_overlap));
+
+  description = g_strdup_printf ("%s %s", branch, branch);
+  pipeline = gst_parse_launch (description, &err);
+  fail_unless (pipeline != NULL, "Failed to create '%s': %s", description,
+      err ? err->message : "unknown error");
+  g_clear_error (&err);
+  g_free (description);
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_ASYNC);
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, PIPELINE_TIMEOUT,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL, "Pipeline timed out");
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  /* Only count the state changes of the shutdown */
+  take_overlap ();
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  fail_unless (take_overlap () > 1);
+
+  gst_object_unref (pipeline);
+  g_module_close (core);
+}
+
+GST_END_TEST;
+
+static Suite *
+mockomx_suite (void)
+{
+  Suite *s = suite_create ("mockomx");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_checked_fixture (tc_chain, NULL, teardown);
+  tcase_add_test (tc_chain, test_mockomx_video_enc_dec);
+  tcase_add_test (tc_chain, test_mockomx_video_enc_input_pool);
+  tcase_add_test (tc_chain, test_mockomx_video_enc_input_pool_reconfigure);
+  tcase_add_test (tc_chain, test_mockomx_video_dec_input_pool);
+  tcase_add_test (tc_chain, test_mockomx_video_dec_input_pool_held);
+  tcase_add_test (tc_chain, test_mockomx_video_dec_input_pool_reconfigure);
+  tcase_add_test (tc_chain, test_mockomx_video_resolution_change);
+  tcase_add_test (tc_chain, test_mockomx_video_dec_output_formats);
+  tcase_add_test (tc_chain, test_mockomx_audio_enc_dec);
+  tcase_add_test (tc_chain, test_mockomx_audio_sink);
+  tcase_add_test (tc_chain, test_mockomx_latency);
+  tcase_add_test (tc_chain, test_mockomx_message_stress);
+  tcase_add_test (tc_chain, test_mockomx_error);
+  tcase_add_test (tc_chain, test_mockomx_component_pool);
+  tcase_add_test (tc_chain, test_mockomx_startup_timeline);
+  tcase_add_test (tc_chain, test_mockomx_probe_caps);
+  tcase_add_test (tc_chain, test_mockomx_adaptive_resolution_change);
+  tcase_add_test (tc_chain, test_mockomx_admission);
+  tcase_add_test (tc_chain, test_mockomx_acquire_throughput);
+  tcase_add_test (tc_chain, test_mockomx_seek);
+  tcase_add_test (tc_chain, test_mockomx_adaptive_output_buffers);
+  tcase_add_test (tc_chain, test_mockomx_video_dec_copy_thread);
+  tcase_add_test (tc_chain, test_mockomx_video_dec_copy_workers);
+  tcase_add_test (tc_chain, test_mockomx_frame_memory);
+  tcase_add_test (tc_chain, test_mockomx_pool_stats);
+  tcase_add_test (tc_chain, test_mockomx_video_dec_video_meta);
+  tcase_add_test (tc_chain, test_mockomx_frame_matching);
+  tcase_add_test (tc_chain, test_mockomx_state_change_overlap);
+
+  return s;
+}
+
+int
+main (int argc, char **argv)
+{
+  /* The mock core and its configuration replace the ones of the target
+   * the elements were built for. Needs to be set before the plugin is
+   * loaded */
+  g_setenv ("GST_OMX_CONFIG_DIR", MOCKOMX_CONFIG_DIR, TRUE);
+
+  gst_check_init (&argc, &argv);
+
+  return gst_check_run_suite (mockomx_suite (), "mockomx", __FILE__);
+}
@@ -0,0 +1,2723 @@
+/*
+ * Copyright (C) 2026, RidgeRun
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/* A software-only OpenMAX IL core that is used to run the gst-omx elements
+ * without any hardware, e.g. for the unit tests and benchmarks.
+ *
+ * The components don't decode or encode anything. They implement the
+ * OpenMAX IL state machine, the port handling and the buffer flow of a
+ * real component and produce one output buffer per input frame, carrying
+ * over its timestamp and EOS flag. Components are named
+ * "OMX.mock.<role>", e.g. "OMX.mock.video_decoder.avc".
+ *
+ * The behaviour can be tuned with the MOCKOMX_OPTIONS environment
+ * variable, a comma separated list of key=value pairs that is read every
+ * time a component is created:
+ *
+ *   latency             usecs between receiving an input buffer and
+ *                       processing it (default 0)
+ *   state-latency       usecs a state change takes (default 0)
+ *   in-buffers          buffer count of the input port
+ *   out-buffers         buffer count of the output port
+ *   in-buffer-size      buffer size of compressed or PCM input ports
+ *   out-buffer-size     buffer size of compressed or PCM output ports
+ *   alignment           required buffer alignment (default 16)
+ *   stride-align        alignment of the stride of raw video ports
+ *   slice-height-align  alignment of the slice height of raw video ports
+ *   width, height       size of the decoded video, 0 to use the input size
+ *   psc-interval        output frames between port settings changed
+ *                       events, 0 to only signal the initial settings
+ *   psc-after           output frames after which port settings changed
+ *                       is signalled once more, 0 to never signal it
+ *   psc-halve           halve the decoded video size with every other
+ *                       port settings changed event
+ *   in-psc-after        input frames after which new input port settings
+ *                       are signalled once, 0 to never signal them
+ *   ts-shift            usecs added to the timestamps of the output
+ *                       buffers, like the jitter of a real component
+ *   drop-frame          input frame that produces no output, e.g.
+ *                       because it is corrupt, 0 to output all frames
+ *   flag-events         signal an OMX_EventBufferFlag event without flags
+ *                       for every returned input buffer. gst-omx handles
+ *                       it like any other event and can't take the fast
+ *                       path when acquiring the next input buffer
+ *   adaptive            keep filling the allocated output buffers after
+ *                       port settings changed events if they are still
+ *                       large enough, instead of waiting for the port
+ *                       to be disabled and enabled again
+ *   gop                 encoder frames between sync frames (default 30)
+ *   error-after         input buffers after which an error is signalled,
+ *                       0 to never fail
+ *   error               OMX_ERRORTYPE to signal (default OMX_ErrorHardware)
+ *
+ * Besides the OpenMAX IL core functions, MockOMX_GetHandleCount(),
+ * MockOMX_GetPortCounters() and MockOMX_TakeStateChangeOverlap() let
+ * tests check how many components were created, how often their ports
+ * were disabled, how many buffers were added to them and how many
+ * components changed their state at the same time.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mockomx.h"
+
+#ifdef GST_OMX_STRUCT_PACKING
+# if GST_OMX_STRUCT_PACKING == 1
+#  pragma pack(1)
+# elif GST_OMX_STRUCT_PACKING == 2
+#  pragma pack(2)
+# elif GST_OMX_STRUCT_PACKING == 4
+#  pragma pack(4)
+# elif GST_OMX_STRUCT_PACKING == 8
+#  pragma pack(8)
+# else
+#  error "Unsupported struct packing value"
+# endif
+#endif
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#ifdef HAVE_VIDEO_EXT
+#include <OMX_VideoExt.h>
+#endif
+
+#ifdef GST_OMX_STRUCT_PACKING
+#pragma pack()
+#endif
+
+#if OMX_VERSION_MINOR == 2
+#define OMX_StateInvalid OMX_StateReserved_0x00000000
+#endif
+
+#define MOCK_OMX_PREFIX "OMX.mock."
+#define MOCK_OMX_OPTIONS_ENV "MOCKOMX_OPTIONS"
+
+#define MOCK_OMX_IN_PORT 0
+#define MOCK_OMX_OUT_PORT 1
+#define MOCK_OMX_N_PORTS 2
+#define MOCK_OMX_N_COMPONENTS (sizeof (components) / sizeof (components[0]))
+
+#define MOCK_OMX_MAX_BUFFERS 64
+#define MOCK_OMX_MAX_PLANAR_WIDTH 1920
+#define MOCK_OMX_MAX_COMMANDS 32
+#define MOCK_OMX_MAX_FRAMES 64
+
+#define MOCK_OMX_ROUND_UP(v, a) ((a) > 1 ? (((v) + (a) - 1) / (a)) * (a) : (v))
+
+#define MOCK_OMX_INIT_STRUCT(st) do { \
+  memset ((st), 0, sizeof (*(st))); \
+  (st)->nSize = sizeof (*(st)); \
+  (st)->nVersion.s.nVersionMajor = OMX_VERSION_MAJOR; \
+  (st)->nVersion.s.nVersionMinor = OMX_VERSION_MINOR; \
+  (st)->nVersion.s.nRevision = OMX_VERSION_REVISION; \
+  (st)->nVersion.s.nStep = OMX_VERSION_STEP; \
+} while (0)
+
+/* All parameter and config structures start like this one */
+typedef struct
+{
+  OMX_U32 nSize;
+  OMX_VERSIONTYPE nVersion;
+  OMX_U32 nPortIndex;
+} MockOMXParamHeader;
+
+typedef enum
+{
+  MOCK_OMX_VIDEO_DECODER,
+  MOCK_OMX_VIDEO_ENCODER,
+  MOCK_OMX_AUDIO_DECODER,
+  MOCK_OMX_AUDIO_ENCODER,
+  MOCK_OMX_AUDIO_RENDERER,
+} MockOMXKind;
+
+typedef struct
+{
+  const char *role;
+  MockOMXKind kind;
+  OMX_U32 coding;
+} MockOMXComponentInfo;
+
+static const MockOMXComponentInfo components[] = {
+  {"video_decoder.avc", MOCK_OMX_VIDEO_DECODER, OMX_VIDEO_CodingAVC},
+  {"video_decoder.mpeg2", MOCK_OMX_VIDEO_DECODER, OMX_VIDEO_CodingMPEG2},
+  {"video_decoder.mpeg4", MOCK_OMX_VIDEO_DECODER, OMX_VIDEO_CodingMPEG4},
+  {"video_decoder.h263", MOCK_OMX_VIDEO_DECODER, OMX_VIDEO_CodingH263},
+  {"video_decoder.wmv", MOCK_OMX_VIDEO_DECODER, OMX_VIDEO_CodingWMV},
+  {"video_decoder.mjpeg", MOCK_OMX_VIDEO_DECODER, OMX_VIDEO_CodingMJPEG},
+#ifdef HAVE_VP8
+  {"video_decoder.vp8", MOCK_OMX_VIDEO_DECODER, OMX_VIDEO_CodingVP8},
+#endif
+#ifdef HAVE_HEVC
+  {"video_decoder.hevc", MOCK_OMX_VIDEO_DECODER, OMX_VIDEO_CodingHEVC},
+#endif
+  {"video_encoder.avc", MOCK_OMX_VIDEO_ENCODER, OMX_VIDEO_CodingAVC},
+  {"video_encoder.mpeg4", MOCK_OMX_VIDEO_ENCODER, OMX_VIDEO_CodingMPEG4},
+  {"video_encoder.h263", MOCK_OMX_VIDEO_ENCODER, OMX_VIDEO_CodingH263},
+#ifdef HAVE_HEVC
+  {"video_encoder.hevc", MOCK_OMX_VIDEO_ENCODER, OMX_VIDEO_CodingHEVC},
+#endif
+  {"audio_decoder.aac", MOCK_OMX_AUDIO_DECODER, OMX_AUDIO_CodingAAC},
+  {"audio_decoder.mp3", MOCK_OMX_AUDIO_DECODER, OMX_AUDIO_CodingMP3},
+  {"audio_encoder.aac", MOCK_OMX_AUDIO_ENCODER, OMX_AUDIO_CodingAAC},
+  {"audio_encoder.mp3", MOCK_OMX_AUDIO_ENCODER, OMX_AUDIO_CodingMP3},
+  {"audio_render.local", MOCK_OMX_AUDIO_RENDERER, OMX_AUDIO_CodingPCM},
+  {"audio_render.hdmi", MOCK_OMX_AUDIO_RENDERER, OMX_AUDIO_CodingPCM},
+};
+
+static const OMX_COLOR_FORMATTYPE color_formats[] = {
+  OMX_COLOR_FormatYUV420SemiPlanar,
+  OMX_COLOR_FormatYUV420Planar,
+};
+
+typedef struct
+{
+  OMX_U32 latency;
+  OMX_U32 state_latency;
+  OMX_U32 in_buffers;
+  OMX_U32 out_buffers;
+  OMX_U32 in_buffer_size;
+  OMX_U32 out_buffer_size;
+  OMX_U32 alignment;
+  OMX_U32 stride_align;
+  OMX_U32 slice_height_align;
+  OMX_U32 width;
+  OMX_U32 height;
+  OMX_U32 psc_interval;
+  OMX_U32 psc_after;
+  OMX_U32 psc_halve;
+  OMX_U32 in_psc_after;
+  OMX_U32 ts_shift;
+  OMX_U32 drop_frame;
+  OMX_U32 flag_events;
+  OMX_U32 adaptive;
+  OMX_U32 gop;
+  OMX_U32 error_after;
+  OMX_U32 error;
+} MockOMXOptions;
+
+static const struct
+{
+  const char *name;
+  size_t offset;
+} option_names[] = {
+  {"latency", offsetof (MockOMXOptions, latency)},
+  {"state-latency", offsetof (MockOMXOptions, state_latency)},
+  {"in-buffers", offsetof (MockOMXOptions, in_buffers)},
+  {"out-buffers", offsetof (MockOMXOptions, out_buffers)},
+  {"in-buffer-size", offsetof (MockOMXOptions, in_buffer_size)},
+  {"out-buffer-size", offsetof (MockOMXOptions, out_buffer_size)},
+  {"alignment", offsetof (MockOMXOptions, alignment)},
+  {"stride-align", offsetof (MockOMXOptions, stride_align)},
+  {"slice-height-align", offsetof (MockOMXOptions, slice_height_align)},
+  {"width", offsetof (MockOMXOptions, width)},
+  {"height", offsetof (MockOMXOptions, height)},
+  {"psc-interval", offsetof (MockOMXOptions, psc_interval)},
+  {"psc-after", offsetof (MockOMXOptions, psc_after)},
+  {"psc-halve", offsetof (MockOMXOptions, psc_halve)},
+  {"in-psc-after", offsetof (MockOMXOptions, in_psc_after)},
+  {"ts-shift", offsetof (MockOMXOptions, ts_shift)},
+  {"drop-frame", offsetof (MockOMXOptions, drop_frame)},
+  {"flag-events", offsetof (MockOMXOptions, flag_events)},
+  {"adaptive", offsetof (MockOMXOptions, adaptive)},
+  {"gop", offsetof (MockOMXOptions, gop)},
+  {"error-after", offsetof (MockOMXOptions, error_after)},
+  {"error", offsetof (MockOMXOptions, error)},
+};
+
+typedef struct _MockOMXComponent MockOMXComponent;
+typedef struct _MockOMXBuffer MockOMXBuffer;
+
+struct _MockOMXBuffer
+{
+  /* Must be the first member, buffer headers are cast to MockOMXBuffer */
+  OMX_BUFFERHEADERTYPE header;
+
+  /* pBuffer was allocated by us */
+  int allocated;
+  /* Owned by the component at the moment */
+  int held;
+  /* Monotonic time in usecs at which an input buffer is processed */
+  uint64_t due;
+  MockOMXBuffer *next;
+};
+
+typedef struct
+{
+  OMX_PARAM_PORTDEFINITIONTYPE def;
+
+  OMX_VIDEO_PARAM_PROFILELEVELTYPE profile_level;
+  OMX_VIDEO_PARAM_BITRATETYPE bitrate;
+  OMX_VIDEO_PARAM_AVCTYPE avc;
+  OMX_AUDIO_PARAM_PCMMODETYPE pcm;
+  OMX_AUDIO_PARAM_AACPROFILETYPE aac;
+  OMX_AUDIO_PARAM_MP3TYPE mp3;
+  OMX_AUDIO_CONFIG_VOLUMETYPE volume;
+  OMX_AUDIO_CONFIG_MUTETYPE mute;
+
+  MockOMXBuffer *buffers[MOCK_OMX_MAX_BUFFERS];
+  OMX_U32 n_buffers;
+
+  /* Buffers owned by the component, in the order they were passed */
+  MockOMXBuffer *queue_head, *queue_tail;
+} MockOMXPort;
+
+typedef struct
+{
+  OMX_COMMANDTYPE cmd;
+  OMX_U32 param;
+} MockOMXCommand;
+
+typedef struct
+{
+  OMX_TICKS timestamp;
+  OMX_U32 flags;
+  int has_data;
+  /* New output settings are signalled before this frame is output */
+  int new_settings;
+} MockOMXFrame;
+
+typedef enum
+{
+  MOCK_OMX_CALLBACK_EVENT,
+  MOCK_OMX_CALLBACK_EMPTY_BUFFER_DONE,
+  MOCK_OMX_CALLBACK_FILL_BUFFER_DONE,
+} MockOMXCallbackType;
+
+typedef struct
+{
+  MockOMXCallbackType type;
+  OMX_EVENTTYPE event;
+  OMX_U32 data1, data2;
+  OMX_BUFFERHEADERTYPE *buffer;
+} MockOMXCallback;
+
+struct _MockOMXComponent
+{
+  OMX_COMPONENTTYPE handle;
+  const MockOMXComponentInfo *info;
+  MockOMXOptions options;
+
+  OMX_CALLBACKTYPE callbacks;
+  OMX_PTR app_data;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+  int running;
+
+  OMX_STATETYPE state;
+  MockOMXPort ports[MOCK_OMX_N_PORTS];
+
+  MockOMXCommand commands[MOCK_OMX_MAX_COMMANDS];
+  OMX_U32 commands_head, commands_len;
+  /* The command that is currently executed, if any, and the ports it
+   * still has to complete for */
+  int command_active;
+  MockOMXCommand command;
+  OMX_U32 command_ports;
+  /* The current state change started and doesn't finish before due */
+  int changing_state;
+  uint64_t command_due;
+
+  /* Frames that were produced but not output yet */
+  MockOMXFrame frames[MOCK_OMX_MAX_FRAMES];
+  OMX_U32 frames_head, frames_len;
+
+  /* The initial output port settings were not signalled yet */
+  int settings_initial;
+  /* Output port settings were signalled but the port was not
+   * reconfigured yet */
+  int settings_pending;
+  /* The decoded video size is currently halved */
+  int settings_halved;
+  OMX_U32 n_frames;
+  OMX_U32 n_processed;
+  OMX_U32 n_input_frames;
+  int force_sync;
+  int failed;
+
+  /* Only accessed from the component thread */
+  MockOMXCallback *outbox;
+  OMX_U32 outbox_len, outbox_size;
+};
+
+typedef struct
+{
+  unsigned int n_disabled;
+  unsigned int n_buffers_added;
+} MockOMXPortCounters;
+
+static int core_refcount = 0;
+static pthread_mutex_t core_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Summed over all components of a role, protected by core_lock */
+static unsigned int n_handles[MOCK_OMX_N_COMPONENTS];
+static MockOMXPortCounters counters[MOCK_OMX_N_COMPONENTS][MOCK_OMX_N_PORTS];
+/* Components that are changing their state and the most that did at the
+ * same time since the last MockOMX_TakeStateChangeOverlap(), protected
+ * by core_lock */
+static unsigned int n_state_changes, max_state_changes;
+
+static uint64_t
+mock_omx_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void
+mock_omx_state_change_begin (MockOMXComponent * self)
+{
+  self->changing_state = 1;
+  self->command_due = mock_omx_now () + self->options.state_latency;
+
+  pthread_mutex_lock (&core_lock);
+  n_state_changes++;
+  if (n_state_changes > max_state_changes)
+    max_state_changes = n_state_changes;
+  pthread_mutex_unlock (&core_lock);
+}
+
+static void
+mock_omx_state_change_end (MockOMXComponent * self)
+{
+  if (!self->changing_state)
+    return;
+  self->changing_state = 0;
+
+  pthread_mutex_lock (&core_lock);
+  n_state_changes--;
+  pthread_mutex_unlock (&core_lock);
+}
+
+static void
+mock_omx_options_parse (MockOMXOptions * options)
+{
+  const char *env;
+  char *str, *token, *saveptr = NULL;
+  unsigned int i;
+
+  memset (options, 0, sizeof (*options));
+  options->alignment = 16;
+  options->stride_align = 32;
+  options->slice_height_align = 16;
+  options->gop = 30;
+  options->error = (OMX_U32) OMX_ErrorHardware;
+
+  env = getenv (MOCK_OMX_OPTIONS_ENV);
+  if (!env || !*env)
+    return;
+
+  str = strdup (env);
+  for (token = strtok_r (str, ",;", &saveptr); token;
+      token = strtok_r (NULL, ",;", &saveptr)) {
+    char *value = strchr (token, '=');
+    char *end;
+    unsigned long v;
+
+    if (!value) {
+      fprintf (stderr, "mockomx: ignoring invalid option '%s'\n", token);
+      continue;
+    }
+    *value++ = '\0';
+
+    v = strtoul (value, &end, 0);
+    if (*value == '\0' || *end != '\0') {
+      fprintf (stderr, "mockomx: invalid value '%s' for option '%s'\n", value,
+          token);
+      continue;
+    }
+
+    for (i = 0; i < sizeof (option_names) / sizeof (option_names[0]); i++) {
+      if (strcmp (option_names[i].name, token) == 0) {
+        *((OMX_U32 *) (((char *) options) + option_names[i].offset)) = v;
+        break;
+      }
+    }
+    if (i == sizeof (option_names) / sizeof (option_names[0]))
+      fprintf (stderr, "mockomx: ignoring unknown option '%s'\n", token);
+  }
+  free (str);
+}
+
+static MockOMXComponent *
+mock_omx_get (OMX_HANDLETYPE handle)
+{
+  if (!handle)
+    return NULL;
+
+  return ((OMX_COMPONENTTYPE *) handle)->pComponentPrivate;
+}
+
+static int
+mock_omx_has_output (MockOMXComponent * self)
+{
+  return self->info->kind != MOCK_OMX_AUDIO_RENDERER;
+}
+
+static MockOMXPort *
+mock_omx_get_port (MockOMXComponent * self, OMX_U32 index)
+{
+  if (index >= MOCK_OMX_N_PORTS)
+    return NULL;
+
+  return &self->ports[index];
+}
+
+static int
+mock_omx_port_is_raw_video (MockOMXPort * port)
+{
+  return port->def.eDomain == OMX_PortDomainVideo
+      && port->def.format.video.eCompressionFormat == OMX_VIDEO_CodingUnused;
+}
+
+static int
+mock_omx_port_is_compressed_video (MockOMXPort * port)
+{
+  return port->def.eDomain == OMX_PortDomainVideo
+      && port->def.format.video.eCompressionFormat != OMX_VIDEO_CodingUnused;
+}
+
+static int
+mock_omx_port_is_audio (MockOMXPort * port, OMX_AUDIO_CODINGTYPE coding)
+{
+  return port->def.eDomain == OMX_PortDomainAudio
+      && port->def.format.audio.eEncoding == coding;
+}
+
+/* Like real decoders the output formats depend on the stream: frames
+ * wider than MOCK_OMX_MAX_PLANAR_WIDTH are only decoded to the first,
+ * semi-planar, format */
+static unsigned int
+mock_omx_n_color_formats (MockOMXComponent * self, MockOMXPort * port)
+{
+  if (self->info->kind == MOCK_OMX_VIDEO_DECODER
+      && port->def.eDir == OMX_DirOutput
+      && self->ports[MOCK_OMX_IN_PORT].def.format.video.nFrameWidth >
+      MOCK_OMX_MAX_PLANAR_WIDTH)
+    return 1;
+
+  return sizeof (color_formats) / sizeof (color_formats[0]);
+}
+
+static int
+mock_omx_color_format_supported (MockOMXComponent * self, MockOMXPort * port,
+    OMX_COLOR_FORMATTYPE format)
+{
+  unsigned int i;
+
+  for (i = 0; i < mock_omx_n_color_formats (self, port); i++) {
+    if (color_formats[i] == format)
+      return 1;
+  }
+
+  return 0;
+}
+
+/* Updates stride, slice height and the minimum buffer size of a raw video
+ * port from its frame size. Returns the size of one frame */
+static OMX_U32
+mock_omx_port_update_video_layout (MockOMXComponent * self, MockOMXPort * port)
+{
+  OMX_VIDEO_PORTDEFINITIONTYPE *video = &port->def.format.video;
+  OMX_U32 stride, slice_height;
+
+  stride = video->nStride > 0 ? (OMX_U32) video->nStride : 0;
+  if (stride < video->nFrameWidth)
+    stride = video->nFrameWidth;
+  stride = MOCK_OMX_ROUND_UP (stride, self->options.stride_align);
+
+  slice_height = video->nSliceHeight;
+  if (slice_height < video->nFrameHeight)
+    slice_height = video->nFrameHeight;
+  slice_height =
+      MOCK_OMX_ROUND_UP (slice_height, self->options.slice_height_align);
+
+  video->nStride = stride;
+  video->nSliceHeight = slice_height;
+
+  /* Both supported formats are 4:2:0 with 8 bits per sample */
+  return stride * slice_height * 3 / 2;
+}
+
+static void
+mock_omx_port_init (MockOMXComponent * self, OMX_U32 index, OMX_DIRTYPE dir,
+    OMX_PORTDOMAINTYPE domain, OMX_U32 count, OMX_U32 size)
+{
+  MockOMXPort *port = &self->ports[index];
+
+  MOCK_OMX_INIT_STRUCT (&port->def);
+  port->def.nPortIndex = index;
+  port->def.eDir = dir;
+  port->def.nBufferCountActual = count;
+  port->def.nBufferCountMin = count;
+  port->def.nBufferSize = size;
+  port->def.bEnabled = OMX_TRUE;
+  port->def.bPopulated = OMX_FALSE;
+  port->def.eDomain = domain;
+  port->def.nBufferAlignment = self->options.alignment;
+}
+
+static void
+mock_omx_port_init_video (MockOMXComponent * self, OMX_U32 index,
+    OMX_DIRTYPE dir, OMX_U32 count, OMX_U32 size, OMX_VIDEO_CODINGTYPE coding)
+{
+  MockOMXPort *port = &self->ports[index];
+  OMX_VIDEO_PORTDEFINITIONTYPE *video = &port->def.format.video;
+
+  mock_omx_port_init (self, index, dir, OMX_PortDomainVideo, count, size);
+
+  video->nFrameWidth = self->options.width ? self->options.width : 320;
+  video->nFrameHeight = self->options.height ? self->options.height : 240;
+  video->xFramerate = 30 << 16;
+  video->eCompressionFormat = coding;
+
+  if (coding == OMX_VIDEO_CodingUnused) {
+    video->eColorFormat = color_formats[0];
+    port->def.nBufferSize = mock_omx_port_update_video_layout (self, port);
+  } else {
+    video->eColorFormat = OMX_COLOR_FormatUnused;
+    video->nBitrate = 4000000;
+
+    MOCK_OMX_INIT_STRUCT (&port->profile_level);
+    port->profile_level.nPortIndex = index;
+    if (coding == OMX_VIDEO_CodingAVC) {
+      port->profile_level.eProfile = OMX_VIDEO_AVCProfileBaseline;
+      port->profile_level.eLevel = OMX_VIDEO_AVCLevel4;
+    } else {
+      /* The lowest profile and level of all codecs */
+      port->profile_level.eProfile = 0x1;
+      port->profile_level.eLevel = 0x1;
+    }
+
+    MOCK_OMX_INIT_STRUCT (&port->bitrate);
+    port->bitrate.nPortIndex = index;
+    port->bitrate.eControlRate = OMX_Video_ControlRateVariable;
+    port->bitrate.nTargetBitrate = video->nBitrate;
+
+    MOCK_OMX_INIT_STRUCT (&port->avc);
+    port->avc.nPortIndex = index;
+    port->avc.nPFrames = self->options.gop ? self->options.gop - 1 : 0;
+    port->avc.nRefFrames = 1;
+    port->avc.eProfile = OMX_VIDEO_AVCProfileBaseline;
+    port->avc.eLevel = OMX_VIDEO_AVCLevel4;
+    port->avc.nAllowedPictureTypes =
+        OMX_VIDEO_PictureTypeI | OMX_VIDEO_PictureTypeP;
+    port->avc.bFrameMBsOnly = OMX_TRUE;
+    port->avc.bEnableFMO = OMX_FALSE;
+    port->avc.eLoopFilterMode = OMX_VIDEO_AVCLoopFilterEnable;
+  }
+}
+
+static void
+mock_omx_port_init_audio (MockOMXComponent * self, OMX_U32 index,
+    OMX_DIRTYPE dir, OMX_U32 count, OMX_U32 size, OMX_AUDIO_CODINGTYPE coding)
+{
+  MockOMXPort *port = &self->ports[index];
+
+  mock_omx_port_init (self, index, dir, OMX_PortDomainAudio, count, size);
+  port->def.format.audio.eEncoding = coding;
+
+  MOCK_OMX_INIT_STRUCT (&port->pcm);
+  port->pcm.nPortIndex = index;
+  port->pcm.nChannels = 2;
+  port->pcm.eNumData = OMX_NumericalDataSigned;
+  port->pcm.eEndian = OMX_EndianLittle;
+  port->pcm.bInterleaved = OMX_TRUE;
+  port->pcm.nBitPerSample = 16;
+  port->pcm.nSamplingRate = 48000;
+  port->pcm.ePCMMode = OMX_AUDIO_PCMModeLinear;
+  port->pcm.eChannelMapping[0] = OMX_AUDIO_ChannelLF;
+  port->pcm.eChannelMapping[1] = OMX_AUDIO_ChannelRF;
+
+  MOCK_OMX_INIT_STRUCT (&port->aac);
+  port->aac.nPortIndex = index;
+  port->aac.nChannels = 2;
+  port->aac.nSampleRate = 48000;
+  port->aac.nBitRate = 128000;
+  port->aac.nFrameLength = 1024;
+  port->aac.eAACProfile = OMX_AUDIO_AACObjectLC;
+  port->aac.eAACStreamFormat = OMX_AUDIO_AACStreamFormatMP4ADTS;
+  port->aac.eChannelMode = OMX_AUDIO_ChannelModeStereo;
+
+  MOCK_OMX_INIT_STRUCT (&port->mp3);
+  port->mp3.nPortIndex = index;
+  port->mp3.nChannels = 2;
+  port->mp3.nBitRate = 128000;
+  port->mp3.nSampleRate = 48000;
+  port->mp3.eChannelMode = OMX_AUDIO_ChannelModeStereo;
+  port->mp3.eFormat = OMX_AUDIO_MP3StreamFormatMP1Layer3;
+
+  MOCK_OMX_INIT_STRUCT (&port->volume);
+  port->volume.nPortIndex = index;
+  port->volume.bLinear = OMX_TRUE;
+  port->volume.sVolume.nValue = 100;
+  port->volume.sVolume.nMax = 100;
+
+  MOCK_OMX_INIT_STRUCT (&port->mute);
+  port->mute.nPortIndex = index;
+}
+
+static void
+mock_omx_init_ports (MockOMXComponent * self)
+{
+  const MockOMXOptions *o = &self->options;
+  OMX_U32 in_buffers, out_buffers;
+
+  in_buffers = o->in_buffers ? o->in_buffers : 4;
+  out_buffers = o->out_buffers ? o->out_buffers : 4;
+
+  switch (self->info->kind) {
+    case MOCK_OMX_VIDEO_DECODER:
+      mock_omx_port_init_video (self, MOCK_OMX_IN_PORT, OMX_DirInput,
+          in_buffers, o->in_buffer_size ? o->in_buffer_size : 1024 * 1024,
+          self->info->coding);
+      mock_omx_port_init_video (self, MOCK_OMX_OUT_PORT, OMX_DirOutput,
+          out_buffers, 0, OMX_VIDEO_CodingUnused);
+      break;
+    case MOCK_OMX_VIDEO_ENCODER:
+      mock_omx_port_init_video (self, MOCK_OMX_IN_PORT, OMX_DirInput,
+          in_buffers, 0, OMX_VIDEO_CodingUnused);
+      mock_omx_port_init_video (self, MOCK_OMX_OUT_PORT, OMX_DirOutput,
+          out_buffers, o->out_buffer_size ? o->out_buffer_size : 1024 * 1024,
+          self->info->coding);
+      break;
+    case MOCK_OMX_AUDIO_DECODER:
+      mock_omx_port_init_audio (self, MOCK_OMX_IN_PORT, OMX_DirInput,
+          in_buffers, o->in_buffer_size ? o->in_buffer_size : 8192,
+          self->info->coding);
+      mock_omx_port_init_audio (self, MOCK_OMX_OUT_PORT, OMX_DirOutput,
+          out_buffers, o->out_buffer_size ? o->out_buffer_size : 32768,
+          OMX_AUDIO_CodingPCM);
+      break;
+    case MOCK_OMX_AUDIO_ENCODER:
+      mock_omx_port_init_audio (self, MOCK_OMX_IN_PORT, OMX_DirInput,
+          in_buffers, o->in_buffer_size ? o->in_buffer_size : 32768,
+          OMX_AUDIO_CodingPCM);
+      mock_omx_port_init_audio (self, MOCK_OMX_OUT_PORT, OMX_DirOutput,
+          out_buffers, o->out_buffer_size ? o->out_buffer_size : 8192,
+          self->info->coding);
+      break;
+    case MOCK_OMX_AUDIO_RENDERER:
+      mock_omx_port_init_audio (self, MOCK_OMX_IN_PORT, OMX_DirInput,
+          in_buffers, o->in_buffer_size ? o->in_buffer_size : 32768,
+          OMX_AUDIO_CodingPCM);
+      /* Clock port, like the one of hardware renderers. It is never
+       * used for data */
+      mock_omx_port_init (self, MOCK_OMX_OUT_PORT, OMX_DirInput,
+          OMX_PortDomainOther, 1, sizeof (OMX_TIME_MEDIATIMETYPE));
+      self->ports[MOCK_OMX_OUT_PORT].def.format.other.eFormat =
+          OMX_OTHER_FormatTime;
+      break;
+  }
+}
+
+/* Propagates input port settings to the output port, like a real
+ * component would do after parsing the stream headers */
+static void
+mock_omx_update_output_settings (MockOMXComponent * self)
+{
+  MockOMXPort *in = &self->ports[MOCK_OMX_IN_PORT];
+  MockOMXPort *out = &self->ports[MOCK_OMX_OUT_PORT];
+
+  switch (self->info->kind) {
+    case MOCK_OMX_VIDEO_DECODER:{
+      OMX_VIDEO_PORTDEFINITIONTYPE *video = &out->def.format.video;
+
+      video->nFrameWidth = self->options.width ? self->options.width :
+          in->def.format.video.nFrameWidth;
+      video->nFrameHeight = self->options.height ? self->options.height :
+          in->def.format.video.nFrameHeight;
+      if (self->settings_halved) {
+        video->nFrameWidth = (video->nFrameWidth / 2 + 1) & ~1;
+        video->nFrameHeight = (video->nFrameHeight / 2 + 1) & ~1;
+      }
+      video->xFramerate = in->def.format.video.xFramerate;
+      video->nStride = 0;
+      video->nSliceHeight = 0;
+      out->def.nBufferSize = mock_omx_port_update_video_layout (self, out);
+      break;
+    }
+    case MOCK_OMX_VIDEO_ENCODER:
+      out->def.format.video.nFrameWidth = in->def.format.video.nFrameWidth;
+      out->def.format.video.nFrameHeight = in->def.format.video.nFrameHeight;
+      out->def.format.video.xFramerate = in->def.format.video.xFramerate;
+      break;
+    case MOCK_OMX_AUDIO_DECODER:
+      if (self->info->coding == OMX_AUDIO_CodingAAC) {
+        out->pcm.nChannels = in->aac.nChannels;
+        out->pcm.nSamplingRate = in->aac.nSampleRate;
+      } else {
+        out->pcm.nChannels = in->mp3.nChannels;
+        out->pcm.nSamplingRate = in->mp3.nSampleRate;
+      }
+      break;
+    case MOCK_OMX_AUDIO_ENCODER:
+      out->aac.nChannels = out->mp3.nChannels = in->pcm.nChannels;
+      out->aac.nSampleRate = out->mp3.nSampleRate = in->pcm.nSamplingRate;
+      break;
+    case MOCK_OMX_AUDIO_RENDERER:
+      break;
+  }
+}
+
+static void
+mock_omx_emit (MockOMXComponent * self, MockOMXCallbackType type,
+    OMX_EVENTTYPE event, OMX_U32 data1, OMX_U32 data2,
+    OMX_BUFFERHEADERTYPE * buffer)
+{
+  MockOMXCallback *cb;
+
+  if (self->outbox_len == self->outbox_size) {
+    self->outbox_size = self->outbox_size ? 2 * self->outbox_size : 16;
+    self->outbox =
+        realloc (self->outbox, self->outbox_size * sizeof (MockOMXCallback));
+    if (!self->outbox)
+      abort ();
+  }
+
+  cb = &self->outbox[self->outbox_len++];
+  cb->type = type;
+  cb->event = event;
+  cb->data1 = data1;
+  cb->data2 = data2;
+  cb->buffer = buffer;
+}
+
+static void
+mock_omx_emit_event (MockOMXComponent * self, OMX_EVENTTYPE event,
+    OMX_U32 data1, OMX_U32 data2)
+{
+  mock_omx_emit (self, MOCK_OMX_CALLBACK_EVENT, event, data1, data2, NULL);
+}
+
+static void
+mock_omx_emit_buffer_done (MockOMXComponent * self, MockOMXPort * port,
+    MockOMXBuffer * buf)
+{
+  buf->held = 0;
+  mock_omx_emit (self, port->def.eDir == OMX_DirInput ?
+      MOCK_OMX_CALLBACK_EMPTY_BUFFER_DONE : MOCK_OMX_CALLBACK_FILL_BUFFER_DONE,
+      OMX_EventMax, 0, 0, &buf->header);
+}
+
+/* Called without the lock */
+static void
+mock_omx_dispatch (MockOMXComponent * self)
+{
+  OMX_U32 i;
+
+  for (i = 0; i < self->outbox_len; i++) {
+    MockOMXCallback *cb = &self->outbox[i];
+
+    switch (cb->type) {
+      case MOCK_OMX_CALLBACK_EVENT:
+        if (self->callbacks.EventHandler)
+          self->callbacks.EventHandler (&self->handle, self->app_data,
+              cb->event, cb->data1, cb->data2, NULL);
+        break;
+      case MOCK_OMX_CALLBACK_EMPTY_BUFFER_DONE:
+        if (self->callbacks.EmptyBufferDone)
+          self->callbacks.EmptyBufferDone (&self->handle, self->app_data,
+              cb->buffer);
+        break;
+      case MOCK_OMX_CALLBACK_FILL_BUFFER_DONE:
+        if (self->callbacks.FillBufferDone)
+          self->callbacks.FillBufferDone (&self->handle, self->app_data,
+              cb->buffer);
+        break;
+    }
+  }
+  self->outbox_len = 0;
+}
+
+static void
+mock_omx_port_push (MockOMXPort * port, MockOMXBuffer * buf)
+{
+  buf->held = 1;
+  buf->next = NULL;
+  if (port->queue_tail)
+    port->queue_tail->next = buf;
+  else
+    port->queue_head = buf;
+  port->queue_tail = buf;
+}
+
+static MockOMXBuffer *
+mock_omx_port_pop (MockOMXPort * port)
+{
+  MockOMXBuffer *buf = port->queue_head;
+
+  if (buf) {
+    port->queue_head = buf->next;
+    if (!port->queue_head)
+      port->queue_tail = NULL;
+    buf->next = NULL;
+  }
+
+  return buf;
+}
+
+static void
+mock_omx_port_remove (MockOMXPort * port, MockOMXBuffer * buf)
+{
+  MockOMXBuffer **p, *prev = NULL;
+
+  for (p = &port->queue_head; *p; prev = *p, p = &(*p)->next) {
+    if (*p == buf) {
+      *p = buf->next;
+      if (port->queue_tail == buf)
+        port->queue_tail = prev;
+      buf->next = NULL;
+      buf->held = 0;
+      return;
+    }
+  }
+}
+
+static void
+mock_omx_port_return_buffers (MockOMXComponent * self, MockOMXPort * port)
+{
+  MockOMXBuffer *buf;
+
+  while ((buf = mock_omx_port_pop (port))) {
+    if (port->def.eDir == OMX_DirOutput) {
+      buf->header.nFilledLen = 0;
+      buf->header.nOffset = 0;
+      buf->header.nFlags = 0;
+    }
+    mock_omx_emit_buffer_done (self, port, buf);
+  }
+}
+
+static int
+mock_omx_port_is_populated (MockOMXPort * port)
+{
+  return port->n_buffers >= port->def.nBufferCountActual;
+}
+
+static void
+mock_omx_reset_stream (MockOMXComponent * self)
+{
+  self->frames_head = self->frames_len = 0;
+  self->n_frames = 0;
+  self->force_sync = 0;
+  self->settings_halved = 0;
+}
+
+/* Returns 1 once the current command is completely executed, otherwise
+ * deadline is lowered to when it must be run again if it is only waiting
+ * for the time to pass */
+static int
+mock_omx_run_command (MockOMXComponent * self, int start, uint64_t * deadline)
+{
+  MockOMXCommand *cmd = &self->command;
+  OMX_U32 i;
+
+  switch (cmd->cmd) {
+    case OMX_CommandStateSet:{
+      OMX_STATETYPE target = (OMX_STATETYPE) cmd->param;
+      OMX_STATETYPE state = self->state;
+
+      if (start) {
+        int valid;
+
+        if (target == state) {
+          mock_omx_emit_event (self, OMX_EventError,
+              (OMX_U32) OMX_ErrorSameState, 0);
+          return 1;
+        }
+
+        switch (target) {
+          case OMX_StateLoaded:
+            valid = (state == OMX_StateIdle
+                || state == OMX_StateWaitForResources);
+            break;
+          case OMX_StateIdle:
+            valid = (state != OMX_StateInvalid);
+            break;
+          case OMX_StateExecuting:
+          case OMX_StatePause:
+            valid = (state == OMX_StateIdle || state == OMX_StateExecuting
+                || state == OMX_StatePause);
+            break;
+          case OMX_StateWaitForResources:
+            valid = (state == OMX_StateLoaded);
+            break;
+          case OMX_StateInvalid:
+            valid = 1;
+            break;
+          default:
+            valid = 0;
+            break;
+        }
+
+        if (!valid) {
+          mock_omx_emit_event (self, OMX_EventError,
+              (OMX_U32) OMX_ErrorIncorrectStateTransition, 0);
+          return 1;
+        }
+
+        if (target == OMX_StateInvalid) {
+          self->state = OMX_StateInvalid;
+          mock_omx_emit_event (self, OMX_EventError,
+              (OMX_U32) OMX_ErrorInvalidState, 0);
+          return 1;
+        }
+
+        /* Stopping returns all buffers and drops everything that is
+         * currently processed */
+        if (target == OMX_StateIdle && (state == OMX_StateExecuting
+                || state == OMX_StatePause)) {
+          for (i = 0; i < MOCK_OMX_N_PORTS; i++)
+            mock_omx_port_return_buffers (self, &self->ports[i]);
+          mock_omx_reset_stream (self);
+        }
+
+        mock_omx_state_change_begin (self);
+      }
+
+      if (mock_omx_now () < self->command_due) {
+        if (self->command_due < *deadline)
+          *deadline = self->command_due;
+        return 0;
+      }
+
+      if (target == OMX_StateIdle && state == OMX_StateLoaded) {
+        for (i = 0; i < MOCK_OMX_N_PORTS; i++) {
+          MockOMXPort *port = &self->ports[i];
+
+          if (port->def.bEnabled && !mock_omx_port_is_populated (port))
+            return 0;
+        }
+        for (i = 0; i < MOCK_OMX_N_PORTS; i++) {
+          if (self->ports[i].def.bEnabled)
+            self->ports[i].def.bPopulated = OMX_TRUE;
+        }
+      } else if (target == OMX_StateLoaded && state == OMX_StateIdle) {
+        for (i = 0; i < MOCK_OMX_N_PORTS; i++) {
+          if (self->ports[i].n_buffers > 0)
+            return 0;
+        }
+        for (i = 0; i < MOCK_OMX_N_PORTS; i++)
+          self->ports[i].def.bPopulated = OMX_FALSE;
+
+        /* Start over with the next stream */
+        mock_omx_reset_stream (self);
+        self->settings_initial =
+            (self->info->kind == MOCK_OMX_VIDEO_DECODER
+            || self->info->kind == MOCK_OMX_AUDIO_DECODER);
+        self->settings_pending = 0;
+        self->n_processed = 0;
+        self->n_input_frames = 0;
+        self->failed = 0;
+      }
+
+      self->state = target;
+      mock_omx_state_change_end (self);
+      mock_omx_emit_event (self, OMX_EventCmdComplete, OMX_CommandStateSet,
+          target);
+      return 1;
+    }
+    case OMX_CommandFlush:
+      for (i = 0; i < MOCK_OMX_N_PORTS; i++) {
+        if (cmd->param != OMX_ALL && cmd->param != i)
+          continue;
+
+        mock_omx_port_return_buffers (self, &self->ports[i]);
+        if (i == MOCK_OMX_OUT_PORT && mock_omx_has_output (self))
+          self->frames_head = self->frames_len = 0;
+
+        mock_omx_emit_event (self, OMX_EventCmdComplete, OMX_CommandFlush, i);
+      }
+      return 1;
+    case OMX_CommandPortDisable:
+    case OMX_CommandPortEnable:{
+      int enable = (cmd->cmd == OMX_CommandPortEnable);
+
+      if (start) {
+        self->command_ports = 0;
+        for (i = 0; i < MOCK_OMX_N_PORTS; i++) {
+          if (cmd->param != OMX_ALL && cmd->param != i)
+            continue;
+
+          self->command_ports |= 1 << i;
+          if (!enable)
+            mock_omx_port_return_buffers (self, &self->ports[i]);
+        }
+      }
+
+      for (i = 0; i < MOCK_OMX_N_PORTS; i++) {
+        MockOMXPort *port = &self->ports[i];
+
+        if (!(self->command_ports & (1 << i)))
+          continue;
+
+        if (self->state != OMX_StateLoaded
+            && self->state != OMX_StateWaitForResources) {
+          if (enable && !mock_omx_port_is_populated (port))
+            return 0;
+          if (!enable && port->n_buffers > 0)
+            return 0;
+        }
+
+        port->def.bPopulated = (enable && port->n_buffers > 0);
+        if (enable && i == MOCK_OMX_OUT_PORT)
+          self->settings_pending = 0;
+
+        self->command_ports &= ~(1 << i);
+        mock_omx_emit_event (self, OMX_EventCmdComplete, cmd->cmd, i);
+      }
+      return 1;
+    }
+    case OMX_CommandMarkBuffer:
+    default:
+      return 1;
+  }
+}
+
+static int
+mock_omx_process_commands (MockOMXComponent * self, uint64_t * deadline)
+{
+  int progress = 0;
+
+  for (;;) {
+    int start = 0;
+
+    if (!self->command_active) {
+      if (self->commands_len == 0)
+        break;
+
+      self->command = self->commands[self->commands_head];
+      self->commands_head = (self->commands_head + 1) % MOCK_OMX_MAX_COMMANDS;
+      self->commands_len--;
+      self->command_active = 1;
+      start = 1;
+      progress = 1;
+    }
+
+    if (!mock_omx_run_command (self, start, deadline))
+      break;
+
+    self->command_active = 0;
+    progress = 1;
+  }
+
+  return progress;
+}
+
+/* Whether an input buffer completes a frame that is decoded or encoded */
+static int
+mock_omx_buffer_completes_frame (MockOMXComponent * self,
+    OMX_BUFFERHEADERTYPE * header)
+{
+  if (header->nFilledLen == 0)
+    return 0;
+
+  if (header->nFlags & OMX_BUFFERFLAG_CODECCONFIG)
+    return 0;
+
+  /* Decoders get frames split over multiple buffers, encoders get
+   * complete frames or just chunks of samples */
+  if (self->info->kind == MOCK_OMX_VIDEO_DECODER
+      || self->info->kind == MOCK_OMX_AUDIO_DECODER)
+    return (header->nFlags & OMX_BUFFERFLAG_ENDOFFRAME) != 0;
+
+  return 1;
+}
+
+/* Returns 1 if the allocated output buffers are still enough for the
+ * current output port settings */
+static int
+mock_omx_output_buffers_fit (MockOMXComponent * self)
+{
+  MockOMXPort *out = &self->ports[MOCK_OMX_OUT_PORT];
+  OMX_U32 i;
+
+  if (out->n_buffers == 0 || out->n_buffers < out->def.nBufferCountMin)
+    return 0;
+
+  for (i = 0; i < out->n_buffers; i++) {
+    if (out->buffers[i]->header.nAllocLen < out->def.nBufferSize)
+      return 0;
+  }
+
+  return 1;
+}
+
+static void
+mock_omx_signal_output_settings (MockOMXComponent * self)
+{
+  if (self->options.psc_halve && !self->settings_initial)
+    self->settings_halved = !self->settings_halved;
+  mock_omx_update_output_settings (self);
+
+  self->settings_initial = 0;
+  self->settings_pending = !(self->options.adaptive
+      && mock_omx_output_buffers_fit (self));
+  mock_omx_emit_event (self, OMX_EventPortSettingsChanged, MOCK_OMX_OUT_PORT,
+      OMX_IndexParamPortDefinition);
+}
+
+static void
+mock_omx_push_frame (MockOMXComponent * self, OMX_BUFFERHEADERTYPE * header,
+    int has_data)
+{
+  MockOMXPort *out = &self->ports[MOCK_OMX_OUT_PORT];
+  MockOMXFrame *frame;
+  OMX_U32 interval = self->options.psc_interval;
+  int new_settings = 0;
+
+  if (!self->settings_pending && (self->settings_initial || !out->def.bEnabled
+          || (interval && has_data && self->n_frames > 0
+              && self->n_frames % interval == 0)
+          || (has_data && self->options.psc_after
+              && self->n_frames == self->options.psc_after))) {
+    /* Adaptive components signal new settings right before outputting
+     * the first frame with them, after all previous frames */
+    if (self->options.adaptive && !self->settings_initial
+        && out->def.bEnabled)
+      new_settings = 1;
+    else
+      mock_omx_signal_output_settings (self);
+  }
+
+  frame = &self->frames[(self->frames_head + self->frames_len) %
+      MOCK_OMX_MAX_FRAMES];
+  self->frames_len++;
+
+  frame->timestamp = header->nTimeStamp;
+  frame->has_data = has_data;
+  frame->new_settings = new_settings;
+  frame->flags = header->nFlags & OMX_BUFFERFLAG_EOS;
+
+  if (has_data) {
+    frame->flags |= OMX_BUFFERFLAG_ENDOFFRAME;
+
+    if (self->info->kind == MOCK_OMX_VIDEO_ENCODER) {
+      if (self->force_sync || self->options.gop == 0
+          || self->n_frames % self->options.gop == 0)
+        frame->flags |= OMX_BUFFERFLAG_SYNCFRAME;
+      self->force_sync = 0;
+    } else {
+      frame->flags |= OMX_BUFFERFLAG_SYNCFRAME;
+    }
+
+    self->n_frames++;
+
+    /* The input buffers have to be reallocated while the stream runs */
+    if (self->n_frames == self->options.in_psc_after)
+      mock_omx_emit_event (self, OMX_EventPortSettingsChanged,
+          MOCK_OMX_IN_PORT, OMX_IndexParamPortDefinition);
+  }
+}
+
+static OMX_U32
+mock_omx_frame_limit (MockOMXComponent * self)
+{
+  OMX_U32 limit = self->ports[MOCK_OMX_OUT_PORT].def.nBufferCountActual;
+
+  if (limit < 1)
+    limit = 1;
+  if (limit > MOCK_OMX_MAX_FRAMES)
+    limit = MOCK_OMX_MAX_FRAMES;
+
+  return limit;
+}
+
+/* OMX_TICKS is a struct on targets without 64 bit integers */
+static OMX_TICKS
+mock_omx_ticks_add (OMX_TICKS ticks, OMX_U32 usecs)
+{
+#ifdef OMX_SKIP64BIT
+  uint64_t value = ((uint64_t) ticks.nHighPart << 32) | ticks.nLowPart;
+
+  value += usecs;
+  ticks.nLowPart = (OMX_U32) value;
+  ticks.nHighPart = (OMX_U32) (value >> 32);
+#else
+  ticks += usecs;
+#endif
+
+  return ticks;
+}
+
+static int
+mock_omx_process_input (MockOMXComponent * self, uint64_t now,
+    uint64_t * deadline)
+{
+  MockOMXPort *in = &self->ports[MOCK_OMX_IN_PORT];
+  int progress = 0;
+
+  while (in->queue_head && !self->failed) {
+    MockOMXBuffer *buf = in->queue_head;
+    OMX_BUFFERHEADERTYPE *header = &buf->header;
+    OMX_U32 flags = header->nFlags;
+    int has_data, eos, drop;
+
+    if (buf->due > now) {
+      if (buf->due < *deadline)
+        *deadline = buf->due;
+      break;
+    }
+
+    has_data = mock_omx_buffer_completes_frame (self, header);
+    eos = (flags & OMX_BUFFERFLAG_EOS) != 0;
+
+    if (mock_omx_has_output (self) && (has_data || eos)) {
+      /* Like real hardware, stop taking input if the output is not
+       * consumed */
+      if (self->frames_len >= mock_omx_frame_limit (self))
+        break;
+
+      drop = has_data && !eos
+          && ++self->n_input_frames == self->options.drop_frame;
+      if (!drop)
+        mock_omx_push_frame (self, header, has_data);
+    }
+
+    mock_omx_port_pop (in);
+    header->nFilledLen = 0;
+    header->nOffset = 0;
+    mock_omx_emit_buffer_done (self, in, buf);
+    progress = 1;
+
+    if (!mock_omx_has_output (self) && eos)
+      mock_omx_emit_event (self, OMX_EventBufferFlag, MOCK_OMX_IN_PORT, flags);
+    else if (self->options.flag_events)
+      mock_omx_emit_event (self, OMX_EventBufferFlag, MOCK_OMX_IN_PORT, 0);
+
+    self->n_processed++;
+    if (self->options.error_after
+        && self->n_processed == self->options.error_after) {
+      self->failed = 1;
+      mock_omx_emit_event (self, OMX_EventError, self->options.error, 0);
+    }
+  }
+
+  return progress;
+}
+
+static const OMX_U32 aac_sample_rates[] = {
+  96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000,
+  11025, 8000, 7350
+};
+
+static void
+mock_omx_write_adts_header (MockOMXPort * port, OMX_U8 * data, OMX_U32 size)
+{
+  OMX_U32 profile, rate_index, channels;
+
+  profile = port->aac.eAACProfile;
+  if (profile < OMX_AUDIO_AACObjectMain || profile > OMX_AUDIO_AACObjectLTP)
+    profile = OMX_AUDIO_AACObjectLC;
+
+  for (rate_index = 0;
+      rate_index < sizeof (aac_sample_rates) / sizeof (aac_sample_rates[0]);
+      rate_index++) {
+    if (aac_sample_rates[rate_index] == port->aac.nSampleRate)
+      break;
+  }
+  if (rate_index == sizeof (aac_sample_rates) / sizeof (aac_sample_rates[0]))
+    rate_index = 4;
+
+  channels = port->aac.nChannels & 0x7;
+
+  data[0] = 0xff;
+  data[1] = 0xf1;
+  data[2] = ((profile - 1) << 6) | (rate_index << 2) | (channels >> 2);
+  data[3] = ((channels & 0x3) << 6) | ((size >> 11) & 0x3);
+  data[4] = (size >> 3) & 0xff;
+  data[5] = ((size & 0x7) << 5) | 0x1f;
+  data[6] = 0xfc;
+}
+
+/* Fills an output buffer for a frame. Raw outputs are not touched at all
+ * and compressed outputs only get a start code, nothing should look at
+ * the payload */
+static void
+mock_omx_fill_buffer (MockOMXComponent * self, MockOMXFrame * frame,
+    OMX_BUFFERHEADERTYPE * header)
+{
+  MockOMXPort *in = &self->ports[MOCK_OMX_IN_PORT];
+  MockOMXPort *out = &self->ports[MOCK_OMX_OUT_PORT];
+  OMX_U8 *data = header->pBuffer;
+  OMX_U32 size = 0;
+  int sync = (frame->flags & OMX_BUFFERFLAG_SYNCFRAME) != 0;
+
+  if (frame->has_data) {
+    switch (self->info->kind) {
+      case MOCK_OMX_VIDEO_DECODER:{
+        OMX_VIDEO_PORTDEFINITIONTYPE *video = &out->def.format.video;
+
+        size = video->nStride * video->nSliceHeight * 3 / 2;
+        break;
+      }
+      case MOCK_OMX_VIDEO_ENCODER:{
+        OMX_VIDEO_PORTDEFINITIONTYPE *video = &in->def.format.video;
+
+        size = video->nFrameWidth * video->nFrameHeight / (sync ? 8 : 32);
+        if (size < 64)
+          size = 64;
+        break;
+      }
+      case MOCK_OMX_AUDIO_DECODER:
+        size = (self->info->coding == OMX_AUDIO_CodingMP3 ? 1152 : 1024) *
+            out->pcm.nChannels * (out->pcm.nBitPerSample / 8);
+        break;
+      case MOCK_OMX_AUDIO_ENCODER:
+        size = 256;
+        break;
+      case MOCK_OMX_AUDIO_RENDERER:
+        break;
+    }
+  }
+
+  if (size > header->nAllocLen)
+    size = header->nAllocLen;
+
+  if (self->info->kind == MOCK_OMX_VIDEO_ENCODER && size >= 6) {
+    static const OMX_U8 start_code[] = { 0x00, 0x00, 0x00, 0x01 };
+
+    memcpy (data, start_code, sizeof (start_code));
+    switch (self->info->coding) {
+      case OMX_VIDEO_CodingAVC:
+        data[4] = sync ? 0x65 : 0x41;
+        data[5] = 0x88;
+        break;
+#ifdef HAVE_HEVC
+      case OMX_VIDEO_CodingHEVC:
+        data[4] = sync ? 0x26 : 0x02;
+        data[5] = 0x01;
+        break;
+#endif
+      case OMX_VIDEO_CodingMPEG4:
+        /* VOP start code */
+        data[1] = 0x00;
+        data[2] = 0x01;
+        data[3] = 0xb6;
+        data[4] = sync ? 0x00 : 0x40;
+        break;
+      default:
+        break;
+    }
+  } else if (self->info->kind == MOCK_OMX_AUDIO_ENCODER && size >= 7) {
+    if (self->info->coding == OMX_AUDIO_CodingAAC
+        && out->aac.eAACStreamFormat == OMX_AUDIO_AACStreamFormatMP4ADTS) {
+      mock_omx_write_adts_header (out, data, size);
+    } else if (self->info->coding == OMX_AUDIO_CodingMP3) {
+      data[0] = 0xff;
+      data[1] = 0xfb;
+    }
+  }
+
+  header->nOffset = 0;
+  header->nFilledLen = size;
+  header->nFlags = frame->flags;
+  header->nTimeStamp =
+      mock_omx_ticks_add (frame->timestamp, self->options.ts_shift);
+}
+
+static int
+mock_omx_process_output (MockOMXComponent * self)
+{
+  MockOMXPort *out = &self->ports[MOCK_OMX_OUT_PORT];
+  int progress = 0;
+
+  if (!mock_omx_has_output (self) || !out->def.bEnabled
+      || self->settings_pending)
+    return 0;
+
+  while (self->frames_len > 0 && out->queue_head) {
+    MockOMXFrame *frame = &self->frames[self->frames_head];
+    MockOMXBuffer *buf;
+    OMX_U32 flags = frame->flags;
+
+    if (frame->new_settings) {
+      frame->new_settings = 0;
+      mock_omx_signal_output_settings (self);
+      progress = 1;
+      if (self->settings_pending)
+        break;
+    }
+
+    buf = mock_omx_port_pop (out);
+
+    mock_omx_fill_buffer (self, frame, &buf->header);
+    self->frames_head = (self->frames_head + 1) % MOCK_OMX_MAX_FRAMES;
+    self->frames_len--;
+
+    mock_omx_emit_buffer_done (self, out, buf);
+    if (flags & OMX_BUFFERFLAG_EOS)
+      mock_omx_emit_event (self, OMX_EventBufferFlag, MOCK_OMX_OUT_PORT,
+          flags);
+    progress = 1;
+  }
+
+  return progress;
+}
+
+static void *
+mock_omx_thread (void *data)
+{
+  MockOMXComponent *self = data;
+
+  pthread_mutex_lock (&self->lock);
+  while (self->running) {
+    uint64_t deadline = UINT64_MAX;
+    int progress;
+
+    progress = mock_omx_process_commands (self, &deadline);
+    if (self->state == OMX_StateExecuting && !self->failed) {
+      progress |= mock_omx_process_input (self, mock_omx_now (), &deadline);
+      progress |= mock_omx_process_output (self);
+    }
+
+    /* Callbacks are never called with the lock, the client is free to
+     * call back into the component from them */
+    if (self->outbox_len > 0) {
+      pthread_mutex_unlock (&self->lock);
+      mock_omx_dispatch (self);
+      pthread_mutex_lock (&self->lock);
+      continue;
+    }
+
+    if (progress)
+      continue;
+
+    if (deadline == UINT64_MAX) {
+      pthread_cond_wait (&self->cond, &self->lock);
+    } else {
+      struct timespec ts;
+
+      ts.tv_sec = deadline / 1000000;
+      ts.tv_nsec = (deadline % 1000000) * 1000;
+      pthread_cond_timedwait (&self->cond, &self->lock, &ts);
+    }
+  }
+  pthread_mutex_unlock (&self->lock);
+
+  return NULL;
+}
+
+static OMX_ERRORTYPE
+mock_omx_get_component_version (OMX_HANDLETYPE handle, OMX_STRING name,
+    OMX_VERSIONTYPE * component_version, OMX_VERSIONTYPE * spec_version,
+    OMX_UUIDTYPE * uuid)
+{
+  MockOMXComponent *self = mock_omx_get (handle);
+
+  if (!self || !name || !component_version || !spec_version)
+    return OMX_ErrorBadParameter;
+
+  snprintf (name, OMX_MAX_STRINGNAME_SIZE, MOCK_OMX_PREFIX "%s",
+      self->info->role);
+  component_version->nVersion = 0;
+  component_version->s.nVersionMajor = 1;
+  spec_version->nVersion = self->handle.nVersion.nVersion;
+  if (uuid)
+    memset (uuid, 0, sizeof (OMX_UUIDTYPE));
+
+  return OMX_ErrorNone;
+}
+
+static MockOMXPortCounters *
+mock_omx_get_counters (MockOMXComponent * self, OMX_U32 port_index)
+{
+  return &counters[self->info - components][port_index];
+}
+
+static OMX_ERRORTYPE
+mock_omx_send_command (OMX_HANDLETYPE handle, OMX_COMMANDTYPE cmd,
+    OMX_U32 param, OMX_PTR cmd_data)
+{
+  MockOMXComponent *self = mock_omx_get (handle);
+  OMX_ERRORTYPE err = OMX_ErrorNone;
+  OMX_U32 i;
+
+  if (!self)
+    return OMX_ErrorBadParameter;
+
+  switch (cmd) {
+    case OMX_CommandStateSet:
+    case OMX_CommandMarkBuffer:
+      break;
+    case OMX_CommandFlush:
+    case OMX_CommandPortDisable:
+    case OMX_CommandPortEnable:
+      if (param != OMX_ALL && param >= MOCK_OMX_N_PORTS)
+        return OMX_ErrorBadPortIndex;
+      break;
+    default:
+      return OMX_ErrorBadParameter;
+  }
+
+  pthread_mutex_lock (&self->lock);
+  if (self->state == OMX_StateInvalid) {
+    err = OMX_ErrorInvalidState;
+    goto done;
+  }
+
+  if (self->commands_len == MOCK_OMX_MAX_COMMANDS) {
+    err = OMX_ErrorInsufficientResources;
+    goto done;
+  }
+
+  /* Ports stop or start accepting buffers right away */
+  if (cmd == OMX_CommandPortDisable || cmd == OMX_CommandPortEnable) {
+    for (i = 0; i < MOCK_OMX_N_PORTS; i++) {
+      if (param != OMX_ALL && param != i)
+        continue;
+
+      self->ports[i].def.bEnabled = (cmd == OMX_CommandPortEnable);
+      if (cmd == OMX_CommandPortDisable) {
+        pthread_mutex_lock (&core_lock);
+        mock_omx_get_counters (self, i)->n_disabled++;
+        pthread_mutex_unlock (&core_lock);
+      }
+    }
+  }
+
+  self->commands[(self->commands_head + self->commands_len) %
+      MOCK_OMX_MAX_COMMANDS].cmd = cmd;
+  self->commands[(self->commands_head + self->commands_len) %
+      MOCK_OMX_MAX_COMMANDS].param = param;
+  self->commands_len++;
+  pthread_cond_signal (&self->cond);
+
+done:
+  pthread_mutex_unlock (&self->lock);
+
+  return err;
+}
+
+/* Checks the size of a structure and returns the port it applies to, if
+ * any */
+static OMX_ERRORTYPE
+mock_omx_check_param (MockOMXComponent * self, OMX_PTR param, size_t size,
+    MockOMXPort ** port)
+{
+  MockOMXParamHeader *header = param;
+
+  if (!param)
+    return OMX_ErrorBadParameter;
+
+  if (header->nSize < size)
+    return OMX_ErrorBadParameter;
+
+  if (port) {
+    *port = mock_omx_get_port (self, header->nPortIndex);
+    if (!*port)
+      return OMX_ErrorBadPortIndex;
+  }
+
+  return OMX_ErrorNone;
+}
+
+/* Copies a client structure into the port's copy of it, keeping the
+ * parts that can't be changed */
+static void
+mock_omx_store_param (void *dst, const void *src, size_t size)
+{
+  MockOMXParamHeader saved = *(MockOMXParamHeader *) dst;
+
+  memcpy (dst, src, size);
+  *(MockOMXParamHeader *) dst = saved;
+}
+
+static OMX_ERRORTYPE
+mock_omx_get_parameter (OMX_HANDLETYPE handle, OMX_INDEXTYPE index,
+    OMX_PTR param)
+{
+  MockOMXComponent *self = mock_omx_get (handle);
+  MockOMXPort *port = NULL;
+  OMX_ERRORTYPE err;
+
+  if (!self || !param)
+    return OMX_ErrorBadParameter;
+
+  pthread_mutex_lock (&self->lock);
+  switch ((int) index) {
+    case OMX_IndexParamAudioInit:
+    case OMX_IndexParamVideoInit:
+    case OMX_IndexParamImageInit:
+    case OMX_IndexParamOtherInit:{
+      OMX_PORT_PARAM_TYPE *p = param;
+      OMX_PORTDOMAINTYPE domain;
+      OMX_U32 i;
+
+      if ((err = mock_omx_check_param (self, param, sizeof (*p), NULL)))
+        break;
+
+      if (index == OMX_IndexParamAudioInit)
+        domain = OMX_PortDomainAudio;
+      else if (index == OMX_IndexParamVideoInit)
+        domain = OMX_PortDomainVideo;
+      else if (index == OMX_IndexParamImageInit)
+        domain = OMX_PortDomainImage;
+      else
+        domain = OMX_PortDomainOther;
+
+      p->nPorts = 0;
+      p->nStartPortNumber = 0;
+      for (i = 0; i < MOCK_OMX_N_PORTS; i++) {
+        if (self->ports[i].def.eDomain != domain)
+          continue;
+        if (p->nPorts++ == 0)
+          p->nStartPortNumber = i;
+      }
+      break;
+    }
+    case OMX_IndexParamStandardComponentRole:{
+      OMX_PARAM_COMPONENTROLETYPE *p = param;
+
+      if ((err = mock_omx_check_param (self, param, sizeof (*p), NULL)))
+        break;
+
+      snprintf ((char *) p->cRole, sizeof (p->cRole), "%s", self->info->role);
+      break;
+    }
+    case OMX_IndexParamPortDefinition:
+      if ((err = mock_omx_check_param (self, param,
+                  sizeof (OMX_PARAM_PORTDEFINITIONTYPE), &port)))
+        break;
+
+      memcpy (param, &port->def, sizeof (OMX_PARAM_PORTDEFINITIONTYPE));
+      break;
+    case OMX_IndexParamVideoPortFormat:{
+      OMX_VIDEO_PARAM_PORTFORMATTYPE *p = param;
+
+      if ((err = mock_omx_check_param (self, param, sizeof (*p), &port)))
+        break;
+
+      if (port->def.eDomain != OMX_PortDomainVideo) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+
+      p->xFramerate = port->def.format.video.xFramerate;
+      p->eCompressionFormat = port->def.format.video.eCompressionFormat;
+      if (mock_omx_port_is_raw_video (port)) {
+        if (p->nIndex < mock_omx_n_color_formats (self, port)) {
+          p->eColorFormat = color_formats[p->nIndex];
+        } else {
+          p->eColorFormat = OMX_COLOR_FormatUnused;
+          err = OMX_ErrorNoMore;
+        }
+      } else {
+        p->eColorFormat = OMX_COLOR_FormatUnused;
+        if (p->nIndex > 0) {
+          p->eCompressionFormat = OMX_VIDEO_CodingUnused;
+          err = OMX_ErrorNoMore;
+        }
+      }
+      break;
+    }
+    case OMX_IndexParamVideoProfileLevelCurrent:
+      if ((err = mock_omx_check_param (self, param,
+                  sizeof (OMX_VIDEO_PARAM_PROFILELEVELTYPE), &port)))
+        break;
+
+      if (!mock_omx_port_is_compressed_video (port)) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+      memcpy (param, &port->profile_level,
+          sizeof (OMX_VIDEO_PARAM_PROFILELEVELTYPE));
+      break;
+    case OMX_IndexParamVideoProfileLevelQuerySupported:{
+      OMX_VIDEO_PARAM_PROFILELEVELTYPE *p = param;
+
+      if ((err = mock_omx_check_param (self, param, sizeof (*p), &port)))
+        break;
+
+      if (!mock_omx_port_is_compressed_video (port)) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+
+      /* Only the default profile and level are supported */
+      if (p->nProfileIndex > 0) {
+        err = OMX_ErrorNoMore;
+        break;
+      }
+      p->eProfile = port->profile_level.eProfile;
+      p->eLevel = port->profile_level.eLevel;
+      break;
+    }
+    case OMX_IndexParamVideoBitrate:
+      if ((err = mock_omx_check_param (self, param,
+                  sizeof (OMX_VIDEO_PARAM_BITRATETYPE), &port)))
+        break;
+
+      if (self->info->kind != MOCK_OMX_VIDEO_ENCODER
+          || !mock_omx_port_is_compressed_video (port)) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+      memcpy (param, &port->bitrate, sizeof (OMX_VIDEO_PARAM_BITRATETYPE));
+      break;
+    case OMX_IndexParamVideoAvc:
+      if ((err = mock_omx_check_param (self, param,
+                  sizeof (OMX_VIDEO_PARAM_AVCTYPE), &port)))
+        break;
+
+      if (!mock_omx_port_is_compressed_video (port)
+          || port->def.format.video.eCompressionFormat != OMX_VIDEO_CodingAVC) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+      memcpy (param, &port->avc, sizeof (OMX_VIDEO_PARAM_AVCTYPE));
+      break;
+    case OMX_IndexParamAudioPcm:
+      if ((err = mock_omx_check_param (self, param,
+                  sizeof (OMX_AUDIO_PARAM_PCMMODETYPE), &port)))
+        break;
+
+      if (!mock_omx_port_is_audio (port, OMX_AUDIO_CodingPCM)) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+      memcpy (param, &port->pcm, sizeof (OMX_AUDIO_PARAM_PCMMODETYPE));
+      break;
+    case OMX_IndexParamAudioAac:
+      if ((err = mock_omx_check_param (self, param,
+                  sizeof (OMX_AUDIO_PARAM_AACPROFILETYPE), &port)))
+        break;
+
+      if (!mock_omx_port_is_audio (port, OMX_AUDIO_CodingAAC)) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+      memcpy (param, &port->aac, sizeof (OMX_AUDIO_PARAM_AACPROFILETYPE));
+      break;
+    case OMX_IndexParamAudioMp3:
+      if ((err = mock_omx_check_param (self, param,
+                  sizeof (OMX_AUDIO_PARAM_MP3TYPE), &port)))
+        break;
+
+      if (!mock_omx_port_is_audio (port, OMX_AUDIO_CodingMP3)) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+      memcpy (param, &port->mp3, sizeof (OMX_AUDIO_PARAM_MP3TYPE));
+      break;
+    default:
+      err = OMX_ErrorUnsupportedIndex;
+      break;
+  }
+  pthread_mutex_unlock (&self->lock);
+
+  return err;
+}
+
+static OMX_ERRORTYPE
+mock_omx_set_port_definition (MockOMXComponent * self, MockOMXPort * port,
+    const OMX_PARAM_PORTDEFINITIONTYPE * def)
+{
+  if (def->nBufferCountActual < port->def.nBufferCountMin
+      || def->nBufferCountActual > MOCK_OMX_MAX_BUFFERS)
+    return OMX_ErrorBadParameter;
+
+  if (port->def.eDomain == OMX_PortDomainVideo) {
+    const OMX_VIDEO_PORTDEFINITIONTYPE *video = &def->format.video;
+    OMX_VIDEO_PORTDEFINITIONTYPE *port_video = &port->def.format.video;
+
+    if (video->nFrameWidth == 0 || video->nFrameHeight == 0)
+      return OMX_ErrorBadParameter;
+
+    if (mock_omx_port_is_raw_video (port)) {
+      OMX_U32 size;
+
+      if (video->eColorFormat != OMX_COLOR_FormatUnused) {
+        if (!mock_omx_color_format_supported (self, port,
+                video->eColorFormat))
+          return OMX_ErrorUnsupportedSetting;
+        port_video->eColorFormat = video->eColorFormat;
+      }
+
+      port_video->nFrameWidth = video->nFrameWidth;
+      port_video->nFrameHeight = video->nFrameHeight;
+      port_video->nStride = video->nStride;
+      port_video->nSliceHeight = video->nSliceHeight;
+      size = mock_omx_port_update_video_layout (self, port);
+      port->def.nBufferSize = def->nBufferSize > size ? def->nBufferSize : size;
+    } else {
+      if (video->eCompressionFormat != port_video->eCompressionFormat
+          && video->eCompressionFormat != OMX_VIDEO_CodingAutoDetect)
+        return OMX_ErrorUnsupportedSetting;
+
+      port_video->nFrameWidth = video->nFrameWidth;
+      port_video->nFrameHeight = video->nFrameHeight;
+      port_video->nStride = video->nStride;
+      port_video->nSliceHeight = video->nSliceHeight;
+      port_video->nBitrate = video->nBitrate;
+      if (def->nBufferSize > 0)
+        port->def.nBufferSize = def->nBufferSize;
+    }
+
+    if (video->xFramerate)
+      port_video->xFramerate = video->xFramerate;
+  } else if (port->def.eDomain == OMX_PortDomainAudio) {
+    if (def->format.audio.eEncoding != port->def.format.audio.eEncoding
+        && def->format.audio.eEncoding != OMX_AUDIO_CodingAutoDetect)
+      return OMX_ErrorUnsupportedSetting;
+
+    if (def->nBufferSize > 0)
+      port->def.nBufferSize = def->nBufferSize;
+  }
+
+  port->def.nBufferCountActual = def->nBufferCountActual;
+
+  if (port->def.nPortIndex == MOCK_OMX_IN_PORT && mock_omx_has_output (self))
+    mock_omx_update_output_settings (self);
+
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+mock_omx_set_parameter (OMX_HANDLETYPE handle, OMX_INDEXTYPE index,
+    OMX_PTR param)
+{
+  MockOMXComponent *self = mock_omx_get (handle);
+  MockOMXPort *port = NULL;
+  OMX_ERRORTYPE err;
+
+  if (!self || !param)
+    return OMX_ErrorBadParameter;
+
+  pthread_mutex_lock (&self->lock);
+  switch ((int) index) {
+    case OMX_IndexParamStandardComponentRole:{
+      OMX_PARAM_COMPONENTROLETYPE *p = param;
+
+      if ((err = mock_omx_check_param (self, param, sizeof (*p), NULL)))
+        break;
+
+      if (self->state != OMX_StateLoaded)
+        err = OMX_ErrorIncorrectStateOperation;
+      else if (strncmp ((const char *) p->cRole, self->info->role,
+              sizeof (p->cRole)) != 0)
+        err = OMX_ErrorUnsupportedSetting;
+      break;
+    }
+    case OMX_IndexParamPortDefinition:
+      if ((err = mock_omx_check_param (self, param,
+                  sizeof (OMX_PARAM_PORTDEFINITIONTYPE), &port)))
+        break;
+
+      err = mock_omx_set_port_definition (self, port, param);
+      break;
+    case OMX_IndexParamVideoPortFormat:{
+      OMX_VIDEO_PARAM_PORTFORMATTYPE *p = param;
+
+      if ((err = mock_omx_check_param (self, param, sizeof (*p), &port)))
+        break;
+
+      if (port->def.eDomain != OMX_PortDomainVideo) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+
+      if (mock_omx_port_is_raw_video (port)) {
+        if (!mock_omx_color_format_supported (self, port, p->eColorFormat)) {
+          err = OMX_ErrorUnsupportedSetting;
+          break;
+        }
+        port->def.format.video.eColorFormat = p->eColorFormat;
+        port->def.nBufferSize = mock_omx_port_update_video_layout (self, port);
+      } else if (p->eCompressionFormat !=
+          port->def.format.video.eCompressionFormat) {
+        err = OMX_ErrorUnsupportedSetting;
+        break;
+      }
+
+      if (p->xFramerate)
+        port->def.format.video.xFramerate = p->xFramerate;
+      break;
+    }
+    case OMX_IndexParamVideoProfileLevelCurrent:
+      if ((err = mock_omx_check_param (self, param,
+                  sizeof (OMX_VIDEO_PARAM_PROFILELEVELTYPE), &port)))
+        break;
+
+      if (!mock_omx_port_is_compressed_video (port)) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+      mock_omx_store_param (&port->profile_level, param,
+          sizeof (OMX_VIDEO_PARAM_PROFILELEVELTYPE));
+      break;
+    case OMX_IndexParamVideoBitrate:
+      if ((err = mock_omx_check_param (self, param,
+                  sizeof (OMX_VIDEO_PARAM_BITRATETYPE), &port)))
+        break;
+
+      if (self->info->kind != MOCK_OMX_VIDEO_ENCODER
+          || !mock_omx_port_is_compressed_video (port)) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+      mock_omx_store_param (&port->bitrate, param,
+          sizeof (OMX_VIDEO_PARAM_BITRATETYPE));
+      break;
+    case OMX_IndexParamVideoAvc:
+      if ((err = mock_omx_check_param (self, param,
+                  sizeof (OMX_VIDEO_PARAM_AVCTYPE), &port)))
+        break;
+
+      if (!mock_omx_port_is_compressed_video (port)
+          || port->def.format.video.eCompressionFormat != OMX_VIDEO_CodingAVC) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+      mock_omx_store_param (&port->avc, param,
+          sizeof (OMX_VIDEO_PARAM_AVCTYPE));
+      break;
+    case OMX_IndexParamAudioPcm:{
+      OMX_AUDIO_PARAM_PCMMODETYPE *p = param;
+
+      if ((err = mock_omx_check_param (self, param, sizeof (*p), &port)))
+        break;
+
+      if (!mock_omx_port_is_audio (port, OMX_AUDIO_CodingPCM)) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+      if (p->nChannels < 1 || p->nChannels > OMX_AUDIO_MAXCHANNELS
+          || (p->nBitPerSample != 8 && p->nBitPerSample != 16
+              && p->nBitPerSample != 24 && p->nBitPerSample != 32)) {
+        err = OMX_ErrorUnsupportedSetting;
+        break;
+      }
+      mock_omx_store_param (&port->pcm, param, sizeof (*p));
+      break;
+    }
+    case OMX_IndexParamAudioAac:
+      if ((err = mock_omx_check_param (self, param,
+                  sizeof (OMX_AUDIO_PARAM_AACPROFILETYPE), &port)))
+        break;
+
+      if (!mock_omx_port_is_audio (port, OMX_AUDIO_CodingAAC)) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+      mock_omx_store_param (&port->aac, param,
+          sizeof (OMX_AUDIO_PARAM_AACPROFILETYPE));
+      break;
+    case OMX_IndexParamAudioMp3:
+      if ((err = mock_omx_check_param (self, param,
+                  sizeof (OMX_AUDIO_PARAM_MP3TYPE), &port)))
+        break;
+
+      if (!mock_omx_port_is_audio (port, OMX_AUDIO_CodingMP3)) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+      mock_omx_store_param (&port->mp3, param,
+          sizeof (OMX_AUDIO_PARAM_MP3TYPE));
+      break;
+    default:
+      err = OMX_ErrorUnsupportedIndex;
+      break;
+  }
+
+  if (err == OMX_ErrorNone && port && port->def.nPortIndex == MOCK_OMX_IN_PORT
+      && mock_omx_has_output (self))
+    mock_omx_update_output_settings (self);
+  pthread_mutex_unlock (&self->lock);
+
+  return err;
+}
+
+static OMX_ERRORTYPE
+mock_omx_get_config (OMX_HANDLETYPE handle, OMX_INDEXTYPE index,
+    OMX_PTR config)
+{
+  MockOMXComponent *self = mock_omx_get (handle);
+  MockOMXPort *port = NULL;
+  OMX_ERRORTYPE err;
+
+  if (!self || !config)
+    return OMX_ErrorBadParameter;
+
+  pthread_mutex_lock (&self->lock);
+  switch ((int) index) {
+    case OMX_IndexConfigAudioVolume:
+      if ((err = mock_omx_check_param (self, config,
+                  sizeof (OMX_AUDIO_CONFIG_VOLUMETYPE), &port)))
+        break;
+
+      if (self->info->kind != MOCK_OMX_AUDIO_RENDERER
+          || port->def.eDomain != OMX_PortDomainAudio) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+      memcpy (config, &port->volume, sizeof (OMX_AUDIO_CONFIG_VOLUMETYPE));
+      break;
+    case OMX_IndexConfigAudioMute:
+      if ((err = mock_omx_check_param (self, config,
+                  sizeof (OMX_AUDIO_CONFIG_MUTETYPE), &port)))
+        break;
+
+      if (self->info->kind != MOCK_OMX_AUDIO_RENDERER
+          || port->def.eDomain != OMX_PortDomainAudio) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+      memcpy (config, &port->mute, sizeof (OMX_AUDIO_CONFIG_MUTETYPE));
+      break;
+    default:
+      err = OMX_ErrorUnsupportedIndex;
+      break;
+  }
+  pthread_mutex_unlock (&self->lock);
+
+  return err;
+}
+
+static OMX_ERRORTYPE
+mock_omx_set_config (OMX_HANDLETYPE handle, OMX_INDEXTYPE index,
+    OMX_PTR config)
+{
+  MockOMXComponent *self = mock_omx_get (handle);
+  MockOMXPort *port = NULL;
+  OMX_ERRORTYPE err;
+
+  if (!self || !config)
+    return OMX_ErrorBadParameter;
+
+  pthread_mutex_lock (&self->lock);
+  switch ((int) index) {
+    case OMX_IndexConfigAudioVolume:
+      if ((err = mock_omx_check_param (self, config,
+                  sizeof (OMX_AUDIO_CONFIG_VOLUMETYPE), &port)))
+        break;
+
+      if (self->info->kind != MOCK_OMX_AUDIO_RENDERER
+          || port->def.eDomain != OMX_PortDomainAudio) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+      mock_omx_store_param (&port->volume, config,
+          sizeof (OMX_AUDIO_CONFIG_VOLUMETYPE));
+      break;
+    case OMX_IndexConfigAudioMute:
+      if ((err = mock_omx_check_param (self, config,
+                  sizeof (OMX_AUDIO_CONFIG_MUTETYPE), &port)))
+        break;
+
+      if (self->info->kind != MOCK_OMX_AUDIO_RENDERER
+          || port->def.eDomain != OMX_PortDomainAudio) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+      mock_omx_store_param (&port->mute, config,
+          sizeof (OMX_AUDIO_CONFIG_MUTETYPE));
+      break;
+    case OMX_IndexConfigVideoIntraVOPRefresh:{
+      OMX_CONFIG_INTRAREFRESHVOPTYPE *c = config;
+
+      if ((err = mock_omx_check_param (self, config, sizeof (*c), &port)))
+        break;
+
+      if (self->info->kind != MOCK_OMX_VIDEO_ENCODER) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+      if (c->IntraRefreshVOP)
+        self->force_sync = 1;
+      break;
+    }
+    case OMX_IndexConfigVideoBitrate:{
+      OMX_VIDEO_CONFIG_BITRATETYPE *c = config;
+
+      if ((err = mock_omx_check_param (self, config, sizeof (*c), &port)))
+        break;
+
+      if (self->info->kind != MOCK_OMX_VIDEO_ENCODER
+          || !mock_omx_port_is_compressed_video (port)) {
+        err = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+      port->bitrate.nTargetBitrate = c->nEncodeBitrate;
+      break;
+    }
+    default:
+      err = OMX_ErrorUnsupportedIndex;
+      break;
+  }
+  pthread_mutex_unlock (&self->lock);
+
+  return err;
+}
+
+static OMX_ERRORTYPE
+mock_omx_get_extension_index (OMX_HANDLETYPE handle, OMX_STRING name,
+    OMX_INDEXTYPE * index)
+{
+  return OMX_ErrorUnsupportedIndex;
+}
+
+static OMX_ERRORTYPE
+mock_omx_get_state (OMX_HANDLETYPE handle, OMX_STATETYPE * state)
+{
+  MockOMXComponent *self = mock_omx_get (handle);
+
+  if (!self || !state)
+    return OMX_ErrorBadParameter;
+
+  pthread_mutex_lock (&self->lock);
+  *state = self->state;
+  pthread_mutex_unlock (&self->lock);
+
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+mock_omx_component_tunnel_request (OMX_HANDLETYPE handle, OMX_U32 port,
+    OMX_HANDLETYPE tunneled_handle, OMX_U32 tunneled_port,
+    OMX_TUNNELSETUPTYPE * setup)
+{
+  return OMX_ErrorNotImplemented;
+}
+
+static OMX_ERRORTYPE
+mock_omx_add_buffer (MockOMXComponent * self, OMX_BUFFERHEADERTYPE ** header,
+    OMX_U32 port_index, OMX_PTR app_private, OMX_U32 size, OMX_U8 * data)
+{
+  MockOMXPort *port;
+  MockOMXBuffer *buf;
+  OMX_ERRORTYPE err = OMX_ErrorNone;
+
+  if (!header)
+    return OMX_ErrorBadParameter;
+
+  pthread_mutex_lock (&self->lock);
+  if (!(port = mock_omx_get_port (self, port_index))) {
+    err = OMX_ErrorBadPortIndex;
+    goto done;
+  }
+
+  if (self->state != OMX_StateLoaded && self->state != OMX_StateIdle
+      && !port->def.bEnabled) {
+    err = OMX_ErrorIncorrectStateOperation;
+    goto done;
+  }
+
+  if (size < port->def.nBufferSize) {
+    fprintf (stderr, "mockomx: %s port %u buffer of %u bytes is smaller "
+        "than %u bytes\n", self->info->role, (unsigned) port_index,
+        (unsigned) size, (unsigned) port->def.nBufferSize);
+    err = OMX_ErrorBadParameter;
+    goto done;
+  }
+
+  if (port->n_buffers >= port->def.nBufferCountActual) {
+    err = OMX_ErrorInsufficientResources;
+    goto done;
+  }
+
+  buf = calloc (1, sizeof (MockOMXBuffer));
+  if (!buf) {
+    err = OMX_ErrorInsufficientResources;
+    goto done;
+  }
+
+  if (!data) {
+    size_t alignment = port->def.nBufferAlignment;
+
+    if (alignment < sizeof (void *))
+      alignment = sizeof (void *);
+    if (posix_memalign ((void **) &data, alignment, size) != 0) {
+      free (buf);
+      err = OMX_ErrorInsufficientResources;
+      goto done;
+    }
+    buf->allocated = 1;
+  }
+
+  MOCK_OMX_INIT_STRUCT (&buf->header);
+  buf->header.pBuffer = data;
+  buf->header.nAllocLen = size;
+  buf->header.pAppPrivate = app_private;
+  buf->header.pPlatformPrivate = self;
+  if (port->def.eDir == OMX_DirInput) {
+    buf->header.nInputPortIndex = port_index;
+    buf->header.nOutputPortIndex = OMX_ALL;
+  } else {
+    buf->header.nInputPortIndex = OMX_ALL;
+    buf->header.nOutputPortIndex = port_index;
+  }
+
+  port->buffers[port->n_buffers++] = buf;
+  *header = &buf->header;
+
+  pthread_mutex_lock (&core_lock);
+  mock_omx_get_counters (self, port_index)->n_buffers_added++;
+  pthread_mutex_unlock (&core_lock);
+
+  /* Might finish a state change or port enable */
+  pthread_cond_signal (&self->cond);
+
+done:
+  pthread_mutex_unlock (&self->lock);
+
+  return err;
+}
+
+static OMX_ERRORTYPE
+mock_omx_use_buffer (OMX_HANDLETYPE handle, OMX_BUFFERHEADERTYPE ** header,
+    OMX_U32 port_index, OMX_PTR app_private, OMX_U32 size, OMX_U8 * data)
+{
+  MockOMXComponent *self = mock_omx_get (handle);
+
+  if (!self || !data)
+    return OMX_ErrorBadParameter;
+
+  return mock_omx_add_buffer (self, header, port_index, app_private, size,
+      data);
+}
+
+static OMX_ERRORTYPE
+mock_omx_allocate_buffer (OMX_HANDLETYPE handle,
+    OMX_BUFFERHEADERTYPE ** header, OMX_U32 port_index, OMX_PTR app_private,
+    OMX_U32 size)
+{
+  MockOMXComponent *self = mock_omx_get (handle);
+
+  if (!self)
+    return OMX_ErrorBadParameter;
+
+  return mock_omx_add_buffer (self, header, port_index, app_private, size,
+      NULL);
+}
+
+static void
+mock_omx_buffer_free (MockOMXBuffer * buf)
+{
+  if (buf->allocated)
+    free (buf->header.pBuffer);
+  free (buf);
+}
+
+static OMX_ERRORTYPE
+mock_omx_free_buffer (OMX_HANDLETYPE handle, OMX_U32 port_index,
+    OMX_BUFFERHEADERTYPE * header)
+{
+  MockOMXComponent *self = mock_omx_get (handle);
+  MockOMXPort *port;
+  OMX_ERRORTYPE err = OMX_ErrorBadParameter;
+  OMX_U32 i;
+
+  if (!self || !header)
+    return OMX_ErrorBadParameter;
+
+  pthread_mutex_lock (&self->lock);
+  if (!(port = mock_omx_get_port (self, port_index))) {
+    err = OMX_ErrorBadPortIndex;
+    goto done;
+  }
+
+  for (i = 0; i < port->n_buffers; i++) {
+    MockOMXBuffer *buf = port->buffers[i];
+
+    if (&buf->header != header)
+      continue;
+
+    if (buf->held)
+      mock_omx_port_remove (port, buf);
+
+    port->buffers[i] = port->buffers[--port->n_buffers];
+    port->buffers[port->n_buffers] = NULL;
+    mock_omx_buffer_free (buf);
+    err = OMX_ErrorNone;
+
+    /* Might finish a state change or port disable */
+    pthread_cond_signal (&self->cond);
+    break;
+  }
+
+done:
+  pthread_mutex_unlock (&self->lock);
+
+  return err;
+}
+
+static OMX_ERRORTYPE
+mock_omx_queue_buffer (OMX_HANDLETYPE handle, OMX_BUFFERHEADERTYPE * header,
+    OMX_DIRTYPE dir)
+{
+  MockOMXComponent *self = mock_omx_get (handle);
+  MockOMXBuffer *buf = (MockOMXBuffer *) header;
+  MockOMXPort *port;
+  OMX_U32 port_index;
+  OMX_ERRORTYPE err = OMX_ErrorNone;
+
+  if (!self || !header || header->pPlatformPrivate != self)
+    return OMX_ErrorBadParameter;
+
+  port_index = (dir == OMX_DirInput) ? header->nInputPortIndex :
+      header->nOutputPortIndex;
+
+  pthread_mutex_lock (&self->lock);
+  if (!(port = mock_omx_get_port (self, port_index))
+      || port->def.eDir != dir) {
+    err = OMX_ErrorBadPortIndex;
+    goto done;
+  }
+
+  if (self->state != OMX_StateIdle && self->state != OMX_StateExecuting
+      && self->state != OMX_StatePause) {
+    err = OMX_ErrorIncorrectStateOperation;
+    goto done;
+  }
+
+  if (!port->def.bEnabled) {
+    err = OMX_ErrorIncorrectStateOperation;
+    goto done;
+  }
+
+  if (buf->held) {
+    fprintf (stderr, "mockomx: %s port %u buffer %p passed twice\n",
+        self->info->role, (unsigned) port_index, header);
+    err = OMX_ErrorBadParameter;
+    goto done;
+  }
+
+  if (dir == OMX_DirInput) {
+    if (header->nOffset + header->nFilledLen > header->nAllocLen) {
+      err = OMX_ErrorBadParameter;
+      goto done;
+    }
+    buf->due = self->options.latency ?
+        mock_omx_now () + self->options.latency : 0;
+  }
+
+  mock_omx_port_push (port, buf);
+  pthread_cond_signal (&self->cond);
+
+done:
+  pthread_mutex_unlock (&self->lock);
+
+  return err;
+}
+
+static OMX_ERRORTYPE
+mock_omx_empty_this_buffer (OMX_HANDLETYPE handle,
+    OMX_BUFFERHEADERTYPE * header)
+{
+  return mock_omx_queue_buffer (handle, header, OMX_DirInput);
+}
+
+static OMX_ERRORTYPE
+mock_omx_fill_this_buffer (OMX_HANDLETYPE handle,
+    OMX_BUFFERHEADERTYPE * header)
+{
+  return mock_omx_queue_buffer (handle, header, OMX_DirOutput);
+}
+
+static OMX_ERRORTYPE
+mock_omx_set_callbacks (OMX_HANDLETYPE handle, OMX_CALLBACKTYPE * callbacks,
+    OMX_PTR app_data)
+{
+  MockOMXComponent *self = mock_omx_get (handle);
+
+  if (!self || !callbacks)
+    return OMX_ErrorBadParameter;
+
+  pthread_mutex_lock (&self->lock);
+  self->callbacks = *callbacks;
+  self->app_data = app_data;
+  self->handle.pApplicationPrivate = app_data;
+  pthread_mutex_unlock (&self->lock);
+
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+mock_omx_component_deinit (OMX_HANDLETYPE handle)
+{
+  MockOMXComponent *self = mock_omx_get (handle);
+  OMX_U32 i, j;
+
+  if (!self)
+    return OMX_ErrorBadParameter;
+
+  pthread_mutex_lock (&self->lock);
+  self->running = 0;
+  pthread_cond_signal (&self->cond);
+  pthread_mutex_unlock (&self->lock);
+  pthread_join (self->thread, NULL);
+
+  mock_omx_state_change_end (self);
+
+  /* Clients are supposed to free all buffers first */
+  for (i = 0; i < MOCK_OMX_N_PORTS; i++) {
+    for (j = 0; j < self->ports[i].n_buffers; j++)
+      mock_omx_buffer_free (self->ports[i].buffers[j]);
+  }
+
+  pthread_cond_destroy (&self->cond);
+  pthread_mutex_destroy (&self->lock);
+  free (self->outbox);
+  free (self);
+
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+mock_omx_use_egl_image (OMX_HANDLETYPE handle, OMX_BUFFERHEADERTYPE ** header,
+    OMX_U32 port_index, OMX_PTR app_private, void *egl_image)
+{
+  return OMX_ErrorNotImplemented;
+}
+
+static OMX_ERRORTYPE
+mock_omx_component_role_enum (OMX_HANDLETYPE handle, OMX_U8 * role,
+    OMX_U32 index)
+{
+  MockOMXComponent *self = mock_omx_get (handle);
+
+  if (!self || !role)
+    return OMX_ErrorBadParameter;
+
+  if (index > 0)
+    return OMX_ErrorNoMore;
+
+  snprintf ((char *) role, OMX_MAX_STRINGNAME_SIZE, "%s", self->info->role);
+
+  return OMX_ErrorNone;
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY
+OMX_Init (void)
+{
+  pthread_mutex_lock (&core_lock);
+  core_refcount++;
+  pthread_mutex_unlock (&core_lock);
+
+  return OMX_ErrorNone;
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY
+OMX_Deinit (void)
+{
+  OMX_ERRORTYPE err = OMX_ErrorNone;
+
+  pthread_mutex_lock (&core_lock);
+  if (core_refcount > 0)
+    core_refcount--;
+  else
+    err = OMX_ErrorNotReady;
+  pthread_mutex_unlock (&core_lock);
+
+  return err;
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY
+OMX_ComponentNameEnum (OMX_STRING name, OMX_U32 length, OMX_U32 index)
+{
+  if (!name)
+    return OMX_ErrorBadParameter;
+
+  if (index >= MOCK_OMX_N_COMPONENTS)
+    return OMX_ErrorNoMore;
+
+  snprintf (name, length, MOCK_OMX_PREFIX "%s", components[index].role);
+
+  return OMX_ErrorNone;
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY
+OMX_GetHandle (OMX_HANDLETYPE * handle, OMX_STRING name, OMX_PTR app_data,
+    OMX_CALLBACKTYPE * callbacks)
+{
+  const MockOMXComponentInfo *info = NULL;
+  MockOMXComponent *self;
+  pthread_condattr_t attr;
+  unsigned int i;
+
+  if (!handle || !name || !callbacks)
+    return OMX_ErrorBadParameter;
+
+  if (strncmp (name, MOCK_OMX_PREFIX, strlen (MOCK_OMX_PREFIX)) == 0) {
+    for (i = 0; i < MOCK_OMX_N_COMPONENTS; i++) {
+      if (strcmp (name + strlen (MOCK_OMX_PREFIX), components[i].role) == 0) {
+        info = &components[i];
+        break;
+      }
+    }
+  }
+
+  if (!info)
+    return OMX_ErrorComponentNotFound;
+
+  self = calloc (1, sizeof (MockOMXComponent));
+  if (!self)
+    return OMX_ErrorInsufficientResources;
+
+  self->info = info;
+
+  pthread_mutex_lock (&core_lock);
+  n_handles[info - components]++;
+  pthread_mutex_unlock (&core_lock);
+  mock_omx_options_parse (&self->options);
+
+  MOCK_OMX_INIT_STRUCT (&self->handle);
+  self->handle.pComponentPrivate = self;
+  self->handle.pApplicationPrivate = app_data;
+  self->handle.GetComponentVersion = mock_omx_get_component_version;
+  self->handle.SendCommand = mock_omx_send_command;
+  self->handle.GetParameter = mock_omx_get_parameter;
+  self->handle.SetParameter = mock_omx_set_parameter;
+  self->handle.GetConfig = mock_omx_get_config;
+  self->handle.SetConfig = mock_omx_set_config;
+  self->handle.GetExtensionIndex = mock_omx_get_extension_index;
+  self->handle.GetState = mock_omx_get_state;
+  self->handle.ComponentTunnelRequest = mock_omx_component_tunnel_request;
+  self->handle.UseBuffer = mock_omx_use_buffer;
+  self->handle.AllocateBuffer = mock_omx_allocate_buffer;
+  self->handle.FreeBuffer = mock_omx_free_buffer;
+  self->handle.EmptyThisBuffer = mock_omx_empty_this_buffer;
+  self->handle.FillThisBuffer = mock_omx_fill_this_buffer;
+  self->handle.SetCallbacks = mock_omx_set_callbacks;
+  self->handle.ComponentDeInit = mock_omx_component_deinit;
+  self->handle.UseEGLImage = mock_omx_use_egl_image;
+  self->handle.ComponentRoleEnum = mock_omx_component_role_enum;
+
+  self->callbacks = *callbacks;
+  self->app_data = app_data;
+
+  self->state = OMX_StateLoaded;
+  mock_omx_init_ports (self);
+  if (mock_omx_has_output (self))
+    mock_omx_update_output_settings (self);
+  self->settings_initial = (info->kind == MOCK_OMX_VIDEO_DECODER
+      || info->kind == MOCK_OMX_AUDIO_DECODER);
+
+  pthread_mutex_init (&self->lock, NULL);
+  pthread_condattr_init (&attr);
+  pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+  pthread_cond_init (&self->cond, &attr);
+  pthread_condattr_destroy (&attr);
+
+  self->running = 1;
+  if (pthread_create (&self->thread, NULL, mock_omx_thread, self) != 0) {
+    pthread_cond_destroy (&self->cond);
+    pthread_mutex_destroy (&self->lock);
+    free (self);
+    return OMX_ErrorInsufficientResources;
+  }
+
+  *handle = &self->handle;
+
+  return OMX_ErrorNone;
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY
+OMX_FreeHandle (OMX_HANDLETYPE handle)
+{
+  if (!mock_omx_get (handle))
+    return OMX_ErrorBadParameter;
+
+  return mock_omx_component_deinit (handle);
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY
+OMX_SetupTunnel (OMX_HANDLETYPE output, OMX_U32 output_port,
+    OMX_HANDLETYPE input, OMX_U32 input_port)
+{
+  /* Base profile components don't support tunneling */
+  return OMX_ErrorNotImplemented;
+}
+
+static int
+mock_omx_find_component (const char *role)
+{
+  unsigned int i;
+
+  if (role) {
+    for (i = 0; i < MOCK_OMX_N_COMPONENTS; i++) {
+      if (strcmp (role, components[i].role) == 0)
+        return i;
+    }
+  }
+
+  return -1;
+}
+
+int
+MockOMX_GetHandleCount (const char *role, unsigned int *n_created)
+{
+  int i = mock_omx_find_component (role);
+
+  if (i < 0 || !n_created)
+    return 0;
+
+  pthread_mutex_lock (&core_lock);
+  *n_created = n_handles[i];
+  pthread_mutex_unlock (&core_lock);
+
+  return 1;
+}
+
+unsigned int
+MockOMX_TakeStateChangeOverlap (void)
+{
+  unsigned int ret;
+
+  pthread_mutex_lock (&core_lock);
+  ret = max_state_changes;
+  max_state_changes = n_state_changes;
+  pthread_mutex_unlock (&core_lock);
+
+  return ret;
+}
+
+int
+MockOMX_GetPortCounters (const char *role, unsigned int port_index,
+    unsigned int *n_disabled, unsigned int *n_buffers_added)
+{
+  int i = mock_omx_find_component (role);
+
+  if (i < 0 || port_index >= MOCK_OMX_N_PORTS)
+    return 0;
+
+  pthread_mutex_lock (&core_lock);
+  if (n_disabled)
+    *n_disabled = counters[i][port_index].n_disabled;
+  if (n_buffers_added)
+    *n_buffers_added = counters[i][port_index].n_buffers_added;
+  pthread_mutex_unlock (&core_lock);
+
+  return 1;
+}
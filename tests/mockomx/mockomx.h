@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2026, RidgeRun
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __MOCK_OMX_H__
+#define __MOCK_OMX_H__
+
+/* Functions of the mock core that are not part of OpenMAX IL. Tests look
+ * them up in the core the elements loaded, the types of the pointers
+ * they get are given as well */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Returns how many components with the given role (e.g.
+ * "video_decoder.avc") were created since the core was loaded, or 0 if
+ * there is no such role */
+int MockOMX_GetHandleCount (const char *role, unsigned int *n_created);
+typedef int (*MockOMXGetHandleCount) (const char *role,
+    unsigned int *n_created);
+
+/* Returns how often a port of the components with the given role was
+ * disabled and how many buffers were added to it since the core was
+ * loaded, or 0 if there is no such role or port */
+int MockOMX_GetPortCounters (const char *role, unsigned int port_index,
+    unsigned int *n_disabled, unsigned int *n_buffers_added);
+typedef int (*MockOMXGetPortCounters) (const char *role,
+    unsigned int port_index, unsigned int *n_disabled,
+    unsigned int *n_buffers_added);
+
+/* Returns the most components that were changing their state at the same
+ * time since the last call */
+unsigned int MockOMX_TakeStateChangeOverlap (void);
+typedef unsigned int (*MockOMXTakeStateChangeOverlap) (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MOCK_OMX_H__ */